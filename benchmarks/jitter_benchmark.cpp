@@ -0,0 +1,301 @@
+#include "correlator/OpenCLFFTBackend.hpp"
+#include "correlator/RealtimeMemory.hpp"
+#include "correlator/StaticCorrelationPipeline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <sched.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace Correlator;
+
+// ============================================================================
+// Jitter benchmark: хвост задержки батча с режимом реального времени и без
+// ============================================================================
+//
+// Каждый режим — отдельный процесс (fork/exec самого себя через popen):
+// mlockall и настройки malloc необратимы, а прогретая куча одного режима
+// не должна влиять на другой.
+//
+//   off — как обычный запуск: без mlockall, префолта и закрепления потока
+//   rt  — StaticCorrelationPipeline::enableRealtimeMode() после initialize()
+//
+// Батч — executeStep2 + executeStep3 (Step 1 один раз), первые warmup батчей
+// в статистику не входят. Логи FFTHandler в дочернем процессе уходят в /dev/null.
+//
+// Использование:
+//   JitterBenchmark [--batches K] [--warmup K] [--mode off|rt|both] [--cpu C] [--fifo P]
+//   JitterBenchmark --child off|rt batches warmup cpu fifo   (внутренний режим)
+
+// Форма батча фиксирована при компиляции (StaticCorrelationPipeline)
+using JitterPipeline = StaticCorrelationPipeline<OpenCLFFTBackend, 4096, 8, 16, 5>;
+
+struct JitterResult {
+    std::string mode;
+    double p50_us = 0.0;
+    double p90_us = 0.0;
+    double p99_us = 0.0;
+    double p999_us = 0.0;
+    double p9999_us = 0.0;
+    double max_us = 0.0;
+    double mean_us = 0.0;
+    unsigned long long minor_faults = 0;
+    unsigned long long major_faults = 0;
+    std::string status;
+};
+
+// Ближайший ранг по отсортированным значениям
+static double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(fraction * static_cast<double>(sorted.size()));
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+// ============================================================================
+// Дочерний режим: прогон батчей и вывод в машиночитаемом виде
+// ============================================================================
+
+static int run_child(int argc, char** argv) {
+    if (argc < 7) {
+        fprintf(stderr, "ERROR: --child requires mode batches warmup cpu fifo\n");
+        return 2;
+    }
+    const bool realtime = std::strcmp(argv[2], "rt") == 0;
+    const size_t batches = std::strtoull(argv[3], nullptr, 10);
+    const size_t warmup = std::strtoull(argv[4], nullptr, 10);
+    const int cpu = std::atoi(argv[5]);
+    const int fifo = std::atoi(argv[6]);
+
+    // Результаты — в исходный stdout, подробные логи шагов — в /dev/null
+    FILE* out = fdopen(dup(fileno(stdout)), "w");
+    if (!out || !std::freopen("/dev/null", "w", stdout)) {
+        return 1;
+    }
+
+    std::vector<int32_t> reference(JitterPipeline::kReferenceSamples);
+    std::vector<int32_t> inputs(JitterPipeline::kInputSamples);
+    uint32_t lfsr = 0xACE1u;
+    auto next_chip = [&lfsr]() {
+        lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+        return (lfsr & 1u) ? 1000 : -1000;
+    };
+    for (auto& value : reference) value = next_chip();
+    for (auto& value : inputs) value = next_chip();
+
+    auto pipeline = std::make_unique<JitterPipeline>();
+    if (!pipeline->initialize() ||
+        !pipeline->executeStep1(JitterPipeline::ReferenceSpan(reference.data(), reference.size()))) {
+        return 1;
+    }
+
+    // Массив задержек выделяется до замера в обоих режимах
+    std::vector<double> latencies(batches, 0.0);
+
+    RealtimeStatus status;
+    if (realtime) {
+        RealtimeOptions options;
+        options.cpu = cpu >= 0 ? cpu : sched_getcpu();
+        options.fifo_priority = fifo;
+        status = pipeline->enableRealtimeMode(options);
+        status.prefaulted_bytes += prefaultSpan(std::span(latencies));
+    }
+
+    const JitterPipeline::InputSpan input_span(inputs.data(), inputs.size());
+    for (size_t i = 0; i < warmup; ++i) {
+        if (!pipeline->executeStep2(input_span) || !pipeline->executeStep3()) {
+            return 1;
+        }
+    }
+
+    const PageFaultCounters faults_start = PageFaultCounters::current();
+    for (size_t i = 0; i < batches; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        if (!pipeline->executeStep2(input_span) || !pipeline->executeStep3()) {
+            return 1;
+        }
+        auto end = std::chrono::steady_clock::now();
+        latencies[i] = std::chrono::duration<double, std::micro>(end - start).count();
+    }
+    const PageFaultCounters faults = PageFaultCounters::current() - faults_start;
+
+    double sum = 0.0;
+    for (double value : latencies) sum += value;
+    std::sort(latencies.begin(), latencies.end());
+
+    fprintf(out, "[JITTER] LATENCY\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n",
+            percentile(latencies, 0.50), percentile(latencies, 0.90), percentile(latencies, 0.99),
+            percentile(latencies, 0.999), percentile(latencies, 0.9999),
+            latencies.empty() ? 0.0 : latencies.back(), latencies.empty() ? 0.0 : sum / latencies.size());
+    fprintf(out, "[JITTER] FAULTS\t%llu\t%llu\n",
+            static_cast<unsigned long long>(faults.minor), static_cast<unsigned long long>(faults.major));
+    if (realtime) {
+        fprintf(out, "[JITTER] STATUS\tmlock=%s malloc=%s pinned=%s fifo=%s prefaulted=%zuKB\n",
+                status.memory_locked ? "yes" : "no", status.malloc_tuned ? "yes" : "no",
+                status.thread_pinned ? "yes" : "no", status.fifo_scheduling ? "yes" : "no",
+                status.prefaulted_bytes / 1024);
+    }
+    fflush(out);
+    return 0;
+}
+
+// ============================================================================
+// Запуск режима в отдельном процессе
+// ============================================================================
+
+static std::string self_executable_path() {
+    char path[4096] = {0};
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len <= 0) {
+        return "./JitterBenchmark";
+    }
+    return std::string(path, static_cast<size_t>(len));
+}
+
+static bool measure_mode(const std::string& self_path, const std::string& mode, size_t batches, size_t warmup,
+                         int cpu, int fifo, JitterResult& result) {
+    char command[8192];
+    std::snprintf(command, sizeof(command), "\"%s\" --child %s %zu %zu %d %d",
+                  self_path.c_str(), mode.c_str(), batches, warmup, cpu, fifo);
+
+    FILE* pipe = popen(command, "r");
+    if (!pipe) {
+        return false;
+    }
+
+    result.mode = mode;
+    bool has_latency = false;
+    char line[1024];
+    while (std::fgets(line, sizeof(line), pipe)) {
+        if (std::strncmp(line, "[JITTER] ", 9) != 0) {
+            continue;
+        }
+        char* fields = line + 9;
+        fields[std::strcspn(fields, "\r\n")] = '\0';
+
+        if (std::strncmp(fields, "LATENCY\t", 8) == 0) {
+            has_latency = std::sscanf(fields + 8, "%lf\t%lf\t%lf\t%lf\t%lf\t%lf\t%lf",
+                                      &result.p50_us, &result.p90_us, &result.p99_us, &result.p999_us,
+                                      &result.p9999_us, &result.max_us, &result.mean_us) == 7;
+        } else if (std::strncmp(fields, "FAULTS\t", 7) == 0) {
+            std::sscanf(fields + 7, "%llu\t%llu", &result.minor_faults, &result.major_faults);
+        } else if (std::strncmp(fields, "STATUS\t", 7) == 0) {
+            result.status = fields + 7;
+        }
+    }
+
+    return pclose(pipe) == 0 && has_latency;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--child") == 0) {
+        return run_child(argc, argv);
+    }
+
+    size_t batches = 100000;
+    size_t warmup = 1000;
+    std::string mode = "both";
+    int cpu = -1;
+    int fifo = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--batches") == 0 && i + 1 < argc) {
+            batches = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (std::strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            cpu = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--fifo") == 0 && i + 1 < argc) {
+            fifo = std::atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--batches K] [--warmup K] [--mode off|rt|both] [--cpu C] [--fifo P]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (mode != "off" && mode != "rt" && mode != "both") {
+        fprintf(stderr, "ERROR: unknown mode '%s'\n", mode.c_str());
+        return 2;
+    }
+
+    const std::string self_path = self_executable_path();
+
+    printf("\n========== JITTER BENCHMARK ==========\n");
+    printf("Shape: N=%zu, shifts=%d, signals=%d, n_kg=%d; batches: %zu (+%zu warmup)\n\n",
+           JitterPipeline::kFFTSize, JitterPipeline::kNumShifts, JitterPipeline::kNumSignals,
+           JitterPipeline::kNumOutputPoints, batches, warmup);
+
+    std::vector<JitterResult> results;
+    for (const std::string candidate : {"off", "rt"}) {
+        if (mode != "both" && mode != candidate) {
+            continue;
+        }
+        printf("[MODE] %s...\n", candidate.c_str());
+        JitterResult result;
+        if (measure_mode(self_path, candidate, batches, warmup, cpu, fifo, result)) {
+            results.push_back(result);
+        } else {
+            fprintf(stderr, "  WARNING: mode %s failed\n", candidate.c_str());
+        }
+    }
+    if (results.empty()) {
+        return 1;
+    }
+
+    // ========================================================================
+    // Сводка в консоль и Markdown отчёт
+    // ========================================================================
+
+    auto now = std::time(nullptr);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    char timestamp_str[100];
+    std::strftime(timestamp_str, sizeof(timestamp_str), "%Y-%m-%d_%H-%M-%S", &timeinfo);
+
+    std::filesystem::create_directories("Report");
+    std::string report_path = std::string("Report/jitter_benchmark_") + timestamp_str + ".md";
+    std::ofstream report(report_path);
+
+    report << "# ⏱ Jitter benchmark: хвост задержки батча\n\n";
+    report << "**Timestamp:** " << timestamp_str << "\n\n";
+    report << "Батч — Step 2 + Step 3, N=" << JitterPipeline::kFFTSize << ", shifts=" << JitterPipeline::kNumShifts
+           << ", signals=" << JitterPipeline::kNumSignals << "; " << batches << " батчей после " << warmup
+           << " прогревочных. Значения — мкс, page fault'ы — за все замеренные батчи.\n\n";
+    report << "| Режим | p50 | p90 | p99 | p99.9 | p99.99 | max | mean | minor faults | major faults |\n";
+    report << "|-------|-----|-----|-----|-------|--------|-----|------|--------------|--------------|\n";
+
+    printf("\n%-6s %10s %10s %10s %10s %10s %10s %10s %10s %8s\n",
+           "mode", "p50_us", "p90_us", "p99_us", "p99.9_us", "p99.99_us", "max_us", "mean_us", "minflt", "majflt");
+
+    for (const auto& result : results) {
+        printf("%-6s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10llu %8llu\n",
+               result.mode.c_str(), result.p50_us, result.p90_us, result.p99_us, result.p999_us,
+               result.p9999_us, result.max_us, result.mean_us, result.minor_faults, result.major_faults);
+
+        char row[512];
+        std::snprintf(row, sizeof(row), "| %s | %.1f | %.1f | %.1f | %.1f | %.1f | %.1f | %.1f | %llu | %llu |\n",
+                      result.mode.c_str(), result.p50_us, result.p90_us, result.p99_us, result.p999_us,
+                      result.p9999_us, result.max_us, result.mean_us, result.minor_faults, result.major_faults);
+        report << row;
+    }
+    report << "\n";
+
+    for (const auto& result : results) {
+        if (!result.status.empty()) {
+            printf("\n[%s] %s\n", result.mode.c_str(), result.status.c_str());
+            report << "**" << result.mode << ":** " << result.status << "\n\n";
+        }
+    }
+
+    report.close();
+    printf("\n✓ Jitter report saved: %s\n", report_path.c_str());
+    return 0;
+}
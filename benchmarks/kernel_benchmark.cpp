@@ -0,0 +1,712 @@
+#include "cpu_converter.hpp"
+#include "gpu_converter.hpp"
+#include "profiler.hpp"
+#include <CL/cl.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <functional>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <ctime>
+
+#ifndef CORRELATOR_KERNEL_DIR
+#define CORRELATOR_KERNEL_DIR "src"
+#endif
+
+// ============================================================================
+// Kernel micro-benchmark: каждое ядро из src/*.cl отдельно
+// ============================================================================
+//
+// Каждый .cl файл собирается как самостоятельная программа, ядро запускается
+// на сетке размеров N и local size, результат сверяется с CPU путём
+// (cpu_converter.cpp или эталонный цикл), выводится GB/s по каждому варианту.
+//
+// По умолчанию используется CPU устройство (pocl), GPU не требуется.
+//
+// Использование:
+//   KernelBenchmark [--gpu] [--sizes 4096,32768,262144] [--reps 10] [--kernel-dir DIR]
+
+struct BenchContext {
+    cl_context context = nullptr;
+    cl_device_id device = nullptr;
+    cl_command_queue queue = nullptr;
+    std::string device_name;
+    size_t max_work_group_size = 0;
+};
+
+/**
+ * Подготовленный запуск ядра для конкретного N
+ */
+struct PreparedCase {
+    std::vector<cl_mem> buffers;      // Все буферы (освобождаются после прогона)
+    cl_mem output = nullptr;          // Проверяемый выход
+    std::vector<float> expected;      // Эталон с CPU (как массив float)
+    size_t global_size = 0;           // Количество work-items
+    double bytes_moved = 0.0;         // Трафик глобальной памяти за запуск
+    int local_arg_index = -1;         // Индекс __local аргумента (если есть)
+    size_t local_arg_elem_size = 0;   // Размер элемента __local буфера на work-item
+    float tolerance = 1e-5f;          // Допуск (относительный)
+};
+
+using PrepareFn = std::function<bool(BenchContext&, cl_kernel, size_t, PreparedCase&)>;
+
+struct KernelCase {
+    const char* file;                 // .cl файл
+    const char* kernel;               // Имя ядра
+    const char* group;                // Группа сравнения (одинаковая работа)
+    bool requires_local_size;         // __local аргумент требует явный local size
+    PrepareFn prepare;
+};
+
+struct CaseResult {
+    std::string file;
+    std::string kernel;
+    std::string group;
+    size_t N = 0;
+    size_t local_size = 0;            // 0 = выбор драйвера
+    double median_ms = 0.0;
+    double gbps = 0.0;
+    bool valid = false;
+};
+
+// Параметры батча для ядер с несколькими сигналами/сдвигами
+static const int kBatch = 8;          // сигналов / сдвигов в батче
+static const int kSignals3 = 4;       // Step 3: сигналов
+static const int kShifts3 = 4;        // Step 3: сдвигов
+static const float kScale = 1.0f / 32768.0f;
+
+// ============================================================================
+// Вспомогательные функции
+// ============================================================================
+
+static cl_int select_device(cl_device_type device_type, BenchContext& ctx) {
+    cl_uint num_platforms = 0;
+    cl_int err = clGetPlatformIDs(0, nullptr, &num_platforms);
+    if (err != CL_SUCCESS || num_platforms == 0) {
+        return err != CL_SUCCESS ? err : CL_DEVICE_NOT_FOUND;
+    }
+
+    std::vector<cl_platform_id> platforms(num_platforms);
+    clGetPlatformIDs(num_platforms, platforms.data(), nullptr);
+
+    // pocl может быть не первой платформой — перебираем все
+    for (cl_platform_id platform : platforms) {
+        if (clGetDeviceIDs(platform, device_type, 1, &ctx.device, nullptr) == CL_SUCCESS) {
+            break;
+        }
+        ctx.device = nullptr;
+    }
+    if (!ctx.device) {
+        return CL_DEVICE_NOT_FOUND;
+    }
+
+    char name[256] = {0};
+    clGetDeviceInfo(ctx.device, CL_DEVICE_NAME, sizeof(name), name, nullptr);
+    ctx.device_name = name;
+    clGetDeviceInfo(ctx.device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &ctx.max_work_group_size, nullptr);
+
+    ctx.context = clCreateContext(nullptr, 1, &ctx.device, nullptr, nullptr, &err);
+    if (err != CL_SUCCESS) return err;
+
+    cl_queue_properties props[] = {CL_QUEUE_PROPERTIES, CL_QUEUE_PROFILING_ENABLE, 0};
+    ctx.queue = clCreateCommandQueueWithProperties(ctx.context, ctx.device, props, &err);
+    return err;
+}
+
+static cl_program build_program(BenchContext& ctx, const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        fprintf(stderr, "ERROR: Cannot open kernel file '%s'\n", path.c_str());
+        return nullptr;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string source = buffer.str();
+
+    const char* source_ptr = source.c_str();
+    size_t source_len = source.size();
+    cl_int err = CL_SUCCESS;
+    cl_program program = clCreateProgramWithSource(ctx.context, 1, &source_ptr, &source_len, &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "ERROR [clCreateProgramWithSource %s]: %s\n", path.c_str(), get_cl_error_string(err));
+        return nullptr;
+    }
+
+    err = clBuildProgram(program, 1, &ctx.device, "", nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program, ctx.device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+        std::vector<char> log(log_size + 1, '\0');
+        clGetProgramBuildInfo(program, ctx.device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
+        fprintf(stderr, "COMPILE ERROR (%s):\n%s\n", path.c_str(), log.data());
+        clReleaseProgram(program);
+        return nullptr;
+    }
+    return program;
+}
+
+static cl_mem make_buffer(BenchContext& ctx, PreparedCase& pc, cl_mem_flags flags, size_t bytes, const void* host) {
+    cl_int err = CL_SUCCESS;
+    cl_mem mem = clCreateBuffer(ctx.context, flags | (host ? CL_MEM_COPY_HOST_PTR : 0),
+                                bytes, const_cast<void*>(host), &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "ERROR [clCreateBuffer %zu bytes]: %s\n", bytes, get_cl_error_string(err));
+        return nullptr;
+    }
+    pc.buffers.push_back(mem);
+    return mem;
+}
+
+template <typename T>
+static void set_arg(cl_kernel kernel, cl_uint index, const T& value) {
+    clSetKernelArg(kernel, index, sizeof(T), &value);
+}
+
+// Детерминированный сигнал int16-диапазона (точно представим после масштабирования)
+static std::vector<int32_t> make_signal(size_t count, uint32_t seed) {
+    std::vector<int32_t> data(count);
+    uint32_t state = seed * 2654435761u + 1u;
+    for (size_t i = 0; i < count; ++i) {
+        state = state * 1664525u + 1013904223u;
+        data[i] = static_cast<int32_t>((state >> 16) & 0xFFFF) - 32768;
+    }
+    return data;
+}
+
+static std::vector<float> make_complex(size_t count, uint32_t seed) {
+    std::vector<float> data(2 * count);
+    uint32_t state = seed * 2246822519u + 7u;
+    for (auto& value : data) {
+        state = state * 1664525u + 1013904223u;
+        value = static_cast<float>(static_cast<int32_t>(state >> 8) % 20001) / 10000.0f;
+    }
+    return data;
+}
+
+static std::vector<float> flatten(const std::vector<cl_float2>& values) {
+    std::vector<float> out(2 * values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        out[2 * i] = values[i].s[0];
+        out[2 * i + 1] = values[i].s[1];
+    }
+    return out;
+}
+
+// ============================================================================
+// Подготовка ядер (аргументы + эталон CPU)
+// ============================================================================
+
+// int32 → float2 для B сигналов (эталон: convert_input_signals_cpu)
+static PrepareFn prepare_flat_conversion(bool data_first, bool with_count_and_scale_swapped) {
+    return [=](BenchContext& ctx, cl_kernel kernel, size_t N, PreparedCase& pc) {
+        size_t count = N * kBatch;
+        auto input = make_signal(count, 1);
+        cl_mem d_in = make_buffer(ctx, pc, CL_MEM_READ_ONLY, count * sizeof(int32_t), input.data());
+        cl_mem d_out = make_buffer(ctx, pc, CL_MEM_WRITE_ONLY, count * sizeof(cl_float2), nullptr);
+        if (!d_in || !d_out) return false;
+
+        cl_uint n = static_cast<cl_uint>(count);
+        if (data_first) {
+            // convert_int32_to_float2(input, output, scale, num_elements)
+            set_arg(kernel, 0, d_in);
+            set_arg(kernel, 1, d_out);
+            set_arg(kernel, 2, kScale);
+            set_arg(kernel, 3, n);
+        } else if (with_count_and_scale_swapped) {
+            // pre_callback_kernel / simple_int32_to_float2_conversion(output, input, num_elements, scale)
+            set_arg(kernel, 0, d_out);
+            set_arg(kernel, 1, d_in);
+            set_arg(kernel, 2, n);
+            set_arg(kernel, 3, kScale);
+        } else {
+            // batch_int32_to_float2(output, input, num_signals, signal_size, scale)
+            set_arg(kernel, 0, d_out);
+            set_arg(kernel, 1, d_in);
+            set_arg(kernel, 2, static_cast<cl_uint>(kBatch));
+            set_arg(kernel, 3, static_cast<cl_uint>(N));
+            set_arg(kernel, 4, kScale);
+        }
+
+        Profiler profiler;
+        std::vector<cl_float2> reference(count);
+        convert_input_signals_cpu(input.data(), reference.data(), N, kBatch, kScale, profiler, "cpu_reference");
+
+        pc.output = d_out;
+        pc.expected = flatten(reference);
+        pc.global_size = count;
+        pc.bytes_moved = count * (sizeof(int32_t) + sizeof(cl_float2));
+        return true;
+    };
+}
+
+// Циклические сдвиги опорного сигнала (эталон: convert_reference_signals_cpu)
+enum class ShiftVariant { Plain, Batch, Optimized, PreCallbackUserdata };
+
+static PrepareFn prepare_cyclic_shifts(ShiftVariant variant) {
+    return [=](BenchContext& ctx, cl_kernel kernel, size_t N, PreparedCase& pc) {
+        auto input = make_signal(N, 2);
+        size_t count = N * kBatch;
+        cl_mem d_out = make_buffer(ctx, pc, CL_MEM_WRITE_ONLY, count * sizeof(cl_float2), nullptr);
+        cl_uint n = static_cast<cl_uint>(N);
+        cl_uint shifts = static_cast<cl_uint>(kBatch);
+
+        if (variant == ShiftVariant::PreCallbackUserdata) {
+            // prepare_reference_signals_pre_callback(output, userdata = [n_shifts, fft_size, is_hamming, exp, data...])
+            std::vector<int32_t> userdata(4 + N);
+            userdata[0] = kBatch;
+            userdata[1] = static_cast<int32_t>(N);
+            userdata[2] = 0;
+            userdata[3] = 0;
+            std::copy(input.begin(), input.end(), userdata.begin() + 4);
+            cl_mem d_user = make_buffer(ctx, pc, CL_MEM_READ_ONLY, userdata.size() * sizeof(int32_t), userdata.data());
+            if (!d_out || !d_user) return false;
+            set_arg(kernel, 0, d_out);
+            set_arg(kernel, 1, d_user);
+        } else {
+            cl_mem d_in = make_buffer(ctx, pc, CL_MEM_READ_ONLY, N * sizeof(int32_t), input.data());
+            if (!d_out || !d_in) return false;
+            set_arg(kernel, 0, d_in);
+            set_arg(kernel, 1, d_out);
+            if (variant == ShiftVariant::Optimized) {
+                // apply_cyclic_shifts_optimized(input, output, __local cache, scale, N, num_shifts)
+                pc.local_arg_index = 2;
+                pc.local_arg_elem_size = sizeof(cl_float2);
+                set_arg(kernel, 3, kScale);
+                set_arg(kernel, 4, n);
+                set_arg(kernel, 5, shifts);
+            } else {
+                set_arg(kernel, 2, kScale);
+                set_arg(kernel, 3, n);
+                if (variant == ShiftVariant::Batch) {
+                    // apply_cyclic_shifts_batch(..., shift_start, num_shifts_to_process)
+                    set_arg(kernel, 4, static_cast<cl_uint>(0));
+                    set_arg(kernel, 5, shifts);
+                } else {
+                    set_arg(kernel, 4, shifts);
+                }
+            }
+        }
+
+        Profiler profiler;
+        std::vector<cl_float2> reference(count);
+        convert_reference_signals_cpu(input.data(), reference.data(), N, kBatch, kScale, profiler, "cpu_reference");
+
+        pc.output = d_out;
+        pc.expected = flatten(reference);
+        pc.global_size = count;
+        pc.bytes_moved = count * (sizeof(int32_t) + sizeof(cl_float2));
+        return true;
+    };
+}
+
+// prepare_input_signals_pre_callback(output, userdata = [n_signals, fft_size, is_hamming, exp, data...])
+static PrepareFn prepare_input_userdata() {
+    return [](BenchContext& ctx, cl_kernel kernel, size_t N, PreparedCase& pc) {
+        size_t count = N * kBatch;
+        auto input = make_signal(count, 3);
+        std::vector<int32_t> userdata(4 + count);
+        userdata[0] = kBatch;
+        userdata[1] = static_cast<int32_t>(N);
+        std::copy(input.begin(), input.end(), userdata.begin() + 4);
+
+        cl_mem d_user = make_buffer(ctx, pc, CL_MEM_READ_ONLY, userdata.size() * sizeof(int32_t), userdata.data());
+        cl_mem d_out = make_buffer(ctx, pc, CL_MEM_WRITE_ONLY, count * sizeof(cl_float2), nullptr);
+        if (!d_user || !d_out) return false;
+        set_arg(kernel, 0, d_out);
+        set_arg(kernel, 1, d_user);
+
+        Profiler profiler;
+        std::vector<cl_float2> reference(count);
+        convert_input_signals_cpu(input.data(), reference.data(), N, kBatch, kScale, profiler, "cpu_reference");
+
+        pc.output = d_out;
+        pc.expected = flatten(reference);
+        pc.global_size = count;
+        pc.bytes_moved = count * (sizeof(int32_t) + sizeof(cl_float2));
+        return true;
+    };
+}
+
+// embedded_pre_callback: конвертация одного сигнала (signal_idx = 1) из батча
+static PrepareFn prepare_embedded_pre_callback() {
+    return [](BenchContext& ctx, cl_kernel kernel, size_t N, PreparedCase& pc) {
+        const int signal_idx = 1;
+        auto input = make_signal(N * 2, 4);
+
+        struct PreCallbackUserData {
+            cl_uint num_signals;
+            cl_uint signal_size;
+            cl_float scale_factor;
+        } params = {2, static_cast<cl_uint>(N), kScale};
+
+        cl_mem d_out = make_buffer(ctx, pc, CL_MEM_WRITE_ONLY, N * sizeof(cl_float2), nullptr);
+        cl_mem d_in = make_buffer(ctx, pc, CL_MEM_READ_ONLY, input.size() * sizeof(int32_t), input.data());
+        cl_mem d_params = make_buffer(ctx, pc, CL_MEM_READ_ONLY, sizeof(params), &params);
+        if (!d_out || !d_in || !d_params) return false;
+        set_arg(kernel, 0, d_out);
+        set_arg(kernel, 1, d_in);
+        set_arg(kernel, 2, d_params);
+        set_arg(kernel, 3, static_cast<cl_uint>(signal_idx));
+        set_arg(kernel, 4, static_cast<cl_uint>(0));
+
+        Profiler profiler;
+        std::vector<cl_float2> reference(N);
+        convert_input_signals_cpu(input.data() + signal_idx * N, reference.data(), N, 1, kScale, profiler, "cpu_reference");
+
+        pc.output = d_out;
+        pc.expected = flatten(reference);
+        pc.global_size = N;
+        pc.bytes_moved = N * (sizeof(int32_t) + sizeof(cl_float2));
+        return true;
+    };
+}
+
+// complex_multiply_kernel: ref[shift] * conj(inp[signal]) для всех пар
+static PrepareFn prepare_complex_multiply() {
+    return [](BenchContext& ctx, cl_kernel kernel, size_t N, PreparedCase& pc) {
+        auto ref = make_complex(kShifts3 * N, 5);
+        auto inp = make_complex(kSignals3 * N, 6);
+        size_t count = static_cast<size_t>(kSignals3) * kShifts3 * N;
+
+        cl_mem d_ref = make_buffer(ctx, pc, CL_MEM_READ_ONLY, ref.size() * sizeof(float), ref.data());
+        cl_mem d_inp = make_buffer(ctx, pc, CL_MEM_READ_ONLY, inp.size() * sizeof(float), inp.data());
+        cl_mem d_out = make_buffer(ctx, pc, CL_MEM_WRITE_ONLY, count * sizeof(cl_float2), nullptr);
+        if (!d_ref || !d_inp || !d_out) return false;
+        set_arg(kernel, 0, d_ref);
+        set_arg(kernel, 1, d_inp);
+        set_arg(kernel, 2, d_out);
+        set_arg(kernel, 3, static_cast<cl_uint>(kShifts3));
+        set_arg(kernel, 4, static_cast<cl_uint>(kSignals3));
+        set_arg(kernel, 5, static_cast<cl_uint>(N));
+
+        pc.expected.resize(2 * count);
+        for (int s = 0; s < kSignals3; ++s) {
+            for (int k = 0; k < kShifts3; ++k) {
+                for (size_t i = 0; i < N; ++i) {
+                    const float* r = &ref[2 * (k * N + i)];
+                    const float* x = &inp[2 * (s * N + i)];
+                    size_t out = (static_cast<size_t>(s) * kShifts3 + k) * N + i;
+                    pc.expected[2 * out] = r[0] * x[0] + r[1] * x[1];
+                    pc.expected[2 * out + 1] = r[1] * x[0] - r[0] * x[1];
+                }
+            }
+        }
+
+        pc.output = d_out;
+        pc.global_size = count;
+        // Каждый work-item читает ref и inp (8 + 8 байт) и пишет 8 байт
+        pc.bytes_moved = count * 3.0 * sizeof(cl_float2);
+        return true;
+    };
+}
+
+// post_callback_find_peaks: максимум |x| в диапазоне поиска для каждой корреляции
+static PrepareFn prepare_find_peaks() {
+    return [](BenchContext& ctx, cl_kernel kernel, size_t N, PreparedCase& pc) {
+        const cl_uint n_kg = 5;
+        const size_t search_range = N / 2;
+        size_t correlations = static_cast<size_t>(kSignals3) * kShifts3;
+        auto ifft = make_complex(correlations * N, 7);
+
+        cl_mem d_ifft = make_buffer(ctx, pc, CL_MEM_READ_ONLY, ifft.size() * sizeof(float), ifft.data());
+        cl_mem d_peaks = make_buffer(ctx, pc, CL_MEM_WRITE_ONLY, correlations * n_kg * sizeof(float), nullptr);
+        if (!d_ifft || !d_peaks) return false;
+        set_arg(kernel, 0, d_ifft);
+        set_arg(kernel, 1, d_peaks);
+        set_arg(kernel, 2, static_cast<cl_uint>(kSignals3));
+        set_arg(kernel, 3, static_cast<cl_uint>(kShifts3));
+        set_arg(kernel, 4, static_cast<cl_uint>(N));
+        set_arg(kernel, 5, n_kg);
+        set_arg(kernel, 6, static_cast<cl_uint>(search_range));
+
+        pc.expected.assign(correlations * n_kg, 0.0f);
+        for (size_t c = 0; c < correlations; ++c) {
+            float max_magnitude = 0.0f;
+            for (size_t i = 0; i < search_range; ++i) {
+                const float* v = &ifft[2 * (c * N + i)];
+                max_magnitude = std::max(max_magnitude, std::sqrt(v[0] * v[0] + v[1] * v[1]));
+            }
+            pc.expected[c * n_kg] = max_magnitude;
+        }
+
+        pc.output = d_peaks;
+        pc.global_size = correlations;
+        pc.bytes_moved = correlations * search_range * sizeof(cl_float2) + correlations * n_kg * sizeof(float);
+        pc.tolerance = 1e-4f;
+        return true;
+    };
+}
+
+// ============================================================================
+// Запуск и проверка
+// ============================================================================
+
+static bool validate_output(BenchContext& ctx, const PreparedCase& pc, double& max_rel_error) {
+    std::vector<float> actual(pc.expected.size());
+    cl_int err = clEnqueueReadBuffer(ctx.queue, pc.output, CL_TRUE, 0, actual.size() * sizeof(float),
+                                     actual.data(), 0, nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        return false;
+    }
+
+    max_rel_error = 0.0;
+    for (size_t i = 0; i < actual.size(); ++i) {
+        double diff = std::fabs(static_cast<double>(actual[i]) - pc.expected[i]);
+        double rel = diff / std::max(1.0, std::fabs(static_cast<double>(pc.expected[i])));
+        max_rel_error = std::max(max_rel_error, rel);
+    }
+    return max_rel_error <= pc.tolerance;
+}
+
+static bool run_kernel_once(BenchContext& ctx, cl_kernel kernel, const PreparedCase& pc,
+                            size_t local_size, double& execute_ms) {
+    size_t global = pc.global_size;
+    if (local_size > 0) {
+        global = (global + local_size - 1) / local_size * local_size;
+    }
+
+    cl_event event = nullptr;
+    cl_int err = clEnqueueNDRangeKernel(ctx.queue, kernel, 1, nullptr, &global,
+                                        local_size > 0 ? &local_size : nullptr, 0, nullptr, &event);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "  ERROR [clEnqueueNDRangeKernel, local=%zu]: %s\n", local_size, get_cl_error_string(err));
+        return false;
+    }
+    clWaitForEvents(1, &event);
+
+    cl_ulong start = 0, end = 0;
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, nullptr);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, nullptr);
+    clReleaseEvent(event);
+
+    execute_ms = (end - start) / 1e6;
+    return true;
+}
+
+static std::vector<size_t> parse_sizes(const char* text) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t value = static_cast<size_t>(std::strtoull(item.c_str(), nullptr, 10));
+        if (value > 0) sizes.push_back(value);
+    }
+    return sizes;
+}
+
+int main(int argc, char** argv) {
+    cl_device_type device_type = CL_DEVICE_TYPE_CPU;
+    std::vector<size_t> sizes = {1u << 12, 1u << 15, 1u << 18};
+    int reps = 10;
+    std::string kernel_dir = CORRELATOR_KERNEL_DIR;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--gpu") == 0) {
+            device_type = CL_DEVICE_TYPE_GPU;
+        } else if (std::strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            sizes = parse_sizes(argv[++i]);
+        } else if (std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--kernel-dir") == 0 && i + 1 < argc) {
+            kernel_dir = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--gpu] [--sizes N1,N2,...] [--reps K] [--kernel-dir DIR]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    BenchContext ctx;
+    cl_int err = select_device(device_type, ctx);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "ERROR: No OpenCL %s device found (%s)\n",
+                device_type == CL_DEVICE_TYPE_CPU ? "CPU" : "GPU", get_cl_error_string(err));
+        return 1;
+    }
+
+    printf("\n========== KERNEL MICRO-BENCHMARK ==========\n");
+    printf("Device: %s (max work-group %zu)\n", ctx.device_name.c_str(), ctx.max_work_group_size);
+    printf("Kernel dir: %s, reps: %d\n\n", kernel_dir.c_str(), reps);
+
+    const std::vector<KernelCase> cases = {
+        // gpu_converter_kernel.cl
+        {"gpu_converter_kernel.cl", "convert_int32_to_float2", "int32->float2", false, prepare_flat_conversion(true, false)},
+        {"gpu_converter_kernel.cl", "apply_cyclic_shifts", "cyclic shifts", false, prepare_cyclic_shifts(ShiftVariant::Plain)},
+        {"gpu_converter_kernel.cl", "apply_cyclic_shifts_batch", "cyclic shifts", false, prepare_cyclic_shifts(ShiftVariant::Batch)},
+        {"gpu_converter_kernel.cl", "apply_cyclic_shifts_optimized", "cyclic shifts", true, prepare_cyclic_shifts(ShiftVariant::Optimized)},
+        // fft_correlator_kernel.cl
+        {"fft_correlator_kernel.cl", "prepare_reference_signals_pre_callback", "cyclic shifts", false, prepare_cyclic_shifts(ShiftVariant::PreCallbackUserdata)},
+        {"fft_correlator_kernel.cl", "prepare_input_signals_pre_callback", "int32->float2", false, prepare_input_userdata()},
+        // pre_post_callbacks.cl
+        {"pre_post_callbacks.cl", "pre_callback_kernel", "int32->float2", false, prepare_flat_conversion(false, true)},
+        {"pre_post_callbacks.cl", "simple_int32_to_float2_conversion", "int32->float2", false, prepare_flat_conversion(false, true)},
+        {"pre_post_callbacks.cl", "batch_int32_to_float2", "int32->float2", false, prepare_flat_conversion(false, false)},
+        {"pre_post_callbacks.cl", "embedded_pre_callback", "int32->float2 (1 signal)", false, prepare_embedded_pre_callback()},
+        {"pre_post_callbacks.cl", "post_callback_find_peaks", "find peaks", false, prepare_find_peaks()},
+        // step3_correlation_kernel.cl
+        {"step3_correlation_kernel.cl", "complex_multiply_kernel", "complex multiply", false, prepare_complex_multiply()},
+        {"step3_correlation_kernel.cl", "post_callback_find_peaks", "find peaks", false, prepare_find_peaks()},
+    };
+
+    const std::vector<size_t> local_sizes = {0, 32, 64, 128, 256, 512, 1024};
+    std::map<std::string, cl_program> programs;
+    std::vector<CaseResult> results;
+    int failures = 0;
+
+    for (const auto& kc : cases) {
+        // Каждый .cl файл собирается один раз как самостоятельная программа
+        auto prog_it = programs.find(kc.file);
+        if (prog_it == programs.end()) {
+            prog_it = programs.emplace(kc.file, build_program(ctx, kernel_dir + "/" + kc.file)).first;
+        }
+        if (!prog_it->second) {
+            ++failures;
+            continue;
+        }
+
+        cl_kernel kernel = clCreateKernel(prog_it->second, kc.kernel, &err);
+        if (err != CL_SUCCESS) {
+            fprintf(stderr, "ERROR [clCreateKernel %s]: %s\n", kc.kernel, get_cl_error_string(err));
+            ++failures;
+            continue;
+        }
+
+        size_t kernel_wg_size = ctx.max_work_group_size;
+        clGetKernelWorkGroupInfo(kernel, ctx.device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &kernel_wg_size, nullptr);
+
+        for (size_t N : sizes) {
+            PreparedCase pc;
+            if (!kc.prepare(ctx, kernel, N, pc)) {
+                ++failures;
+            } else {
+                for (size_t local_size : local_sizes) {
+                    if (local_size > kernel_wg_size) continue;
+                    if (local_size == 0 && kc.requires_local_size) continue;
+
+                    if (pc.local_arg_index >= 0) {
+                        clSetKernelArg(kernel, pc.local_arg_index, local_size * pc.local_arg_elem_size, nullptr);
+                    }
+
+                    // Прогрев + замеры
+                    double execute_ms = 0.0;
+                    if (!run_kernel_once(ctx, kernel, pc, local_size, execute_ms)) continue;
+
+                    std::vector<double> samples;
+                    for (int r = 0; r < reps; ++r) {
+                        if (run_kernel_once(ctx, kernel, pc, local_size, execute_ms)) {
+                            samples.push_back(execute_ms);
+                        }
+                    }
+                    if (samples.empty()) continue;
+                    std::sort(samples.begin(), samples.end());
+
+                    CaseResult result;
+                    result.file = kc.file;
+                    result.kernel = kc.kernel;
+                    result.group = kc.group;
+                    result.N = N;
+                    result.local_size = local_size;
+                    result.median_ms = samples[samples.size() / 2];
+                    result.gbps = result.median_ms > 0.0 ? pc.bytes_moved / (result.median_ms * 1e6) : 0.0;
+
+                    double max_rel_error = 0.0;
+                    result.valid = validate_output(ctx, pc, max_rel_error);
+                    if (!result.valid) {
+                        ++failures;
+                        fprintf(stderr, "  ✗ %s N=%zu local=%zu: mismatch vs CPU (max rel error %.3e)\n",
+                                kc.kernel, N, local_size, max_rel_error);
+                    }
+
+                    printf("  %-40s N=%-8zu local=%-5s %10.4f ms %8.2f GB/s %s\n",
+                           kc.kernel, N, local_size ? std::to_string(local_size).c_str() : "auto",
+                           result.median_ms, result.gbps, result.valid ? "✓" : "✗");
+                    results.push_back(result);
+                }
+            }
+            for (cl_mem mem : pc.buffers) clReleaseMemObject(mem);
+        }
+        clReleaseKernel(kernel);
+    }
+
+    for (auto& [file, program] : programs) {
+        if (program) clReleaseProgram(program);
+    }
+    clReleaseCommandQueue(ctx.queue);
+    clReleaseContext(ctx.context);
+
+    // ========================================================================
+    // Отчет: лучший local size для каждого ядра и лучший вариант в группе
+    // ========================================================================
+
+    auto now = std::time(nullptr);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    char timestamp_str[100];
+    std::strftime(timestamp_str, sizeof(timestamp_str), "%Y-%m-%d_%H-%M-%S", &timeinfo);
+
+    std::filesystem::create_directories("Report");
+    std::string report_path = std::string("Report/kernel_benchmark_") + timestamp_str + ".md";
+    std::ofstream report(report_path);
+
+    report << "# ⚙️ Kernel micro-benchmark\n\n";
+    report << "**Устройство:** " << ctx.device_name << "\n\n";
+    report << "**Timestamp:** " << timestamp_str << "\n\n";
+    report << "Время — медиана " << reps << " запусков (CL_PROFILING_COMMAND_START..END). "
+           << "GB/s — трафик глобальной памяти за запуск / время. ✓ — совпадение с CPU путём.\n\n";
+
+    // Лучший local size для (ядро, N)
+    std::map<std::tuple<std::string, std::string, size_t>, CaseResult> best_per_kernel;
+    for (const auto& r : results) {
+        if (!r.valid) continue;
+        auto key = std::make_tuple(r.group, r.file + ":" + r.kernel, r.N);
+        auto it = best_per_kernel.find(key);
+        if (it == best_per_kernel.end() || r.median_ms < it->second.median_ms) {
+            best_per_kernel[key] = r;
+        }
+    }
+
+    report << "| Группа | Ядро | N | Лучший local | Время (ms) | GB/s |\n";
+    report << "|--------|------|---|--------------|------------|------|\n";
+    std::map<std::pair<std::string, size_t>, CaseResult> best_per_group;
+    for (const auto& [key, r] : best_per_kernel) {
+        char row[512];
+        std::snprintf(row, sizeof(row), "| %s | %s:%s | %zu | %s | %.4f | %.2f |\n",
+                      r.group.c_str(), r.file.c_str(), r.kernel.c_str(), r.N,
+                      r.local_size ? std::to_string(r.local_size).c_str() : "auto",
+                      r.median_ms, r.gbps);
+        report << row;
+
+        auto group_key = std::make_pair(r.group, r.N);
+        auto it = best_per_group.find(group_key);
+        if (it == best_per_group.end() || r.gbps > it->second.gbps) {
+            best_per_group[group_key] = r;
+        }
+    }
+
+    report << "\n## 🏆 Лучший вариант в группе\n\n";
+    report << "| Группа | N | Ядро | GB/s |\n";
+    report << "|--------|---|------|------|\n";
+    printf("\nBest variant per group:\n");
+    for (const auto& [key, r] : best_per_group) {
+        char row[512];
+        std::snprintf(row, sizeof(row), "| %s | %zu | %s:%s | %.2f |\n",
+                      r.group.c_str(), r.N, r.file.c_str(), r.kernel.c_str(), r.gbps);
+        report << row;
+        printf("  %-26s N=%-8zu %-40s %8.2f GB/s\n", r.group.c_str(), r.N, r.kernel.c_str(), r.gbps);
+    }
+    report.close();
+
+    printf("\n✓ Kernel report saved: %s\n", report_path.c_str());
+    if (failures > 0) {
+        printf("✗ %d failures (build errors or mismatches vs CPU)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,355 @@
+#include "correlator/OpenCLFFTBackend.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <ctime>
+#include <unistd.h>
+
+using namespace Correlator;
+
+// ============================================================================
+// Startup benchmark: холодная и тёплая инициализация бэкенда
+// ============================================================================
+//
+// Холодный запуск  — новый процесс (fork/exec самого себя через popen) с
+//                    отключенными кэшами скомпилированных ядер драйвера/clFFT.
+//                    Измеряется и время initialize(), и полное время процесса
+//                    (загрузка ICD, инициализация драйвера, завершение).
+// Тёплый запуск    — повторные initialize()/cleanup() в уже прогретом процессе.
+//
+// Использование:
+//   StartupBenchmark [--cold-runs K] [--warm-runs K] [--shape N:shifts:signals]...
+//   StartupBenchmark --child N shifts signals n_kg   (внутренний режим)
+
+struct StartupShape {
+    size_t fft_size;
+    int num_shifts;
+    int num_signals;
+    int n_kg;
+};
+
+struct StartupRun {
+    double init_ms = 0.0;                        // Время initialize()
+    double process_ms = 0.0;                     // Полное время процесса (только cold)
+    std::vector<InitPhaseTiming> phases;         // Разбивка по фазам
+};
+
+static double median(std::vector<double> values) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : 0.5 * (values[mid - 1] + values[mid]);
+}
+
+// ============================================================================
+// Один замер initialize() в текущем процессе
+// ============================================================================
+
+static bool measure_init_in_process(const StartupShape& shape, StartupRun& run) {
+    OpenCLFFTBackend backend;
+    backend.setConfiguration(shape.fft_size, shape.num_shifts, shape.num_signals,
+                             shape.n_kg, 1.0f / 32768.0f);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    bool ok = backend.initialize();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    if (!ok) {
+        return false;
+    }
+
+    run.init_ms = std::chrono::duration<double, std::milli>(end - start).count();
+    backend.getInitTimings(run.phases);
+    backend.cleanup();
+    return true;
+}
+
+// ============================================================================
+// Дочерний режим: один замер и вывод в машиночитаемом виде
+// ============================================================================
+
+static int run_child(int argc, char** argv) {
+    if (argc < 6) {
+        fprintf(stderr, "ERROR: --child requires N shifts signals n_kg\n");
+        return 2;
+    }
+
+    StartupShape shape = {
+        static_cast<size_t>(std::strtoull(argv[2], nullptr, 10)),
+        std::atoi(argv[3]),
+        std::atoi(argv[4]),
+        std::atoi(argv[5])
+    };
+
+    StartupRun run;
+    if (!measure_init_in_process(shape, run)) {
+        fprintf(stderr, "ERROR: backend initialization failed\n");
+        return 1;
+    }
+
+    // Строки с префиксом [STARTUP] разбирает родительский процесс,
+    // весь остальной вывод FFTHandler игнорируется
+    printf("[STARTUP] TOTAL\t%.6f\n", run.init_ms);
+    for (const auto& phase : run.phases) {
+        printf("[STARTUP] PHASE\t%s\t%.6f\n", phase.phase.c_str(), phase.time_ms);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+// ============================================================================
+// Холодный замер: новый процесс без кэшей ядер
+// ============================================================================
+
+static std::string self_executable_path() {
+    char path[4096] = {0};
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len <= 0) {
+        return "./StartupBenchmark";
+    }
+    return std::string(path, static_cast<size_t>(len));
+}
+
+static bool measure_cold(const std::string& self_path, const StartupShape& shape, StartupRun& run) {
+    // Отключить persistent-кэши бинарников ядер:
+    //   CLFFT_CACHE_PATH   — кэш скомпилированных ядер clFFT
+    //   POCL_KERNEL_CACHE  — кэш pocl (CPU runtime)
+    //   CUDA_CACHE_DISABLE — кэш NVIDIA OpenCL
+    char command[8192];
+    std::snprintf(command, sizeof(command),
+                  "env -u CLFFT_CACHE_PATH POCL_KERNEL_CACHE=0 CUDA_CACHE_DISABLE=1 "
+                  "\"%s\" --child %zu %d %d %d 2>/dev/null",
+                  self_path.c_str(), shape.fft_size, shape.num_shifts, shape.num_signals, shape.n_kg);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    FILE* pipe = popen(command, "r");
+    if (!pipe) {
+        return false;
+    }
+
+    bool has_total = false;
+    char line[1024];
+    while (std::fgets(line, sizeof(line), pipe)) {
+        if (std::strncmp(line, "[STARTUP] ", 10) != 0) {
+            continue;
+        }
+        char* fields = line + 10;
+        fields[std::strcspn(fields, "\r\n")] = '\0';
+
+        if (std::strncmp(fields, "TOTAL\t", 6) == 0) {
+            run.init_ms = std::atof(fields + 6);
+            has_total = true;
+        } else if (std::strncmp(fields, "PHASE\t", 6) == 0) {
+            char* name = fields + 6;
+            char* value = std::strrchr(name, '\t');
+            if (value) {
+                *value = '\0';
+                run.phases.push_back({name, std::atof(value + 1)});
+            }
+        }
+    }
+
+    int status = pclose(pipe);
+    auto end = std::chrono::high_resolution_clock::now();
+    run.process_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    return has_total && status == 0;
+}
+
+// ============================================================================
+// Усреднение фаз по запускам (порядок фаз — как в первом запуске)
+// ============================================================================
+
+static std::vector<std::pair<std::string, double>> average_phases(const std::vector<StartupRun>& runs) {
+    std::vector<std::pair<std::string, double>> result;
+    if (runs.empty()) return result;
+
+    std::map<std::string, double> sums;
+    for (const auto& run : runs) {
+        for (const auto& phase : run.phases) {
+            sums[phase.phase] += phase.time_ms;
+        }
+    }
+    for (const auto& phase : runs.front().phases) {
+        result.push_back({phase.phase, sums[phase.phase] / runs.size()});
+    }
+    return result;
+}
+
+static bool parse_shape(const char* text, StartupShape& shape) {
+    unsigned long long n = 0;
+    int shifts = 0, signals = 0;
+    if (std::sscanf(text, "%llu:%d:%d", &n, &shifts, &signals) != 3 || n == 0 || shifts <= 0 || signals <= 0) {
+        return false;
+    }
+    shape.fft_size = static_cast<size_t>(n);
+    shape.num_shifts = shifts;
+    shape.num_signals = signals;
+    shape.n_kg = static_cast<int>(std::min<size_t>(2000, shape.fft_size));
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--child") == 0) {
+        return run_child(argc, argv);
+    }
+
+    int cold_runs = 3;
+    int warm_runs = 5;
+    std::vector<StartupShape> shapes;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--cold-runs") == 0 && i + 1 < argc) {
+            cold_runs = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--warm-runs") == 0 && i + 1 < argc) {
+            warm_runs = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--shape") == 0 && i + 1 < argc) {
+            StartupShape shape{};
+            if (!parse_shape(argv[++i], shape)) {
+                fprintf(stderr, "ERROR: invalid shape '%s' (expected N:shifts:signals)\n", argv[i]);
+                return 2;
+            }
+            shapes.push_back(shape);
+        } else {
+            fprintf(stderr, "Usage: %s [--cold-runs K] [--warm-runs K] [--shape N:shifts:signals]...\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (shapes.empty()) {
+        shapes = {
+            {1u << 12, 10, 5, 2000},
+            {1u << 15, 10, 5, 2000},
+            {1u << 15, 40, 50, 2000},
+            {1u << 18, 10, 5, 2000},
+        };
+    }
+
+    const std::string self_path = self_executable_path();
+
+    printf("\n========== STARTUP BENCHMARK ==========\n");
+    printf("Cold runs: %d (new process), warm runs: %d (same process)\n\n", cold_runs, warm_runs);
+
+    struct ShapeResult {
+        StartupShape shape;
+        std::vector<StartupRun> cold;
+        std::vector<StartupRun> warm;
+        double first_in_process_ms = 0.0;
+    };
+    std::vector<ShapeResult> results;
+
+    for (const auto& shape : shapes) {
+        ShapeResult result;
+        result.shape = shape;
+
+        printf("[SHAPE] N=%zu, shifts=%d, signals=%d\n", shape.fft_size, shape.num_shifts, shape.num_signals);
+
+        for (int r = 0; r < cold_runs; ++r) {
+            StartupRun run;
+            if (measure_cold(self_path, shape, run)) {
+                result.cold.push_back(run);
+            } else {
+                fprintf(stderr, "  WARNING: cold run %d failed\n", r + 1);
+            }
+        }
+
+        // Первый запуск в процессе прогревает драйвер и в статистику warm не входит
+        StartupRun first_run;
+        if (measure_init_in_process(shape, first_run)) {
+            result.first_in_process_ms = first_run.init_ms;
+        }
+
+        for (int r = 0; r < warm_runs; ++r) {
+            StartupRun run;
+            if (measure_init_in_process(shape, run)) {
+                result.warm.push_back(run);
+            } else {
+                fprintf(stderr, "  WARNING: warm run %d failed\n", r + 1);
+            }
+        }
+
+        results.push_back(std::move(result));
+    }
+
+    // ========================================================================
+    // Сводка в консоль и Markdown отчёт
+    // ========================================================================
+
+    auto now = std::time(nullptr);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    char timestamp_str[100];
+    std::strftime(timestamp_str, sizeof(timestamp_str), "%Y-%m-%d_%H-%M-%S", &timeinfo);
+
+    std::filesystem::create_directories("Report");
+    std::string report_path = std::string("Report/startup_benchmark_") + timestamp_str + ".md";
+    std::ofstream report(report_path);
+
+    report << "# 🚀 Startup benchmark: холодная и тёплая инициализация\n\n";
+    report << "**Timestamp:** " << timestamp_str << "\n\n";
+    report << "Cold — новый процесс, кэши ядер отключены (CLFFT_CACHE_PATH, POCL_KERNEL_CACHE, CUDA_CACHE_DISABLE). "
+           << "Warm — повторная инициализация в прогретом процессе. Значения — медианы, ms.\n\n";
+    report << "| N | shifts | signals | Cold init | Cold process | First in-process | Warm init |\n";
+    report << "|---|--------|---------|-----------|--------------|------------------|-----------|\n";
+
+    printf("\n%-8s %-7s %-8s %12s %14s %14s %12s\n",
+           "N", "shifts", "signals", "cold_init", "cold_process", "first_inproc", "warm_init");
+
+    for (const auto& result : results) {
+        std::vector<double> cold_init, cold_process, warm_init;
+        for (const auto& run : result.cold) {
+            cold_init.push_back(run.init_ms);
+            cold_process.push_back(run.process_ms);
+        }
+        for (const auto& run : result.warm) {
+            warm_init.push_back(run.init_ms);
+        }
+
+        printf("%-8zu %-7d %-8d %12.3f %14.3f %14.3f %12.3f\n",
+               result.shape.fft_size, result.shape.num_shifts, result.shape.num_signals,
+               median(cold_init), median(cold_process), result.first_in_process_ms, median(warm_init));
+
+        char row[512];
+        std::snprintf(row, sizeof(row), "| %zu | %d | %d | %.3f | %.3f | %.3f | %.3f |\n",
+                      result.shape.fft_size, result.shape.num_shifts, result.shape.num_signals,
+                      median(cold_init), median(cold_process), result.first_in_process_ms, median(warm_init));
+        report << row;
+    }
+    report << "\n";
+
+    // Разбивка по фазам: где теряется время в холодном запуске
+    for (const auto& result : results) {
+        auto cold_phases = average_phases(result.cold);
+        auto warm_phases = average_phases(result.warm);
+        if (cold_phases.empty() && warm_phases.empty()) {
+            continue;
+        }
+
+        std::map<std::string, double> warm_by_name(warm_phases.begin(), warm_phases.end());
+        const auto& ordered = cold_phases.empty() ? warm_phases : cold_phases;
+
+        report << "## N=" << result.shape.fft_size << ", shifts=" << result.shape.num_shifts
+               << ", signals=" << result.shape.num_signals << "\n\n";
+        report << "| Фаза | Cold (ms) | Warm (ms) |\n";
+        report << "|------|-----------|-----------|\n";
+        for (const auto& [phase, cold_ms] : ordered) {
+            double cold_value = cold_phases.empty() ? 0.0 : cold_ms;
+            char row[512];
+            std::snprintf(row, sizeof(row), "| %s | %.3f | %.3f |\n",
+                          phase.c_str(), cold_value, warm_by_name[phase]);
+            report << row;
+        }
+        report << "\n";
+    }
+
+    report.close();
+    printf("\n✓ Startup report saved: %s\n", report_path.c_str());
+    return 0;
+}
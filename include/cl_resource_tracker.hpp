@@ -0,0 +1,137 @@
+#ifndef CL_RESOURCE_TRACKER_HPP
+#define CL_RESOURCE_TRACKER_HPP
+
+#include <CL/cl.h>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// CLResourceTracker - учёт OpenCL объектов и памяти устройства
+// ============================================================================
+
+/**
+ * Обёртка над созданием/освобождением буферов, программ, kernel'ов и событий.
+ *
+ * Для каждого объекта хранится владелец (имя буфера/операции), размер,
+ * шаг, на котором он создан, и время жизни. По шагам (beginStep) ведётся
+ * текущий объём и high-water памяти устройства, при cleanup выводится
+ * список не освобождённых объектов.
+ *
+ * Учитываются только объекты, созданные через трекер: внутренние буферы
+ * и программы clFFT (tmp buffer, скомпилированные планы) сюда не попадают.
+ */
+class CLResourceTracker {
+public:
+    enum class Kind { Buffer, Program, Kernel, Event };
+
+    /**
+     * Живой OpenCL объект
+     */
+    struct Record {
+        Kind kind = Kind::Buffer;
+        const void* handle = nullptr;
+        std::string owner;             // Имя буфера / kernel / операции
+        size_t bytes = 0;              // Размер (только для буферов)
+        std::string step;              // Шаг, на котором объект создан
+        double created_ms = 0.0;       // Время создания от старта трекера
+    };
+
+    /**
+     * Статистика памяти устройства за шаг
+     */
+    struct StepMemory {
+        std::string step;
+        size_t high_water_bytes = 0;   // Максимум занятой памяти во время шага
+        size_t allocated_bytes = 0;    // Выделено за шаг
+        size_t released_bytes = 0;     // Освобождено за шаг
+        size_t buffers_created = 0;
+        size_t events_created = 0;
+    };
+
+    explicit CLResourceTracker(const std::string& scope = "OpenCL");
+
+    CLResourceTracker(const CLResourceTracker&) = delete;
+    CLResourceTracker& operator=(const CLResourceTracker&) = delete;
+
+    // ========================================================================
+    // Создание (вызов OpenCL + регистрация при успехе)
+    // ========================================================================
+
+    cl_mem createBuffer(cl_context context, cl_mem_flags flags, size_t size,
+                        void* host_ptr, cl_int* errcode_ret, const std::string& owner);
+
+    cl_program createProgramWithSource(cl_context context, cl_uint count, const char** strings,
+                                       const size_t* lengths, cl_int* errcode_ret,
+                                       const std::string& owner);
+
+    cl_kernel createKernel(cl_program program, const char* kernel_name, cl_int* errcode_ret);
+
+    /**
+     * Зарегистрировать событие, созданное clEnqueue* / clfftEnqueueTransform
+     */
+    void trackEvent(cl_event event, const std::string& owner);
+
+    // ========================================================================
+    // Освобождение (снятие с учёта + clRelease*)
+    // ========================================================================
+
+    cl_int releaseMemObject(cl_mem buffer);
+    cl_int releaseProgram(cl_program program);
+    cl_int releaseKernel(cl_kernel kernel);
+    cl_int releaseEvent(cl_event event);
+
+    // ========================================================================
+    // Шаги и отчёты
+    // ========================================================================
+
+    /**
+     * Начать шаг (Init, Step1, ...): дальнейшие объекты относятся к нему
+     */
+    void beginStep(const std::string& step);
+
+    /**
+     * Текущий шаг ("Setup" до первого beginStep)
+     */
+    std::string currentStep() const;
+
+    size_t currentBytes() const;
+    size_t highWaterBytes() const;
+    std::vector<StepMemory> getStepMemory() const;
+    std::vector<Record> getLiveObjects() const;
+
+    /**
+     * Вывести таблицу памяти по шагам
+     */
+    void printMemoryReport() const;
+
+    /**
+     * Вывести не освобождённые объекты
+     * @return количество утечек
+     */
+    size_t reportLeaks() const;
+
+    static const char* kindName(Kind kind);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::string scope_;
+    Clock::time_point start_time_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<const void*, Record> live_;
+    std::vector<StepMemory> steps_;    // В порядке beginStep
+    size_t current_bytes_ = 0;
+    size_t high_water_bytes_ = 0;
+
+    double elapsed_ms() const;
+    StepMemory& current_step();        // Вызывать под mutex_
+    void add_record(Kind kind, const void* handle, const std::string& owner, size_t bytes);
+    bool remove_record(const void* handle);
+};
+
+#endif // CL_RESOURCE_TRACKER_HPP
@@ -0,0 +1,148 @@
+#ifndef CORRELATOR_BEAMFORMER_HPP
+#define CORRELATOR_BEAMFORMER_HPP
+
+#include "IDataSnapshot.hpp"
+#include "ParallelChunks.hpp"
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// BeamWeights - весовая матрица C×B на каждую частоту
+// ============================================================================
+
+/**
+ * Луч b на частоте k: Y[b][k] = Σ_c W[c][b][k] · X[c][k], где X — спектры
+ * каналов Step 2. Формирование лучей в частотной области заменяет B
+ * проходов по времени и B× Step 2 одним батчевым комплексным GEMM.
+ *
+ * Раскладка [channels][beams][fft_size]: соседние частоты одного
+ * коэффициента лежат подряд — чтение coalesced на устройстве и
+ * непрерывный внутренний цикл (SIMD) на CPU.
+ */
+class BeamWeights {
+public:
+    BeamWeights() = default;
+
+    BeamWeights(int channels, int beams, size_t fft_size)
+        : channels_(channels), beams_(beams), fft_size_(fft_size),
+          values_(static_cast<size_t>(channels) * beams * fft_size) {}
+
+    /**
+     * @brief Delay-and-sum: выравнивание задержек каналов и усреднение
+     * @param delays [beams][channels] задержка прихода фронта луча b на канал c (в отсчётах)
+     */
+    static BeamWeights delayAndSum(size_t fft_size, const std::vector<std::vector<double>>& delays) {
+        const int beams = static_cast<int>(delays.size());
+        const int channels = beams > 0 ? static_cast<int>(delays.front().size()) : 0;
+        BeamWeights weights(channels, beams, fft_size);
+        const double two_pi = 2.0 * std::acos(-1.0);
+        for (int b = 0; b < beams; ++b) {
+            for (int c = 0; c < channels; ++c) {
+                for (size_t k = 0; k < fft_size; ++k) {
+                    // Знаковая частота бина: компенсация задержки не зависит от стороны спектра
+                    double f = (k < (fft_size + 1) / 2 ? double(k) : double(k) - double(fft_size)) / double(fft_size);
+                    double phase = two_pi * f * delays[b][c];
+                    weights.set(c, b, k, ComplexFloat(static_cast<float>(std::cos(phase) / channels),
+                                                      static_cast<float>(std::sin(phase) / channels)));
+                }
+            }
+        }
+        return weights;
+    }
+
+    int channels() const { return channels_; }
+    int beams() const { return beams_; }
+    size_t fftSize() const { return fft_size_; }
+
+    size_t index(int channel, int beam, size_t bin) const {
+        return (static_cast<size_t>(channel) * beams_ + beam) * fft_size_ + bin;
+    }
+
+    ComplexFloat at(int channel, int beam, size_t bin) const { return values_[index(channel, beam, bin)]; }
+    void set(int channel, int beam, size_t bin, ComplexFloat value) { values_[index(channel, beam, bin)] = value; }
+
+    std::span<const ComplexFloat> values() const { return values_; }
+    std::span<ComplexFloat> values() { return values_; }
+
+private:
+    int channels_ = 0;
+    int beams_ = 0;
+    size_t fft_size_ = 0;
+    std::vector<ComplexFloat> values_;
+};
+
+// ============================================================================
+// CPU реализация (эталон и запасной путь для бэкендов без setBeamWeights)
+// ============================================================================
+
+/**
+ * @brief Сформировать лучи из спектров каналов
+ *
+ * Частоты обрабатываются блоками по kBeamBlock бинов: спектры каналов
+ * блока раскладываются в раздельные массивы Re/Im (влезают в L1/L2),
+ * накопление луча идёт непрерывными циклами по бинам, которые компилятор
+ * векторизует. Блоки распределяются по потокам.
+ *
+ * @param channel_spectra [channels][fft_size]
+ * @param beam_spectra [beams][fft_size] (строки сверх beams не трогаются)
+ */
+inline bool formBeams(std::span<const ComplexFloat> channel_spectra, const BeamWeights& weights,
+                      std::span<ComplexFloat> beam_spectra, unsigned threads = 0) {
+    constexpr size_t kBeamBlock = 256;
+    const size_t n = weights.fftSize();
+    const int channels = weights.channels();
+    const int beams = weights.beams();
+    if (n == 0 || channels <= 0 || beams <= 0 ||
+        channel_spectra.size() != n * channels || beam_spectra.size() < n * beams) {
+        return false;
+    }
+
+    const ComplexFloat* w = weights.values().data();
+    const size_t blocks = (n + kBeamBlock - 1) / kBeamBlock;
+    parallelChunks(blocks, threads, [&](size_t block) {
+        const size_t first = block * kBeamBlock;
+        const size_t count = std::min(kBeamBlock, n - first);
+
+        // Re/Im каналов блока: [channels][count]
+        std::vector<float> xr(channels * count), xi(channels * count);
+        std::vector<float> wr(count), wi(count), acc_r(count), acc_i(count);
+        for (int c = 0; c < channels; ++c) {
+            const ComplexFloat* x = channel_spectra.data() + c * n + first;
+            for (size_t k = 0; k < count; ++k) {
+                xr[c * count + k] = x[k].real;
+                xi[c * count + k] = x[k].imag;
+            }
+        }
+
+        for (int b = 0; b < beams; ++b) {
+            std::fill(acc_r.begin(), acc_r.end(), 0.0f);
+            std::fill(acc_i.begin(), acc_i.end(), 0.0f);
+            for (int c = 0; c < channels; ++c) {
+                const ComplexFloat* wc = w + weights.index(c, b, first);
+                for (size_t k = 0; k < count; ++k) {
+                    wr[k] = wc[k].real;
+                    wi[k] = wc[k].imag;
+                }
+                const float* cr = xr.data() + c * count;
+                const float* ci = xi.data() + c * count;
+                for (size_t k = 0; k < count; ++k) {
+                    acc_r[k] += wr[k] * cr[k] - wi[k] * ci[k];
+                    acc_i[k] += wr[k] * ci[k] + wi[k] * cr[k];
+                }
+            }
+            ComplexFloat* y = beam_spectra.data() + b * n + first;
+            for (size_t k = 0; k < count; ++k) {
+                y[k] = ComplexFloat(acc_r[k], acc_i[k]);
+            }
+        }
+    });
+    return true;
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_BEAMFORMER_HPP
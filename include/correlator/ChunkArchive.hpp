@@ -0,0 +1,501 @@
+#ifndef CORRELATOR_CHUNK_ARCHIVE_HPP
+#define CORRELATOR_CHUNK_ARCHIVE_HPP
+
+#include "ChunkCodec.hpp"
+#include "ParallelChunks.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// ChunkArchive - бинарный контейнер сжатых чанков с произвольным доступом
+// ============================================================================
+
+/**
+ * Формат файла:
+ *
+ *   [FileHeader]  magic "CCHK", версия
+ *   [чанк 0][чанк 1]...          сжатые данные (ChunkCodec)
+ *   [ChunkEntry * entries]       индекс
+ *   [StreamEntry * streams]      форма потоков
+ *   [metadata]                   произвольная строка (обычно JSON конфигурации)
+ *   [Footer]                     смещения индекса, magic "CEND"
+ *
+ * Ключ чанка — (stream, index): например, (Step1 спектры, номер сдвига).
+ * Индекс пишется в конце, поэтому чанки можно добавлять по мере готовности
+ * шагов; читатель отображает файл через mmap и распаковывает только
+ * запрошенные чанки. Дописывание в существующий архив (ArchiveOpenMode::Append)
+ * читает его индекс и пишет новые чанки поверх старого хвоста.
+ */
+struct ChunkArchiveFormat {
+    struct FileHeader {
+        char magic[4] = {'C', 'C', 'H', 'K'};
+        uint32_t version = 1;
+    };
+
+    struct ChunkEntry {
+        uint32_t stream = 0;
+        uint32_t index = 0;
+        uint64_t offset = 0;
+        uint64_t raw_size = 0;
+        uint64_t stored_size = 0;
+        uint32_t checksum = 0;         // FNV-1a распакованных данных
+        uint16_t element_size = 0;
+        uint8_t flags = 0;             // ChunkFlags
+        uint8_t reserved = 0;
+    };
+
+    /// Форма потока: до трёх измерений (например, [shifts][fft_size][2])
+    struct StreamEntry {
+        uint32_t stream = 0;
+        uint32_t dims[3] = {0, 0, 0};
+    };
+
+    struct Footer {
+        uint64_t index_offset = 0;
+        uint64_t entry_count = 0;
+        uint64_t stream_count = 0;
+        uint64_t metadata_size = 0;
+        char magic[4] = {'C', 'E', 'N', 'D'};
+        uint32_t reserved = 0;
+    };
+
+    static uint64_t key(uint32_t stream, uint32_t index) {
+        return (static_cast<uint64_t>(stream) << 32) | index;
+    }
+};
+
+// ============================================================================
+// Запись
+// ============================================================================
+
+enum class ArchiveOpenMode : uint8_t {
+    Truncate,  // Новый архив (существующий файл перезаписывается)
+    Append     // Дописать в существующий архив (нет файла — создать)
+};
+
+/**
+ * @class ChunkArchiveWriter
+ * @brief Последовательная запись; сжатие чанков одного вызова append параллельно
+ *
+ * Пример:
+ * @code
+ * ChunkArchiveWriter writer("snapshot.cchk");
+ * writer.setStreamShape(1, num_shifts, fft_size, 2);
+ * writer.append(1, 0, spectra.data(), fft_size * sizeof(ComplexFloat), num_shifts, sizeof(float));
+ * writer.finish();
+ * @endcode
+ */
+class ChunkArchiveWriter {
+public:
+    explicit ChunkArchiveWriter(const std::string& path, unsigned threads = 0,
+                                ArchiveOpenMode mode = ArchiveOpenMode::Truncate)
+        : path_(path), threads_(threads) {
+        if (mode == ArchiveOpenMode::Append) {
+            file_ = std::fopen(path.c_str(), "r+b");
+            if (file_) {
+                // Повреждённый архив не перезаписываем: файл остаётся как есть
+                ok_ = load_existing();
+                if (!ok_) {
+                    fprintf(stderr, "[ARCHIVE] %s: cannot append to invalid chunk archive\n", path.c_str());
+                    std::fclose(file_);
+                    file_ = nullptr;
+                }
+                return;
+            }
+            if (errno != ENOENT) {
+                return;
+            }
+        }
+        file_ = std::fopen(path.c_str(), "wb");
+        if (file_) {
+            ChunkArchiveFormat::FileHeader header;
+            ok_ = std::fwrite(&header, sizeof(header), 1, file_) == 1;
+            offset_ = sizeof(header);
+        }
+    }
+
+    ~ChunkArchiveWriter() {
+        finish();
+    }
+
+    ChunkArchiveWriter(const ChunkArchiveWriter&) = delete;
+    ChunkArchiveWriter& operator=(const ChunkArchiveWriter&) = delete;
+
+    bool isOpen() const { return file_ != nullptr && ok_; }
+    const std::string& path() const { return path_; }
+
+    void setStreamShape(uint32_t stream, uint32_t d0, uint32_t d1 = 1, uint32_t d2 = 1) {
+        for (auto& s : streams_) {
+            if (s.stream == stream) {
+                s.dims[0] = d0; s.dims[1] = d1; s.dims[2] = d2;
+                return;
+            }
+        }
+        ChunkArchiveFormat::StreamEntry entry;
+        entry.stream = stream;
+        entry.dims[0] = d0; entry.dims[1] = d1; entry.dims[2] = d2;
+        streams_.push_back(entry);
+    }
+
+    void setMetadata(const std::string& metadata) { metadata_ = metadata; }
+    const std::string& metadata() const { return metadata_; }
+
+    /// Форма потока (в режиме Append — в том числе из существующего архива)
+    const ChunkArchiveFormat::StreamEntry* streamShape(uint32_t stream) const {
+        for (const auto& s : streams_) {
+            if (s.stream == stream) return &s;
+        }
+        return nullptr;
+    }
+
+    /// Количество чанков потока (в режиме Append — вместе с уже записанными)
+    size_t chunkCount(uint32_t stream) const {
+        size_t count = 0;
+        for (const auto& e : entries_) {
+            count += e.stream == stream;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Добавить count чанков по chunk_bytes из непрерывного буфера
+     *
+     * Чанк i получает ключ (stream, first_index + i). Сжатие идёт
+     * параллельно, запись в файл — в порядке индексов.
+     * @return false, если индексы не помещаются в uint32_t
+     */
+    bool append(uint32_t stream, uint32_t first_index, const void* data,
+                size_t chunk_bytes, size_t count, size_t element_size) {
+        if (!isOpen() || (count > 0 && count - 1 > std::numeric_limits<uint32_t>::max() - first_index)) {
+            return false;
+        }
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        std::vector<std::vector<uint8_t>> stored(count);
+        std::vector<uint8_t> flags(count);
+        std::vector<uint32_t> checksums(count);
+
+        parallelChunks(count, threads_, [&](size_t i) {
+            const uint8_t* chunk = bytes + i * chunk_bytes;
+            flags[i] = encodeChunk(chunk, chunk_bytes, element_size, stored[i]);
+            checksums[i] = chunkChecksum(chunk, chunk_bytes);
+        });
+
+        for (size_t i = 0; i < count; ++i) {
+            ChunkArchiveFormat::ChunkEntry entry;
+            entry.stream = stream;
+            entry.index = first_index + static_cast<uint32_t>(i);
+            entry.offset = offset_;
+            entry.raw_size = chunk_bytes;
+            entry.stored_size = stored[i].size();
+            entry.checksum = checksums[i];
+            entry.element_size = static_cast<uint16_t>(element_size);
+            entry.flags = flags[i];
+
+            if (!stored[i].empty() && std::fwrite(stored[i].data(), stored[i].size(), 1, file_) != 1) {
+                ok_ = false;
+                return false;
+            }
+            offset_ += stored[i].size();
+            raw_bytes_ += chunk_bytes;
+            entries_.push_back(entry);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Записать индекс и закрыть файл (повторный вызов — no-op)
+     */
+    bool finish() {
+        if (!file_) {
+            return ok_;
+        }
+
+        ChunkArchiveFormat::Footer footer;
+        footer.index_offset = offset_;
+        footer.entry_count = entries_.size();
+        footer.stream_count = streams_.size();
+        footer.metadata_size = metadata_.size();
+
+        if (ok_) {
+            ok_ = (entries_.empty() ||
+                   std::fwrite(entries_.data(), sizeof(entries_[0]), entries_.size(), file_) == entries_.size()) &&
+                  (streams_.empty() ||
+                   std::fwrite(streams_.data(), sizeof(streams_[0]), streams_.size(), file_) == streams_.size()) &&
+                  (metadata_.empty() || std::fwrite(metadata_.data(), metadata_.size(), 1, file_) == 1) &&
+                  std::fwrite(&footer, sizeof(footer), 1, file_) == 1;
+        }
+        if (ok_ && appended_) {
+            // Новый хвост может быть короче старого (метаданные)
+            const off_t end = ftello(file_);
+            ok_ = std::fflush(file_) == 0 && end >= 0 && ftruncate(fileno(file_), end) == 0;
+        }
+        ok_ = (std::fclose(file_) == 0) && ok_;
+        file_ = nullptr;
+        return ok_;
+    }
+
+    uint64_t rawBytes() const { return raw_bytes_; }
+    uint64_t storedBytes() const { return offset_; }
+
+private:
+    std::string path_;
+    unsigned threads_;
+    std::FILE* file_ = nullptr;
+    bool ok_ = false;
+    bool appended_ = false;  // Дописывание в существующий архив
+    uint64_t offset_ = 0;
+    uint64_t raw_bytes_ = 0;
+    std::vector<ChunkArchiveFormat::ChunkEntry> entries_;
+    std::vector<ChunkArchiveFormat::StreamEntry> streams_;
+    std::string metadata_;
+
+    /**
+     * Прочитать индекс, формы потоков и метаданные существующего архива и
+     * встать на начало его индекса: новые чанки пишутся поверх старого хвоста
+     */
+    bool load_existing() {
+        ChunkArchiveFormat::FileHeader header;
+        ChunkArchiveFormat::Footer footer;
+        if (fseeko(file_, 0, SEEK_END) != 0) {
+            return false;
+        }
+        const off_t size = ftello(file_);
+        if (size < static_cast<off_t>(sizeof(header) + sizeof(footer)) ||
+            fseeko(file_, 0, SEEK_SET) != 0 || std::fread(&header, sizeof(header), 1, file_) != 1 ||
+            std::memcmp(header.magic, "CCHK", 4) != 0 || header.version != 1 ||
+            fseeko(file_, size - static_cast<off_t>(sizeof(footer)), SEEK_SET) != 0 ||
+            std::fread(&footer, sizeof(footer), 1, file_) != 1 || std::memcmp(footer.magic, "CEND", 4) != 0) {
+            return false;
+        }
+
+        const uint64_t tail = footer.entry_count * sizeof(ChunkArchiveFormat::ChunkEntry) +
+                              footer.stream_count * sizeof(ChunkArchiveFormat::StreamEntry) +
+                              footer.metadata_size + sizeof(footer);
+        if (footer.index_offset + tail != static_cast<uint64_t>(size) ||
+            fseeko(file_, static_cast<off_t>(footer.index_offset), SEEK_SET) != 0) {
+            return false;
+        }
+        entries_.resize(footer.entry_count);
+        streams_.resize(footer.stream_count);
+        metadata_.resize(footer.metadata_size);
+        if ((!entries_.empty() &&
+             std::fread(entries_.data(), sizeof(entries_[0]), entries_.size(), file_) != entries_.size()) ||
+            (!streams_.empty() &&
+             std::fread(streams_.data(), sizeof(streams_[0]), streams_.size(), file_) != streams_.size()) ||
+            (!metadata_.empty() && std::fread(metadata_.data(), metadata_.size(), 1, file_) != 1)) {
+            return false;
+        }
+        for (const auto& e : entries_) {
+            if (e.offset + e.stored_size > footer.index_offset) {
+                return false;
+            }
+            raw_bytes_ += e.raw_size;
+        }
+
+        offset_ = footer.index_offset;
+        appended_ = true;
+        return fseeko(file_, static_cast<off_t>(offset_), SEEK_SET) == 0;
+    }
+};
+
+// ============================================================================
+// Чтение (mmap)
+// ============================================================================
+
+/**
+ * @class ChunkArchiveReader
+ * @brief Произвольный доступ к чанкам по (stream, index) через mmap
+ */
+class ChunkArchiveReader {
+public:
+    ChunkArchiveReader() = default;
+
+    explicit ChunkArchiveReader(const std::string& path) {
+        open(path);
+    }
+
+    ~ChunkArchiveReader() {
+        close();
+    }
+
+    ChunkArchiveReader(const ChunkArchiveReader&) = delete;
+    ChunkArchiveReader& operator=(const ChunkArchiveReader&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ChunkArchiveFormat::FileHeader) +
+                                                                       sizeof(ChunkArchiveFormat::Footer)) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            size_ = 0;
+            return false;
+        }
+        data_ = static_cast<const uint8_t*>(mapped);
+
+        if (!parse_index()) {
+            fprintf(stderr, "[ARCHIVE] %s: invalid chunk archive\n", path.c_str());
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data_) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+        entries_.clear();
+        streams_.clear();
+        lookup_.clear();
+        metadata_.clear();
+    }
+
+    bool isOpen() const { return data_ != nullptr; }
+    const std::string& metadata() const { return metadata_; }
+    const std::vector<ChunkArchiveFormat::ChunkEntry>& entries() const { return entries_; }
+
+    const ChunkArchiveFormat::ChunkEntry* find(uint32_t stream, uint32_t index) const {
+        auto it = lookup_.find(ChunkArchiveFormat::key(stream, index));
+        return it == lookup_.end() ? nullptr : &entries_[it->second];
+    }
+
+    const ChunkArchiveFormat::StreamEntry* streamShape(uint32_t stream) const {
+        for (const auto& s : streams_) {
+            if (s.stream == stream) return &s;
+        }
+        return nullptr;
+    }
+
+    /// Количество чанков потока (индексы 0..count-1)
+    size_t chunkCount(uint32_t stream) const {
+        size_t count = 0;
+        for (const auto& e : entries_) {
+            count += e.stream == stream;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Распаковать один чанк в out (размер out = raw_size)
+     */
+    bool read(uint32_t stream, uint32_t index, void* out, size_t out_size) const {
+        const ChunkArchiveFormat::ChunkEntry* entry = find(stream, index);
+        if (!entry || entry->raw_size != out_size) {
+            return false;
+        }
+        uint8_t* bytes = static_cast<uint8_t*>(out);
+        return decodeChunk(data_ + entry->offset, entry->stored_size, entry->flags, entry->element_size,
+                           bytes, out_size) &&
+               chunkChecksum(bytes, out_size) == entry->checksum;
+    }
+
+    template <class T>
+    bool read(uint32_t stream, uint32_t index, std::vector<T>& out) const {
+        const ChunkArchiveFormat::ChunkEntry* entry = find(stream, index);
+        if (!entry || entry->raw_size % sizeof(T) != 0) {
+            return false;
+        }
+        out.resize(entry->raw_size / sizeof(T));
+        return read(stream, index, out.data(), entry->raw_size);
+    }
+
+    /**
+     * @brief Распаковать чанки [0, count) потока подряд в один буфер (параллельно)
+     */
+    template <class T>
+    bool readStream(uint32_t stream, std::vector<T>& out, unsigned threads = 0) const {
+        size_t count = chunkCount(stream);
+        const ChunkArchiveFormat::ChunkEntry* first = find(stream, 0);
+        if (count == 0 || !first || first->raw_size % sizeof(T) != 0) {
+            out.clear();
+            return count == 0;
+        }
+
+        size_t chunk_elements = first->raw_size / sizeof(T);
+        out.resize(chunk_elements * count);
+        std::atomic<bool> ok{true};
+        parallelChunks(count, threads, [&](size_t i) {
+            if (!read(stream, static_cast<uint32_t>(i), out.data() + i * chunk_elements, first->raw_size)) {
+                ok = false;
+            }
+        });
+        return ok;
+    }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::vector<ChunkArchiveFormat::ChunkEntry> entries_;
+    std::vector<ChunkArchiveFormat::StreamEntry> streams_;
+    std::unordered_map<uint64_t, size_t> lookup_;
+    std::string metadata_;
+
+    bool parse_index() {
+        ChunkArchiveFormat::FileHeader header;
+        std::memcpy(&header, data_, sizeof(header));
+        if (std::memcmp(header.magic, "CCHK", 4) != 0 || header.version != 1) {
+            return false;
+        }
+
+        ChunkArchiveFormat::Footer footer;
+        std::memcpy(&footer, data_ + size_ - sizeof(footer), sizeof(footer));
+        if (std::memcmp(footer.magic, "CEND", 4) != 0) {
+            return false;
+        }
+
+        uint64_t tail = footer.entry_count * sizeof(ChunkArchiveFormat::ChunkEntry) +
+                        footer.stream_count * sizeof(ChunkArchiveFormat::StreamEntry) +
+                        footer.metadata_size + sizeof(footer);
+        if (footer.index_offset + tail != size_) {
+            return false;
+        }
+
+        const uint8_t* p = data_ + footer.index_offset;
+        entries_.resize(footer.entry_count);
+        std::memcpy(entries_.data(), p, entries_.size() * sizeof(entries_[0]));
+        p += entries_.size() * sizeof(entries_[0]);
+        streams_.resize(footer.stream_count);
+        std::memcpy(streams_.data(), p, streams_.size() * sizeof(streams_[0]));
+        p += streams_.size() * sizeof(streams_[0]);
+        metadata_.assign(reinterpret_cast<const char*>(p), footer.metadata_size);
+
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            const auto& e = entries_[i];
+            if (e.offset + e.stored_size > footer.index_offset) {
+                return false;
+            }
+            lookup_[ChunkArchiveFormat::key(e.stream, e.index)] = i;
+        }
+        return true;
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_CHUNK_ARCHIVE_HPP
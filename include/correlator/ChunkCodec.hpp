@@ -0,0 +1,272 @@
+#ifndef CORRELATOR_CHUNK_CODEC_HPP
+#define CORRELATOR_CHUNK_CODEC_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// ChunkCodec - сжатие без потерь для бинарных дампов (спектры, сигналы)
+// ============================================================================
+
+/**
+ * Конвейер одного чанка: byte-shuffle → delta → LZ.
+ *
+ * - shuffle: байты элементов (element_size, для float = 4) раскладываются
+ *   по плоскостям: сначала все старшие байты, потом следующие и т.д.
+ *   Экспоненты и знаки соседних отсчётов спектра почти совпадают.
+ * - delta: разность соседних байт внутри результата shuffle
+ *   (плавные плоскости превращаются в длинные серии нулей).
+ * - LZ: LZ77 в формате блоков LZ4 (токен, литералы, смещение u16,
+ *   расширенные длины), окно 64 КБ. Правила конца блока LZ4 соблюдаются
+ *   (последние 5 байт — литералы, последнее совпадение начинается не ближе
+ *   12 байт к концу), так что блок читается и стандартным декодером LZ4.
+ *
+ * Если сжатие не уменьшает размер, чанк хранится как есть (flags = 0).
+ */
+enum ChunkFlags : uint8_t {
+    kChunkShuffle = 1 << 0,
+    kChunkDelta = 1 << 1,
+    kChunkLZ = 1 << 2
+};
+
+namespace codec_detail {
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline void write_length(std::vector<uint8_t>& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+inline bool read_length(const uint8_t*& ip, const uint8_t* end, size_t& length) {
+    uint8_t b;
+    do {
+        if (ip >= end) return false;
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+inline void emit_sequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literal_length,
+                          size_t match_length, size_t offset) {
+    uint8_t token = static_cast<uint8_t>(std::min<size_t>(literal_length, 15) << 4);
+    if (match_length) {
+        token |= static_cast<uint8_t>(std::min<size_t>(match_length - 4, 15));
+    }
+    out.push_back(token);
+    if (literal_length >= 15) {
+        write_length(out, literal_length - 15);
+    }
+    out.insert(out.end(), literals, literals + literal_length);
+
+    if (match_length) {
+        out.push_back(static_cast<uint8_t>(offset & 0xFF));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        if (match_length - 4 >= 15) {
+            write_length(out, match_length - 4 - 15);
+        }
+    }
+}
+
+} // namespace codec_detail
+
+// ============================================================================
+// Byte-shuffle и delta
+// ============================================================================
+
+inline void byteShuffle(const uint8_t* in, size_t size, size_t element_size, uint8_t* out) {
+    size_t count = size / element_size;
+    for (size_t b = 0; b < element_size; ++b) {
+        uint8_t* plane = out + b * count;
+        for (size_t i = 0; i < count; ++i) {
+            plane[i] = in[i * element_size + b];
+        }
+    }
+    std::memcpy(out + count * element_size, in + count * element_size, size - count * element_size);
+}
+
+inline void byteUnshuffle(const uint8_t* in, size_t size, size_t element_size, uint8_t* out) {
+    size_t count = size / element_size;
+    for (size_t b = 0; b < element_size; ++b) {
+        const uint8_t* plane = in + b * count;
+        for (size_t i = 0; i < count; ++i) {
+            out[i * element_size + b] = plane[i];
+        }
+    }
+    std::memcpy(out + count * element_size, in + count * element_size, size - count * element_size);
+}
+
+inline void deltaEncode(uint8_t* data, size_t size) {
+    uint8_t previous = 0;
+    for (size_t i = 0; i < size; ++i) {
+        uint8_t current = data[i];
+        data[i] = static_cast<uint8_t>(current - previous);
+        previous = current;
+    }
+}
+
+inline void deltaDecode(uint8_t* data, size_t size) {
+    uint8_t previous = 0;
+    for (size_t i = 0; i < size; ++i) {
+        previous = static_cast<uint8_t>(previous + data[i]);
+        data[i] = previous;
+    }
+}
+
+// ============================================================================
+// LZ (формат блоков LZ4)
+// ============================================================================
+
+inline void lzCompress(const uint8_t* in, size_t size, std::vector<uint8_t>& out) {
+    constexpr int kHashBits = 14;
+    constexpr size_t kMinMatch = 4;
+    constexpr size_t kMaxOffset = 65535;
+    constexpr size_t kLastLiterals = 5;     // LZ4: последние байты блока — литералы
+    constexpr size_t kMatchStartLimit = 12; // LZ4: совпадение начинается не ближе к концу
+
+    out.clear();
+    out.reserve(size + size / 255 + 16);
+    std::vector<uint32_t> table(size_t{1} << kHashBits, UINT32_MAX);
+
+    const size_t match_end = size > kLastLiterals ? size - kLastLiterals : 0;
+    size_t anchor = 0;
+    size_t ip = 0;
+    while (ip + kMatchStartLimit <= size) {
+        uint32_t sequence = codec_detail::read32(in + ip);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - kHashBits);
+        uint32_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(ip);
+
+        if (candidate != UINT32_MAX && ip - candidate <= kMaxOffset &&
+            codec_detail::read32(in + candidate) == sequence) {
+            size_t length = kMinMatch;
+            while (ip + length < match_end && in[candidate + length] == in[ip + length]) {
+                ++length;
+            }
+            codec_detail::emit_sequence(out, in + anchor, ip - anchor, length, ip - candidate);
+            ip += length;
+            anchor = ip;
+        } else {
+            ++ip;
+        }
+    }
+    // Последняя последовательность — только литералы
+    codec_detail::emit_sequence(out, in + anchor, size - anchor, 0, 0);
+}
+
+/**
+ * @return false при повреждённых данных или несовпадении размера
+ */
+inline bool lzDecompress(const uint8_t* in, size_t size, uint8_t* out, size_t out_size) {
+    const uint8_t* ip = in;
+    const uint8_t* end = in + size;
+    size_t op = 0;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !codec_detail::read_length(ip, end, literal_length)) return false;
+        if (literal_length > static_cast<size_t>(end - ip) || literal_length > out_size - op) return false;
+        std::memcpy(out + op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        if (ip == end) break;  // Последняя последовательность
+
+        if (end - ip < 2) return false;
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        size_t match_length = (token & 0x0F);
+        if (match_length == 15 && !codec_detail::read_length(ip, end, match_length)) return false;
+        match_length += 4;
+
+        if (offset == 0 || offset > op || match_length > out_size - op) return false;
+        const uint8_t* match = out + op - offset;
+        for (size_t i = 0; i < match_length; ++i) {  // Перекрытие при offset < length
+            out[op + i] = match[i];
+        }
+        op += match_length;
+    }
+    return op == out_size;
+}
+
+// ============================================================================
+// Чанк целиком
+// ============================================================================
+
+/**
+ * @brief Сжать чанк
+ * @param element_size Размер элемента для shuffle (4 для float/int32, 2 для half)
+ * @return Флаги применённых стадий (0 — хранится без сжатия)
+ */
+inline uint8_t encodeChunk(const uint8_t* data, size_t size, size_t element_size, std::vector<uint8_t>& out) {
+    std::vector<uint8_t> staged(size);
+    uint8_t flags = 0;
+    if (element_size > 1) {
+        byteShuffle(data, size, element_size, staged.data());
+        flags |= kChunkShuffle;
+    } else {
+        std::memcpy(staged.data(), data, size);
+    }
+    deltaEncode(staged.data(), size);
+    flags |= kChunkDelta;
+
+    lzCompress(staged.data(), size, out);
+    if (out.size() >= size) {
+        out.assign(data, data + size);
+        return 0;
+    }
+    return static_cast<uint8_t>(flags | kChunkLZ);
+}
+
+inline bool decodeChunk(const uint8_t* stored, size_t stored_size, uint8_t flags,
+                        size_t element_size, uint8_t* out, size_t raw_size) {
+    if (!(flags & kChunkLZ)) {
+        if (stored_size != raw_size) return false;
+        std::memcpy(out, stored, raw_size);
+        return true;
+    }
+
+    std::vector<uint8_t> staged(raw_size);
+    if (!lzDecompress(stored, stored_size, staged.data(), raw_size)) {
+        return false;
+    }
+    if (flags & kChunkDelta) {
+        deltaDecode(staged.data(), raw_size);
+    }
+    if (flags & kChunkShuffle) {
+        byteUnshuffle(staged.data(), raw_size, element_size, out);
+    } else {
+        std::memcpy(out, staged.data(), raw_size);
+    }
+    return true;
+}
+
+/**
+ * @brief FNV-1a (32 бит) для проверки целостности распакованного чанка
+ */
+inline uint32_t chunkChecksum(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_CHUNK_CODEC_HPP
@@ -22,6 +22,7 @@ private:
     int num_signals_;
     int num_output_points_;
     float scale_factor_;
+    PeaksEncodingParams peaks_encoding_;   // По умолчанию Float32 (без сжатия)
 
 public:
     Configuration()
@@ -49,6 +50,7 @@ public:
     int getNumSignals() const override { return num_signals_; }
     int getNumOutputPoints() const override { return num_output_points_; }
     float getScaleFactor() const override { return scale_factor_; }
+    const PeaksEncodingParams& getPeaksEncoding() const override { return peaks_encoding_; }
 
     // Setters
     void setFFTSize(size_t size) override { fft_size_ = size; }
@@ -56,6 +58,7 @@ public:
     void setNumSignals(int signals) override { num_signals_ = signals; }
     void setNumOutputPoints(int points) override { num_output_points_ = points; }
     void setScaleFactor(float factor) override { scale_factor_ = factor; }
+    void setPeaksEncoding(const PeaksEncodingParams& params) override { peaks_encoding_ = params; }
 
     // Валидация
     bool validate() const override {
@@ -63,7 +66,8 @@ public:
                num_shifts_ > 0 && 
                num_signals_ > 0 && 
                num_output_points_ > 0 && 
-               scale_factor_ > 0.0f;
+               scale_factor_ > 0.0f &&
+               peaks_encoding_.validate(num_output_points_);
     }
 
     std::string getValidationErrors() const override {
@@ -90,6 +94,10 @@ public:
             oss << "Scale factor must be > 0; ";
             has_errors = true;
         }
+        if (!peaks_encoding_.validate(num_output_points_)) {
+            oss << "Sparse peaks encoding needs 1..64 detections, threshold >= 0 and n_kg <= 65536; ";
+            has_errors = true;
+        }
 
         return has_errors ? oss.str() : "";
     }
@@ -102,7 +110,10 @@ public:
             << "  \"num_shifts\": " << num_shifts_ << ",\n"
             << "  \"num_signals\": " << num_signals_ << ",\n"
             << "  \"num_output_points\": " << num_output_points_ << ",\n"
-            << "  \"scale_factor\": " << std::fixed << std::setprecision(9) << scale_factor_ << "\n"
+            << "  \"scale_factor\": " << std::fixed << std::setprecision(9) << scale_factor_ << ",\n"
+            << "  \"peaks_encoding\": \"" << peaksEncodingName(peaks_encoding_.encoding) << "\",\n"
+            << "  \"detection_threshold\": " << std::setprecision(3) << peaks_encoding_.detection_threshold << ",\n"
+            << "  \"max_detections\": " << peaks_encoding_.max_detections << "\n"
             << "}";
         return oss.str();
     }
@@ -0,0 +1,231 @@
+#ifndef CORRELATOR_CORRELATION_2D_HPP
+#define CORRELATOR_CORRELATION_2D_HPP
+
+#include "CpuFFT.hpp"
+#include "ParallelChunks.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// 2D корреляция (сопоставление с шаблоном: спектрограммы, фрагменты изображений)
+// ============================================================================
+
+/**
+ * Кадры и шаблоны — вещественные [height][width] (строки подряд), шаблон
+ * меньше кадра дополняется нулями до height × width (padTemplate2D).
+ * Для кадра I и шаблона T:
+ *
+ *   c[dy][dx] = Σ_{y,x} I[y + dy][x + dx] · T[y][x]   (циклически, масштаб 1/(H·W))
+ *             = IFFT2(FFT2(I) · conj(FFT2(T)))
+ *
+ * Максимум c — положение шаблона в кадре. Сдвиг со знаком: строка y > H/2
+ * означает dy = y − H (как задержки τ < 0 в 1D). Корреляция не нормирована —
+ * при сильно неоднородной яркости кадры нормируют до вызова.
+ *
+ * Пики ищутся по вещественной поверхности; вокруг максимума берётся окно
+ * 3 × 3 (циклически), субпиксельный сдвиг — парабола по каждой оси.
+ */
+
+/**
+ * @struct Peak2D
+ * @brief Максимум 2D корреляции пары (кадр, шаблон)
+ */
+struct Peak2D {
+    float value = 0.0f;     // Значение корреляции в максимуме
+    int row = 0;            // Целочисленный сдвиг dy (со знаком)
+    int col = 0;            // Целочисленный сдвиг dx (со знаком)
+    float dy = 0.0f;        // Субпиксельный сдвиг по строкам
+    float dx = 0.0f;        // Субпиксельный сдвиг по столбцам
+};
+
+/**
+ * Запись максимума, как её пишет устройство: [0] значение, [1] индекс
+ * y·W + x (биты uint32), [2..10] окно 3 × 3 вокруг максимума по строкам
+ * (dy = −1..1, dx = −1..1), [11] выравнивание
+ */
+constexpr size_t kPeak2DRecordFloats = 12;
+
+/**
+ * Размер спектра кадра после R2C: H × (W/2 + 1) (эрмитова половина)
+ */
+inline size_t correlation2DSpectrumBins(size_t height, size_t width) {
+    return height * (width / 2 + 1);
+}
+
+/**
+ * Вершина параболы по трём точкам (−1, 0, +1) в пределах ±0.5
+ */
+inline float parabolicOffset(float left, float center, float right) {
+    const float curvature = left - 2.0f * center + right;
+    if (!(curvature < 0.0f)) {
+        return 0.0f;
+    }
+    return std::clamp(0.5f * (left - right) / curvature, -0.5f, 0.5f);
+}
+
+/**
+ * @brief Пик по записи максимума (общая часть GPU и CPU путей)
+ */
+inline Peak2D refinePeak2D(const float* record, size_t height, size_t width) {
+    uint32_t index = 0;
+    std::memcpy(&index, &record[1], sizeof(index));
+    const size_t y = index / width;
+    const size_t x = index % width;
+    const float* window = record + 2;
+
+    Peak2D peak;
+    peak.value = record[0];
+    peak.row = y > height / 2 ? static_cast<int>(y) - static_cast<int>(height) : static_cast<int>(y);
+    peak.col = x > width / 2 ? static_cast<int>(x) - static_cast<int>(width) : static_cast<int>(x);
+    peak.dy = static_cast<float>(peak.row) + (height > 2 ? parabolicOffset(window[1], window[4], window[7]) : 0.0f);
+    peak.dx = static_cast<float>(peak.col) + (width > 2 ? parabolicOffset(window[3], window[4], window[5]) : 0.0f);
+    return peak;
+}
+
+/**
+ * @brief Запись максимума по поверхности корреляции (при равенстве — меньший индекс)
+ */
+inline void findPeak2DRecord(const float* surface, size_t height, size_t width, float* record) {
+    const size_t size = height * width;
+    const uint32_t best = static_cast<uint32_t>(std::max_element(surface, surface + size) - surface);
+    const size_t y = best / width;
+    const size_t x = best % width;
+
+    record[0] = surface[best];
+    std::memcpy(&record[1], &best, sizeof(best));
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            const size_t ny = (y + height + dy) % height;
+            const size_t nx = (x + width + dx) % width;
+            record[2 + (dy + 1) * 3 + (dx + 1)] = surface[ny * width + nx];
+        }
+    }
+    record[11] = 0.0f;
+}
+
+/**
+ * @brief Шаблон patch_height × patch_width в левом верхнем углу нулевого кадра
+ */
+inline std::vector<float> padTemplate2D(std::span<const float> patch, size_t patch_height, size_t patch_width,
+                                        size_t height, size_t width) {
+    std::vector<float> frame(height * width, 0.0f);
+    const size_t rows = std::min(patch_height, height);
+    const size_t cols = std::min(patch_width, width);
+    for (size_t y = 0; y < rows; ++y) {
+        std::copy_n(patch.data() + y * patch_width, cols, frame.data() + y * width);
+    }
+    return frame;
+}
+
+/**
+ * @class CpuFFT2D
+ * @brief Комплексное 2D FFT на CPU: строки, затем столбцы (CpuFFTPlan по каждой оси)
+ */
+class CpuFFT2D {
+public:
+    using Complex = CpuFFTPlan::Complex;
+
+    CpuFFT2D(size_t height, size_t width)
+        : height_(height), width_(width), rows_(width), cols_(height) {}
+
+    size_t height() const { return height_; }
+    size_t width() const { return width_; }
+
+    /**
+     * Рабочий буфер: столбец + scratch большего из планов
+     */
+    size_t scratchSize() const {
+        return height_ + std::max(rows_.scratchSize(), cols_.scratchSize());
+    }
+
+    void forward(Complex* data, Complex* scratch) const { transform(data, scratch, false); }
+
+    /**
+     * Обратное 2D FFT без масштаба 1/(H·W)
+     */
+    void inverse(Complex* data, Complex* scratch) const { transform(data, scratch, true); }
+
+private:
+    size_t height_;
+    size_t width_;
+    CpuFFTPlan rows_;
+    CpuFFTPlan cols_;
+
+    void transform(Complex* data, Complex* scratch, bool inverse) const {
+        Complex* column = scratch;
+        Complex* plan_scratch = scratch + height_;
+        for (size_t y = 0; y < height_; ++y) {
+            inverse ? rows_.inverse(data + y * width_, plan_scratch) : rows_.forward(data + y * width_, plan_scratch);
+        }
+        for (size_t x = 0; x < width_; ++x) {
+            for (size_t y = 0; y < height_; ++y) column[y] = data[y * width_ + x];
+            inverse ? cols_.inverse(column, plan_scratch) : cols_.forward(column, plan_scratch);
+            for (size_t y = 0; y < height_; ++y) data[y * width_ + x] = column[y];
+        }
+    }
+};
+
+/**
+ * @brief CPU реализация (эталон и запасной путь для бэкендов без 2D режима)
+ * @param templates [num_templates][height][width], шаблоны уже дополнены нулями
+ * @param images [num_images][height][width]
+ * @param peaks [num_images][num_templates]
+ */
+inline bool computeCorrelation2D(std::span<const float> templates, int num_templates,
+                                 std::span<const float> images, int num_images,
+                                 size_t height, size_t width, std::vector<Peak2D>& peaks,
+                                 unsigned threads = 0) {
+    const size_t frame = height * width;
+    if (frame == 0 || num_templates <= 0 || num_images <= 0 ||
+        templates.size() < static_cast<size_t>(num_templates) * frame ||
+        images.size() < static_cast<size_t>(num_images) * frame) {
+        return false;
+    }
+
+    using Complex = CpuFFT2D::Complex;
+    const CpuFFT2D plan(height, width);
+
+    // Step 1: conj(FFT2(T)) один раз на все кадры
+    std::vector<Complex> template_spectra(static_cast<size_t>(num_templates) * frame);
+    parallelChunks(static_cast<size_t>(num_templates), threads, [&](size_t t) {
+        thread_local std::vector<Complex> scratch;
+        scratch.resize(plan.scratchSize());
+        Complex* spectrum = template_spectra.data() + t * frame;
+        for (size_t i = 0; i < frame; ++i) spectrum[i] = Complex(templates[t * frame + i], 0.0f);
+        plan.forward(spectrum, scratch.data());
+        for (size_t i = 0; i < frame; ++i) spectrum[i] = std::conj(spectrum[i]);
+    });
+
+    peaks.assign(static_cast<size_t>(num_images) * num_templates, Peak2D{});
+    const float inv_size = 1.0f / static_cast<float>(frame);
+    parallelChunks(static_cast<size_t>(num_images), threads, [&](size_t image) {
+        thread_local std::vector<Complex> spectrum, product, scratch;
+        thread_local std::vector<float> surface;
+        spectrum.resize(frame);
+        product.resize(frame);
+        scratch.resize(plan.scratchSize());
+        surface.resize(frame);
+        for (size_t i = 0; i < frame; ++i) spectrum[i] = Complex(images[image * frame + i], 0.0f);
+        plan.forward(spectrum.data(), scratch.data());
+
+        float record[kPeak2DRecordFloats];
+        for (int t = 0; t < num_templates; ++t) {
+            const Complex* reference = template_spectra.data() + static_cast<size_t>(t) * frame;
+            for (size_t i = 0; i < frame; ++i) product[i] = spectrum[i] * reference[i];
+            plan.inverse(product.data(), scratch.data());
+            for (size_t i = 0; i < frame; ++i) surface[i] = product[i].real() * inv_size;
+            findPeak2DRecord(surface.data(), height, width, record);
+            peaks[image * num_templates + t] = refinePeak2D(record, height, width);
+        }
+    });
+    return true;
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_CORRELATION_2D_HPP
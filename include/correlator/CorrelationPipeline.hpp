@@ -2,10 +2,26 @@
 #define CORRELATOR_PIPELINE_HPP
 
 #include "IFFTBackend.hpp"
+#include "Beamformer.hpp"
+#include "Correlation2D.hpp"
 #include "IConfiguration.hpp"
 #include "IDataSnapshot.hpp"
 #include "IDataValidator.hpp"
 #include "IResultExporter.hpp"
+#include "MetricsRegistry.hpp"
+#include "PagedReferenceBank.hpp"
+#include "PairwiseCorrelation.hpp"
+#include "PeaksView.hpp"
+#include "RangeDoppler.hpp"
+#include "ResultsRing.hpp"
+#include "SpectralIndex.hpp"
+#include "PipelineCheckpoint.hpp"
+#include "RealtimeMemory.hpp"
+#include "ReferenceSpectra.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <memory>
 #include <vector>
 #include <string>
@@ -36,6 +52,33 @@ private:
     bool step2_completed_;
     bool step3_completed_;
 
+    // Пики последнего Step 3 (переиспользуется между батчами)
+    PeaksBuffer peaks_;
+    std::vector<ComplexFloat> step2_spectra_;  // Спектры Step 2 с устройства, ёмкость между батчами
+    int step2_signals_ = 0;
+    bool step2_spectra_deferred_ = false;      // Слитый путь: спектры Step 2 публикуются после Step 3
+    bool step2_export_ = true;                 // Снимок, валидация и экспорт спектров Step 2
+
+    // Сжатые пики (кодировка из конфигурации, не Float32)
+    EncodedPeaks encoded_peaks_;
+    bool device_encoding_ = false;      // Бэкенд кодирует на устройстве
+
+    // Архив спектров Step 2 (опционально, см. setSpectralIndex)
+    std::shared_ptr<SpectralIndexWriter> spectral_index_;
+
+    // Публикация результатов Step 3 в разделяемую память (опционально, см. setResultsRing)
+    std::shared_ptr<ResultsRingWriter> results_ring_;
+
+    // Страницы банка опорных на устройстве (см. configureReferenceCache, executePagedStep3)
+    ReferencePageCache reference_cache_;
+
+    // Формирование лучей между Step 2 и Step 3 (опционально, см. setBeamforming)
+    std::shared_ptr<const BeamWeights> beam_weights_;
+    bool beam_weights_pending_ = false;     // Веса ещё не переданы бэкенду
+    bool device_beamforming_ = false;       // Бэкенд формирует лучи на устройстве
+    std::vector<ComplexFloat> beam_spectra_; // CPU путь: [num_signals][N]
+    OperationTiming step2_beam_timing_;
+
     // Хранение данных профилирования для каждого шага
     OperationTiming step1_upload_timing_;
     OperationTiming step1_fft_timing_;
@@ -45,6 +88,168 @@ private:
     OperationTiming step3_ifft_timing_;
     OperationTiming step3_download_timing_;
 
+    // Парный режим Step 3 (TDOA), см. executePairwiseStep3
+    std::vector<float> pairwise_peaks_;     // [pairs][num_lags]
+    int pairwise_signals_ = 0;
+    int pairwise_lags_ = 0;
+    OperationTiming pairwise_multiply_timing_;
+    OperationTiming pairwise_ifft_timing_;
+    OperationTiming pairwise_download_timing_;
+
+    // Карта дальность-доплер (Step 4), см. executeRangeDoppler
+    std::vector<float> range_doppler_map_;                  // [range_bins][doppler_size]
+    std::vector<RangeDopplerDetection> range_doppler_detections_;
+    size_t range_doppler_found_ = 0;
+    RangeDopplerParams range_doppler_params_;
+    OperationTiming range_doppler_turn_timing_;
+    OperationTiming range_doppler_fft_timing_;
+    OperationTiming range_doppler_detect_timing_;
+
+    // 2D корреляция (сопоставление с шаблоном), см. setTemplates2D
+    std::vector<float> templates_2d_;       // [templates][H][W] для CPU пути
+    int num_templates_2d_ = 0;
+    size_t height_2d_ = 0;
+    size_t width_2d_ = 0;
+    bool device_templates_2d_ = false;      // Спектры шаблонов на устройстве
+    std::vector<Peak2D> peaks_2d_;          // [images][templates]
+    OperationTiming corr2d_fft_timing_;
+    OperationTiming corr2d_multiply_timing_;
+    OperationTiming corr2d_ifft_timing_;
+
+    // ========================================================================
+    // Метрики (опционально, см. setMetrics)
+    // ========================================================================
+
+    struct StepMetrics {
+        Histogram* latency = nullptr;  // correlator_step_duration_seconds{step}
+        Counter* errors = nullptr;     // correlator_step_errors_total{step}
+    };
+
+    struct PipelineMetrics {
+        std::shared_ptr<MetricsRegistry> registry;
+        StepMetrics steps[3];
+        Counter* batches = nullptr;
+        Counter* signals = nullptr;
+        Counter* correlations = nullptr;
+        Gauge* steps_in_flight = nullptr;
+        Gauge* device_memory = nullptr;
+        Gauge* device_memory_high_water = nullptr;
+    };
+
+    std::unique_ptr<PipelineMetrics> metrics_;
+
+    /**
+     * RAII-замер шага: задержка, in-flight, ошибка (false или исключение)
+     */
+    class StepScope {
+    public:
+        StepScope(PipelineMetrics* metrics, int step_index)
+            : metrics_(metrics),
+              step_(metrics ? &metrics->steps[step_index] : nullptr),
+              start_(std::chrono::steady_clock::now()) {
+            if (metrics_) metrics_->steps_in_flight->add(1.0);
+        }
+
+        ~StepScope() {
+            if (!metrics_) return;
+            metrics_->steps_in_flight->add(-1.0);
+            step_->latency->observe(
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+            if (!succeeded_) step_->errors->inc();
+        }
+
+        void succeeded() { succeeded_ = true; }
+
+    private:
+        PipelineMetrics* metrics_;
+        StepMetrics* step_;
+        std::chrono::steady_clock::time_point start_;
+        bool succeeded_ = false;
+    };
+
+    void updateMemoryMetrics() {
+        if (!metrics_) return;
+        std::vector<DeviceMemoryStep> steps;
+        size_t current_bytes = 0, high_water_bytes = 0;
+        if (backend_->getDeviceMemoryUsage(steps, current_bytes, high_water_bytes)) {
+            metrics_->device_memory->set(static_cast<double>(current_bytes));
+            metrics_->device_memory_high_water->set(static_cast<double>(high_water_bytes));
+        }
+    }
+
+    /**
+     * Спектры каналов (уже в input_fft) → спектры лучей в input_fft
+     */
+    bool formStep2Beams(const std::vector<ComplexFloat>& channel_spectra) {
+        if (beam_weights_pending_) {
+            device_beamforming_ = backend_->setBeamWeights(beam_weights_->values(), beam_weights_->channels(),
+                                                          beam_weights_->beams());
+            beam_weights_pending_ = false;
+        }
+
+        step2_beam_timing_ = OperationTiming{};
+        if (device_beamforming_) {
+            return backend_->step2_FormBeams(step2_beam_timing_);
+        }
+
+        const int num_signals = config_->getNumSignals();
+        beam_spectra_.assign(config_->getFFTSize() * num_signals, ComplexFloat{});
+        return formBeams(channel_spectra, *beam_weights_, beam_spectra_) &&
+               backend_->loadInputSpectra(beam_spectra_, num_signals, step2_beam_timing_);
+    }
+
+    /**
+     * Спектры Step 2 → снимок, индекс, валидация и экспорт (в step2_spectra_).
+     * Без потребителей (need_spectra, экспорт, индекс) спектры с устройства не читаются
+     */
+    bool publishStep2Spectra(bool need_spectra) {
+        if (!need_spectra && !step2_export_ && !spectral_index_) {
+            return true;
+        }
+
+        std::vector<ComplexFloat>& input_fft = step2_spectra_;
+        if (!backend_->getInputFFT(input_fft)) {
+            return false;
+        }
+
+        if (spectral_index_ && !spectral_index_->append(input_fft, step2_signals_)) {
+            fprintf(stderr, "[PIPELINE] Failed to append spectra to %s\n", spectral_index_->path().c_str());
+        }
+
+        if (step2_export_) {
+            snapshot_->saveInputFFT(input_fft, step2_signals_, config_->getFFTSize());
+
+            // Валидация
+            auto validation = validator_->validateStep2(*snapshot_, *config_);
+            if (!validation.is_valid) {
+                // Логируем ошибки
+            }
+
+            // Экспорт в JSON
+            exporter_->exportStep2(*snapshot_, *config_, validation);
+        }
+        return true;
+    }
+
+    /**
+     * Спектры Step 2, отложенные слитым путём: досчитать (время — в Step 2) и опубликовать
+     */
+    bool publishDeferredStep2() {
+        if (!step2_spectra_deferred_) {
+            return true;
+        }
+        step2_spectra_deferred_ = false;
+
+        if (!step2_export_ && !spectral_index_) {
+            return true;
+        }
+        OperationTiming fft_timing;
+        if (backend_->step2_MaterializeInputSpectra(fft_timing)) {
+            step2_fft_timing_ = fft_timing;
+        }
+        return publishStep2Spectra(false);
+    }
+
 public:
     /**
      * @brief Конструктор
@@ -73,12 +278,46 @@ public:
      * @brief Инициализация pipeline
      */
     bool initialize() {
+        device_encoding_ = backend_->setPeaksEncoding(config_->getPeaksEncoding());
         if (!backend_->initialize()) {
             return false;
         }
+        updateMemoryMetrics();
         return true;
     }
 
+    /**
+     * @brief Режим реального времени (после initialize): буферы батча на полную
+     * форму конфигурации, mlockall, префолт, закрепление потока (RealtimeMemory.hpp)
+     *
+     * Снимок заполняется первым батчем; дальше его копии идут в ту же ёмкость.
+     * Каждый следующий батч начинается с beginBatch().
+     */
+    RealtimeStatus enableRealtimeMode(const RealtimeOptions& options = {}) {
+        const int num_signals = config_->getNumSignals();
+        peaks_.reshape(num_signals, config_->getNumShifts(), config_->getNumOutputPoints());
+        step2_spectra_.resize(static_cast<size_t>(num_signals) * config_->getFFTSize());
+
+        RealtimeStatus status = Correlator::enableRealtimeMode(options);
+        if (options.prefault) {
+            status.prefaulted_bytes += prefaultSpan(peaks_.span()) + prefaultSpan(std::span(step2_spectra_));
+        }
+        return status;
+    }
+
+    /**
+     * @brief Начать следующий батч: Step 2 и Step 3 выполнятся заново
+     *
+     * Без вызова executeStep2/executeStep3 после первого батча возвращают
+     * true, ничего не делая. Банк Step 1 и ёмкость буферов батча
+     * (peaks_, step2_spectra_) сохраняются.
+     */
+    void beginBatch() {
+        step2_completed_ = false;
+        step3_completed_ = false;
+        step2_spectra_deferred_ = false;
+    }
+
     /**
      * @brief Step 1: Обработка опорных сигналов
      * @param reference_signal Опорный сигнал (M-sequence)
@@ -90,6 +329,8 @@ public:
             return true;
         }
 
+        StepScope scope(metrics_.get(), 0);
+
         OperationTiming upload_timing, fft_timing;
         
         if (!backend_->step1_ProcessReferenceSignals(reference_signal, num_shifts, 
@@ -120,6 +361,55 @@ public:
         exporter_->exportStep1(*snapshot_, *config_, validation);
 
         step1_completed_ = true;
+        scope.succeeded();
+        updateMemoryMetrics();
+        return true;
+    }
+
+    /**
+     * @brief Step 1 из аналитического спектра опорного (ЛЧМ, периодический код)
+     * Банк разворачивается из одной строки без FFT по сдвигам: на устройстве,
+     * если бэкенд умеет, иначе на CPU с загрузкой через loadReferenceSpectra.
+     * @param base_spectrum R_0 = conj(scale·X), fft_size значений (referenceBaseSpectrum)
+     * @return false — бэкенд не принимает спектры, нужен обычный executeStep1
+     */
+    bool executeStep1FromSpectrum(std::span<const ComplexFloat> base_spectrum, int num_shifts) {
+        if (step1_completed_) {
+            return true;
+        }
+        if (base_spectrum.size() != config_->getFFTSize()) {
+            return false;
+        }
+
+        StepScope scope(metrics_.get(), 0);
+
+        OperationTiming upload_timing, expand_timing;
+        if (!backend_->loadReferenceBaseSpectrum(base_spectrum, num_shifts, upload_timing, expand_timing)) {
+            const auto start = std::chrono::steady_clock::now();
+            const std::vector<ComplexFloat> bank = expandReferenceBank(base_spectrum, num_shifts);
+            expand_timing = OperationTiming{};
+            expand_timing.execute_ms =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (!backend_->loadReferenceSpectra(bank, num_shifts, upload_timing)) {
+                return false;
+            }
+        }
+
+        step1_upload_timing_ = upload_timing;
+        step1_fft_timing_ = expand_timing;
+
+        std::vector<ComplexFloat> reference_fft;
+        if (!backend_->getReferenceFFT(reference_fft)) {
+            return false;
+        }
+        snapshot_->saveReferenceFFT(reference_fft, num_shifts, config_->getFFTSize());
+
+        auto validation = validator_->validateStep1(*snapshot_, *config_);
+        exporter_->exportStep1(*snapshot_, *config_, validation);
+
+        step1_completed_ = true;
+        scope.succeeded();
+        updateMemoryMetrics();
         return true;
     }
 
@@ -137,6 +427,8 @@ public:
             return true;
         }
 
+        StepScope scope(metrics_.get(), 1);
+
         OperationTiming upload_timing, fft_timing;
         
         if (!backend_->step2_ProcessInputSignals(input_signals, num_signals, 
@@ -147,25 +439,29 @@ public:
         // Сохранить данные профилирования
         step2_upload_timing_ = upload_timing;
         step2_fft_timing_ = fft_timing;
+        step2_signals_ = num_signals;
 
-        // Получить результаты и сохранить в snapshot
-        std::vector<ComplexFloat> input_fft;
-        if (!backend_->getInputFFT(input_fft)) {
-            return false;
+        // Слитый путь: FFT входа выполнит Step 3, спектры публикуются после него.
+        // Лучам спектры каналов нужны сейчас — досчитываем сразу
+        if (beam_weights_) {
+            OperationTiming deferred_fft_timing;
+            if (backend_->step2_MaterializeInputSpectra(deferred_fft_timing)) {
+                step2_fft_timing_ = deferred_fft_timing;
+            }
         }
+        step2_spectra_deferred_ = backend_->isInputSpectraDeferred();
 
-        snapshot_->saveInputFFT(input_fft, num_signals, config_->getFFTSize());
-
-        // Валидация
-        auto validation = validator_->validateStep2(*snapshot_, *config_);
-        if (!validation.is_valid) {
-            // Логируем ошибки
+        // Снимок, индекс и валидация — по спектрам каналов; Step 3 — по лучам
+        if (!step2_spectra_deferred_ && !publishStep2Spectra(beam_weights_ != nullptr)) {
+            return false;
+        }
+        if (beam_weights_ && !formStep2Beams(step2_spectra_)) {
+            return false;
         }
-
-        // Экспорт в JSON
-        exporter_->exportStep2(*snapshot_, *config_, validation);
 
         step2_completed_ = true;
+        scope.succeeded();
+        updateMemoryMetrics();
         return true;
     }
 
@@ -184,6 +480,8 @@ public:
             return true;
         }
 
+        StepScope scope(metrics_.get(), 2);
+
         OperationTiming copy_timing, ifft_timing, download_timing;
         
         if (!backend_->step3_ComputeCorrelation(num_signals, num_shifts, n_kg,
@@ -196,13 +494,41 @@ public:
         step3_ifft_timing_ = ifft_timing;
         step3_download_timing_ = download_timing;
 
-        // Получить результаты и сохранить в snapshot
-        std::vector<float> peaks;
-        if (!backend_->getCorrelationPeaks(peaks)) {
+        if (!publishDeferredStep2()) {
             return false;
         }
 
-        snapshot_->savePeaks(peaks, num_signals, num_shifts, n_kg);
+        // Получить результаты и сохранить в snapshot
+        peaks_.reshape(num_signals, num_shifts, n_kg);
+        const PeaksEncodingParams& encoding = config_->getPeaksEncoding();
+        if (encoding.encoding == PeaksEncoding::Float32) {
+            if (!backend_->readCorrelationPeaks(peaks_.span())) {
+                return false;
+            }
+        } else {
+            // Бэкенд без кодирования на устройстве: сжимаем на CPU (экономия только на хранении)
+            bool encoded = device_encoding_
+                ? backend_->getEncodedPeaks(encoded_peaks_)
+                : backend_->readCorrelationPeaks(peaks_.span()) &&
+                  encodePeaks(peaks_.span(), num_signals, num_shifts, n_kg, encoding, encoded_peaks_);
+            // Снимок, валидация и getPeaksView работают с декодированными значениями
+            if (!encoded || !decodePeaks(encoded_peaks_, peaks_.span())) {
+                return false;
+            }
+            exporter_->exportEncodedPeaks(encoded_peaks_, *config_);
+        }
+
+        snapshot_->savePeaks(peaks_.span(), num_signals, num_shifts, n_kg);
+
+        if (results_ring_) {
+            // Сжатые пики публикуются как есть: SparseDelta — только детекции
+            bool published = encoding.encoding == PeaksEncoding::Float32
+                ? results_ring_->publishPeaks(peaks_.span(), num_signals, num_shifts, n_kg)
+                : results_ring_->publishEncoded(encoded_peaks_);
+            if (!published) {
+                fprintf(stderr, "[PIPELINE] Failed to publish peaks to %s\n", results_ring_->name().c_str());
+            }
+        }
 
         // Валидация
         auto validation = validator_->validateStep3(*snapshot_, *config_);
@@ -214,9 +540,176 @@ public:
         exporter_->exportStep3(*snapshot_, *config_, validation);
 
         step3_completed_ = true;
+        scope.succeeded();
+        if (metrics_) {
+            metrics_->batches->inc();
+            metrics_->signals->inc(static_cast<uint64_t>(num_signals));
+            metrics_->correlations->inc(static_cast<uint64_t>(num_signals) * num_shifts);
+        }
+        updateMemoryMetrics();
+        return true;
+    }
+
+    /**
+     * @brief Step 3 в парном режиме (TDOA): корреляция каждой пары входов между собой
+     *
+     * Использует спектры Step 2 (или лучей, если они сформированы), опорные
+     * не участвуют. Считаются только пары i ≤ j (включая автокорреляцию), одним
+     * батчевым IFFT на бэкенде; без поддержки бэкенда — на CPU по getInputFFT.
+     * Раскладка и задержки — PairwiseCorrelation.hpp, результат — getPairwisePeaks().
+     *
+     * @param num_signals Сколько первых строк батча участвуют в парах
+     * @param num_lags Окно задержек вокруг нуля на пару
+     */
+    bool executePairwiseStep3(int num_signals, int num_lags) {
+        if (!step2_completed_) {
+            throw std::runtime_error("Step 2 must be completed before pairwise Step 3");
+        }
+        // Пары считаются по спектрам Step 2: слитый путь их отложил
+        if (!publishDeferredStep2()) {
+            return false;
+        }
+
+        pairwise_multiply_timing_ = OperationTiming{};
+        pairwise_ifft_timing_ = OperationTiming{};
+        pairwise_download_timing_ = OperationTiming{};
+        if (!backend_->step3_ComputePairwiseCorrelation(num_signals, num_lags, pairwise_peaks_,
+                                                        pairwise_multiply_timing_, pairwise_ifft_timing_,
+                                                        pairwise_download_timing_)) {
+            std::vector<ComplexFloat> spectra;
+            if (!backend_->getInputFFT(spectra)) {
+                return false;
+            }
+            auto start = std::chrono::steady_clock::now();
+            pairwise_peaks_.assign(pairwisePairCount(num_signals) * num_lags, 0.0f);
+            if (!computePairwisePeaks(spectra, num_signals, config_->getFFTSize(), num_lags, pairwise_peaks_)) {
+                return false;
+            }
+            pairwise_ifft_timing_.execute_ms =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            pairwise_ifft_timing_.total_gpu_ms = pairwise_ifft_timing_.execute_ms;
+        }
+
+        pairwise_signals_ = num_signals;
+        pairwise_lags_ = num_lags;
+        return true;
+    }
+
+    /**
+     * @brief Пики последнего executePairwiseStep3: [pairs][num_lags]
+     */
+    const std::vector<float>& getPairwisePeaks() const { return pairwise_peaks_; }
+    int getPairwiseSignals() const { return pairwise_signals_; }
+    int getPairwiseLags() const { return pairwise_lags_; }
+
+    /**
+     * @brief Step 4 (импульсно-доплеровский): карта дальность-доплер по последнему Step 3
+     *
+     * Сигналы батча — импульсы. Бэкенд заново считает профили дальности из
+     * спектров Step 1/2 на устройстве (Step 3 хранит только пики) и строит карту
+     * без возврата на хост (перестановка, окно, FFT по импульсам, |·|², CFAR);
+     * бэкенд без этого шага — CPU по спектрам Step 1/2 (getReferenceFFT/getInputFFT).
+     * Соглашения — RangeDoppler.hpp.
+     *
+     * @param download_map false — скачивать только детекции CFAR (карта остаётся на устройстве)
+     */
+    bool executeRangeDoppler(const RangeDopplerParams& params, bool download_map = true) {
+        if (!step3_completed_) {
+            throw std::runtime_error("Step 3 must be completed before range-Doppler processing");
+        }
+
+        range_doppler_turn_timing_ = OperationTiming{};
+        range_doppler_fft_timing_ = OperationTiming{};
+        range_doppler_detect_timing_ = OperationTiming{};
+        range_doppler_map_.clear();
+        if (!backend_->step4_ComputeRangeDoppler(params, download_map ? &range_doppler_map_ : nullptr,
+                                                 range_doppler_detections_, range_doppler_found_,
+                                                 range_doppler_turn_timing_, range_doppler_fft_timing_,
+                                                 range_doppler_detect_timing_)) {
+            std::vector<ComplexFloat> reference_spectra, input_spectra;
+            if (!backend_->getReferenceFFT(reference_spectra) || !backend_->getInputFFT(input_spectra)) {
+                return false;
+            }
+            auto start = std::chrono::steady_clock::now();
+            if (!computeRangeDoppler(reference_spectra, input_spectra, config_->getFFTSize(), params,
+                                     range_doppler_map_, range_doppler_detections_, range_doppler_found_)) {
+                return false;
+            }
+            range_doppler_fft_timing_.execute_ms =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            range_doppler_fft_timing_.total_gpu_ms = range_doppler_fft_timing_.execute_ms;
+            if (!download_map) {
+                range_doppler_map_.clear();
+            }
+        }
+
+        range_doppler_params_ = params;
+        return true;
+    }
+
+    /**
+     * @brief Карта последнего executeRangeDoppler (пусто, если не скачивалась)
+     */
+    const std::vector<float>& getRangeDopplerMap() const { return range_doppler_map_; }
+    const std::vector<RangeDopplerDetection>& getRangeDopplerDetections() const { return range_doppler_detections_; }
+    size_t getRangeDopplerDetectionCount() const { return range_doppler_found_; }
+    const RangeDopplerParams& getRangeDopplerParams() const { return range_doppler_params_; }
+
+    /**
+     * @brief 2D режим: задать шаблоны [num_templates][height][width] (уже дополнены нулями)
+     *
+     * Бэкенд считает спектры шаблонов один раз (батчевый R2C FFT) и держит их
+     * до следующего вызова; бэкенд без 2D режима — корреляция на CPU.
+     */
+    bool setTemplates2D(std::vector<float> templates, int num_templates, size_t height, size_t width) {
+        if (num_templates <= 0 || templates.size() != static_cast<size_t>(num_templates) * height * width) {
+            return false;
+        }
+        corr2d_fft_timing_ = OperationTiming{};
+        device_templates_2d_ = backend_->setTemplates2D(templates, num_templates, height, width, corr2d_fft_timing_);
+        templates_2d_ = std::move(templates);
+        num_templates_2d_ = num_templates;
+        height_2d_ = height;
+        width_2d_ = width;
         return true;
     }
 
+    /**
+     * @brief 2D корреляция кадров [num_images][height][width] со всеми шаблонами
+     *
+     * Максимум на пару (кадр, шаблон) с субпиксельным сдвигом — getCorrelation2DPeaks(),
+     * раскладка [images][templates], соглашения — Correlation2D.hpp.
+     */
+    bool executeCorrelation2D(std::span<const float> images, int num_images) {
+        if (num_templates_2d_ == 0) {
+            throw std::runtime_error("setTemplates2D must be called before 2D correlation");
+        }
+
+        corr2d_multiply_timing_ = OperationTiming{};
+        corr2d_ifft_timing_ = OperationTiming{};
+        if (device_templates_2d_ &&
+            backend_->correlate2D(images, num_images, peaks_2d_, corr2d_fft_timing_,
+                                  corr2d_multiply_timing_, corr2d_ifft_timing_)) {
+            return true;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (!computeCorrelation2D(templates_2d_, num_templates_2d_, images, num_images,
+                                  height_2d_, width_2d_, peaks_2d_)) {
+            return false;
+        }
+        corr2d_ifft_timing_.execute_ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        corr2d_ifft_timing_.total_gpu_ms = corr2d_ifft_timing_.execute_ms;
+        return true;
+    }
+
+    /**
+     * @brief Максимумы последнего executeCorrelation2D: [images][templates]
+     */
+    const std::vector<Peak2D>& getCorrelation2DPeaks() const { return peaks_2d_; }
+    int getNumTemplates2D() const { return num_templates_2d_; }
+
     /**
      * @brief Выполнить весь pipeline
      */
@@ -247,19 +740,387 @@ public:
         return true;
     }
 
+    /**
+     * @brief Сохранить тёплое состояние: спектры Step 1, последний батч, настройки
+     */
+    bool saveCheckpoint(const std::string& path) const {
+        if (!step1_completed_) {
+            return false;
+        }
+        CheckpointState state = PipelineCheckpoint::makeState(*config_, backend_->getDeviceName());
+        state.step_flags = kCheckpointStep1 |
+                           (step2_completed_ ? kCheckpointStep2 : 0) |
+                           (step3_completed_ ? kCheckpointStep3 : 0);
+
+        BackendTuning tuning;
+        if (backend_->getTuning(tuning)) {
+            state.step_flags |= kCheckpointTuning;
+            state.tuning_step2_path = tuning.step2_path;
+            state.tuning_fused = tuning.fused;
+            state.tuning_step2_split = tuning.step2_split;
+            static_assert(sizeof(state.tuning_device) == sizeof(tuning.device));
+            std::memcpy(state.tuning_device, tuning.device, sizeof(tuning.device));
+        }
+
+        std::span<const ComplexFloat> input_fft;
+        std::span<const float> peaks;
+        std::vector<ComplexFloat> input_spectra;
+        if (step2_completed_) {
+            // Снимок пуст без экспорта Step 2 и устарел, пока спектры отложены до Step 3
+            if (step2_export_ && !step2_spectra_deferred_) {
+                input_fft = snapshot_->getInputFFT();
+            } else if (backend_->getInputFFT(input_spectra)) {
+                input_fft = input_spectra;
+            } else {
+                return false;
+            }
+        }
+        if (step3_completed_) peaks = peaks_.span();
+        return PipelineCheckpoint::save(path, state, snapshot_->getReferenceFFT(), input_fft, peaks);
+    }
+
+    /**
+     * @brief Восстановить состояние из checkpoint вместо Step 1
+     *
+     * Применяет сохранённые настройки (кодировка пиков, настройки бэкенда вместо
+     * автотюнинга), при необходимости инициализирует бэкенд и загружает спектры
+     * опорных прямо в reference_fft.
+     * Пики последнего батча доступны через getPeaksView(). С restore_batch
+     * дополнительно восстанавливаются спектры Step 2 и состояние Step 3
+     * (повторная обработка того же батча не требуется).
+     *
+     * @return false, если форма checkpoint не совпадает с конфигурацией или
+     *         настройки бэкенда выбраны на другом устройстве/драйвере
+     */
+    bool restoreCheckpoint(const std::string& path, bool restore_batch = false) {
+        PipelineCheckpoint checkpoint;
+        if (!checkpoint.open(path)) {
+            return false;
+        }
+        const CheckpointState& state = checkpoint.state();
+        std::string reason;
+        if (!PipelineCheckpoint::matches(state, *config_, reason)) {
+            fprintf(stderr, "[PIPELINE] Checkpoint %s rejected: %s\n", path.c_str(), reason.c_str());
+            return false;
+        }
+        if (!(state.step_flags & kCheckpointStep1)) {
+            return false;
+        }
+
+        // Настройки до initialize: кодировка пиков влияет на ресурсы бэкенда,
+        // сохранённая настройка бэкенда заменяет автотюнинг
+        BackendTuning saved_tuning;
+        const bool has_tuning = (state.step_flags & kCheckpointTuning) != 0;
+        if (has_tuning) {
+            saved_tuning.step2_path = state.tuning_step2_path;
+            saved_tuning.fused = state.tuning_fused;
+            saved_tuning.step2_split = state.tuning_step2_split;
+            std::memcpy(saved_tuning.device, state.tuning_device, sizeof(saved_tuning.device));
+            saved_tuning.device[sizeof(saved_tuning.device) - 1] = '\0';
+        }
+        config_->setPeaksEncoding(PipelineCheckpoint::encodingOf(state));
+        bool tuning_applied = !has_tuning;
+        if (backend_->isInitialized()) {
+            device_encoding_ = backend_->setPeaksEncoding(config_->getPeaksEncoding());
+            tuning_applied = tuning_applied || backend_->setTuning(saved_tuning);
+        } else {
+            if (has_tuning) {
+                backend_->setTuning(saved_tuning);
+            }
+            if (!initialize()) {
+                return false;
+            }
+            BackendTuning current;
+            tuning_applied = tuning_applied || (backend_->getTuning(current) && current.sameAs(saved_tuning));
+        }
+        if (!tuning_applied) {
+            fprintf(stderr, "[PIPELINE] Checkpoint %s rejected: tuning from '%s' does not match this device\n",
+                    path.c_str(), saved_tuning.device);
+            return false;
+        }
+        if (backend_->getDeviceName() != state.device_name) {
+            fprintf(stderr, "[PIPELINE] Checkpoint from device '%s', restoring on '%s'\n",
+                    state.device_name, backend_->getDeviceName().c_str());
+        }
+
+        int num_shifts = config_->getNumShifts();
+        int num_signals = config_->getNumSignals();
+        int n_kg = config_->getNumOutputPoints();
+
+        std::vector<ComplexFloat> reference_fft;
+        step1_fft_timing_ = OperationTiming{};
+        if (!checkpoint.readReferenceFFT(reference_fft) ||
+            !backend_->loadReferenceSpectra(reference_fft, num_shifts, step1_upload_timing_)) {
+            return false;
+        }
+        snapshot_->saveReferenceFFT(reference_fft, num_shifts, config_->getFFTSize());
+        step1_completed_ = true;
+        step2_completed_ = false;
+        step3_completed_ = false;
+        step2_spectra_deferred_ = false;
+
+        std::vector<float> peaks;
+        bool peaks_restored = (state.step_flags & kCheckpointStep3) && checkpoint.readPeaks(peaks) &&
+                              peaks.size() == static_cast<size_t>(num_signals) * num_shifts * n_kg;
+        if (peaks_restored) {
+            peaks_.reshape(num_signals, num_shifts, n_kg);
+            std::copy(peaks.begin(), peaks.end(), peaks_.span().begin());
+            snapshot_->savePeaks(peaks_.span(), num_signals, num_shifts, n_kg);
+        }
+
+        if (restore_batch && (state.step_flags & kCheckpointStep2)) {
+            std::vector<ComplexFloat> input_fft;
+            step2_fft_timing_ = OperationTiming{};
+            if (checkpoint.readInputFFT(input_fft) &&
+                backend_->loadInputSpectra(input_fft, num_signals, step2_upload_timing_)) {
+                snapshot_->saveInputFFT(input_fft, num_signals, config_->getFFTSize());
+                step2_completed_ = true;
+                step3_completed_ = peaks_restored;
+            }
+        }
+
+        updateMemoryMetrics();
+        return true;
+    }
+
+    /**
+     * @brief Снимок, валидация и JSON/бинарный экспорт спектров Step 2 (по умолчанию включены)
+     *
+     * Выключенный экспорт без спектрального индекса и CPU лучей не читает
+     * спектры с устройства: слитому пути не нужен отдельный FFT входа.
+     */
+    void setInputSpectraExport(bool enabled) {
+        step2_export_ = enabled;
+    }
+
+    /**
+     * @brief Сохранять спектры каждого Step 2 в спектральный индекс архива
+     */
+    void setSpectralIndex(std::shared_ptr<SpectralIndexWriter> index) {
+        spectral_index_ = std::move(index);
+    }
+
+    /**
+     * @brief Публиковать пики каждого Step 3 в кольцо разделяемой памяти (см. ResultsRing.hpp)
+     */
+    void setResultsRing(std::shared_ptr<ResultsRingWriter> ring) {
+        results_ring_ = std::move(ring);
+    }
+
+    /**
+     * @brief Формировать лучи из спектров каналов после каждого Step 2
+     *
+     * Каналы — сигналы батча (channels = num_signals), лучей не больше
+     * num_signals. Step 3 коррелирует лучи: строка b пиков — луч b,
+     * строки ≥ beams нулевые. Бэкенд без setBeamWeights получает лучи,
+     * посчитанные на CPU (formBeams), через loadInputSpectra.
+     * nullptr отключает формирование лучей.
+     */
+    bool setBeamforming(std::shared_ptr<const BeamWeights> weights) {
+        if (weights && (weights->channels() != config_->getNumSignals() ||
+                        weights->beams() <= 0 || weights->beams() > config_->getNumSignals() ||
+                        weights->fftSize() != config_->getFFTSize())) {
+            return false;
+        }
+        beam_weights_ = std::move(weights);
+        beam_weights_pending_ = beam_weights_ != nullptr;
+        device_beamforming_ = false;
+        return true;
+    }
+
+    const OperationTiming& getBeamformingTiming() const { return step2_beam_timing_; }
+
+    /**
+     * @brief Ретроспективный поиск: опорный сигнал Step 1 против всего архива
+     *
+     * Выполняет только Step 3 над спектрами из индекса (батчами по
+     * num_signals конфигурации). После поиска input_fft бэкенда содержит
+     * спектры архива, поэтому Step 2/3 текущего батча сбрасываются.
+     */
+    bool searchSpectralIndex(const SpectralIndexReader& index, const SpectralSearchCallback& on_batch) {
+        if (!step1_completed_) {
+            throw std::runtime_error("Step 1 must be completed before archive search");
+        }
+        if (index.fftSize() != config_->getFFTSize()) {
+            return false;
+        }
+
+        step2_completed_ = false;
+        step3_completed_ = false;
+        step2_spectra_deferred_ = false;
+
+        StepScope scope(metrics_.get(), 2);
+        step2_upload_timing_ = OperationTiming{};
+        step3_ifft_timing_ = OperationTiming{};
+        if (!correlateSpectralIndex(*backend_, index, config_->getNumSignals(), config_->getNumShifts(),
+                                    config_->getNumOutputPoints(), on_batch,
+                                    &step2_upload_timing_.total_gpu_ms, &step3_ifft_timing_.total_gpu_ms)) {
+            return false;
+        }
+
+        scope.succeeded();
+        if (metrics_) {
+            metrics_->signals->inc(index.signalCount());
+            metrics_->correlations->inc(index.signalCount() * config_->getNumShifts());
+        }
+        return true;
+    }
+
+    /**
+     * @brief Кэш страниц банка опорных на устройстве (см. PagedReferenceBank.hpp)
+     * @param slots Страниц, одновременно резидентных на устройстве (по bank.deviceBytesPerSlot())
+     * @return false — бэкенд не держит страницы; executePagedStep3 всё равно
+     *         работает, загружая каждую страницу через loadReferenceSpectra
+     */
+    bool configureReferenceCache(int slots, SpectralPrecision precision = SpectralPrecision::Float32) {
+        const bool device = slots > 0 &&
+                            backend_->configureReferenceCache(slots, precision == SpectralPrecision::Float16);
+        reference_cache_.reset(device ? slots : 0);
+        reference_cache_.resetStats();
+        return device;
+    }
+
+    /**
+     * @brief Step 3 загруженного Step 2 по страницам банка опорных
+     *
+     * Для каждой страницы из pages (сначала резидентные в кэше) — Step 3 с её
+     * банком, пики передаются в on_page. Точность хранения банка должна
+     * совпадать с configureReferenceCache. После прохода банк Step 1
+     * восстанавливается из snapshot, если Step 1 был выполнен.
+     */
+    bool executePagedStep3(const PagedReferenceBank& bank, std::span<const int> pages,
+                           const PagedReferenceCallback& on_page, const PagedStep3Options& options = {}) {
+        if (!step2_completed_) {
+            throw std::runtime_error("Step 2 must be completed before paged Step 3");
+        }
+        if (bank.fftSize() != config_->getFFTSize() || bank.numShifts() != config_->getNumShifts()) {
+            return false;
+        }
+
+        step3_completed_ = false;
+
+        StepScope scope(metrics_.get(), 2);
+        step3_ifft_timing_ = OperationTiming{};
+        const bool ok = correlatePagedReferences(*backend_, bank, reference_cache_, pages, config_->getNumSignals(),
+                                                 config_->getNumOutputPoints(), on_page, options,
+                                                 &step3_ifft_timing_.total_gpu_ms);
+
+        if (step1_completed_) {
+            OperationTiming upload_timing;
+            if (!backend_->loadReferenceSpectra(snapshot_->getReferenceFFT(), config_->getNumShifts(),
+                                                upload_timing)) {
+                step1_completed_ = false;
+            }
+        }
+        if (!ok || !publishDeferredStep2()) {
+            return false;
+        }
+
+        scope.succeeded();
+        if (metrics_) {
+            metrics_->correlations->inc(pages.size() * config_->getNumSignals() * config_->getNumShifts());
+        }
+        return true;
+    }
+
+    /**
+     * @brief Попадания/промахи кэша страниц с последнего configureReferenceCache
+     */
+    const ReferencePageStats& getReferencePageStats() const { return reference_cache_.stats(); }
+
     // Getters
+    /**
+     * @brief Пики последнего Step 3 как [signals][shifts][n_kg] без копирования
+     *
+     * Представление действительно до следующего executeStep3.
+     */
+    ConstPeaksView getPeaksView() const { return peaks_.view(); }
+
+    /**
+     * @brief Сжатые пики последнего Step 3 (пусто при кодировке Float32)
+     */
+    const EncodedPeaks& getEncodedPeaks() const { return encoded_peaks_; }
+
+    /**
+     * @brief Скопировать пики последнего Step 3 в буфер вызывающего кода
+     */
+    bool copyPeaks(std::span<float> output) const {
+        std::span<const float> peaks = peaks_.span();
+        if (output.size() != peaks.size()) {
+            return false;
+        }
+        std::copy(peaks.begin(), peaks.end(), output.begin());
+        return true;
+    }
+
     const IDataSnapshot& getSnapshot() const { return *snapshot_; }
     IDataSnapshot& getSnapshot() { return *snapshot_; }
     const IConfiguration& getConfiguration() const { return *config_; }
     const IFFTBackend& getBackend() const { return *backend_; }
     IFFTBackend& getBackend() { return *backend_; }
 
+    /**
+     * @brief Подключить реестр метрик (throughput, задержки шагов, память, ошибки)
+     *
+     * Без вызова метрики не собираются. Пропускная способность (батчи/с,
+     * сигналы/с) считается на стороне Prometheus: rate(correlator_batches_total[1m]).
+     * Батч засчитывается при каждом завершённом Step 3, поэтому поток батчей
+     * должен начинать каждый батч с beginBatch() (иначе Step 3 не повторяется).
+     */
+    void setMetrics(std::shared_ptr<MetricsRegistry> registry) {
+        if (!registry) {
+            metrics_.reset();
+            return;
+        }
+
+        auto metrics = std::make_unique<PipelineMetrics>();
+        metrics->registry = registry;
+
+        const char* step_names[3] = {"Step1", "Step2", "Step3"};
+        for (int i = 0; i < 3; ++i) {
+            std::string labels = std::string("step=\"") + step_names[i] + "\"";
+            metrics->steps[i].latency = &registry->histogram(
+                "correlator_step_duration_seconds", "Длительность шага pipeline (host)",
+                Histogram::latencyBounds(), labels);
+            metrics->steps[i].errors = &registry->counter(
+                "correlator_step_errors_total", "Ошибки шага (false или исключение)", labels);
+        }
+        metrics->batches = &registry->counter(
+            "correlator_batches_total", "Полностью обработанные батчи (Step 3 завершён; батч — beginBatch)");
+        metrics->signals = &registry->counter(
+            "correlator_signals_total", "Обработанные входные сигналы");
+        metrics->correlations = &registry->counter(
+            "correlator_correlations_total", "Вычисленные корреляции (сигналы x сдвиги)");
+        metrics->steps_in_flight = &registry->gauge(
+            "correlator_steps_in_flight", "Шаги pipeline, выполняемые в данный момент (не очередь ожидающих)");
+        metrics->device_memory = &registry->gauge(
+            "correlator_device_memory_bytes", "Память устройства, занятая буферами коррелятора");
+        metrics->device_memory_high_water = &registry->gauge(
+            "correlator_device_memory_high_water_bytes", "Пик памяти устройства с момента инициализации");
+
+        metrics_ = std::move(metrics);
+        updateMemoryMetrics();
+    }
+
     // Установка exporter (для использования одного и того же timestamp каталога)
     void setExporter(std::unique_ptr<IResultExporter> exporter) {
         exporter_ = std::move(exporter);
     }
 
     // Получение данных профилирования
+    bool getInitTimings(std::vector<InitPhaseTiming>& phases) const {
+        return backend_->getInitTimings(phases);
+    }
+
+    bool getBuildTimings(std::vector<BuildPhaseTiming>& builds) const {
+        return backend_->getBuildTimings(builds);
+    }
+
+    bool getDeviceMemoryUsage(std::vector<DeviceMemoryStep>& steps,
+                              size_t& current_bytes, size_t& high_water_bytes) const {
+        return backend_->getDeviceMemoryUsage(steps, current_bytes, high_water_bytes);
+    }
+
     void getStep1Timings(OperationTiming& upload, OperationTiming& fft) const {
         upload = step1_upload_timing_;
         fft = step1_fft_timing_;
@@ -276,6 +1137,24 @@ public:
         download = step3_download_timing_;
     }
 
+    void getPairwiseTimings(OperationTiming& multiply, OperationTiming& ifft, OperationTiming& download) const {
+        multiply = pairwise_multiply_timing_;
+        ifft = pairwise_ifft_timing_;
+        download = pairwise_download_timing_;
+    }
+
+    void getRangeDopplerTimings(OperationTiming& corner_turn, OperationTiming& fft, OperationTiming& detect) const {
+        corner_turn = range_doppler_turn_timing_;
+        fft = range_doppler_fft_timing_;
+        detect = range_doppler_detect_timing_;
+    }
+
+    void getCorrelation2DTimings(OperationTiming& fft, OperationTiming& multiply, OperationTiming& ifft) const {
+        fft = corr2d_fft_timing_;
+        multiply = corr2d_multiply_timing_;
+        ifft = corr2d_ifft_timing_;
+    }
+
     // Очистка
     void cleanup() {
         if (backend_) {
@@ -24,6 +24,8 @@
 #include "DataSnapshot.hpp"
 #include "DataValidator.hpp"
 #include "ResultExporter.hpp"
+#include "MetricsRegistry.hpp"
+#include "PeaksView.hpp"
 #include "CorrelationPipeline.hpp"
 
 /**
@@ -55,8 +57,9 @@ namespace Correlator {
  * 
  * if (pipeline.executeFullPipeline(reference_signal, input_signals)) {
  *     // Получить результаты
- *     const auto& snapshot = pipeline.getSnapshot();
- *     const auto& peaks = snapshot.getPeaks();
+ *     // Пики [signals][shifts][n_kg] без копирования
+ *     auto peaks = pipeline.getPeaksView();
+ *     float p = peakAt(peaks, signal, shift, 0);
  *     // ...
  * }
  * @endcode
@@ -0,0 +1,165 @@
+#ifndef CORRELATOR_CPU_FFT_HPP
+#define CORRELATOR_CPU_FFT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// CpuFFTPlan - одномерный комплексный FFT на CPU (без внешних библиотек)
+// ============================================================================
+
+/**
+ * Степень двойки: итеративный radix-2 (DIT) с таблицами перестановки
+ * и поворотных множителей. Остальные N — Bluestein через степень двойки
+ * M ≥ 2N - 1 (спектр chirp-ядра считается один раз при создании плана).
+ *
+ * Знаки и масштаб как у clFFT: forward — e^{-j2πkn/N} без масштаба,
+ * inverse — e^{+j2πkn/N} без масштаба (1/N применяет вызывающий код).
+ * План неизменяем после создания — один план на все потоки; scratch
+ * (для Bluestein) передаёт вызывающий код.
+ */
+class CpuFFTPlan {
+public:
+    using Complex = std::complex<float>;
+
+    CpuFFTPlan() = default;
+
+    explicit CpuFFTPlan(size_t n) : n_(n) {
+        if (n_ == 0) {
+            return;
+        }
+        const double two_pi = 2.0 * std::acos(-1.0);
+        roots_.resize(n_);
+        for (size_t i = 0; i < n_; ++i) {
+            roots_[i] = Complex(static_cast<float>(std::cos(two_pi * i / n_)),
+                                static_cast<float>(-std::sin(two_pi * i / n_)));
+        }
+
+        if (isPowerOfTwo(n_)) {
+            initRadix2(n_, bitrev_, twiddles_);
+            return;
+        }
+
+        // Bluestein: X[k] = c[k] · Σ_n (x[n]·c[n]) · conj(c[k - n]), c[n] = e^{-jπn²/N}
+        m_ = 1;
+        while (m_ < 2 * n_ - 1) {
+            m_ <<= 1;
+        }
+        initRadix2(m_, bitrev_, twiddles_);
+        chirp_.resize(n_);
+        for (size_t i = 0; i < n_; ++i) {
+            // n² mod 2N без переполнения и потери точности угла
+            const uint64_t sq = (static_cast<uint64_t>(i) * i) % (2 * n_);
+            const double angle = std::acos(-1.0) * static_cast<double>(sq) / static_cast<double>(n_);
+            chirp_[i] = Complex(static_cast<float>(std::cos(angle)), static_cast<float>(-std::sin(angle)));
+        }
+        kernel_fft_.assign(m_, Complex(0.0f, 0.0f));
+        kernel_fft_[0] = std::conj(chirp_[0]);
+        for (size_t i = 1; i < n_; ++i) {
+            kernel_fft_[i] = kernel_fft_[m_ - i] = std::conj(chirp_[i]);
+        }
+        radix2(kernel_fft_.data(), m_);
+    }
+
+    size_t size() const { return n_; }
+
+    /**
+     * Комплексных значений scratch для forward/inverse (0 для степени двойки)
+     */
+    size_t scratchSize() const { return m_; }
+
+    static bool isPowerOfTwo(size_t n) { return n != 0 && (n & (n - 1)) == 0; }
+
+    /**
+     * e^{-j2πm/N}, m < N — для частичных преобразований (несколько отсчётов IFFT)
+     */
+    Complex root(size_t m) const { return roots_[m]; }
+
+    void forward(Complex* data, Complex* scratch = nullptr) const {
+        if (m_ == 0) {
+            radix2(data, n_);
+        } else {
+            bluestein(data, scratch);
+        }
+    }
+
+    void inverse(Complex* data, Complex* scratch = nullptr) const {
+        for (size_t i = 0; i < n_; ++i) data[i] = std::conj(data[i]);
+        forward(data, scratch);
+        for (size_t i = 0; i < n_; ++i) data[i] = std::conj(data[i]);
+    }
+
+private:
+    size_t n_ = 0;
+    size_t m_ = 0;                     // Размер степени двойки для Bluestein (0 — не нужен)
+    std::vector<uint32_t> bitrev_;
+    std::vector<Complex> twiddles_;    // [half + k] = e^{-jπk/half} для этапов radix-2
+    std::vector<Complex> roots_;       // e^{-j2πm/N}, m < N
+    std::vector<Complex> chirp_;
+    std::vector<Complex> kernel_fft_;
+
+    static void initRadix2(size_t length, std::vector<uint32_t>& bitrev, std::vector<Complex>& twiddles) {
+        unsigned log2 = 0;
+        while ((size_t(1) << log2) < length) ++log2;
+        bitrev.resize(length);
+        for (size_t i = 0; i < length; ++i) {
+            uint32_t r = 0;
+            for (unsigned b = 0; b < log2; ++b) {
+                r |= ((i >> b) & 1u) << (log2 - 1 - b);
+            }
+            bitrev[i] = r;
+        }
+        // Поворотные множители этапа half подряд с индекса half: e^{-jπk/half}, k < half
+        const double pi = std::acos(-1.0);
+        twiddles.resize(std::max<size_t>(length, 1));
+        for (size_t half = 1; half < length; half <<= 1) {
+            for (size_t k = 0; k < half; ++k) {
+                twiddles[half + k] = Complex(static_cast<float>(std::cos(pi * k / half)),
+                                             static_cast<float>(-std::sin(pi * k / half)));
+            }
+        }
+    }
+
+    void radix2(Complex* data, size_t length) const {
+        for (size_t i = 0; i < length; ++i) {
+            const size_t j = bitrev_[i];
+            if (i < j) std::swap(data[i], data[j]);
+        }
+        for (size_t half = 1; half < length; half <<= 1) {
+            const Complex* stage = twiddles_.data() + half;
+            for (size_t start = 0; start < length; start += 2 * half) {
+                Complex* a = data + start;
+                Complex* b = a + half;
+                for (size_t k = 0; k < half; ++k) {
+                    // Раздельные Re/Im: std::complex operator* проверяет NaN и не векторизуется
+                    const Complex w = stage[k];
+                    const float tr = b[k].real() * w.real() - b[k].imag() * w.imag();
+                    const float ti = b[k].real() * w.imag() + b[k].imag() * w.real();
+                    const Complex t(tr, ti);
+                    b[k] = a[k] - t;
+                    a[k] += t;
+                }
+            }
+        }
+    }
+
+    void bluestein(Complex* data, Complex* scratch) const {
+        for (size_t i = 0; i < n_; ++i) scratch[i] = data[i] * chirp_[i];
+        for (size_t i = n_; i < m_; ++i) scratch[i] = Complex(0.0f, 0.0f);
+        radix2(scratch, m_);
+        for (size_t i = 0; i < m_; ++i) scratch[i] = std::conj(scratch[i] * kernel_fft_[i]);
+        radix2(scratch, m_);   // Обратный через сопряжение
+        const float inv_m = 1.0f / static_cast<float>(m_);
+        for (size_t i = 0; i < n_; ++i) data[i] = std::conj(scratch[i]) * inv_m * chirp_[i];
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_CPU_FFT_HPP
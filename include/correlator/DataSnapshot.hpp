@@ -95,9 +95,9 @@ public:
         timestamp_ = getCurrentTimestamp();
     }
 
-    void savePeaks(const std::vector<float>& peaks,
+    void savePeaks(std::span<const float> peaks,
                   int num_signals, int num_shifts, int num_points) override {
-        peaks_ = peaks;
+        peaks_.assign(peaks.begin(), peaks.end());  // Ёмкость переиспользуется между батчами
         num_signals_ = num_signals;
         num_shifts_ = num_shifts;
         num_output_points_ = num_points;
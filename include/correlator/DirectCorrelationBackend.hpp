@@ -0,0 +1,769 @@
+#ifndef CORRELATOR_DIRECT_CORRELATION_BACKEND_HPP
+#define CORRELATOR_DIRECT_CORRELATION_BACKEND_HPP
+
+#include "IConfiguration.hpp"
+#include "IFFTBackend.hpp"
+#include "ParallelChunks.hpp"
+#include <CL/opencl.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// Прямая корреляция как матричное произведение (малые N)
+// ============================================================================
+
+/**
+ * Цепочка Step 1–3 (FFT опорного с сопряжением, FFT входа, ref·conj(inp),
+ * IFFT с масштабом 1/N, модуль) для вещественных сигналов сводится к
+ *
+ *   peaks[s][sh][k] = | Σ_j x_s[j] · r[(sh - k - j) mod N] |,
+ *
+ * где x_s = scale·input_s, r = scale·reference. Строка (sh, k) матрицы сдвигов
+ * M[(sh, k)][j] = r[(sh - k - j) mod N] не зависит от входа и строится один
+ * раз в Step 1, и тогда пики батча — это |X · Mᵀ|: SGEMM
+ * [signals × N] · [N × shifts·n_kg] в вещественной арифметике.
+ *
+ * При N ≤ 256 это дешевле трёх запусков clFFT с callback'ами, которые
+ * упираются в накладные расходы запуска, а не в арифметику.
+ */
+constexpr size_t kDirectMaxFFTSize = 256;
+
+/**
+ * Где выполнять произведение
+ */
+enum class DirectCorrelationDevice : uint8_t {
+    CPU,       // Упакованный SGEMM с микроядром 4×8 в регистрах
+    OpenCL     // Тайловый kernel 16×16 в локальной памяти
+};
+
+inline const char* directCorrelationDeviceName(DirectCorrelationDevice device) {
+    return device == DirectCorrelationDevice::OpenCL ? "opencl" : "cpu";
+}
+
+// ============================================================================
+// CPU SGEMM: C[m][n] = |Σ_k A[m][k] · B[n][k]|
+// ============================================================================
+
+constexpr int kDirectMR = 4;   // Строк A (сигналов) в микроядре
+constexpr int kDirectNR = 8;   // Строк B (сдвиг×отсчёт) в микроядре — одна AVX строка
+
+/**
+ * Упаковать строки row-major матрицы [rows × K] в панели по P строк:
+ * panel[p][k][0..P) — соседние строки одного k подряд, недостающие строки
+ * последней панели заполняются нулями. Микроядро читает панели линейно.
+ */
+template <int P>
+inline void packDirectPanels(const float* source, size_t rows, size_t K, std::vector<float>& packed) {
+    const size_t panels = (rows + P - 1) / P;
+    packed.assign(panels * K * P, 0.0f);
+    for (size_t panel = 0; panel < panels; ++panel) {
+        float* out = packed.data() + panel * K * P;
+        for (int i = 0; i < P; ++i) {
+            const size_t row = panel * P + i;
+            if (row >= rows) {
+                break;
+            }
+            const float* in = source + row * K;
+            for (size_t k = 0; k < K; ++k) {
+                out[k * P + i] = in[k];
+            }
+        }
+    }
+}
+
+/**
+ * Строка микроядра: NR float в одном векторном регистре (GCC/Clang vector
+ * extension; без AVX компилятор разложит её на две SSE операции).
+ * Автовекторизатор на скалярном варианте векторизует внешний цикл по k
+ * с gather/scatter — на порядок медленнее
+ */
+typedef float DirectRow __attribute__((vector_size(kDirectNR * sizeof(float))));
+
+/**
+ * Микроядро MR×NR: MR строк-аккумуляторов в регистрах, на каждый k —
+ * одна загрузка строки панели B и MR умножений-сложений на скаляр из A
+ */
+inline void directMicroKernel(const float* a_panel, const float* b_panel, size_t K,
+                              float out[kDirectMR][kDirectNR]) {
+    DirectRow acc[kDirectMR] = {};
+    for (size_t k = 0; k < K; ++k) {
+        const float* a = a_panel + k * kDirectMR;
+        DirectRow b;
+        std::memcpy(&b, b_panel + k * kDirectNR, sizeof(b));
+        for (int i = 0; i < kDirectMR; ++i) {
+            acc[i] += a[i] * b;
+        }
+    }
+    std::memcpy(out, acc, sizeof(acc));
+}
+
+/**
+ * @brief C = |A · Bᵀ| по упакованным панелям
+ *
+ * Поток берёт панель B (K × NR, при K ≤ 256 — 8 КБ, живёт в L1) и проходит
+ * по ней все панели A; края панелей дописываются в C только в пределах m × n.
+ *
+ * @param packed_a packDirectPanels<kDirectMR> от A [m × K]
+ * @param packed_b packDirectPanels<kDirectNR> от B [n × K]
+ * @param c        [m × n] row-major
+ */
+inline void directSgemmAbs(const float* packed_a, const float* packed_b, size_t m, size_t n, size_t K,
+                           float* c, unsigned threads) {
+    const size_t a_panels = (m + kDirectMR - 1) / kDirectMR;
+    const size_t b_panels = (n + kDirectNR - 1) / kDirectNR;
+    parallelChunks(b_panels, threads, [&](size_t bp) {
+        const float* b_panel = packed_b + bp * K * kDirectNR;
+        const size_t col0 = bp * kDirectNR;
+        const size_t cols = std::min<size_t>(kDirectNR, n - col0);
+        float acc[kDirectMR][kDirectNR];
+        for (size_t ap = 0; ap < a_panels; ++ap) {
+            directMicroKernel(packed_a + ap * K * kDirectMR, b_panel, K, acc);
+            const size_t row0 = ap * kDirectMR;
+            const size_t rows = std::min<size_t>(kDirectMR, m - row0);
+            for (size_t i = 0; i < rows; ++i) {
+                float* out = c + (row0 + i) * n + col0;
+                for (size_t j = 0; j < cols; ++j) {
+                    out[j] = std::fabs(acc[i][j]);
+                }
+            }
+        }
+    });
+}
+
+/**
+ * @brief Матрица сдвигов [shifts·n_kg × N]: M[(sh, k)][j] = scale·ref[(sh - k - j) mod N]
+ */
+inline void buildDirectShiftMatrix(const int32_t* reference, size_t N, int num_shifts, int n_kg,
+                                   float scale, std::vector<float>& matrix) {
+    matrix.resize(static_cast<size_t>(num_shifts) * n_kg * N);
+    for (int shift = 0; shift < num_shifts; ++shift) {
+        for (int k = 0; k < n_kg; ++k) {
+            float* row = matrix.data() + (static_cast<size_t>(shift) * n_kg + k) * N;
+            // Индекс убывает по j: старт (sh - k) mod N, дальше с переносом через 0
+            size_t index = ((static_cast<size_t>(shift) % N) + N - static_cast<size_t>(k) % N) % N;
+            for (size_t j = 0; j < N; ++j) {
+                row[j] = static_cast<float>(reference[index]) * scale;
+                index = index == 0 ? N - 1 : index - 1;
+            }
+        }
+    }
+}
+
+// ============================================================================
+// OpenCL: тайловый kernel
+// ============================================================================
+
+inline const char* directCorrelationKernelSource() {
+    return R"(
+#define TILE 16
+
+// peaks[s][r] = |Σ_k scale·inputs[s][k] · matrix[r][k]|, r = shift·n_kg + k
+__kernel void direct_correlation(
+    __global const int* inputs,     // [num_signals][fft_size]
+    __global const float* matrix,   // [rows][fft_size]
+    __global float* peaks,          // [num_signals][rows]
+    const uint fft_size,
+    const uint num_signals,
+    const uint rows,
+    const float scale)
+{
+    __local float tile_x[TILE][TILE + 1];   // +1: без конфликтов банков при чтении по столбцу
+    __local float tile_m[TILE][TILE + 1];
+
+    const uint lr = get_local_id(0);
+    const uint ls = get_local_id(1);
+    const uint r = get_group_id(0) * TILE + lr;
+    const uint s = get_group_id(1) * TILE + ls;
+    const uint m_row = get_group_id(0) * TILE + ls;
+
+    float acc = 0.0f;
+    for (uint k0 = 0; k0 < fft_size; k0 += TILE) {
+        // Соседние lr читают соседние k — загрузка coalesced для обеих матриц
+        const uint k = k0 + lr;
+        tile_x[ls][lr] = (s < num_signals && k < fft_size) ? (float)inputs[s * fft_size + k] * scale : 0.0f;
+        tile_m[ls][lr] = (m_row < rows && k < fft_size) ? matrix[m_row * fft_size + k] : 0.0f;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (uint t = 0; t < TILE; ++t) {
+            acc += tile_x[ls][t] * tile_m[lr][t];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (s < num_signals && r < rows) {
+        peaks[s * rows + r] = fabs(acc);
+    }
+}
+)";
+}
+
+// ============================================================================
+// DirectCorrelationBackend
+// ============================================================================
+
+/**
+ * @class DirectCorrelationBackend
+ * @brief IFFTBackend без FFT: Step 1 строит матрицу сдвигов, Step 3 — один SGEMM
+ *
+ * Пики совпадают с OpenCLFFTBackend с точностью float. Спектры Step 1/2
+ * (getReferenceFFT/getInputFFT) нужны только экспорту и checkpoint, поэтому
+ * считаются лениво прямым DFT по запросу. Загрузка готовых спектров
+ * (loadReferenceSpectra, loadInputSpectra, формирование лучей) не
+ * поддерживается: матрице сдвигов нужен сам опорный сигнал во времени.
+ *
+ * Выбор между бэкендами — measureDirectCrossover().
+ */
+class DirectCorrelationBackend final : public IFFTBackend {
+public:
+    explicit DirectCorrelationBackend(DirectCorrelationDevice device = DirectCorrelationDevice::CPU)
+        : device_type_(device) {}
+
+    ~DirectCorrelationBackend() override {
+        cleanup();
+    }
+
+    DirectCorrelationBackend(const DirectCorrelationBackend&) = delete;
+    DirectCorrelationBackend& operator=(const DirectCorrelationBackend&) = delete;
+
+    void setConfiguration(size_t fft_size, int num_shifts, int num_signals, int n_kg, float scale_factor) {
+        if (initialized_) {
+            throw std::runtime_error("Cannot change configuration after initialization");
+        }
+        fft_size_ = fft_size;
+        num_shifts_ = num_shifts;
+        num_signals_ = num_signals;
+        n_kg_ = n_kg;
+        scale_factor_ = scale_factor;
+    }
+
+    /**
+     * @brief Число потоков CPU SGEMM (0 — по объёму работы, не больше числа ядер)
+     */
+    void setThreads(unsigned threads) { threads_ = threads; }
+
+    /**
+     * @brief Номер GPU для DirectCorrelationDevice::OpenCL (по модулю числа устройств)
+     */
+    void setDeviceIndex(int device_index) {
+        if (initialized_) {
+            throw std::runtime_error("Cannot change device after initialization");
+        }
+        device_index_ = device_index;
+    }
+
+    DirectCorrelationDevice device() const { return device_type_; }
+
+    bool initialize() override {
+        if (initialized_) {
+            return true;
+        }
+        if (fft_size_ == 0 || num_shifts_ <= 0 || num_signals_ <= 0 || n_kg_ <= 0 ||
+            static_cast<size_t>(n_kg_) > fft_size_) {
+            return false;
+        }
+
+        init_timings_.clear();
+        auto start = Clock::now();
+        rows_ = static_cast<size_t>(num_shifts_) * n_kg_;
+        peaks_.assign(static_cast<size_t>(num_signals_) * rows_, 0.0f);
+        if (device_type_ == DirectCorrelationDevice::OpenCL && !initialize_opencl()) {
+            cleanup();
+            return false;
+        }
+        init_timings_.push_back({std::string("Direct correlation (") + directCorrelationDeviceName(device_type_) + ")",
+                                 elapsed_ms(start)});
+        initialized_ = true;
+        return true;
+    }
+
+    void cleanup() override {
+        if (kernel_) { clReleaseKernel(kernel_); kernel_ = nullptr; }
+        if (program_) { clReleaseProgram(program_); program_ = nullptr; }
+        for (cl_mem* buffer : {&matrix_buffer_, &input_buffer_, &peaks_buffer_}) {
+            if (*buffer) {
+                clReleaseMemObject(*buffer);
+                *buffer = nullptr;
+            }
+        }
+        if (queue_) { clReleaseCommandQueue(queue_); queue_ = nullptr; }
+        if (context_) { clReleaseContext(context_); context_ = nullptr; }
+        device_ = nullptr;
+        initialized_ = false;
+        reference_ready_ = false;
+    }
+
+    bool isInitialized() const override { return initialized_; }
+
+    bool getInitTimings(std::vector<InitPhaseTiming>& output) const override {
+        output = init_timings_;
+        return !output.empty();
+    }
+
+    // Планов нет: форма задана setConfiguration()
+    bool createReferenceFFTPlan(size_t, int, float) override { return initialized_; }
+    bool createInputFFTPlan(size_t, int, float) override { return initialized_; }
+    bool createCorrelationIFFTPlan(size_t, int, int, int, int) override { return initialized_; }
+
+    bool step1_ProcessReferenceSignals(const std::vector<int32_t>& reference_signal, int num_shifts,
+                                       OperationTiming& upload_timing, OperationTiming& fft_timing) override {
+        if (!initialized_ || num_shifts != num_shifts_ || reference_signal.size() < fft_size_) {
+            return false;
+        }
+        auto start = Clock::now();
+        reference_.assign(reference_signal.begin(), reference_signal.begin() + fft_size_);
+        buildDirectShiftMatrix(reference_.data(), fft_size_, num_shifts_, n_kg_, scale_factor_, matrix_);
+        if (device_type_ == DirectCorrelationDevice::CPU) {
+            packDirectPanels<kDirectNR>(matrix_.data(), rows_, fft_size_, packed_matrix_);
+        }
+        set_host_timing(fft_timing, elapsed_ms(start));
+
+        upload_timing = OperationTiming{};
+        if (device_type_ == DirectCorrelationDevice::OpenCL) {
+            cl_event event = nullptr;
+            if (clEnqueueWriteBuffer(queue_, matrix_buffer_, CL_TRUE, 0, matrix_.size() * sizeof(float),
+                                     matrix_.data(), 0, nullptr, &event) != CL_SUCCESS) {
+                return false;
+            }
+            set_event_timing(upload_timing, event);
+        }
+        reference_fft_valid_ = false;
+        reference_ready_ = true;
+        return true;
+    }
+
+    bool step2_ProcessInputSignals(const std::vector<int32_t>& input_signals, int num_signals,
+                                   OperationTiming& upload_timing, OperationTiming& fft_timing) override {
+        if (!initialized_ || num_signals <= 0 || num_signals > num_signals_ ||
+            input_signals.size() < static_cast<size_t>(num_signals) * fft_size_) {
+            return false;
+        }
+        // Строки сверх num_signals — нули (как недозаполненный батч FFT)
+        const size_t count = static_cast<size_t>(num_signals) * fft_size_;
+        upload_timing = OperationTiming{};
+        fft_timing = OperationTiming{};
+        auto start = Clock::now();
+        if (device_type_ == DirectCorrelationDevice::CPU) {
+            inputs_.assign(static_cast<size_t>(num_signals_) * fft_size_, 0.0f);
+            for (size_t i = 0; i < count; ++i) {
+                inputs_[i] = static_cast<float>(input_signals[i]) * scale_factor_;
+            }
+            packDirectPanels<kDirectMR>(inputs_.data(), num_signals_, fft_size_, packed_inputs_);
+            set_host_timing(fft_timing, elapsed_ms(start));
+        } else {
+            raw_inputs_.assign(static_cast<size_t>(num_signals_) * fft_size_, 0);
+            std::copy_n(input_signals.begin(), count, raw_inputs_.begin());
+            cl_event event = nullptr;
+            if (clEnqueueWriteBuffer(queue_, input_buffer_, CL_TRUE, 0, raw_inputs_.size() * sizeof(int32_t),
+                                     raw_inputs_.data(), 0, nullptr, &event) != CL_SUCCESS) {
+                return false;
+            }
+            set_event_timing(upload_timing, event);
+        }
+        input_fft_valid_ = false;
+        return true;
+    }
+
+    bool step3_ComputeCorrelation(int num_signals, int num_shifts, int n_kg, OperationTiming& copy_timing,
+                                  OperationTiming& ifft_timing, OperationTiming& download_timing) override {
+        if (!initialized_ || !reference_ready_ || num_signals != num_signals_ ||
+            num_shifts != num_shifts_ || n_kg != n_kg_) {
+            return false;
+        }
+        copy_timing = OperationTiming{};
+        download_timing = OperationTiming{};
+        if (device_type_ == DirectCorrelationDevice::CPU) {
+            if (packed_inputs_.empty()) {
+                return false;
+            }
+            auto start = Clock::now();
+            directSgemmAbs(packed_inputs_.data(), packed_matrix_.data(), num_signals_, rows_, fft_size_,
+                           peaks_.data(), sgemm_threads());
+            set_host_timing(ifft_timing, elapsed_ms(start));
+            return true;
+        }
+        return run_opencl_gemm(ifft_timing, download_timing);
+    }
+
+    bool getReferenceFFT(std::vector<ComplexFloat>& output) const override {
+        if (!reference_ready_) {
+            return false;
+        }
+        if (!reference_fft_valid_) {
+            // Как после Step 1: conj(FFT(scale·ref[(n + shift) mod N]))
+            std::vector<float> shifted(fft_size_);
+            reference_fft_.resize(static_cast<size_t>(num_shifts_) * fft_size_);
+            for (int shift = 0; shift < num_shifts_; ++shift) {
+                for (size_t n = 0; n < fft_size_; ++n) {
+                    shifted[n] = static_cast<float>(reference_[(n + shift) % fft_size_]) * scale_factor_;
+                }
+                ComplexFloat* row = reference_fft_.data() + shift * fft_size_;
+                dft(shifted.data(), row);
+                for (size_t k = 0; k < fft_size_; ++k) {
+                    row[k].imag = -row[k].imag;
+                }
+            }
+            reference_fft_valid_ = true;
+        }
+        output = reference_fft_;
+        return true;
+    }
+
+    bool getInputFFT(std::vector<ComplexFloat>& output) const override {
+        if (!input_fft_valid_) {
+            std::vector<float> row(fft_size_);
+            input_fft_.resize(static_cast<size_t>(num_signals_) * fft_size_);
+            for (int signal = 0; signal < num_signals_; ++signal) {
+                for (size_t n = 0; n < fft_size_; ++n) {
+                    const size_t index = signal * fft_size_ + n;
+                    row[n] = device_type_ == DirectCorrelationDevice::CPU
+                                 ? (index < inputs_.size() ? inputs_[index] : 0.0f)
+                                 : (index < raw_inputs_.size() ? static_cast<float>(raw_inputs_[index]) * scale_factor_ : 0.0f);
+                }
+                dft(row.data(), input_fft_.data() + signal * fft_size_);
+            }
+            input_fft_valid_ = true;
+        }
+        output = input_fft_;
+        return true;
+    }
+
+    bool getCorrelationPeaks(std::vector<float>& output) const override {
+        output = peaks_;
+        return initialized_;
+    }
+
+    bool readCorrelationPeaks(std::span<float> output) const override {
+        if (!initialized_ || output.size() != peaks_.size()) {
+            return false;
+        }
+        std::copy(peaks_.begin(), peaks_.end(), output.begin());
+        return true;
+    }
+
+    std::string getPlatformName() const override {
+        return device_type_ == DirectCorrelationDevice::OpenCL ? "OpenCL (direct GEMM)" : "CPU (direct GEMM)";
+    }
+
+    std::string getDeviceName() const override {
+        if (device_type_ == DirectCorrelationDevice::CPU) {
+            return "CPU x" + std::to_string(std::max(1u, std::thread::hardware_concurrency()));
+        }
+        return device_info(CL_DEVICE_NAME);
+    }
+
+    std::string getDriverVersion() const override {
+        return device_type_ == DirectCorrelationDevice::CPU ? "n/a" : device_info(CL_DRIVER_VERSION);
+    }
+
+    std::string getAPIVersion() const override {
+        return device_type_ == DirectCorrelationDevice::CPU ? "n/a" : device_info(CL_DEVICE_VERSION);
+    }
+
+    cl_device_id getDeviceId() const override { return device_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Умножений-сложений на поток, ниже которых запуск потоков дороже самой работы
+    static constexpr size_t kDirectFlopsPerThread = size_t(1) << 20;
+
+    DirectCorrelationDevice device_type_;
+    bool initialized_ = false;
+    bool reference_ready_ = false;
+    unsigned threads_ = 0;
+    int device_index_ = 0;
+
+    size_t fft_size_ = 0;
+    int num_shifts_ = 0;
+    int num_signals_ = 0;
+    int n_kg_ = 0;
+    float scale_factor_ = 1.0f;
+    size_t rows_ = 0;               // shifts × n_kg
+
+    std::vector<int32_t> reference_;
+    std::vector<float> matrix_;          // [rows][N]
+    std::vector<float> packed_matrix_;   // панели NR (CPU)
+    std::vector<float> inputs_;          // [signals][N], с масштабом (CPU)
+    std::vector<float> packed_inputs_;   // панели MR (CPU)
+    std::vector<int32_t> raw_inputs_;    // [signals][N] (OpenCL)
+    std::vector<float> peaks_;           // [signals][shifts][n_kg]
+
+    mutable std::vector<ComplexFloat> reference_fft_;
+    mutable std::vector<ComplexFloat> input_fft_;
+    mutable bool reference_fft_valid_ = false;
+    mutable bool input_fft_valid_ = false;
+
+    std::vector<InitPhaseTiming> init_timings_;
+
+    // OpenCL
+    cl_context context_ = nullptr;
+    cl_command_queue queue_ = nullptr;
+    cl_device_id device_ = nullptr;
+    cl_program program_ = nullptr;
+    cl_kernel kernel_ = nullptr;
+    cl_mem matrix_buffer_ = nullptr;
+    cl_mem input_buffer_ = nullptr;
+    cl_mem peaks_buffer_ = nullptr;
+
+    static double elapsed_ms(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    static void set_host_timing(OperationTiming& timing, double ms) {
+        timing = OperationTiming{};
+        timing.execute_ms = ms;
+        timing.total_gpu_ms = ms;
+    }
+
+    static void set_event_timing(OperationTiming& timing, cl_event event) {
+        timing = OperationTiming{};
+        if (!event) {
+            return;
+        }
+        cl_ulong queued = 0, start = 0, end = 0;
+        if (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_QUEUED, sizeof(queued), &queued, nullptr) == CL_SUCCESS &&
+            clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, nullptr) == CL_SUCCESS &&
+            clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, nullptr) == CL_SUCCESS) {
+            timing.execute_ms = (end - start) * 1e-6;
+            timing.queue_wait_ms = (start - queued) * 1e-6;
+            timing.total_gpu_ms = (end - queued) * 1e-6;
+        }
+        clReleaseEvent(event);
+    }
+
+    unsigned sgemm_threads() const {
+        if (threads_ != 0) {
+            return threads_;
+        }
+        const size_t work = static_cast<size_t>(num_signals_) * rows_ * fft_size_;
+        const size_t wanted = std::max<size_t>(1, work / kDirectFlopsPerThread);
+        return static_cast<unsigned>(std::min<size_t>(wanted, std::max(1u, std::thread::hardware_concurrency())));
+    }
+
+    /**
+     * Прямой DFT (только для экспорта спектров): X[f] = Σ x[n]·e^{-j2πfn/N}
+     */
+    void dft(const float* x, ComplexFloat* out) const {
+        const size_t n = fft_size_;
+        const double two_pi = 2.0 * std::acos(-1.0);
+        std::vector<double> cos_table(n), sin_table(n);
+        for (size_t i = 0; i < n; ++i) {
+            cos_table[i] = std::cos(two_pi * i / n);
+            sin_table[i] = std::sin(two_pi * i / n);
+        }
+        for (size_t f = 0; f < n; ++f) {
+            double re = 0.0, im = 0.0;
+            size_t phase = 0;
+            for (size_t t = 0; t < n; ++t) {
+                re += x[t] * cos_table[phase];
+                im -= x[t] * sin_table[phase];
+                phase += f;
+                if (phase >= n) phase -= n;
+            }
+            out[f] = ComplexFloat(static_cast<float>(re), static_cast<float>(im));
+        }
+    }
+
+    std::string device_info(cl_device_info param) const {
+        if (!device_) {
+            return "Unknown";
+        }
+        char value[256] = {0};
+        if (clGetDeviceInfo(device_, param, sizeof(value), value, nullptr) != CL_SUCCESS) {
+            return "Unknown";
+        }
+        return std::string(value);
+    }
+
+    bool initialize_opencl() {
+        cl_int err = CL_SUCCESS;
+        cl_platform_id platform = nullptr;
+        if (clGetPlatformIDs(1, &platform, nullptr) != CL_SUCCESS) {
+            return false;
+        }
+        cl_uint num_devices = 0;
+        if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 0, nullptr, &num_devices) != CL_SUCCESS || num_devices == 0) {
+            return false;
+        }
+        std::vector<cl_device_id> devices(num_devices);
+        if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, num_devices, devices.data(), nullptr) != CL_SUCCESS) {
+            return false;
+        }
+        device_ = devices[static_cast<cl_uint>(device_index_ < 0 ? 0 : device_index_) % num_devices];
+
+        context_ = clCreateContext(nullptr, 1, &device_, nullptr, nullptr, &err);
+        if (err != CL_SUCCESS || !context_) {
+            return false;
+        }
+        queue_ = clCreateCommandQueue(context_, device_, CL_QUEUE_PROFILING_ENABLE, &err);
+        if (err != CL_SUCCESS || !queue_) {
+            return false;
+        }
+
+        const char* source = directCorrelationKernelSource();
+        program_ = clCreateProgramWithSource(context_, 1, &source, nullptr, &err);
+        if (err != CL_SUCCESS || !program_) {
+            return false;
+        }
+        if (clBuildProgram(program_, 1, &device_, nullptr, nullptr, nullptr) != CL_SUCCESS) {
+            size_t log_size = 0;
+            clGetProgramBuildInfo(program_, device_, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+            std::string log(log_size, '\0');
+            clGetProgramBuildInfo(program_, device_, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
+            fprintf(stderr, "[DIRECT] Kernel build failed:\n%s\n", log.c_str());
+            return false;
+        }
+        kernel_ = clCreateKernel(program_, "direct_correlation", &err);
+        if (err != CL_SUCCESS || !kernel_) {
+            return false;
+        }
+
+        matrix_buffer_ = clCreateBuffer(context_, CL_MEM_READ_ONLY, rows_ * fft_size_ * sizeof(float), nullptr, &err);
+        if (err != CL_SUCCESS) return false;
+        input_buffer_ = clCreateBuffer(context_, CL_MEM_READ_ONLY, num_signals_ * fft_size_ * sizeof(int32_t), nullptr, &err);
+        if (err != CL_SUCCESS) return false;
+        peaks_buffer_ = clCreateBuffer(context_, CL_MEM_WRITE_ONLY, peaks_.size() * sizeof(float), nullptr, &err);
+        return err == CL_SUCCESS;
+    }
+
+    bool run_opencl_gemm(OperationTiming& kernel_timing, OperationTiming& download_timing) {
+        constexpr size_t kTile = 16;
+        const cl_uint fft_size = static_cast<cl_uint>(fft_size_);
+        const cl_uint num_signals = static_cast<cl_uint>(num_signals_);
+        const cl_uint rows = static_cast<cl_uint>(rows_);
+        cl_int err = clSetKernelArg(kernel_, 0, sizeof(cl_mem), &input_buffer_);
+        err |= clSetKernelArg(kernel_, 1, sizeof(cl_mem), &matrix_buffer_);
+        err |= clSetKernelArg(kernel_, 2, sizeof(cl_mem), &peaks_buffer_);
+        err |= clSetKernelArg(kernel_, 3, sizeof(cl_uint), &fft_size);
+        err |= clSetKernelArg(kernel_, 4, sizeof(cl_uint), &num_signals);
+        err |= clSetKernelArg(kernel_, 5, sizeof(cl_uint), &rows);
+        err |= clSetKernelArg(kernel_, 6, sizeof(float), &scale_factor_);
+        if (err != CL_SUCCESS) {
+            return false;
+        }
+
+        const size_t global[2] = {(rows_ + kTile - 1) / kTile * kTile,
+                                  (static_cast<size_t>(num_signals_) + kTile - 1) / kTile * kTile};
+        const size_t local[2] = {kTile, kTile};
+        cl_event kernel_event = nullptr, read_event = nullptr;
+        if (clEnqueueNDRangeKernel(queue_, kernel_, 2, nullptr, global, local, 0, nullptr, &kernel_event) != CL_SUCCESS) {
+            return false;
+        }
+        err = clEnqueueReadBuffer(queue_, peaks_buffer_, CL_TRUE, 0, peaks_.size() * sizeof(float), peaks_.data(),
+                                  1, &kernel_event, &read_event);
+        set_event_timing(kernel_timing, kernel_event);
+        if (err != CL_SUCCESS) {
+            return false;
+        }
+        set_event_timing(download_timing, read_event);
+        return true;
+    }
+};
+
+// ============================================================================
+// Автовыбор: точка пересечения с FFT бэкендом
+// ============================================================================
+
+/**
+ * Фабрика FFT бэкенда для замера: форма как у конфигурации, кроме размера FFT
+ */
+using DirectCrossoverFactory = std::function<std::unique_ptr<IFFTBackend>(size_t fft_size, int n_kg)>;
+
+struct DirectCrossoverPoint {
+    size_t fft_size = 0;
+    double fft_ms = 0.0;      // Медиана Step 2 + Step 3 + чтение пиков
+    double direct_ms = 0.0;
+};
+
+/**
+ * @brief Замерить наибольший N, до которого прямой GEMM быстрее FFT бэкенда
+ *
+ * Проходит N = 16, 32, ..., kDirectMaxFFTSize с формой (shifts, signals, n_kg)
+ * конфигурации. Оба бэкенда инициализируются и выполняют Step 1 вне замера;
+ * меряется медиана Step 2 + Step 3 + readCorrelationPeaks после прогрева.
+ * Скан останавливается на первом N, где FFT не медленнее (дальше разрыв
+ * только растёт: GEMM O(N²), FFT O(N log N)).
+ *
+ * @return Точка пересечения (0 — прямой путь не выигрывает ни при каком N)
+ */
+inline size_t measureDirectCrossover(const IConfiguration& config, const DirectCrossoverFactory& fft_factory,
+                                     DirectCorrelationDevice device = DirectCorrelationDevice::CPU,
+                                     std::vector<DirectCrossoverPoint>* points = nullptr, int iterations = 5) {
+    const int num_shifts = config.getNumShifts();
+    const int num_signals = config.getNumSignals();
+    std::mt19937 rng(0x5EED);
+    std::uniform_int_distribution<int32_t> sample(-32768, 32767);
+
+    auto time_backend = [&](IFFTBackend& backend, const std::vector<int32_t>& reference,
+                            const std::vector<int32_t>& inputs, int n_kg, double& median_ms) {
+        OperationTiming a, b, c;
+        std::vector<float> peaks(static_cast<size_t>(num_signals) * num_shifts * n_kg);
+        if (!backend.initialize() || !backend.step1_ProcessReferenceSignals(reference, num_shifts, a, b)) {
+            return false;
+        }
+        std::vector<double> samples;
+        for (int i = 0; i <= iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            if (!backend.step2_ProcessInputSignals(inputs, num_signals, a, b) ||
+                !backend.step3_ComputeCorrelation(num_signals, num_shifts, n_kg, a, b, c) ||
+                !backend.readCorrelationPeaks(peaks)) {
+                return false;
+            }
+            if (i > 0) {   // Первый проход — прогрев
+                samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+        std::sort(samples.begin(), samples.end());
+        median_ms = samples[samples.size() / 2];
+        return true;
+    };
+
+    size_t crossover = 0;
+    for (size_t n = 16; n <= kDirectMaxFFTSize; n *= 2) {
+        const int n_kg = std::min<int>(config.getNumOutputPoints(), static_cast<int>(n));
+        std::vector<int32_t> reference(n), inputs(n * num_signals);
+        for (auto& value : reference) value = sample(rng);
+        for (auto& value : inputs) value = sample(rng);
+
+        DirectCrossoverPoint point;
+        point.fft_size = n;
+        DirectCorrelationBackend direct(device);
+        direct.setConfiguration(n, num_shifts, num_signals, n_kg, config.getScaleFactor());
+        std::unique_ptr<IFFTBackend> fft = fft_factory(n, n_kg);
+        const bool ok = fft && time_backend(direct, reference, inputs, n_kg, point.direct_ms) &&
+                        time_backend(*fft, reference, inputs, n_kg, point.fft_ms);
+        if (fft) {
+            fft->cleanup();
+        }
+        if (!ok) {
+            fprintf(stderr, "[DIRECT] Crossover measurement failed at N=%zu\n", n);
+            break;
+        }
+        printf("[DIRECT] N=%zu: FFT %.3f ms, direct (%s) %.3f ms\n", n, point.fft_ms,
+               directCorrelationDeviceName(device), point.direct_ms);
+        if (points) {
+            points->push_back(point);
+        }
+        if (point.direct_ms >= point.fft_ms) {
+            break;
+        }
+        crossover = n;
+    }
+    return crossover;
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_DIRECT_CORRELATION_BACKEND_HPP
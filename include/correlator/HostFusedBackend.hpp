@@ -0,0 +1,377 @@
+#ifndef CORRELATOR_HOST_FUSED_BACKEND_HPP
+#define CORRELATOR_HOST_FUSED_BACKEND_HPP
+
+#include "CpuFFT.hpp"
+#include "IFFTBackend.hpp"
+#include "ParallelChunks.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// HostFusedBackend - Step 2 + Step 3 на CPU по одному сигналу
+// ============================================================================
+
+/**
+ * @class HostFusedBackend
+ * @brief IFFTBackend для хостов без GPU: сигнал проходит Step 2 и Step 3 целиком, пока его спектр в L2
+ *
+ * CorrelationPipeline вызывает Step 2 для всего батча, затем Step 3 для всех
+ * пар. На CPU это выталкивает каждый спектр входа в DRAM и читает обратно
+ * shifts раз. Здесь Step 2 только запоминает отсчёты, а Step 3 раздаёт
+ * сигналы потокам: поток переводит сигнал в float, делает FFT и сразу
+ * перемножает спектр со всеми опорными, считает IFFT и пишет n_kg модулей.
+ * Спектр входа (N·8 байт) и рабочий буфер не покидают кэш потока; из
+ * памяти читаются только входы и спектры опорных.
+ *
+ * Пики совпадают с OpenCLFFTBackend с точностью float. При малом n_kg
+ * вместо полного IFFT считаются только нужные n_kg отсчётов (O(N·n_kg)).
+ * Загрузка готовых спектров (checkpoint, спектральный индекс, лучи на CPU)
+ * поддерживается: тогда Step 3 пропускает преобразование и FFT входа.
+ */
+class HostFusedBackend final : public IFFTBackend {
+public:
+    using Complex = CpuFFTPlan::Complex;
+
+    HostFusedBackend() = default;
+
+    ~HostFusedBackend() override {
+        cleanup();
+    }
+
+    HostFusedBackend(const HostFusedBackend&) = delete;
+    HostFusedBackend& operator=(const HostFusedBackend&) = delete;
+
+    void setConfiguration(size_t fft_size, int num_shifts, int num_signals, int n_kg, float scale_factor) {
+        if (initialized_) {
+            throw std::runtime_error("Cannot change configuration after initialization");
+        }
+        fft_size_ = fft_size;
+        num_shifts_ = num_shifts;
+        num_signals_ = num_signals;
+        n_kg_ = n_kg;
+        scale_factor_ = scale_factor;
+    }
+
+    /**
+     * @brief Число рабочих потоков (0 — все ядра, не больше числа сигналов)
+     */
+    void setThreads(unsigned threads) { threads_ = threads; }
+
+    /**
+     * @brief Считаются ли в Step 3 только n_kg отсчётов IFFT (иначе полный IFFT)
+     */
+    bool usesPartialInverse() const { return partial_inverse_; }
+
+    bool initialize() override {
+        if (initialized_) {
+            return true;
+        }
+        if (fft_size_ == 0 || num_shifts_ <= 0 || num_signals_ <= 0 || n_kg_ <= 0 ||
+            static_cast<size_t>(n_kg_) > fft_size_) {
+            return false;
+        }
+
+        init_timings_.clear();
+        auto start = Clock::now();
+        plan_ = CpuFFTPlan(fft_size_);
+
+        // Полный IFFT ~5·log2(L) флопов на отсчёт (Bluestein — два FFT длины M ≥ 2N),
+        // частичный — 8·n_kg
+        const size_t length = plan_.scratchSize() ? plan_.scratchSize() : fft_size_;
+        const double log2_length = std::log2(static_cast<double>(length));
+        const double full_cost = plan_.scratchSize()
+                                     ? 10.0 * log2_length * static_cast<double>(length) / static_cast<double>(fft_size_)
+                                     : 5.0 * log2_length;
+        partial_inverse_ = 8.0 * n_kg_ < full_cost;
+
+        peaks_.assign(static_cast<size_t>(num_signals_) * num_shifts_ * n_kg_, 0.0f);
+        reference_fft_.assign(static_cast<size_t>(num_shifts_) * fft_size_, Complex(0.0f, 0.0f));
+        init_timings_.push_back({"CPU FFT plans (host fused)", elapsed_ms(start)});
+        initialized_ = true;
+        return true;
+    }
+
+    void cleanup() override {
+        initialized_ = false;
+        reference_ready_ = false;
+        inputs_pending_ = false;
+        spectra_loaded_ = false;
+        raw_inputs_.clear();
+        input_fft_.clear();
+        reference_fft_.clear();
+    }
+
+    bool isInitialized() const override { return initialized_; }
+
+    bool getInitTimings(std::vector<InitPhaseTiming>& output) const override {
+        output = init_timings_;
+        return !output.empty();
+    }
+
+    // Планы строятся в initialize(): форма задана setConfiguration()
+    bool createReferenceFFTPlan(size_t, int, float) override { return initialized_; }
+    bool createInputFFTPlan(size_t, int, float) override { return initialized_; }
+    bool createCorrelationIFFTPlan(size_t, int, int, int, int) override { return initialized_; }
+
+    bool step1_ProcessReferenceSignals(const std::vector<int32_t>& reference_signal, int num_shifts,
+                                       OperationTiming& upload_timing, OperationTiming& fft_timing) override {
+        if (!initialized_ || num_shifts != num_shifts_ || reference_signal.size() < fft_size_) {
+            return false;
+        }
+        upload_timing = OperationTiming{};
+        auto start = Clock::now();
+        // conj(FFT(scale·ref[(n + shift) mod N])) — как после Step 1 OpenCLFFTBackend
+        parallelChunks(static_cast<size_t>(num_shifts_), threads_, [&](size_t shift) {
+            std::vector<Complex> scratch(plan_.scratchSize());
+            Complex* row = reference_fft_.data() + shift * fft_size_;
+            for (size_t n = 0; n < fft_size_; ++n) {
+                row[n] = Complex(static_cast<float>(reference_signal[(n + shift) % fft_size_]) * scale_factor_, 0.0f);
+            }
+            plan_.forward(row, scratch.data());
+            for (size_t k = 0; k < fft_size_; ++k) {
+                row[k] = std::conj(row[k]);
+            }
+        });
+        set_host_timing(fft_timing, elapsed_ms(start));
+        reference_ready_ = true;
+        return true;
+    }
+
+    bool step2_ProcessInputSignals(const std::vector<int32_t>& input_signals, int num_signals,
+                                   OperationTiming& upload_timing, OperationTiming& fft_timing) override {
+        if (!initialized_ || num_signals <= 0 || num_signals > num_signals_ ||
+            input_signals.size() < static_cast<size_t>(num_signals) * fft_size_) {
+            return false;
+        }
+        // Преобразование и FFT — в Step 3, сигнал за сигналом. Строки сверх num_signals — нули
+        auto start = Clock::now();
+        const size_t count = static_cast<size_t>(num_signals) * fft_size_;
+        raw_inputs_.assign(static_cast<size_t>(num_signals_) * fft_size_, 0);
+        std::copy_n(input_signals.begin(), count, raw_inputs_.begin());
+        upload_timing = OperationTiming{};
+        set_host_timing(fft_timing, elapsed_ms(start));
+        inputs_pending_ = true;
+        spectra_loaded_ = false;
+        input_fft_valid_ = false;
+        return true;
+    }
+
+    bool loadReferenceSpectra(std::span<const ComplexFloat> spectra, int num_shifts,
+                              OperationTiming& upload_timing) override {
+        if (!initialized_ || num_shifts != num_shifts_ ||
+            spectra.size() != static_cast<size_t>(num_shifts_) * fft_size_) {
+            return false;
+        }
+        upload_timing = OperationTiming{};
+        for (size_t i = 0; i < spectra.size(); ++i) {
+            reference_fft_[i] = Complex(spectra[i].real, spectra[i].imag);
+        }
+        reference_ready_ = true;
+        return true;
+    }
+
+    bool loadInputSpectra(std::span<const ComplexFloat> spectra, int num_signals,
+                          OperationTiming& upload_timing) override {
+        if (!initialized_ || num_signals <= 0 || num_signals > num_signals_ ||
+            spectra.size() != static_cast<size_t>(num_signals) * fft_size_) {
+            return false;
+        }
+        upload_timing = OperationTiming{};
+        input_fft_.assign(static_cast<size_t>(num_signals_) * fft_size_, ComplexFloat());
+        std::copy(spectra.begin(), spectra.end(), input_fft_.begin());
+        inputs_pending_ = false;
+        spectra_loaded_ = true;
+        input_fft_valid_ = true;
+        return true;
+    }
+
+    bool step3_ComputeCorrelation(int num_signals, int num_shifts, int n_kg, OperationTiming& copy_timing,
+                                  OperationTiming& ifft_timing, OperationTiming& download_timing) override {
+        if (!initialized_ || !reference_ready_ || num_signals != num_signals_ ||
+            num_shifts != num_shifts_ || n_kg != n_kg_ || (!inputs_pending_ && !spectra_loaded_)) {
+            return false;
+        }
+        copy_timing = OperationTiming{};
+        download_timing = OperationTiming{};
+        auto start = Clock::now();
+        parallelChunks(static_cast<size_t>(num_signals_), worker_threads(), [&](size_t signal) {
+            correlate_signal(signal);
+        });
+        set_host_timing(ifft_timing, elapsed_ms(start));
+        return true;
+    }
+
+    bool getReferenceFFT(std::vector<ComplexFloat>& output) const override {
+        if (!reference_ready_) {
+            return false;
+        }
+        output.resize(reference_fft_.size());
+        for (size_t i = 0; i < reference_fft_.size(); ++i) {
+            output[i] = ComplexFloat(reference_fft_[i].real(), reference_fft_[i].imag());
+        }
+        return true;
+    }
+
+    bool getInputFFT(std::vector<ComplexFloat>& output) const override {
+        if (!inputs_pending_ && !spectra_loaded_) {
+            return false;
+        }
+        if (!input_fft_valid_) {
+            // Спектры входа в Step 3 не сохраняются — пересчёт только для экспорта
+            input_fft_.resize(static_cast<size_t>(num_signals_) * fft_size_);
+            parallelChunks(static_cast<size_t>(num_signals_), worker_threads(), [&](size_t signal) {
+                std::vector<Complex> spectrum(fft_size_), scratch(plan_.scratchSize());
+                input_spectrum(signal, spectrum.data(), scratch.data());
+                ComplexFloat* row = input_fft_.data() + signal * fft_size_;
+                for (size_t k = 0; k < fft_size_; ++k) {
+                    row[k] = ComplexFloat(spectrum[k].real(), spectrum[k].imag());
+                }
+            });
+            input_fft_valid_ = true;
+        }
+        output = input_fft_;
+        return true;
+    }
+
+    bool getCorrelationPeaks(std::vector<float>& output) const override {
+        output = peaks_;
+        return initialized_;
+    }
+
+    bool readCorrelationPeaks(std::span<float> output) const override {
+        if (!initialized_ || output.size() != peaks_.size()) {
+            return false;
+        }
+        std::copy(peaks_.begin(), peaks_.end(), output.begin());
+        return true;
+    }
+
+    std::string getPlatformName() const override { return "CPU (host fused)"; }
+
+    std::string getDeviceName() const override {
+        return "CPU x" + std::to_string(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    std::string getDriverVersion() const override { return "n/a"; }
+    std::string getAPIVersion() const override { return "n/a"; }
+    cl_device_id getDeviceId() const override { return nullptr; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    bool initialized_ = false;
+    bool reference_ready_ = false;
+    bool inputs_pending_ = false;   // Step 2 запомнил отсчёты, FFT входа — в Step 3
+    bool spectra_loaded_ = false;   // Спектры входа загружены loadInputSpectra
+    bool partial_inverse_ = false;
+    unsigned threads_ = 0;
+
+    size_t fft_size_ = 0;
+    int num_shifts_ = 0;
+    int num_signals_ = 0;
+    int n_kg_ = 0;
+    float scale_factor_ = 1.0f;
+
+    CpuFFTPlan plan_;
+    std::vector<Complex> reference_fft_;   // [shifts][N], conj(FFT) опорных
+    std::vector<int32_t> raw_inputs_;      // [signals][N]
+    std::vector<float> peaks_;             // [signals][shifts][n_kg]
+
+    mutable std::vector<ComplexFloat> input_fft_;
+    mutable bool input_fft_valid_ = false;
+
+    std::vector<InitPhaseTiming> init_timings_;
+
+    static double elapsed_ms(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    static void set_host_timing(OperationTiming& timing, double ms) {
+        timing = OperationTiming{};
+        timing.execute_ms = ms;
+        timing.total_gpu_ms = ms;
+    }
+
+    unsigned worker_threads() const {
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        return threads_ != 0 ? threads_ : std::min<unsigned>(cores, static_cast<unsigned>(num_signals_));
+    }
+
+    /**
+     * Спектр сигнала: загруженный или FFT(scale·x) из отсчётов Step 2
+     */
+    void input_spectrum(size_t signal, Complex* spectrum, Complex* scratch) const {
+        if (spectra_loaded_) {
+            const ComplexFloat* row = input_fft_.data() + signal * fft_size_;
+            for (size_t k = 0; k < fft_size_; ++k) {
+                spectrum[k] = Complex(row[k].real, row[k].imag);
+            }
+            return;
+        }
+        const int32_t* row = raw_inputs_.data() + signal * fft_size_;
+        for (size_t n = 0; n < fft_size_; ++n) {
+            spectrum[n] = Complex(static_cast<float>(row[n]) * scale_factor_, 0.0f);
+        }
+        plan_.forward(spectrum, scratch);
+    }
+
+    /**
+     * Step 2 + Step 3 одного сигнала: буферы потока переиспользуются
+     * между сигналами и остаются в его кэше
+     */
+    void correlate_signal(size_t signal) {
+        thread_local std::vector<Complex> spectrum, product, scratch;
+        spectrum.resize(fft_size_);
+        product.resize(fft_size_);
+        scratch.resize(plan_.scratchSize());
+
+        input_spectrum(signal, spectrum.data(), scratch.data());
+
+        const float inv_n = 1.0f / static_cast<float>(fft_size_);
+        for (int shift = 0; shift < num_shifts_; ++shift) {
+            const Complex* ref = reference_fft_.data() + static_cast<size_t>(shift) * fft_size_;
+            float* out = peaks_.data() + (signal * num_shifts_ + shift) * n_kg_;
+
+            // ref · conj(inp), раздельные Re/Im для векторизации
+            for (size_t k = 0; k < fft_size_; ++k) {
+                const float ar = ref[k].real(), ai = ref[k].imag();
+                const float br = spectrum[k].real(), bi = spectrum[k].imag();
+                product[k] = Complex(ar * br + ai * bi, ai * br - ar * bi);
+            }
+
+            if (partial_inverse_) {
+                // y[t] = Σ_f P[f]·e^{+j2πft/N} только для t < n_kg
+                for (int t = 0; t < n_kg_; ++t) {
+                    float re = 0.0f, im = 0.0f;
+                    size_t phase = 0;
+                    for (size_t f = 0; f < fft_size_; ++f) {
+                        const Complex w = plan_.root(phase);   // e^{-j2π·phase/N}, нужен conj
+                        re += product[f].real() * w.real() + product[f].imag() * w.imag();
+                        im += product[f].imag() * w.real() - product[f].real() * w.imag();
+                        phase += t;
+                        if (phase >= fft_size_) phase -= fft_size_;
+                    }
+                    out[t] = std::sqrt(re * re + im * im) * inv_n;
+                }
+                continue;
+            }
+
+            plan_.inverse(product.data(), scratch.data());
+            for (int t = 0; t < n_kg_; ++t) {
+                out[t] = std::abs(product[t]) * inv_n;
+            }
+        }
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_HOST_FUSED_BACKEND_HPP
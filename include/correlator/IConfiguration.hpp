@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <string>
 #include <memory>
+#include "PeaksEncoding.hpp"
 
 namespace Correlator {
 
@@ -24,6 +25,7 @@ public:
     virtual int getNumSignals() const = 0;
     virtual int getNumOutputPoints() const = 0;
     virtual float getScaleFactor() const = 0;
+    virtual const PeaksEncodingParams& getPeaksEncoding() const = 0;
 
     // Установка параметров
     virtual void setFFTSize(size_t size) = 0;
@@ -31,6 +33,7 @@ public:
     virtual void setNumSignals(int signals) = 0;
     virtual void setNumOutputPoints(int points) = 0;
     virtual void setScaleFactor(float factor) = 0;
+    virtual void setPeaksEncoding(const PeaksEncodingParams& params) = 0;
 
     // Валидация
     virtual bool validate() const = 0;
@@ -2,6 +2,7 @@
 #define ICORRELATOR_DATA_SNAPSHOT_HPP
 
 #include <vector>
+#include <span>
 #include <string>
 #include <memory>
 #include <cstdint>
@@ -62,7 +63,8 @@ public:
     virtual void saveCorrelationIFFT(const std::vector<ComplexFloat>& data,
                                      int num_signals, int num_shifts, size_t fft_size) = 0;
     
-    virtual void savePeaks(const std::vector<float>& peaks,
+    // span: принимает и std::vector, и PeaksBuffer::span() без промежуточной копии
+    virtual void savePeaks(std::span<const float> peaks,
                           int num_signals, int num_shifts, int num_points) = 0;
 
     // Методы для получения данных
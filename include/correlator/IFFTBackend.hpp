@@ -1,10 +1,17 @@
 #ifndef ICORRELATOR_FFT_BACKEND_HPP
 #define ICORRELATOR_FFT_BACKEND_HPP
 
+#include <algorithm>
 #include <vector>
 #include <memory>
 #include <cstdint>
+#include <cstring>
+#include <string>
+#include <span>
+#include "Correlation2D.hpp"
 #include "IDataSnapshot.hpp"
+#include "PeaksEncoding.hpp"
+#include "RangeDoppler.hpp"
 #include <CL/opencl.h>
 
 namespace Correlator {
@@ -20,6 +27,56 @@ struct OperationTiming {
     double total_gpu_ms = 0.0;    // Общее время GPU (QUEUED to END)
 };
 
+/**
+ * @struct InitPhaseTiming
+ * @brief Время одной фазы инициализации бэкенда (host-время)
+ */
+struct InitPhaseTiming {
+    std::string phase;            // Название фазы (контекст, буфер, план...)
+    double time_ms = 0.0;         // Длительность фазы
+};
+
+/**
+ * @struct BuildPhaseTiming
+ * @brief Ленивая сборка плана/программы после initialize() (host-время)
+ */
+struct BuildPhaseTiming {
+    std::string step;             // Шаг, вызвавший сборку (Step2, Step3, Autotune...)
+    std::string phase;            // Название фазы (план, программа)
+    double time_ms = 0.0;         // Длительность фазы
+};
+
+/**
+ * @struct DeviceMemoryStep
+ * @brief Память устройства за шаг (Init, Step1, Step2, Step3)
+ */
+struct DeviceMemoryStep {
+    std::string step;
+    size_t high_water_bytes = 0;  // Максимум занятой памяти во время шага
+    size_t allocated_bytes = 0;   // Выделено за шаг
+    size_t released_bytes = 0;    // Освобождено за шаг
+};
+
+/**
+ * @struct BackendTuning
+ * @brief Настройки, выбранные бэкендом на устройстве (автотюнинг Step 2, слитый Step 2+3)
+ *
+ * Сохраняются в checkpoint, чтобы восстановление не калибровало заново.
+ * device — имя устройства и версия драйвера, на которых настройки выбраны.
+ */
+struct BackendTuning {
+    uint8_t step2_path = 0;       // Путь конвертации Step 2 (0 — callback, 1 — ядро-конвертер)
+    uint8_t fused = 0;            // Слитый Step 2+3
+    uint16_t reserved = 0;
+    int32_t step2_split = 1;      // Частей батча Step 2
+    char device[192] = {};
+
+    bool sameAs(const BackendTuning& other) const {
+        return step2_path == other.step2_path && fused == other.fused && step2_split == other.step2_split &&
+               std::strncmp(device, other.device, sizeof(device)) == 0;
+    }
+};
+
 /**
  * @class IFFTBackend
  * @brief Интерфейс для FFT бэкенда (Strategy Pattern)
@@ -36,6 +93,49 @@ public:
     virtual void cleanup() = 0;
     virtual bool isInitialized() const = 0;
 
+    // Разбивка времени initialize() по фазам (пусто, если бэкенд не профилирует инициализацию)
+    virtual bool getInitTimings(std::vector<InitPhaseTiming>& output) const {
+        output.clear();
+        return false;
+    }
+
+    // Ленивые сборки после initialize() с шагом, который их вызвал (в getInitTimings не входят)
+    virtual bool getBuildTimings(std::vector<BuildPhaseTiming>& output) const {
+        output.clear();
+        return false;
+    }
+
+    /**
+     * @brief Настройки после initialize() (см. BackendTuning)
+     * @return false, если бэкенд ничего не настраивает
+     */
+    virtual bool getTuning(BackendTuning& tuning) const {
+        (void)tuning;
+        return false;
+    }
+
+    /**
+     * @brief Применить сохранённые настройки вместо автотюнинга
+     *
+     * До initialize() настройки запоминаются и применяются в нём, если
+     * устройство и драйвер совпали (иначе — обычный выбор, см. getTuning);
+     * после initialize() — сразу.
+     * @return false, если бэкенд без настроек, устройство другое или применить не удалось
+     */
+    virtual bool setTuning(const BackendTuning& tuning) {
+        (void)tuning;
+        return false;
+    }
+
+    // Память устройства по шагам + текущий объём и high-water (пусто, если бэкенд не ведёт учёт)
+    virtual bool getDeviceMemoryUsage(std::vector<DeviceMemoryStep>& steps,
+                                      size_t& current_bytes, size_t& high_water_bytes) const {
+        steps.clear();
+        current_bytes = 0;
+        high_water_bytes = 0;
+        return false;
+    }
+
     // Создание FFT планов
     virtual bool createReferenceFFTPlan(size_t fft_size, int batch_size, float scale_factor) = 0;
     virtual bool createInputFFTPlan(size_t fft_size, int batch_size, float scale_factor) = 0;
@@ -58,6 +158,122 @@ public:
         OperationTiming& fft_timing
     ) = 0;
 
+    /**
+     * @brief Step 1 без FFT: загрузить спектры опорных из checkpoint
+     * @param spectra num_shifts × fft_size значений в формате getReferenceFFT
+     * @return false, если бэкенд не поддерживает загрузку спектров
+     */
+    virtual bool loadReferenceSpectra(std::span<const ComplexFloat> spectra, int num_shifts,
+                                      OperationTiming& upload_timing) {
+        (void)spectra;
+        (void)num_shifts;
+        (void)upload_timing;
+        return false;
+    }
+
+    /**
+     * @brief Step 1 из аналитического спектра: развернуть банк по базовой строке
+     * @param base_spectrum fft_size значений R_0 = conj(scale·X) (ReferenceSpectra.hpp)
+     * @param expand_timing Время развёртки строк 1..num_shifts−1
+     * @return false, если бэкенд не умеет разворачивать банк сам (pipeline
+     *         развернёт на CPU и вызовет loadReferenceSpectra)
+     */
+    virtual bool loadReferenceBaseSpectrum(std::span<const ComplexFloat> base_spectrum, int num_shifts,
+                                           OperationTiming& upload_timing, OperationTiming& expand_timing) {
+        (void)base_spectrum;
+        (void)num_shifts;
+        (void)upload_timing;
+        (void)expand_timing;
+        return false;
+    }
+
+    /**
+     * @brief Кэш страниц банка опорных на устройстве (см. PagedReferenceBank.hpp)
+     * @param slots Страниц [num_shifts][fft_size], одновременно резидентных на устройстве
+     * @param half_precision Страницы приходят с хоста в fp16
+     * @return false, если бэкенд не держит страницы сам (pipeline грузит каждую
+     *         страницу через loadReferenceSpectra)
+     */
+    virtual bool configureReferenceCache(int slots, bool half_precision) {
+        (void)slots;
+        (void)half_precision;
+        return false;
+    }
+
+    /**
+     * @brief Асинхронно загрузить страницу банка в слот кэша
+     * @param page Страница в формате PagedReferenceBank::pageData, копируется до возврата
+     */
+    virtual bool pageInReference(int slot, const void* page, OperationTiming& staging_timing) {
+        (void)slot;
+        (void)page;
+        (void)staging_timing;
+        return false;
+    }
+
+    /**
+     * @brief Сделать страницу слота банком Step 1 для следующего Step 3
+     * @param activate_timing total_gpu_ms − execute_ms — ожидание окончания подкачки
+     */
+    virtual bool activateReferencePage(int slot, OperationTiming& activate_timing) {
+        (void)slot;
+        (void)activate_timing;
+        return false;
+    }
+
+    /**
+     * @brief Step 2 без FFT: загрузить готовые спектры (спектральный индекс архива)
+     * @param spectra num_signals × fft_size значений, num_signals ≤ размера батча
+     * @return false, если бэкенд не поддерживает загрузку спектров
+     */
+    virtual bool loadInputSpectra(std::span<const ComplexFloat> spectra, int num_signals,
+                                  OperationTiming& upload_timing) {
+        (void)spectra;
+        (void)num_signals;
+        (void)upload_timing;
+        return false;
+    }
+
+    /**
+     * @brief Загрузить веса формирования лучей на устройство (см. Beamformer.hpp)
+     * @param weights channels × beams × fft_size, раскладка BeamWeights
+     * @return false, если бэкенд не формирует лучи сам (pipeline считает их на CPU)
+     */
+    virtual bool setBeamWeights(std::span<const ComplexFloat> weights, int channels, int beams) {
+        (void)weights;
+        (void)channels;
+        (void)beams;
+        return false;
+    }
+
+    /**
+     * @brief Заменить спектры каналов Step 2 спектрами лучей (строки ≥ beams обнуляются)
+     */
+    virtual bool step2_FormBeams(OperationTiming& beam_timing) {
+        (void)beam_timing;
+        return false;
+    }
+
+    /**
+     * @brief Step 2 только загрузил сигналы, а FFT выполнит слитый Step 3
+     *
+     * Пока спектры отложены, getInputFFT досчитывает их отдельным FFT;
+     * pipeline читает их только после Step 3 (см. step2_MaterializeInputSpectra).
+     */
+    virtual bool isInputSpectraDeferred() const {
+        return false;
+    }
+
+    /**
+     * @brief Досчитать отложенные спектры Step 2 (экспорт, индекс, лучи, парный режим)
+     * @param fft_timing Время досчёта
+     * @return false, если спектры не отложены или досчёт не удался
+     */
+    virtual bool step2_MaterializeInputSpectra(OperationTiming& fft_timing) {
+        (void)fft_timing;
+        return false;
+    }
+
     // Step 3: Корреляция
     virtual bool step3_ComputeCorrelation(
         int num_signals,
@@ -68,11 +284,112 @@ public:
         OperationTiming& download_timing
     ) = 0;
 
+    /**
+     * @brief Step 3 в парном режиме (TDOA): корреляция каждой пары входов i ≤ j по спектрам Step 2
+     * @param num_lags Окно задержек на пару (см. PairwiseCorrelation.hpp)
+     * @param peaks [pairs][num_lags], pairs = num_signals·(num_signals + 1)/2
+     * @return false, если бэкенд не считает пары сам (pipeline считает на CPU по getInputFFT)
+     */
+    virtual bool step3_ComputePairwiseCorrelation(int num_signals, int num_lags, std::vector<float>& peaks,
+                                                  OperationTiming& multiply_timing, OperationTiming& ifft_timing,
+                                                  OperationTiming& download_timing) {
+        (void)num_signals;
+        (void)num_lags;
+        (void)peaks;
+        (void)multiply_timing;
+        (void)ifft_timing;
+        (void)download_timing;
+        return false;
+    }
+
+    /**
+     * @brief Карта дальность-доплер по импульсам последнего Step 3 на устройстве (см. RangeDoppler.hpp)
+     * @param map Если не nullptr — карта [range_bins][doppler_size]
+     * @param detections_found Ячеек выше порога CFAR (в detections — не больше max_detections)
+     * @return false, если бэкенд не держит спектры Step 1/2 на устройстве (pipeline считает на CPU)
+     */
+    virtual bool step4_ComputeRangeDoppler(const RangeDopplerParams& params, std::vector<float>* map,
+                                           std::vector<RangeDopplerDetection>& detections,
+                                           size_t& detections_found, OperationTiming& corner_turn_timing,
+                                           OperationTiming& fft_timing, OperationTiming& detect_timing) {
+        (void)params;
+        (void)map;
+        (void)detections;
+        (void)detections_found;
+        (void)corner_turn_timing;
+        (void)fft_timing;
+        (void)detect_timing;
+        return false;
+    }
+
+    /**
+     * @brief 2D корреляция: спектры шаблонов [num_templates][height][width] (см. Correlation2D.hpp)
+     * @return false, если бэкенд не поддерживает 2D режим (pipeline считает на CPU)
+     */
+    virtual bool setTemplates2D(std::span<const float> templates, int num_templates,
+                                size_t height, size_t width, OperationTiming& fft_timing) {
+        (void)templates;
+        (void)num_templates;
+        (void)height;
+        (void)width;
+        (void)fft_timing;
+        return false;
+    }
+
+    /**
+     * @brief 2D корреляция кадров [num_images][height][width] со всеми шаблонами setTemplates2D
+     * @param peaks [num_images][num_templates]
+     */
+    virtual bool correlate2D(std::span<const float> images, int num_images, std::vector<Peak2D>& peaks,
+                             OperationTiming& fft_timing, OperationTiming& multiply_timing,
+                             OperationTiming& ifft_timing) {
+        (void)images;
+        (void)num_images;
+        (void)peaks;
+        (void)fft_timing;
+        (void)multiply_timing;
+        (void)ifft_timing;
+        return false;
+    }
+
     // Получение результатов
     virtual bool getReferenceFFT(std::vector<ComplexFloat>& output) const = 0;
     virtual bool getInputFFT(std::vector<ComplexFloat>& output) const = 0;
     virtual bool getCorrelationPeaks(std::vector<float>& output) const = 0;
 
+    /**
+     * @brief Скачать пики прямо в буфер вызывающего кода [signals][shifts][n_kg]
+     *
+     * Размер output должен совпадать с num_signals * num_shifts * n_kg.
+     * Реализация по умолчанию идёт через getCorrelationPeaks (с временным
+     * вектором); бэкенды переопределяют её чтением без аллокаций.
+     */
+    virtual bool readCorrelationPeaks(std::span<float> output) const {
+        std::vector<float> peaks;
+        if (!getCorrelationPeaks(peaks) || peaks.size() != output.size()) {
+            return false;
+        }
+        std::copy(peaks.begin(), peaks.end(), output.begin());
+        return true;
+    }
+
+    /**
+     * @brief Включить кодирование пиков на устройстве (до или после initialize)
+     * @return false, если бэкенд не умеет кодировать (pipeline кодирует на CPU)
+     */
+    virtual bool setPeaksEncoding(const PeaksEncodingParams& params) {
+        return params.encoding == PeaksEncoding::Float32;
+    }
+
+    /**
+     * @brief Сжатые пики последнего Step 3 в кодировке из setPeaksEncoding
+     * @return false, если кодирование на устройстве не поддерживается
+     */
+    virtual bool getEncodedPeaks(EncodedPeaks& output) const {
+        (void)output;
+        return false;
+    }
+
     // Информация о платформе
     virtual std::string getPlatformName() const = 0;
     virtual std::string getDeviceName() const = 0;
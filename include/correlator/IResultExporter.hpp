@@ -4,6 +4,7 @@
 #include "IDataSnapshot.hpp"
 #include "IConfiguration.hpp"
 #include "IDataValidator.hpp"
+#include "PeaksEncoding.hpp"
 #include <string>
 #include <memory>
 #include <vector>
@@ -11,6 +12,17 @@
 
 namespace Correlator {
 
+/**
+ * Формат данных шагов:
+ *   Json   — массивы внутри StepN.json (по умолчанию)
+ *   Binary — массивы в <timestamp_dir>/snapshot.cchk (ChunkArchive,
+ *            shuffle + delta + LZ), в StepN.json только ссылка на поток
+ */
+enum class SnapshotFormat : uint8_t {
+    Json,
+    Binary
+};
+
 /**
  * @class IResultExporter
  * @brief Интерфейс для экспорта результатов в JSON
@@ -39,10 +51,18 @@ public:
                             const IConfiguration& config,
                             const ValidationResult& validation) = 0;
 
+    // Сжатые пики Step 3 (бинарный файл, см. PeaksEncoding.hpp)
+    virtual void exportEncodedPeaks(const EncodedPeaks& peaks,
+                                   const IConfiguration& config) = 0;
+
     // Финальный отчет
     virtual void exportFinalReport(const IDataSnapshot& snapshot,
                                   const IConfiguration& config) = 0;
 
+    // Формат данных шагов
+    virtual void setSnapshotFormat(SnapshotFormat format) = 0;
+    virtual SnapshotFormat getSnapshotFormat() const = 0;
+
     // Настройка пути экспорта
     virtual void setExportPath(const std::string& path) = 0;
     virtual std::string getExportPath() const = 0;
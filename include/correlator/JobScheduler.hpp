@@ -0,0 +1,406 @@
+#ifndef CORRELATOR_JOB_SCHEDULER_HPP
+#define CORRELATOR_JOB_SCHEDULER_HPP
+
+#include "MetricsRegistry.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// Классы приоритета
+// ============================================================================
+
+/**
+ * Строгий приоритет между классами: батч Bulk запускается, только если
+ * в Realtime и Interactive нет готовой работы
+ */
+enum class JobPriority : uint8_t {
+    Realtime = 0,       // Потоки сопровождения: задержка важнее пропускной способности
+    Interactive = 1,    // Запросы оператора
+    Bulk = 2            // Переобработка архивов
+};
+
+constexpr size_t kJobPriorityClasses = 3;
+
+inline const char* jobPriorityName(JobPriority priority) {
+    switch (priority) {
+        case JobPriority::Realtime: return "realtime";
+        case JobPriority::Interactive: return "interactive";
+        case JobPriority::Bulk: return "bulk";
+    }
+    return "unknown";
+}
+
+/**
+ * @struct CorrelationJob
+ * @brief Задание: последовательность батчей одного арендатора
+ *
+ * run_batch(batch, executor) выполняет батч с номером batch на исполнителе
+ * executor (например, pipelines[executor]: beginBatch, executeStep2, executeStep3).
+ * Батчи задания идут строго по порядку и не выполняются одновременно, но
+ * соседние батчи могут попасть на разных исполнителей. false или исключение
+ * прекращают задание.
+ *
+ * Pipeline исполнителя переживает батчи и задания: без beginBatch() его
+ * Step 2/3 после первого батча возвращают true, ничего не делая. Банк
+ * Step 1 beginBatch() сохраняет — задания с другим опорным сигналом
+ * выполняют свой Step 1 на исполнителе сами.
+ *
+ * @code
+ * job.run_batch = [&](size_t batch, size_t executor) {
+ *     CorrelationPipeline& pipeline = *pipelines[executor];
+ *     pipeline.beginBatch();
+ *     return pipeline.executeStep2(inputs[batch], num_signals) &&
+ *            pipeline.executeStep3(num_signals, num_shifts, n_kg);
+ * };
+ * @endcode
+ */
+struct CorrelationJob {
+    std::string tenant = "default";
+    JobPriority priority = JobPriority::Bulk;
+    size_t batches = 1;
+    std::function<bool(size_t batch, size_t executor)> run_batch;
+};
+
+/**
+ * @struct TenantStats
+ * @brief Сводка по арендатору (без реестра метрик)
+ */
+struct TenantStats {
+    uint64_t jobs_completed = 0;
+    uint64_t jobs_failed = 0;
+    uint64_t batches = 0;
+    uint64_t preemptions = 0;        // Задание уступило исполнителя на границе батча
+    double busy_seconds = 0.0;       // Время исполнителей на батчах арендатора
+    double wait_seconds = 0.0;       // Сумма ожиданий от submit до первого батча
+    double max_job_seconds = 0.0;    // Худшая задержка задания (submit → последний батч)
+};
+
+// ============================================================================
+// JobScheduler - очередь заданий перед pipeline'ами
+// ============================================================================
+
+/**
+ * @class JobScheduler
+ * @brief Приоритеты, взвешенная справедливость между арендаторами, вытеснение на границе батча
+ *
+ * Исполнители (по одному потоку на pipeline/устройство) после каждого батча
+ * заново выбирают работу, так что пришедшее задание Realtime ждёт не дольше
+ * одного батча, а не всего задания Bulk. Внутри класса — start-time fair
+ * queuing: у арендатора виртуальное время, растущее на (время батча / вес);
+ * выбирается арендатор с наименьшим. Вновь активный арендатор начинает с
+ * текущего виртуального времени класса — простой не копит кредит.
+ *
+ * Метрики (если передан реестр), метки tenant и priority:
+ * correlator_scheduler_wait_seconds, correlator_scheduler_job_seconds,
+ * correlator_scheduler_batch_seconds (sum — занятость исполнителей),
+ * correlator_scheduler_jobs_total{status}, correlator_scheduler_preemptions_total,
+ * correlator_scheduler_queued_jobs.
+ */
+class JobScheduler {
+public:
+    explicit JobScheduler(size_t executors, std::shared_ptr<MetricsRegistry> metrics = nullptr)
+        : metrics_(std::move(metrics)), last_job_(executors) {
+        if (executors == 0) {
+            throw std::invalid_argument("JobScheduler needs at least one executor");
+        }
+        workers_.reserve(executors);
+        for (size_t executor = 0; executor < executors; ++executor) {
+            workers_.emplace_back([this, executor]() { workerLoop(executor); });
+        }
+    }
+
+    ~JobScheduler() {
+        shutdown();
+    }
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    /**
+     * @brief Вес арендатора (доля времени исполнителей внутри класса приоритета)
+     */
+    void setTenantWeight(const std::string& tenant, double weight) {
+        if (!(weight > 0.0)) {
+            throw std::invalid_argument("Tenant weight must be positive");
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        tenantLocked(tenant).weight = weight;
+    }
+
+    /**
+     * @return true, когда все батчи выполнены; false — ошибка батча или shutdown()
+     */
+    std::shared_future<bool> submit(CorrelationJob job) {
+        if (!job.run_batch) {
+            throw std::invalid_argument("CorrelationJob::run_batch is empty");
+        }
+        auto state = std::make_shared<JobState>();
+        state->job = std::move(job);
+        state->submitted = Clock::now();
+        std::shared_future<bool> result = state->done.get_future().share();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            state->done.set_value(false);
+            return result;
+        }
+        if (state->job.batches == 0) {
+            state->done.set_value(true);
+            return result;
+        }
+        Tenant& tenant = tenantLocked(state->job.tenant);
+        const size_t cls = static_cast<size_t>(state->job.priority);
+        if (tenant.queues[cls].empty()) {
+            tenant.virtual_time[cls] = std::max(tenant.virtual_time[cls], class_virtual_time_[cls]);
+        }
+        tenant.queues[cls].push_back(state);
+        if (tenant.metrics.queued) tenant.metrics.queued->add(1.0);
+        ++pending_jobs_;
+        work_ready_.notify_one();
+        return result;
+    }
+
+    /**
+     * @brief Дождаться, пока все принятые задания завершатся
+     */
+    void waitIdle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this]() { return pending_jobs_ == 0; });
+    }
+
+    /**
+     * @brief Остановить исполнителей: текущие батчи доигрываются, остальное завершается с false
+     */
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return;
+            }
+            stopping_ = true;
+        }
+        work_ready_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [name, tenant] : tenants_) {
+            for (auto& queue : tenant.queues) {
+                for (auto& state : queue) {
+                    finishLocked(tenant, *state, false);
+                }
+                queue.clear();
+            }
+        }
+        idle_.notify_all();
+    }
+
+    TenantStats tenantStats(const std::string& tenant) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = tenants_.find(tenant);
+        return it != tenants_.end() ? it->second.stats : TenantStats{};
+    }
+
+    size_t executorCount() const { return workers_.size(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct JobState {
+        CorrelationJob job;
+        Clock::time_point submitted;
+        size_t next_batch = 0;
+        bool running = false;     // Батч на исполнителе (батчи задания не параллелятся)
+        bool started = false;
+        bool failed = false;
+        std::promise<bool> done;
+    };
+
+    struct TenantMetrics {
+        std::array<Histogram*, kJobPriorityClasses> wait{};
+        std::array<Histogram*, kJobPriorityClasses> job{};
+        Histogram* batch = nullptr;
+        Counter* completed = nullptr;
+        Counter* failed = nullptr;
+        Counter* preemptions = nullptr;
+        Gauge* queued = nullptr;
+    };
+
+    struct Tenant {
+        double weight = 1.0;
+        std::array<double, kJobPriorityClasses> virtual_time{};
+        std::array<std::deque<std::shared_ptr<JobState>>, kJobPriorityClasses> queues;
+        TenantStats stats;
+        TenantMetrics metrics;
+    };
+
+    std::shared_ptr<MetricsRegistry> metrics_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable idle_;
+    std::map<std::string, Tenant> tenants_;
+    std::array<double, kJobPriorityClasses> class_virtual_time_{};
+    std::vector<std::shared_ptr<JobState>> last_job_;   // Последнее задание исполнителя (для вытеснений)
+    size_t pending_jobs_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+
+    Tenant& tenantLocked(const std::string& name) {
+        auto [it, inserted] = tenants_.try_emplace(name);
+        if (inserted && metrics_) {
+            registerMetrics(name, it->second.metrics);
+        }
+        return it->second;
+    }
+
+    void registerMetrics(const std::string& name, TenantMetrics& m) {
+        const std::string tenant_label = "tenant=\"" + name + "\"";
+        for (size_t cls = 0; cls < kJobPriorityClasses; ++cls) {
+            const std::string labels = tenant_label + ",priority=\"" +
+                                       jobPriorityName(static_cast<JobPriority>(cls)) + "\"";
+            m.wait[cls] = &metrics_->histogram("correlator_scheduler_wait_seconds",
+                                               "Ожидание задания до первого батча", Histogram::latencyBounds(), labels);
+            m.job[cls] = &metrics_->histogram("correlator_scheduler_job_seconds",
+                                              "Задержка задания от submit до последнего батча",
+                                              Histogram::latencyBounds(), labels);
+        }
+        m.batch = &metrics_->histogram("correlator_scheduler_batch_seconds", "Время батча на исполнителе",
+                                       Histogram::latencyBounds(), tenant_label);
+        m.completed = &metrics_->counter("correlator_scheduler_jobs_total", "Завершённые задания",
+                                         tenant_label + ",status=\"ok\"");
+        m.failed = &metrics_->counter("correlator_scheduler_jobs_total", "Завершённые задания",
+                                      tenant_label + ",status=\"failed\"");
+        m.preemptions = &metrics_->counter("correlator_scheduler_preemptions_total",
+                                           "Задание уступило исполнителя на границе батча", tenant_label);
+        m.queued = &metrics_->gauge("correlator_scheduler_queued_jobs", "Задания в очереди и в работе", tenant_label);
+    }
+
+    /**
+     * Старший класс с готовой работой, в нём — арендатор с наименьшим виртуальным временем
+     */
+    std::shared_ptr<JobState> pickLocked(Tenant*& owner) {
+        for (size_t cls = 0; cls < kJobPriorityClasses; ++cls) {
+            Tenant* best = nullptr;
+            std::shared_ptr<JobState> best_job;
+            for (auto& [name, tenant] : tenants_) {
+                if (best && tenant.virtual_time[cls] >= best->virtual_time[cls]) {
+                    continue;
+                }
+                for (auto& state : tenant.queues[cls]) {
+                    if (!state->running) {
+                        best = &tenant;
+                        best_job = state;
+                        break;
+                    }
+                }
+            }
+            if (best) {
+                class_virtual_time_[cls] = best->virtual_time[cls];
+                owner = best;
+                return best_job;
+            }
+        }
+        return nullptr;
+    }
+
+    void finishLocked(Tenant& tenant, JobState& state, bool ok) {
+        const double seconds = std::chrono::duration<double>(Clock::now() - state.submitted).count();
+        const size_t cls = static_cast<size_t>(state.job.priority);
+        if (ok) {
+            ++tenant.stats.jobs_completed;
+            if (tenant.metrics.completed) tenant.metrics.completed->inc();
+        } else {
+            ++tenant.stats.jobs_failed;
+            if (tenant.metrics.failed) tenant.metrics.failed->inc();
+        }
+        tenant.stats.max_job_seconds = std::max(tenant.stats.max_job_seconds, seconds);
+        if (tenant.metrics.job[cls]) tenant.metrics.job[cls]->observe(seconds);
+        if (tenant.metrics.queued) tenant.metrics.queued->add(-1.0);
+        state.done.set_value(ok);
+        --pending_jobs_;
+    }
+
+    void workerLoop(size_t executor) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            Tenant* tenant = nullptr;
+            std::shared_ptr<JobState> state;
+            work_ready_.wait(lock, [&]() {
+                if (stopping_) return true;
+                state = pickLocked(tenant);
+                return state != nullptr;
+            });
+            if (stopping_) {
+                break;
+            }
+
+            // Прошлое задание исполнителя не доделано и не продолжено другим — вытеснено
+            std::shared_ptr<JobState>& last = last_job_[executor];
+            if (last && last != state && !last->running && last->next_batch < last->job.batches && !last->failed) {
+                Tenant& last_tenant = tenants_[last->job.tenant];
+                ++last_tenant.stats.preemptions;
+                if (last_tenant.metrics.preemptions) last_tenant.metrics.preemptions->inc();
+            }
+            last = state;
+
+            const size_t cls = static_cast<size_t>(state->job.priority);
+            if (!state->started) {
+                state->started = true;
+                const double wait = std::chrono::duration<double>(Clock::now() - state->submitted).count();
+                tenant->stats.wait_seconds += wait;
+                if (tenant->metrics.wait[cls]) tenant->metrics.wait[cls]->observe(wait);
+            }
+            state->running = true;
+            const size_t batch = state->next_batch++;
+
+            lock.unlock();
+            const auto start = Clock::now();
+            bool ok = false;
+            try {
+                ok = state->job.run_batch(batch, executor);
+            } catch (...) {
+                ok = false;
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            lock.lock();
+
+            state->running = false;
+            tenant->virtual_time[cls] += seconds / tenant->weight;
+            tenant->stats.busy_seconds += seconds;
+            ++tenant->stats.batches;
+            if (tenant->metrics.batch) tenant->metrics.batch->observe(seconds);
+
+            if (!ok || state->next_batch == state->job.batches) {
+                state->failed = !ok;
+                auto& queue = tenant->queues[cls];
+                queue.erase(std::find(queue.begin(), queue.end(), state));
+                finishLocked(*tenant, *state, ok);
+                if (pending_jobs_ == 0) {
+                    idle_.notify_all();
+                }
+            }
+            // Освободившееся задание (или место в очереди) может взять другой исполнитель
+            work_ready_.notify_all();
+        }
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_JOB_SCHEDULER_HPP
@@ -0,0 +1,230 @@
+#ifndef CORRELATOR_METRICS_REGISTRY_HPP
+#define CORRELATOR_METRICS_REGISTRY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Correlator {
+
+/**
+ * @class Counter
+ * @brief Монотонный счётчик (атомарный, relaxed)
+ */
+class Counter {
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+/**
+ * @class Gauge
+ * @brief Текущее значение (память, глубина очереди)
+ */
+class Gauge {
+public:
+    void set(double v) { value_.store(v, std::memory_order_relaxed); }
+    void add(double v) { value_.fetch_add(v, std::memory_order_relaxed); }
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+/**
+ * @class Histogram
+ * @brief Гистограмма с фиксированными границами корзин (без блокировок)
+ *
+ * observe() — линейный поиск корзины + один fetch_add; кумулятивные
+ * значения (как требует Prometheus) считаются только при экспорте.
+ */
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds)
+        : bounds_(std::move(bounds)),
+          buckets_(std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1)) {
+        for (size_t i = 0; i <= bounds_.size(); ++i) {
+            buckets_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void observe(double v) {
+        size_t i = 0;
+        while (i < bounds_.size() && v > bounds_[i]) {
+            ++i;
+        }
+        buckets_[i].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(v, std::memory_order_relaxed);
+    }
+
+    const std::vector<double>& bounds() const { return bounds_; }
+    uint64_t bucketCount(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double sum() const { return sum_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Границы по умолчанию для задержек шагов (секунды, 100 мкс .. 10 с)
+     */
+    static std::vector<double> latencyBounds() {
+        return {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+    }
+
+private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;  // bounds_.size() + 1 (последняя = +Inf)
+    std::atomic<uint64_t> count_{0};
+    std::atomic<double> sum_{0.0};
+};
+
+/**
+ * @class MetricsRegistry
+ * @brief Реестр метрик с экспортом в текстовый формат Prometheus
+ *
+ * Регистрация (под mutex) выполняется один раз при настройке; горячий путь
+ * работает только с возвращёнными ссылками (атомарные операции, без блокировок).
+ * Ссылки остаются валидными всё время жизни реестра.
+ *
+ * Пример:
+ * @code
+ * auto metrics = std::make_shared<MetricsRegistry>();
+ * Counter& batches = metrics->counter("correlator_batches_total", "Обработанные батчи");
+ * Histogram& latency = metrics->histogram("correlator_step_seconds", "Задержка шага",
+ *                                         Histogram::latencyBounds(), "step=\"Step1\"");
+ * batches.inc();
+ * latency.observe(0.0042);
+ * std::string text = metrics->renderPrometheus();
+ * @endcode
+ */
+class MetricsRegistry {
+public:
+    /**
+     * @param labels Готовая строка меток без фигурных скобок, например step="Step1"
+     */
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Series& series = find_or_add(name, help, "counter", labels);
+        if (!series.counter) series.counter = std::make_unique<Counter>();
+        return *series.counter;
+    }
+
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Series& series = find_or_add(name, help, "gauge", labels);
+        if (!series.gauge) series.gauge = std::make_unique<Gauge>();
+        return *series.gauge;
+    }
+
+    Histogram& histogram(const std::string& name, const std::string& help,
+                         const std::vector<double>& bounds, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Series& series = find_or_add(name, help, "histogram", labels);
+        if (!series.histogram) series.histogram = std::make_unique<Histogram>(bounds);
+        return *series.histogram;
+    }
+
+    /**
+     * @brief Текстовый формат Prometheus (exposition format 0.0.4)
+     */
+    std::string renderPrometheus() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ostringstream out;
+
+        for (const auto& family : families_) {
+            out << "# HELP " << family.name << " " << family.help << "\n";
+            out << "# TYPE " << family.name << " " << family.type << "\n";
+
+            for (const auto& series : family.series) {
+                if (series.counter) {
+                    out << family.name << braces(series.labels) << " " << series.counter->value() << "\n";
+                } else if (series.gauge) {
+                    out << family.name << braces(series.labels) << " " << format_double(series.gauge->value()) << "\n";
+                } else if (series.histogram) {
+                    const Histogram& h = *series.histogram;
+                    uint64_t cumulative = 0;
+                    for (size_t i = 0; i < h.bounds().size(); ++i) {
+                        cumulative += h.bucketCount(i);
+                        out << family.name << "_bucket"
+                            << braces(join_labels(series.labels, "le=\"" + format_double(h.bounds()[i]) + "\""))
+                            << " " << cumulative << "\n";
+                    }
+                    cumulative += h.bucketCount(h.bounds().size());
+                    out << family.name << "_bucket" << braces(join_labels(series.labels, "le=\"+Inf\""))
+                        << " " << cumulative << "\n";
+                    out << family.name << "_sum" << braces(series.labels) << " " << format_double(h.sum()) << "\n";
+                    out << family.name << "_count" << braces(series.labels) << " " << h.count() << "\n";
+                }
+            }
+        }
+        return out.str();
+    }
+
+private:
+    struct Series {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    struct Family {
+        std::string name;
+        std::string help;
+        std::string type;
+        std::vector<Series> series;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Family> families_;     // Порядок регистрации = порядок экспорта
+
+    Series& find_or_add(const std::string& name, const std::string& help,
+                        const std::string& type, const std::string& labels) {
+        Family* family = nullptr;
+        for (auto& f : families_) {
+            if (f.name == name) {
+                family = &f;
+                break;
+            }
+        }
+        if (!family) {
+            families_.push_back(Family{name, help, type, {}});
+            family = &families_.back();
+        } else if (family->type != type) {
+            throw std::invalid_argument("Metric " + name + " already registered as " + family->type);
+        }
+
+        for (auto& s : family->series) {
+            if (s.labels == labels) return s;
+        }
+        family->series.push_back(Series{labels, nullptr, nullptr, nullptr});
+        return family->series.back();
+    }
+
+    static std::string braces(const std::string& labels) {
+        return labels.empty() ? "" : "{" + labels + "}";
+    }
+
+    static std::string join_labels(const std::string& a, const std::string& b) {
+        return a.empty() ? b : a + "," + b;
+    }
+
+    static std::string format_double(double v) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%.9g", v);
+        return buf;
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_METRICS_REGISTRY_HPP
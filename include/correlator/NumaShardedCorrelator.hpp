@@ -0,0 +1,573 @@
+#ifndef CORRELATOR_NUMA_SHARDED_CORRELATOR_HPP
+#define CORRELATOR_NUMA_SHARDED_CORRELATOR_HPP
+
+#include "IConfiguration.hpp"
+#include "IFFTBackend.hpp"
+#include "PeaksView.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <new>
+#include <sched.h>
+#include <signal.h>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// NUMA топология
+// ============================================================================
+
+struct NumaNode {
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+/**
+ * @brief Разобрать список CPU в формате sysfs ("0-7,16-23")
+ */
+inline std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string range = list.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (...) {
+            // Пустой или повреждённый фрагмент (перевод строки в конце файла)
+        }
+    }
+    return cpus;
+}
+
+/**
+ * @brief Узлы NUMA из /sys/devices/system/node (без libnuma)
+ *
+ * На машине без NUMA (или без sysfs) возвращается один узел со всеми CPU.
+ */
+inline std::vector<NumaNode> detectNumaNodes() {
+    std::vector<NumaNode> nodes;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+            !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+            continue;
+        }
+        std::ifstream file(entry.path() / "cpulist");
+        std::string list;
+        std::getline(file, list);
+        NumaNode node{std::stoi(name.substr(4)), parseCpuList(list)};
+        if (!node.cpus.empty()) {  // Узлы только с памятью (CXL, HBM) пропускаются
+            nodes.push_back(std::move(node));
+        }
+    }
+    std::sort(nodes.begin(), nodes.end(), [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+
+    if (nodes.empty()) {
+        NumaNode node;
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < std::max(1L, count); ++cpu) {
+            node.cpus.push_back(cpu);
+        }
+        nodes.push_back(std::move(node));
+    }
+    return nodes;
+}
+
+/**
+ * @brief Закрепить текущий процесс за CPU узла и выделять память только на нём
+ * @param bind_memory false — только affinity (политика памяти по умолчанию)
+ */
+inline bool bindToNumaNode(const NumaNode& node, bool bind_memory) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : node.cpus) {
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    bool ok = sched_setaffinity(0, sizeof(set), &set) == 0;
+    if (!ok) {
+        fprintf(stderr, "[NUMA] sched_setaffinity(node %d) failed: %s\n", node.id, strerror(errno));
+    }
+
+#if defined(SYS_set_mempolicy)
+    if (bind_memory) {
+        constexpr int kMpolBind = 2;  // MPOL_BIND из <linux/mempolicy.h>
+        constexpr size_t kBits = sizeof(unsigned long) * 8;
+        std::vector<unsigned long> mask(static_cast<size_t>(node.id) / kBits + 1, 0);
+        mask[node.id / kBits] |= 1UL << (node.id % kBits);
+        if (syscall(SYS_set_mempolicy, kMpolBind, mask.data(), mask.size() * kBits + 1) != 0) {
+            // Ядро без NUMA: ENOSYS/EINVAL — работаем с политикой по умолчанию
+            fprintf(stderr, "[NUMA] set_mempolicy(node %d) failed: %s\n", node.id, strerror(errno));
+        }
+    }
+#else
+    (void)bind_memory;
+#endif
+    return ok;
+}
+
+// ============================================================================
+// Разделяемая память
+// ============================================================================
+
+/**
+ * Задание воркеру: сигналы [first_signal, first_signal + count) батча.
+ * count = 0 — команда завершения.
+ */
+struct ShardTask {
+    uint32_t batch = 0;
+    uint32_t first_signal = 0;
+    uint32_t count = 0;
+    uint32_t reserved = 0;
+};
+
+/**
+ * @struct ShardRing
+ * @brief SPSC кольцо заданий в разделяемой памяти (координатор → один воркер)
+ *
+ * Атомики lock-free, поэтому корректны между процессами в MAP_SHARED.
+ */
+struct ShardRing {
+    static constexpr uint32_t kCapacity = 256;
+
+    alignas(64) std::atomic<uint32_t> head{0};  // Пишет координатор
+    alignas(64) std::atomic<uint32_t> tail{0};  // Пишет воркер
+    ShardTask tasks[kCapacity];
+
+    bool push(const ShardTask& task) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= kCapacity) {
+            return false;
+        }
+        tasks[h % kCapacity] = task;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(ShardTask& task) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        task = tasks[t % kCapacity];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "ShardRing requires lock-free atomics");
+
+/**
+ * Управляющий блок в начале разделяемой области.
+ */
+struct ShardControl {
+    alignas(64) std::atomic<uint32_t> ready_workers{0};
+    std::atomic<uint32_t> failed_workers{0};
+    alignas(64) std::atomic<uint32_t> completed_shards{0};
+    std::atomic<uint32_t> failed_shards{0};
+};
+
+// ============================================================================
+// NumaShardedCorrelator
+// ============================================================================
+
+struct NumaShardingOptions {
+    int workers_per_node = 1;     // Процессов на узел (например, по числу GPU узла)
+    int max_nodes = 0;            // 0 = все узлы
+    int shard_signals = 0;        // Сигналов в задании (0 = поровну между воркерами)
+    bool bind_memory = true;      // MPOL_BIND на узел воркера
+};
+
+/**
+ * Фабрика бэкенда воркера. Вызывается в дочернем процессе после
+ * закрепления за узлом, поэтому контекст OpenCL и все буферы хоста
+ * создаются в памяти узла. batch_signals — размер батча плана FFT.
+ */
+using ShardBackendFactory =
+    std::function<std::unique_ptr<IFFTBackend>(int worker, const NumaNode& node, int batch_signals)>;
+
+/**
+ * @class NumaShardedCorrelator
+ * @brief Локальный многопроцессный режим: один процесс-воркер на NUMA узел
+ *
+ * Координатор (вызывающий процесс) выделяет одну анонимную MAP_SHARED
+ * область и делает fork() воркеров. Каждый воркер закрепляется за CPU
+ * своего узла, включает MPOL_BIND, создаёт собственный бэкенд, выполняет
+ * Step 1 для опорного сигнала и ждёт задания в своём кольце.
+ *
+ * process(): входные сигналы копируются в разделяемую область, шарды
+ * раздаются по кольцам воркеров по кругу; воркер копирует свои сигналы
+ * в локальную память узла, выполняет Step 2 + Step 3 и скачивает пики
+ * прямо в свою часть общего буфера результатов [signals][shifts][n_kg].
+ *
+ * Ограничения:
+ * - start() вызывается до любой инициализации OpenCL в координаторе
+ *   и до запуска фоновых потоков (fork копирует только вызывающий поток);
+ * - пики передаются в Float32 (кодирование пиков воркерами не применяется).
+ *
+ * Пример:
+ * @code
+ * NumaShardedCorrelator sharded(*config, [&](int worker, const NumaNode&, int batch) {
+ *     auto backend = std::make_unique<OpenCLFFTBackend>();
+ *     backend->setDeviceIndex(worker);
+ *     backend->setConfiguration(N, shifts, batch, n_kg, scale);
+ *     return std::unique_ptr<IFFTBackend>(std::move(backend));
+ * });
+ * sharded.start(reference_signal);
+ * sharded.process(input_signals);
+ * float p = peakAt(sharded.getPeaksView(), signal, shift, k);
+ * @endcode
+ */
+class NumaShardedCorrelator {
+public:
+    NumaShardedCorrelator(const IConfiguration& config, ShardBackendFactory factory,
+                          NumaShardingOptions options = {})
+        : factory_(std::move(factory)), options_(options),
+          fft_size_(config.getFFTSize()), num_shifts_(config.getNumShifts()),
+          num_signals_(config.getNumSignals()), n_kg_(config.getNumOutputPoints()) {
+        nodes_ = detectNumaNodes();
+        if (options_.max_nodes > 0 && static_cast<int>(nodes_.size()) > options_.max_nodes) {
+            nodes_.resize(options_.max_nodes);
+        }
+        int workers = static_cast<int>(nodes_.size()) * std::max(1, options_.workers_per_node);
+        workers = std::min(workers, num_signals_);
+        for (int w = 0; w < workers; ++w) {
+            worker_nodes_.push_back(w % static_cast<int>(nodes_.size()));
+        }
+        shard_signals_ = options_.shard_signals > 0
+            ? std::min(options_.shard_signals, num_signals_)
+            : (num_signals_ + workers - 1) / workers;
+    }
+
+    ~NumaShardedCorrelator() {
+        stop();
+    }
+
+    NumaShardedCorrelator(const NumaShardedCorrelator&) = delete;
+    NumaShardedCorrelator& operator=(const NumaShardedCorrelator&) = delete;
+
+    /**
+     * @brief Выделить разделяемую память, запустить воркеров и выполнить Step 1
+     */
+    bool start(const std::vector<int32_t>& reference_signal) {
+        if (!pids_.empty() || reference_signal.size() < fft_size_) {
+            return false;
+        }
+        if (!allocate_shared()) {
+            return false;
+        }
+        std::copy_n(reference_signal.begin(), fft_size_, reference_);
+
+        parent_pid_ = getpid();
+        for (int w = 0; w < workerCount(); ++w) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                fprintf(stderr, "[NUMA] fork failed: %s\n", strerror(errno));
+                stop();
+                return false;
+            }
+            if (pid == 0) {
+                // Воркер не переживает родителя (SIGTERM при его смерти; если
+                // родитель умер до prctl — getppid уже не совпадает)
+                prctl(PR_SET_PDEATHSIG, SIGTERM);
+                if (getppid() != parent_pid_) {
+                    _exit(1);
+                }
+                // Исключение не должно раскрутить копию стека родителя
+                int code = 1;
+                try {
+                    code = worker_main(w);
+                } catch (const std::exception& e) {
+                    fprintf(stderr, "[NUMA] worker %d: %s\n", w, e.what());
+                } catch (...) {
+                    fprintf(stderr, "[NUMA] worker %d: unknown exception\n", w);
+                }
+                _exit(code);
+            }
+            pids_.push_back(pid);
+        }
+
+        // Ждать готовности всех воркеров (Step 1 выполнен)
+        while (control_->ready_workers.load(std::memory_order_acquire) +
+               control_->failed_workers.load(std::memory_order_acquire) < pids_.size()) {
+            if (!workers_alive()) break;
+            backoff();
+        }
+        if (control_->failed_workers.load() != 0 ||
+            control_->ready_workers.load() != pids_.size()) {
+            fprintf(stderr, "[NUMA] %u of %zu workers failed to start\n",
+                    control_->failed_workers.load(), pids_.size());
+            stop();
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Step 2 + Step 3 для батча num_signals × fft_size
+     * @return false при ошибке любого шарда или падении воркера
+     */
+    bool process(const std::vector<int32_t>& input_signals) {
+        if (pids_.empty() || input_signals.size() < fft_size_ * num_signals_) {
+            return false;
+        }
+        if (!workers_alive()) {
+            fprintf(stderr, "[NUMA] a worker has exited; restart the correlator\n");
+            return false;
+        }
+        std::copy_n(input_signals.begin(), fft_size_ * num_signals_, input_);
+
+        ++batch_;
+        control_->completed_shards.store(0, std::memory_order_relaxed);
+        control_->failed_shards.store(0, std::memory_order_relaxed);
+
+        uint32_t shards = 0;
+        for (int first = 0; first < num_signals_; first += shard_signals_, ++shards) {
+            ShardTask task;
+            task.batch = batch_;
+            task.first_signal = static_cast<uint32_t>(first);
+            task.count = static_cast<uint32_t>(std::min(shard_signals_, num_signals_ - first));
+            ShardRing& ring = rings_[shards % pids_.size()];
+            while (!ring.push(task)) {
+                if (!workers_alive()) return false;
+                backoff();
+            }
+        }
+
+        while (control_->completed_shards.load(std::memory_order_acquire) < shards) {
+            if (!workers_alive()) {
+                fprintf(stderr, "[NUMA] worker exited during batch %u\n", batch_);
+                return false;
+            }
+            backoff();
+        }
+        return control_->failed_shards.load() == 0;
+    }
+
+    /**
+     * @brief Остановить воркеров и освободить разделяемую память
+     */
+    void stop() {
+        for (size_t w = 0; w < pids_.size(); ++w) {
+            ShardTask quit;  // count = 0
+            for (int attempt = 0; attempt < 1000 && !rings_[w].push(quit); ++attempt) {
+                backoff();
+            }
+        }
+        for (pid_t pid : pids_) {
+            if (pid <= 0) {
+                continue;  // Уже снят workers_alive
+            }
+            int status = 0;
+            for (int attempt = 0; attempt < 2000; ++attempt) {  // До ~2 с на корректное завершение
+                if (waitpid(pid, &status, WNOHANG) != 0) break;
+                backoff(1000000);
+                if (attempt == 1999) {
+                    kill(pid, SIGKILL);
+                    waitpid(pid, &status, 0);
+                }
+            }
+        }
+        pids_.clear();
+        dead_ = false;
+
+        if (shared_) {
+            munmap(shared_, shared_size_);
+            shared_ = nullptr;
+            shared_size_ = 0;
+        }
+    }
+
+    /**
+     * @brief Пики последнего process() (в разделяемой памяти, до stop())
+     */
+    ConstPeaksView getPeaksView() const {
+        return ConstPeaksView(result_, PeaksExtents<>(shared_ ? num_signals_ : 0, num_shifts_, n_kg_));
+    }
+
+    std::span<const float> peaks() const {
+        return {result_, shared_ ? static_cast<size_t>(num_signals_) * num_shifts_ * n_kg_ : 0};
+    }
+
+    int workerCount() const { return static_cast<int>(worker_nodes_.size()); }
+    int shardSignals() const { return shard_signals_; }
+    const std::vector<NumaNode>& nodes() const { return nodes_; }
+    const NumaNode& workerNode(int worker) const { return nodes_[worker_nodes_[worker]]; }
+
+private:
+    ShardBackendFactory factory_;
+    NumaShardingOptions options_;
+    size_t fft_size_;
+    int num_shifts_;
+    int num_signals_;
+    int n_kg_;
+    int shard_signals_ = 1;
+
+    std::vector<NumaNode> nodes_;
+    std::vector<int> worker_nodes_;  // Воркер → индекс в nodes_
+    std::vector<pid_t> pids_;        // −1 — воркер завершился и снят waitpid
+    bool dead_ = false;              // Хотя бы один воркер завершился
+    pid_t parent_pid_ = 0;
+    uint32_t batch_ = 0;
+
+    // Разделяемая область: [control][rings][reference][input][result]
+    void* shared_ = nullptr;
+    size_t shared_size_ = 0;
+    ShardControl* control_ = nullptr;
+    ShardRing* rings_ = nullptr;
+    int32_t* reference_ = nullptr;
+    int32_t* input_ = nullptr;
+    float* result_ = nullptr;
+
+    static size_t align_up(size_t size) {
+        constexpr size_t kAlign = 4096;
+        return (size + kAlign - 1) / kAlign * kAlign;
+    }
+
+    static void backoff(long nanoseconds = 20000) {
+        timespec pause{0, nanoseconds};
+        nanosleep(&pause, nullptr);
+    }
+
+    bool allocate_shared() {
+        size_t control_bytes = align_up(sizeof(ShardControl) + sizeof(ShardRing) * static_cast<size_t>(workerCount()));
+        size_t reference_bytes = align_up(fft_size_ * sizeof(int32_t));
+        size_t input_bytes = align_up(fft_size_ * num_signals_ * sizeof(int32_t));
+        size_t result_bytes = align_up(static_cast<size_t>(num_signals_) * num_shifts_ * n_kg_ * sizeof(float));
+        shared_size_ = control_bytes + reference_bytes + input_bytes + result_bytes;
+
+        shared_ = mmap(nullptr, shared_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (shared_ == MAP_FAILED) {
+            fprintf(stderr, "[NUMA] mmap(%zu bytes) failed: %s\n", shared_size_, strerror(errno));
+            shared_ = nullptr;
+            shared_size_ = 0;
+            return false;
+        }
+
+        uint8_t* base = static_cast<uint8_t*>(shared_);
+        control_ = new (base) ShardControl();
+        rings_ = reinterpret_cast<ShardRing*>(base + sizeof(ShardControl));
+        for (size_t w = 0; w < static_cast<size_t>(workerCount()); ++w) {
+            new (&rings_[w]) ShardRing();
+        }
+        reference_ = reinterpret_cast<int32_t*>(base + control_bytes);
+        input_ = reinterpret_cast<int32_t*>(base + control_bytes + reference_bytes);
+        result_ = reinterpret_cast<float*>(base + control_bytes + reference_bytes + input_bytes);
+        return true;
+    }
+
+    // Воркер, однажды замеченный мёртвым, остаётся мёртвым: его pid снят
+    // waitpid (−1 в pids_), повторный waitpid дал бы ECHILD
+    bool workers_alive() {
+        for (pid_t& pid : pids_) {
+            if (pid <= 0) {
+                continue;
+            }
+            int status = 0;
+            const pid_t result = waitpid(pid, &status, WNOHANG);
+            if (result == pid || (result < 0 && errno == ECHILD)) {
+                pid = -1;
+                dead_ = true;
+            }
+        }
+        return !dead_;
+    }
+
+    // ========================================================================
+    // Дочерний процесс
+    // ========================================================================
+
+    int worker_main(int worker) {
+        const NumaNode& node = workerNode(worker);
+        bindToNumaNode(node, options_.bind_memory);
+
+        std::unique_ptr<IFFTBackend> backend;
+        try {
+            backend = factory_(worker, node, shard_signals_);
+        } catch (...) {
+            backend.reset();
+        }
+
+        // Копии в памяти узла (после MPOL_BIND)
+        std::vector<int32_t> reference(reference_, reference_ + fft_size_);
+        std::vector<int32_t> shard_input(fft_size_ * shard_signals_, 0);
+        PeaksBuffer partial(shard_signals_, num_shifts_, n_kg_);
+
+        OperationTiming t0, t1, t2;
+        if (!backend || !backend->initialize() ||
+            !backend->step1_ProcessReferenceSignals(reference, num_shifts_, t0, t1)) {
+            fprintf(stderr, "[NUMA] worker %d (node %d): backend initialization failed\n", worker, node.id);
+            control_->failed_workers.fetch_add(1, std::memory_order_release);
+            return 1;
+        }
+        control_->ready_workers.fetch_add(1, std::memory_order_release);
+
+        ShardRing& ring = rings_[worker];
+        ShardTask task;
+        for (;;) {
+            if (!ring.pop(task)) {
+                if (getppid() != parent_pid_) {
+                    return 1;  // Родитель умер, задач больше не будет
+                }
+                backoff();
+                continue;
+            }
+            if (task.count == 0) {
+                break;
+            }
+
+            const int32_t* source = input_ + fft_size_ * task.first_signal;
+            std::copy_n(source, fft_size_ * task.count, shard_input.begin());
+            std::fill(shard_input.begin() + fft_size_ * task.count, shard_input.end(), 0);  // Хвостовой шард
+
+            size_t row = static_cast<size_t>(num_shifts_) * n_kg_;
+            std::span<float> target(result_ + row * task.first_signal, row * task.count);
+            bool ok = backend->step2_ProcessInputSignals(shard_input, shard_signals_, t0, t1) &&
+                      backend->step3_ComputeCorrelation(shard_signals_, num_shifts_, n_kg_, t0, t1, t2);
+            if (ok && static_cast<int>(task.count) == shard_signals_) {
+                ok = backend->readCorrelationPeaks(target);  // Прямо в общий буфер
+            } else if (ok) {
+                ok = backend->readCorrelationPeaks(partial.span());
+                std::copy_n(partial.span().begin(), target.size(), target.begin());
+            }
+
+            if (!ok) {
+                control_->failed_shards.fetch_add(1, std::memory_order_relaxed);
+            }
+            control_->completed_shards.fetch_add(1, std::memory_order_release);
+        }
+
+        backend->cleanup();
+        return 0;
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_NUMA_SHARDED_CORRELATOR_HPP
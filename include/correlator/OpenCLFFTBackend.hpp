@@ -2,11 +2,14 @@
 #define CORRELATOR_OPENCL_FFT_BACKEND_HPP
 
 #include "IFFTBackend.hpp"
+#include "TuningCache.hpp"
 #include "../../include/fft_handler.hpp"
 #include <CL/opencl.h>
 #include <memory>
 #include <vector>
 #include <stdexcept>
+#include <chrono>
+#include <cstring>
 
 namespace Correlator {
 
@@ -16,8 +19,15 @@ namespace Correlator {
  * 
  * Адаптер над существующим FFTHandler, реализующий интерфейс IFFTBackend.
  * Позволяет использовать существующий код в новой архитектуре.
+ *
+ * Класс final: при вызове через конкретный тип (StaticCorrelationPipeline)
+ * компилятор девиртуализирует вызовы. Перегрузки step1/step2 с указателем
+ * и размером позволяют передавать данные без копирования в std::vector.
  */
-class OpenCLFFTBackend : public IFFTBackend {
+// Спектры передаются в FFTHandler без конвертации (loadReferenceSpectra/loadInputSpectra)
+static_assert(sizeof(ComplexFloat) == sizeof(cl_float2), "ComplexFloat must match cl_float2 layout");
+
+class OpenCLFFTBackend final : public IFFTBackend {
 private:
     std::unique_ptr<FFTHandler> fft_handler_;
     cl_context context_;
@@ -31,12 +41,37 @@ private:
     int num_signals_;
     int n_kg_;
     float scale_factor_;
+    int device_index_ = 0;  // Номер GPU платформы (по модулю числа устройств)
+
+    // Автотюнинг Step 2 при initialize() (результат кэшируется по хосту/устройству/форме)
+    bool autotune_ = false;
+    std::string tuning_cache_path_;
+    Step2PlanTuning step2_tuning_;
+
+    // Слитый Step 2+3 в локальной памяти (N — степень двойки ≤ 4096)
+    bool fused_ = false;
+
+    // Настройки из checkpoint: применяются в initialize() вместо fused_/автотюнинга
+    bool has_saved_tuning_ = false;
+    BackendTuning saved_tuning_;
 
     // Внутренние буферы для хранения результатов
     mutable std::vector<ComplexFloat> reference_fft_cache_;
     mutable std::vector<ComplexFloat> input_fft_cache_;
     mutable std::vector<float> peaks_cache_;
 
+    // Кодировка пиков Step 3 (передаётся в FFTHandler)
+    PeaksEncodingParams peaks_encoding_;
+
+    // Разбивка времени initialize() по фазам
+    std::vector<InitPhaseTiming> init_timings_;
+
+    // 2D корреляция: форма шаблонов на устройстве и записи максимумов последнего вызова
+    int templates_2d_ = 0;
+    size_t height_2d_ = 0;
+    size_t width_2d_ = 0;
+    std::vector<float> records_2d_;
+
     // Конвертация cl_float2 в ComplexFloat
     ComplexFloat toComplexFloat(const cl_float2& val) const {
         return ComplexFloat(val.s[0], val.s[1]);
@@ -50,6 +85,61 @@ private:
         return result;
     }
 
+    /**
+     * Взять конфигурацию Step 2 из кэша или откалибровать и сохранить.
+     * Ошибка калибровки не фатальна: остаётся план по умолчанию
+     */
+    void apply_autotune() {
+        TuningCache cache(tuning_cache_path_.empty() ? TuningCache::defaultPath() : tuning_cache_path_);
+        const std::string key = TuningCache::makeKey(getDeviceName(), getDriverVersion(),
+                                                     fft_size_, num_signals_, num_shifts_, n_kg_);
+        Step2TuningResult cached;
+        try {
+            if (cache.lookup(key, cached)) {
+                printf("[TUNE] Cached Step 2 tuning (%s): %s, split %d\n", cache.path().c_str(),
+                       Step2PlanTuning::pathName(cached.tuning.path), cached.tuning.split);
+                fft_handler_->apply_step2_tuning(cached.tuning);
+            } else {
+                std::vector<Step2TuningResult> results;
+                Step2TuningResult best;
+                best.tuning = fft_handler_->autotune_step2(5, &results);
+                for (const auto& result : results) {
+                    if (result.tuning.path == best.tuning.path && result.tuning.split == best.tuning.split) {
+                        best.time_ms = result.time_ms;
+                    }
+                }
+                if (!results.empty() && !cache.store(key, best)) {
+                    printf("[WARNING] Failed to write tuning cache %s\n", cache.path().c_str());
+                }
+            }
+        } catch (const std::exception& e) {
+            printf("[WARNING] Step 2 autotune failed, using default plan: %s\n", e.what());
+        }
+        step2_tuning_ = fft_handler_->getStep2Tuning();
+    }
+
+    // Устройство и драйвер в формате BackendTuning::device
+    void fill_tuning_device(BackendTuning& tuning) const {
+        const std::string device = getDeviceName() + " | " + getDriverVersion();
+        std::memset(tuning.device, 0, sizeof(tuning.device));
+        std::strncpy(tuning.device, device.c_str(), sizeof(tuning.device) - 1);
+    }
+
+    bool tuning_matches_device(const BackendTuning& tuning) const {
+        BackendTuning current;
+        fill_tuning_device(current);
+        return std::strncmp(current.device, tuning.device, sizeof(tuning.device)) == 0;
+    }
+
+    void apply_saved_step2_tuning(const BackendTuning& tuning) {
+        Step2PlanTuning step2;
+        step2.path = tuning.step2_path == Step2PlanTuning::Converter ? Step2PlanTuning::Converter
+                                                                     : Step2PlanTuning::Callback;
+        step2.split = tuning.step2_split;
+        fft_handler_->apply_step2_tuning(step2);
+        step2_tuning_ = fft_handler_->getStep2Tuning();
+    }
+
 public:
     OpenCLFFTBackend() 
         : initialized_(false), context_(nullptr), queue_(nullptr), device_(nullptr),
@@ -69,11 +159,101 @@ public:
         scale_factor_ = scale_factor;
     }
 
+    /**
+     * @brief Выбрать GPU по номеру (например, ближайший к NUMA узлу воркера)
+     */
+    void setDeviceIndex(int device_index) {
+        if (initialized_) {
+            throw std::runtime_error("Cannot change device after initialization");
+        }
+        device_index_ = device_index;
+    }
+
+    /**
+     * @brief Включить калибровку Step 2 (путь конвертации, деление батча) при initialize()
+     * @param cache_path Файл кэша (пусто — TuningCache::defaultPath())
+     */
+    void setAutotune(bool enabled, const std::string& cache_path = "") {
+        if (initialized_) {
+            throw std::runtime_error("Cannot change autotune after initialization");
+        }
+        autotune_ = enabled;
+        tuning_cache_path_ = cache_path;
+    }
+
+    /**
+     * @brief Слитый Step 2+3 одним kernel'ом на батч (см. FFTHandler::enable_fused_correlation)
+     *
+     * Если форма или устройство не подходят, initialize() остаётся на пути clFFT;
+     * isFusedCorrelation() после initialize() показывает выбранный путь.
+     */
+    void setFusedCorrelation(bool enabled) {
+        if (initialized_) {
+            throw std::runtime_error("Cannot change fused correlation after initialization");
+        }
+        fused_ = enabled;
+    }
+
+    bool isFusedCorrelation() const {
+        return fft_handler_ && fft_handler_->isFusedCorrelationEnabled();
+    }
+
+    /**
+     * @brief Конфигурация Step 2 после initialize() (по умолчанию callback, без деления)
+     */
+    const Step2PlanTuning& getStep2Tuning() const { return step2_tuning_; }
+
+    bool getTuning(BackendTuning& tuning) const override {
+        if (!isInitialized()) {
+            return false;
+        }
+        tuning = BackendTuning{};
+        tuning.step2_path = static_cast<uint8_t>(step2_tuning_.path);
+        tuning.step2_split = step2_tuning_.split;
+        tuning.fused = isFusedCorrelation() ? 1 : 0;
+        fill_tuning_device(tuning);
+        return true;
+    }
+
+    bool setTuning(const BackendTuning& tuning) override {
+        if (!initialized_) {
+            saved_tuning_ = tuning;
+            has_saved_tuning_ = true;
+            return true;
+        }
+        if (!tuning_matches_device(tuning)) {
+            return false;
+        }
+
+        try {
+            if (tuning.fused && !fft_handler_->enable_fused_correlation()) {
+                return false;
+            }
+            if (!tuning.fused) {
+                fft_handler_->disable_fused_correlation();
+            }
+            apply_saved_step2_tuning(tuning);
+            input_fft_cache_.clear();
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
     bool initialize() override {
         if (initialized_) {
             return true;
         }
 
+        // Замер фаз инициализации (host-время от конца предыдущей фазы)
+        init_timings_.clear();
+        auto phase_start = std::chrono::high_resolution_clock::now();
+        auto record_phase = [&](const char* phase) {
+            auto now = std::chrono::high_resolution_clock::now();
+            init_timings_.push_back({phase, std::chrono::duration<double, std::milli>(now - phase_start).count()});
+            phase_start = now;
+        };
+
         try {
             // Инициализировать OpenCL контекст
             cl_int err = CL_SUCCESS;
@@ -84,18 +264,28 @@ public:
             if (err != CL_SUCCESS) {
                 return false;
             }
+            record_phase("clGetPlatformIDs");
             
             // Получить устройство
-            err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device_, nullptr);
+            cl_uint num_devices = 0;
+            err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 0, nullptr, &num_devices);
+            if (err != CL_SUCCESS || num_devices == 0) {
+                return false;
+            }
+            std::vector<cl_device_id> devices(num_devices);
+            err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, num_devices, devices.data(), nullptr);
             if (err != CL_SUCCESS) {
                 return false;
             }
+            device_ = devices[static_cast<cl_uint>(device_index_ < 0 ? 0 : device_index_) % num_devices];
+            record_phase("clGetDeviceIDs");
             
             // Создать контекст
             context_ = clCreateContext(nullptr, 1, &device_, nullptr, nullptr, &err);
             if (err != CL_SUCCESS || !context_) {
                 return false;
             }
+            record_phase("clCreateContext");
             
             // Создать очередь команд
             queue_ = clCreateCommandQueue(context_, device_, CL_QUEUE_PROFILING_ENABLE, &err);
@@ -103,13 +293,47 @@ public:
                 clReleaseContext(context_);
                 return false;
             }
+            record_phase("clCreateCommandQueue");
             
             // Создать FFTHandler
             fft_handler_ = std::make_unique<FFTHandler>(context_, queue_, device_);
+            fft_handler_->setPeaksEncoding(peaks_encoding_);
             
             // Инициализировать FFTHandler (создать буферы и планы)
             fft_handler_->initialize(fft_size_, num_shifts_, num_signals_, n_kg_, scale_factor_);
             
+            // Фазы FFTHandler (буферы, планы, userdata) идут после фаз контекста
+            for (const auto& handler_phase : fft_handler_->getInitTimings()) {
+                init_timings_.push_back({handler_phase.phase, handler_phase.time_ms});
+            }
+            
+            // Настройки checkpoint подходят только тому же устройству и драйверу
+            const bool use_saved = has_saved_tuning_ && tuning_matches_device(saved_tuning_);
+            if (has_saved_tuning_ && !use_saved) {
+                printf("[TUNE] Saved tuning is for '%s', tuning for this device\n", saved_tuning_.device);
+            }
+            has_saved_tuning_ = false;
+
+            if (use_saved ? saved_tuning_.fused != 0 : fused_) {
+                phase_start = std::chrono::high_resolution_clock::now();
+                fft_handler_->enable_fused_correlation();
+                record_phase("Fused Step 2+3");
+            }
+            
+            if (use_saved) {
+                phase_start = std::chrono::high_resolution_clock::now();
+                try {
+                    apply_saved_step2_tuning(saved_tuning_);
+                } catch (const std::exception& e) {
+                    printf("[WARNING] Saved Step 2 tuning not applied: %s\n", e.what());
+                }
+                record_phase("Saved Step 2 tuning");
+            } else if (autotune_) {
+                phase_start = std::chrono::high_resolution_clock::now();
+                apply_autotune();
+                record_phase("Autotune Step 2");
+            }
+            
             initialized_ = true;
             return true;
         } catch (...) {
@@ -123,6 +347,7 @@ public:
             fft_handler_->cleanup();
             fft_handler_.reset();
         }
+        templates_2d_ = 0;
         if (queue_) {
             clReleaseCommandQueue(queue_);
             queue_ = nullptr;
@@ -139,6 +364,39 @@ public:
         return initialized_ && fft_handler_ != nullptr;
     }
 
+    bool getInitTimings(std::vector<InitPhaseTiming>& output) const override {
+        output = init_timings_;
+        return !output.empty();
+    }
+
+    bool getBuildTimings(std::vector<BuildPhaseTiming>& output) const override {
+        output.clear();
+        if (!fft_handler_) {
+            return false;
+        }
+        for (const auto& build : fft_handler_->getBuildTimings()) {
+            output.push_back({build.step, build.phase, build.time_ms});
+        }
+        return !output.empty();
+    }
+
+    bool getDeviceMemoryUsage(std::vector<DeviceMemoryStep>& steps,
+                              size_t& current_bytes, size_t& high_water_bytes) const override {
+        steps.clear();
+        current_bytes = 0;
+        high_water_bytes = 0;
+        if (!fft_handler_) {
+            return false;
+        }
+        const CLResourceTracker& resources = fft_handler_->getResourceTracker();
+        for (const auto& step : resources.getStepMemory()) {
+            steps.push_back({step.step, step.high_water_bytes, step.allocated_bytes, step.released_bytes});
+        }
+        current_bytes = resources.currentBytes();
+        high_water_bytes = resources.highWaterBytes();
+        return true;
+    }
+
     bool createReferenceFFTPlan(size_t fft_size, int batch_size, float scale_factor) override {
         if (!isInitialized()) {
             return false;
@@ -169,6 +427,17 @@ public:
         OperationTiming& upload_timing,
         OperationTiming& fft_timing
     ) override {
+        return step1_ProcessReferenceSignals(reference_signal.data(), reference_signal.size(),
+                                             num_shifts, upload_timing, fft_timing);
+    }
+
+    bool step1_ProcessReferenceSignals(
+        const int32_t* reference_signal,
+        size_t signal_size,
+        int num_shifts,
+        OperationTiming& upload_timing,
+        OperationTiming& fft_timing
+    ) {
         if (!isInitialized()) {
             return false;
         }
@@ -183,8 +452,8 @@ public:
             
             double time_callback = 0.0;
             fft_handler_->step1_reference_signals(
-                reference_signal.data(),
-                reference_signal.size(),
+                reference_signal,
+                signal_size,
                 num_shifts,
                 scale_factor_,
                 time_upload,
@@ -220,7 +489,18 @@ public:
         OperationTiming& upload_timing,
         OperationTiming& fft_timing
     ) override {
-        if (!isInitialized()) {
+        return step2_ProcessInputSignals(input_signals.data(), input_signals.size(),
+                                         num_signals, upload_timing, fft_timing);
+    }
+
+    bool step2_ProcessInputSignals(
+        const int32_t* input_signals,
+        size_t total_samples,
+        int num_signals,
+        OperationTiming& upload_timing,
+        OperationTiming& fft_timing
+    ) {
+        if (!isInitialized() || num_signals <= 0) {
             return false;
         }
 
@@ -232,8 +512,8 @@ public:
             
             double time_callback = 0.0;
             fft_handler_->step2_input_signals(
-                input_signals.data(),
-                input_signals.size()/num_signals,
+                input_signals,
+                total_samples / num_signals,
                 num_signals,
                 scale_factor_,
                 time_upload,
@@ -263,6 +543,194 @@ public:
         }
     }
 
+    bool loadReferenceSpectra(std::span<const ComplexFloat> spectra, int num_shifts,
+                              OperationTiming& upload_timing) override {
+        if (!isInitialized() || num_shifts <= 0 || spectra.size() != fft_size_ * num_shifts) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming upload_op_timing;
+            fft_handler_->step1_load_reference_spectra(reinterpret_cast<const cl_float2*>(spectra.data()),
+                                                       fft_size_, num_shifts, upload_op_timing);
+
+            upload_timing.execute_ms = upload_op_timing.execute_ms;
+            upload_timing.queue_wait_ms = upload_op_timing.queue_wait_ms;
+            upload_timing.cpu_wait_ms = upload_op_timing.cpu_wait_ms;
+            upload_timing.total_gpu_ms = upload_op_timing.total_gpu_ms;
+
+            reference_fft_cache_.clear();
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool loadReferenceBaseSpectrum(std::span<const ComplexFloat> base_spectrum, int num_shifts,
+                                   OperationTiming& upload_timing, OperationTiming& expand_timing) override {
+        if (!isInitialized() || num_shifts <= 0 || base_spectrum.size() != fft_size_) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming upload_op_timing, expand_op_timing;
+            fft_handler_->step1_expand_reference_spectrum(reinterpret_cast<const cl_float2*>(base_spectrum.data()),
+                                                          fft_size_, num_shifts, upload_op_timing, expand_op_timing);
+
+            upload_timing.execute_ms = upload_op_timing.execute_ms;
+            upload_timing.queue_wait_ms = upload_op_timing.queue_wait_ms;
+            upload_timing.cpu_wait_ms = upload_op_timing.cpu_wait_ms;
+            upload_timing.total_gpu_ms = upload_op_timing.total_gpu_ms;
+
+            expand_timing.execute_ms = expand_op_timing.execute_ms;
+            expand_timing.queue_wait_ms = expand_op_timing.queue_wait_ms;
+            expand_timing.cpu_wait_ms = expand_op_timing.cpu_wait_ms;
+            expand_timing.total_gpu_ms = expand_op_timing.total_gpu_ms;
+
+            reference_fft_cache_.clear();
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool configureReferenceCache(int slots, bool half_precision) override {
+        if (!isInitialized() || slots <= 0) {
+            return false;
+        }
+
+        try {
+            fft_handler_->configure_reference_cache(slots, half_precision);
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool pageInReference(int slot, const void* page, OperationTiming& staging_timing) override {
+        if (!isInitialized() || !page) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming staging_op_timing;
+            fft_handler_->page_in_reference(slot, page, staging_op_timing);
+
+            staging_timing.execute_ms = staging_op_timing.execute_ms;
+            staging_timing.queue_wait_ms = staging_op_timing.queue_wait_ms;
+            staging_timing.cpu_wait_ms = staging_op_timing.cpu_wait_ms;
+            staging_timing.total_gpu_ms = staging_op_timing.total_gpu_ms;
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool activateReferencePage(int slot, OperationTiming& activate_timing) override {
+        if (!isInitialized()) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming activate_op_timing;
+            fft_handler_->activate_reference_page(slot, activate_op_timing);
+
+            activate_timing.execute_ms = activate_op_timing.execute_ms;
+            activate_timing.queue_wait_ms = activate_op_timing.queue_wait_ms;
+            activate_timing.cpu_wait_ms = activate_op_timing.cpu_wait_ms;
+            activate_timing.total_gpu_ms = activate_op_timing.total_gpu_ms;
+
+            reference_fft_cache_.clear();
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool loadInputSpectra(std::span<const ComplexFloat> spectra, int num_signals,
+                          OperationTiming& upload_timing) override {
+        if (!isInitialized() || num_signals <= 0 || spectra.size() != fft_size_ * num_signals) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming upload_op_timing;
+            fft_handler_->step2_load_input_spectra(reinterpret_cast<const cl_float2*>(spectra.data()),
+                                                   fft_size_, num_signals, upload_op_timing);
+
+            upload_timing.execute_ms = upload_op_timing.execute_ms;
+            upload_timing.queue_wait_ms = upload_op_timing.queue_wait_ms;
+            upload_timing.cpu_wait_ms = upload_op_timing.cpu_wait_ms;
+            upload_timing.total_gpu_ms = upload_op_timing.total_gpu_ms;
+
+            input_fft_cache_.clear();
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool setBeamWeights(std::span<const ComplexFloat> weights, int channels, int beams) override {
+        if (!isInitialized() || weights.size() != fft_size_ * channels * beams) {
+            return false;
+        }
+
+        try {
+            fft_handler_->set_beam_weights(reinterpret_cast<const cl_float2*>(weights.data()), channels, beams);
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool isInputSpectraDeferred() const override {
+        return isInitialized() && fft_handler_->isInputSpectraDeferred();
+    }
+
+    bool step2_MaterializeInputSpectra(OperationTiming& fft_timing) override {
+        if (!isInitialized()) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming fft_op_timing;
+            if (!fft_handler_->materialize_input_spectra(fft_op_timing)) {
+                return false;
+            }
+
+            fft_timing.execute_ms = fft_op_timing.execute_ms;
+            fft_timing.queue_wait_ms = fft_op_timing.queue_wait_ms;
+            fft_timing.cpu_wait_ms = fft_op_timing.cpu_wait_ms;
+            fft_timing.total_gpu_ms = fft_op_timing.total_gpu_ms;
+
+            input_fft_cache_.clear();
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool step2_FormBeams(OperationTiming& beam_timing) override {
+        if (!isInitialized()) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming beam_op_timing;
+            fft_handler_->step2_form_beams(beam_op_timing);
+
+            beam_timing.execute_ms = beam_op_timing.execute_ms;
+            beam_timing.queue_wait_ms = beam_op_timing.queue_wait_ms;
+            beam_timing.cpu_wait_ms = beam_op_timing.cpu_wait_ms;
+            beam_timing.total_gpu_ms = beam_op_timing.total_gpu_ms;
+
+            input_fft_cache_.clear();
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
     bool step3_ComputeCorrelation(
         int num_signals,
         int num_shifts,
@@ -328,6 +796,106 @@ public:
         }
     }
 
+    bool step3_ComputePairwiseCorrelation(int num_signals, int num_lags, std::vector<float>& peaks,
+                                          OperationTiming& multiply_timing, OperationTiming& ifft_timing,
+                                          OperationTiming& download_timing) override {
+        if (!isInitialized()) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming multiply_op_timing, ifft_op_timing, download_op_timing;
+            fft_handler_->step3_pairwise_correlation(num_signals, num_lags, peaks,
+                                                     multiply_op_timing, ifft_op_timing, download_op_timing);
+
+            multiply_timing = {multiply_op_timing.execute_ms, multiply_op_timing.queue_wait_ms,
+                               multiply_op_timing.cpu_wait_ms, multiply_op_timing.total_gpu_ms};
+            ifft_timing = {ifft_op_timing.execute_ms, ifft_op_timing.queue_wait_ms,
+                           ifft_op_timing.cpu_wait_ms, ifft_op_timing.total_gpu_ms};
+            download_timing = {download_op_timing.execute_ms, download_op_timing.queue_wait_ms,
+                               download_op_timing.cpu_wait_ms, download_op_timing.total_gpu_ms};
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool step4_ComputeRangeDoppler(const RangeDopplerParams& params, std::vector<float>* map,
+                                   std::vector<RangeDopplerDetection>& detections,
+                                   size_t& detections_found, OperationTiming& corner_turn_timing,
+                                   OperationTiming& fft_timing, OperationTiming& detect_timing) override {
+        if (!isInitialized()) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming turn_op_timing, fft_op_timing, detect_op_timing;
+            detections_found = fft_handler_->step4_range_doppler(params, map, detections,
+                                                                 turn_op_timing, fft_op_timing, detect_op_timing);
+
+            corner_turn_timing = {turn_op_timing.execute_ms, turn_op_timing.queue_wait_ms,
+                                  turn_op_timing.cpu_wait_ms, turn_op_timing.total_gpu_ms};
+            fft_timing = {fft_op_timing.execute_ms, fft_op_timing.queue_wait_ms,
+                          fft_op_timing.cpu_wait_ms, fft_op_timing.total_gpu_ms};
+            detect_timing = {detect_op_timing.execute_ms, detect_op_timing.queue_wait_ms,
+                             detect_op_timing.cpu_wait_ms, detect_op_timing.total_gpu_ms};
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
+    bool setTemplates2D(std::span<const float> templates, int num_templates,
+                        size_t height, size_t width, OperationTiming& fft_timing) override {
+        if (!isInitialized()) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming fft_op_timing;
+            fft_handler_->set_templates_2d(templates, num_templates, height, width, fft_op_timing);
+            fft_timing = {fft_op_timing.execute_ms, fft_op_timing.queue_wait_ms,
+                          fft_op_timing.cpu_wait_ms, fft_op_timing.total_gpu_ms};
+            templates_2d_ = num_templates;
+            height_2d_ = height;
+            width_2d_ = width;
+            return true;
+        } catch (...) {
+            templates_2d_ = 0;
+            return false;
+        }
+    }
+
+    bool correlate2D(std::span<const float> images, int num_images, std::vector<Peak2D>& peaks,
+                     OperationTiming& fft_timing, OperationTiming& multiply_timing,
+                     OperationTiming& ifft_timing) override {
+        if (!isInitialized() || templates_2d_ == 0) {
+            return false;
+        }
+
+        try {
+            FFTHandler::OperationTiming fft_op_timing, multiply_op_timing, ifft_op_timing;
+            fft_handler_->correlate_2d(images, num_images, records_2d_,
+                                       fft_op_timing, multiply_op_timing, ifft_op_timing);
+
+            fft_timing = {fft_op_timing.execute_ms, fft_op_timing.queue_wait_ms,
+                          fft_op_timing.cpu_wait_ms, fft_op_timing.total_gpu_ms};
+            multiply_timing = {multiply_op_timing.execute_ms, multiply_op_timing.queue_wait_ms,
+                               multiply_op_timing.cpu_wait_ms, multiply_op_timing.total_gpu_ms};
+            ifft_timing = {ifft_op_timing.execute_ms, ifft_op_timing.queue_wait_ms,
+                           ifft_op_timing.cpu_wait_ms, ifft_op_timing.total_gpu_ms};
+
+            // Субпиксельное уточнение по окнам 3 × 3 с устройства
+            peaks.resize(static_cast<size_t>(num_images) * templates_2d_);
+            for (size_t i = 0; i < peaks.size(); ++i) {
+                peaks[i] = refinePeak2D(records_2d_.data() + i * kPeak2DRecordFloats, height_2d_, width_2d_);
+            }
+            return true;
+        } catch (...) {
+            return false;
+        }
+    }
+
     bool getReferenceFFT(std::vector<ComplexFloat>& output) const override {
         if (!isInitialized()) {
             return false;
@@ -354,6 +922,15 @@ public:
             return false;
         }
 
+        // Слитый Step 3 не оставляет спектров входа — досчитать планом Step 2
+        // (pipeline делает это сам через step2_MaterializeInputSpectra, с учётом времени)
+        try {
+            FFTHandler::OperationTiming deferred_fft;
+            fft_handler_->materialize_input_spectra(deferred_fft);
+        } catch (...) {
+            return false;
+        }
+
         // Загрузить данные из FFTHandler
         std::vector<cl_float2> cl_data;
         if (!fft_handler_->getInputFFTData(cl_data, num_signals_, fft_size_)) {
@@ -379,6 +956,45 @@ public:
         return fft_handler_->getCorrelationPeaksData(output, num_signals_, num_shifts_, n_kg_);
     }
 
+    bool readCorrelationPeaks(std::span<float> output) const override {
+        if (!isInitialized()) {
+            return false;
+        }
+
+        // Одно чтение из post_callback_userdata прямо в output
+        return fft_handler_->get_correlation_results(output, num_signals_, num_shifts_, n_kg_);
+    }
+
+    bool setPeaksEncoding(const PeaksEncodingParams& params) override {
+        if (!params.validate(n_kg_)) {
+            return false;
+        }
+        peaks_encoding_ = params;
+        if (fft_handler_) {
+            fft_handler_->setPeaksEncoding(params);
+        }
+        return true;
+    }
+
+    bool getEncodedPeaks(EncodedPeaks& output) const override {
+        if (!isInitialized()) {
+            return false;
+        }
+
+        // Payload уже скачан в step3_correlation; Float32 читается на месте
+        if (peaks_encoding_.encoding == PeaksEncoding::Float32) {
+            FFTHandler::OperationTiming timing;
+            return fft_handler_->encode_correlation_results(peaks_encoding_, num_signals_, num_shifts_, n_kg_,
+                                                            output, timing);
+        }
+        const EncodedPeaks& encoded = fft_handler_->getEncodedResults();
+        if (encoded.payload.empty()) {
+            return false;
+        }
+        output = encoded;
+        return true;
+    }
+
     std::string getPlatformName() const override {
         return "OpenCL";
     }
@@ -0,0 +1,488 @@
+#ifndef CORRELATOR_PAGED_REFERENCE_BANK_HPP
+#define CORRELATOR_PAGED_REFERENCE_BANK_HPP
+
+#include "IFFTBackend.hpp"
+#include "PeaksEncoding.hpp"
+#include "PeaksView.hpp"
+#include "ReferenceSpectra.hpp"
+#include "SpectralIndex.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <span>
+#include <sys/mman.h>
+#include <unordered_map>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// Страничный банк опорных: банки больше памяти устройства
+// ============================================================================
+
+/**
+ * Банк Step 1 одного опорного — [num_shifts][N] комплексных значений. Когда
+ * опорных много (каталог шаблонов), их банки не помещаются на устройство
+ * целиком. Страница = банк одного опорного:
+ *
+ *  - PagedReferenceBank — все страницы на хосте (f32 или f16, опционально
+ *    mlock, чтобы подкачка не ловила page fault);
+ *  - ReferencePageCache — какие страницы сейчас в слотах устройства;
+ *    вытесняется незаблокированный слот с наименьшим приоритетом страницы,
+ *    среди равных — давнее всех использованный (LRU);
+ *  - correlatePagedReferences — Step 3 по списку страниц для загруженного
+ *    Step 2: сначала уже резидентные, затем остальные; подкачка следующих
+ *    prefetch_depth страниц ставится до Step 3 текущей и идёт параллельно
+ *    (отдельная очередь передачи в OpenCL-бэкенде).
+ *
+ * Статистика: hit — страница уже была в слоте; miss — подкачка на пути Step 3
+ * (без упреждения); prefetch — подкачка заранее; stall_ms — сколько Step 3
+ * ждал окончания подкачки своей страницы.
+ */
+
+/**
+ * @struct ReferencePageStats
+ * @brief Счётчики кэша страниц
+ */
+struct ReferencePageStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t prefetches = 0;
+    uint64_t evictions = 0;
+    uint64_t page_in_bytes = 0;     // Передано с хоста (в формате хранения)
+    double stall_ms = 0.0;          // Ожидание подкачки перед Step 3
+    double staging_ms = 0.0;        // memcpy в staging + ожидание свободного staging (хост)
+
+    uint64_t lookups() const { return hits + misses + prefetches; }
+    double hitRate() const {
+        return lookups() ? static_cast<double>(hits) / static_cast<double>(lookups()) : 0.0;
+    }
+};
+
+/**
+ * @class ReferencePageCache
+ * @brief Соответствие страниц слотам устройства (только учёт, без данных)
+ */
+class ReferencePageCache {
+public:
+    static constexpr int kNoPage = -1;
+
+    struct Lookup {
+        int slot = -1;              // −1 — все слоты заблокированы
+        bool hit = false;           // Страница уже в слоте, подкачка не нужна
+        int evicted_page = kNoPage;
+    };
+
+    explicit ReferencePageCache(int slots = 0) { reset(slots); }
+
+    /**
+     * @brief Задать число слотов и очистить кэш (статистика сохраняется)
+     */
+    void reset(int slots) {
+        slots_.assign(static_cast<size_t>(std::max(slots, 0)), Slot{});
+        page_slot_.clear();
+        tick_ = 0;
+    }
+
+    int capacity() const { return static_cast<int>(slots_.size()); }
+
+    int slotOf(int page) const {
+        auto it = page_slot_.find(page);
+        return it == page_slot_.end() ? -1 : it->second;
+    }
+
+    bool isResident(int page) const { return slotOf(page) >= 0; }
+
+    /**
+     * @brief Найти страницу или выделить ей слот (с вытеснением)
+     * @param prefetch Подкачка заранее: промах считается в prefetches, а не в misses
+     */
+    Lookup acquire(int page, int priority = 0, bool prefetch = false) {
+        Lookup result;
+        const int resident = slotOf(page);
+        if (resident >= 0) {
+            Slot& slot = slots_[static_cast<size_t>(resident)];
+            slot.priority = priority;
+            slot.last_use = ++tick_;
+            result.slot = resident;
+            result.hit = true;
+            ++stats_.hits;
+            return result;
+        }
+
+        int victim = -1;
+        for (int i = 0; i < capacity(); ++i) {
+            const Slot& slot = slots_[static_cast<size_t>(i)];
+            if (slot.locks > 0) {
+                continue;
+            }
+            if (slot.page == kNoPage) {
+                victim = i;
+                break;
+            }
+            if (victim < 0) {
+                victim = i;
+                continue;
+            }
+            const Slot& best = slots_[static_cast<size_t>(victim)];
+            if (slot.priority < best.priority || (slot.priority == best.priority && slot.last_use < best.last_use)) {
+                victim = i;
+            }
+        }
+        if (victim < 0) {
+            return result;
+        }
+
+        Slot& slot = slots_[static_cast<size_t>(victim)];
+        if (slot.page != kNoPage) {
+            page_slot_.erase(slot.page);
+            result.evicted_page = slot.page;
+            ++stats_.evictions;
+        }
+        slot.page = page;
+        slot.priority = priority;
+        slot.last_use = ++tick_;
+        page_slot_[page] = victim;
+        result.slot = victim;
+        ++(prefetch ? stats_.prefetches : stats_.misses);
+        return result;
+    }
+
+    /**
+     * @brief Забыть страницу (подкачка в слот не удалась)
+     */
+    void invalidate(int slot) {
+        if (slot < 0 || slot >= capacity()) {
+            return;
+        }
+        Slot& entry = slots_[static_cast<size_t>(slot)];
+        if (entry.page != kNoPage) {
+            page_slot_.erase(entry.page);
+        }
+        entry = Slot{};
+    }
+
+    /**
+     * Заблокированный слот не вытесняется (страница ждёт Step 3 или считается)
+     */
+    void lock(int slot) { ++slots_[static_cast<size_t>(slot)].locks; }
+    void unlock(int slot) {
+        Slot& entry = slots_[static_cast<size_t>(slot)];
+        entry.locks = std::max(entry.locks - 1, 0);
+    }
+
+    const ReferencePageStats& stats() const { return stats_; }
+    ReferencePageStats& stats() { return stats_; }
+    void resetStats() { stats_ = ReferencePageStats{}; }
+
+private:
+    struct Slot {
+        int page = kNoPage;
+        int priority = 0;
+        uint64_t last_use = 0;
+        int locks = 0;
+    };
+
+    std::vector<Slot> slots_;
+    std::unordered_map<int, int> page_slot_;
+    uint64_t tick_ = 0;
+    ReferencePageStats stats_;
+};
+
+/**
+ * @class PagedReferenceBank
+ * @brief Банки Step 1 всех опорных на хосте, постранично
+ *
+ * Формат страницы совпадает с getReferenceFFT: [num_shifts][fft_size],
+ * в f16 — пары half (re, im), как vload_half2 на устройстве.
+ */
+class PagedReferenceBank {
+public:
+    PagedReferenceBank(size_t fft_size, int num_shifts, SpectralPrecision precision = SpectralPrecision::Float32)
+        : fft_size_(fft_size), num_shifts_(std::max(num_shifts, 0)), precision_(precision) {}
+
+    ~PagedReferenceBank() { unlockHostMemory(); }
+
+    PagedReferenceBank(const PagedReferenceBank&) = delete;
+    PagedReferenceBank& operator=(const PagedReferenceBank&) = delete;
+
+    /**
+     * @brief Добавить готовый банк [num_shifts][fft_size]
+     * @return Номер страницы, −1 — форма не совпадает
+     */
+    int addBank(std::span<const ComplexFloat> bank, int priority = 0) {
+        if (bank.size() != pageValues()) {
+            return -1;
+        }
+        if (precision_ == SpectralPrecision::Float16) {
+            std::vector<uint16_t> page(pageValues() * 2);
+            for (size_t i = 0; i < bank.size(); ++i) {
+                page[2 * i] = floatToHalf(bank[i].real);
+                page[2 * i + 1] = floatToHalf(bank[i].imag);
+            }
+            half_pages_.push_back(std::move(page));
+        } else {
+            std::vector<ComplexFloat> page(bank.begin(), bank.end());
+            float_pages_.push_back(std::move(page));
+        }
+        priorities_.push_back(priority);
+        const int page = static_cast<int>(pageCount()) - 1;
+        if (locked_) {
+            lockPage(page);
+        }
+        return page;
+    }
+
+    /**
+     * @brief Банк из базовой строки R_0 = conj(scale·X) (ReferenceSpectra.hpp)
+     */
+    int addBaseSpectrum(std::span<const ComplexFloat> base_spectrum, int priority = 0) {
+        if (base_spectrum.size() != fft_size_) {
+            return -1;
+        }
+        return addBank(expandReferenceBank(base_spectrum, num_shifts_), priority);
+    }
+
+    /**
+     * @brief Банк опорного во времени (как executeStep1): одно FFT + развёртка по сдвигам
+     */
+    int addReference(std::span<const int32_t> reference, float scale, int priority = 0) {
+        if (reference.size() != fft_size_) {
+            return -1;
+        }
+        std::vector<CpuFFTPlan::Complex> spectrum(fft_size_);
+        for (size_t n = 0; n < fft_size_; ++n) {
+            spectrum[n] = CpuFFTPlan::Complex(static_cast<float>(reference[n]), 0.0f);
+        }
+        const CpuFFTPlan plan(fft_size_);
+        std::vector<CpuFFTPlan::Complex> scratch(plan.scratchSize());
+        plan.forward(spectrum.data(), scratch.data());
+        return addBaseSpectrum(referenceBaseSpectrum(spectrum, scale), priority);
+    }
+
+    size_t fftSize() const { return fft_size_; }
+    int numShifts() const { return num_shifts_; }
+    SpectralPrecision precision() const { return precision_; }
+    bool halfPrecision() const { return precision_ == SpectralPrecision::Float16; }
+
+    size_t pageCount() const { return priorities_.size(); }
+    size_t pageValues() const { return fft_size_ * static_cast<size_t>(num_shifts_); }
+    size_t pageBytes() const { return pageValues() * (halfPrecision() ? 2 * sizeof(uint16_t) : sizeof(ComplexFloat)); }
+    size_t hostBytes() const { return pageBytes() * pageCount(); }
+    size_t deviceBytesPerSlot() const { return pageValues() * sizeof(ComplexFloat); }
+
+    /**
+     * Приоритет страницы: при вытеснении из кэша первыми уходят страницы с меньшим
+     */
+    int priority(int page) const { return priorities_[static_cast<size_t>(page)]; }
+    void setPriority(int page, int priority) { priorities_[static_cast<size_t>(page)] = priority; }
+
+    /**
+     * @brief Страница в формате хранения (для IFFTBackend::pageInReference)
+     */
+    const void* pageData(int page) const {
+        return halfPrecision() ? static_cast<const void*>(half_pages_[static_cast<size_t>(page)].data())
+                               : static_cast<const void*>(float_pages_[static_cast<size_t>(page)].data());
+    }
+
+    /**
+     * @brief Страница в float (для loadReferenceSpectra)
+     */
+    void decodePage(int page, std::span<ComplexFloat> output) const {
+        if (!halfPrecision()) {
+            const auto& source = float_pages_[static_cast<size_t>(page)];
+            std::copy(source.begin(), source.end(), output.begin());
+            return;
+        }
+        const auto& source = half_pages_[static_cast<size_t>(page)];
+        for (size_t i = 0; i < pageValues(); ++i) {
+            output[i] = ComplexFloat{halfToFloat(source[2 * i]), halfToFloat(source[2 * i + 1])};
+        }
+    }
+
+    /**
+     * @brief Закрепить страницы в RAM (mlock), в том числе добавленные позже
+     * Требует RLIMIT_MEMLOCK (ulimit -l) или CAP_IPC_LOCK; при отказе — false
+     */
+    bool lockHostMemory() {
+        locked_ = true;
+        bool ok = true;
+        for (size_t page = 0; page < pageCount(); ++page) {
+            ok = lockPage(static_cast<int>(page)) && ok;
+        }
+        return ok;
+    }
+
+    void unlockHostMemory() {
+        if (!locked_) {
+            return;
+        }
+        for (size_t page = 0; page < pageCount(); ++page) {
+            munlock(pageData(static_cast<int>(page)), pageBytes());
+        }
+        locked_ = false;
+    }
+
+private:
+    bool lockPage(int page) { return mlock(pageData(page), pageBytes()) == 0; }
+
+    size_t fft_size_;
+    int num_shifts_;
+    SpectralPrecision precision_;
+    std::vector<std::vector<ComplexFloat>> float_pages_;
+    std::vector<std::vector<uint16_t>> half_pages_;
+    std::vector<int> priorities_;
+    bool locked_ = false;
+};
+
+/**
+ * Результат Step 3 для страницы: пики [num_signals][num_shifts][n_kg].
+ * Представление действительно только внутри вызова; false — остановить проход.
+ */
+using PagedReferenceCallback = std::function<bool(int page, ConstPeaksView peaks)>;
+
+/**
+ * @struct PagedStep3Options
+ * @brief Порядок и упреждение прохода по страницам
+ */
+struct PagedStep3Options {
+    int prefetch_depth = 1;         // Страниц в подкачке впереди текущей (≤ слотов − 1)
+    bool resident_first = true;     // Сначала страницы, уже лежащие в кэше
+};
+
+/**
+ * Порядок прохода: резидентные страницы вперёд (порядок внутри групп сохраняется)
+ */
+inline std::vector<int> pagedReferenceOrder(std::span<const int> pages, const ReferencePageCache& cache,
+                                            bool resident_first) {
+    std::vector<int> order(pages.begin(), pages.end());
+    if (resident_first) {
+        std::stable_partition(order.begin(), order.end(), [&](int page) { return cache.isResident(page); });
+    }
+    return order;
+}
+
+/**
+ * @brief Step 3 загруженного Step 2 по страницам банка через кэш устройства
+ *
+ * Бэкенд должен быть настроен configureReferenceCache(cache.capacity(), ...).
+ * При cache.capacity() == 0 (бэкенд не держит страницы) каждая страница
+ * декодируется на хосте и грузится loadReferenceSpectra, декодирование
+ * следующей идёт параллельно Step 3 текущей. Банк Step 1 бэкенда после
+ * прохода — последняя страница.
+ */
+inline bool correlatePagedReferences(IFFTBackend& backend, const PagedReferenceBank& bank,
+                                     ReferencePageCache& cache, std::span<const int> pages,
+                                     int num_signals, int n_kg, const PagedReferenceCallback& on_page,
+                                     const PagedStep3Options& options = {}, double* stats_step3_ms = nullptr) {
+    const int num_shifts = bank.numShifts();
+    for (int page : pages) {
+        if (page < 0 || static_cast<size_t>(page) >= bank.pageCount()) {
+            return false;
+        }
+    }
+    if (pages.empty()) {
+        return true;
+    }
+
+    PeaksBuffer peaks(num_signals, num_shifts, n_kg);
+    bool ok = true;
+    auto correlate = [&](int page) {
+        OperationTiming copy, ifft, download;
+        ok = backend.step3_ComputeCorrelation(num_signals, num_shifts, n_kg, copy, ifft, download) &&
+             backend.readCorrelationPeaks(peaks.span());
+        if (stats_step3_ms) *stats_step3_ms += copy.total_gpu_ms + ifft.total_gpu_ms + download.total_gpu_ms;
+        return ok && on_page(page, ConstPeaksView(peaks.view().data_handle(),
+                                                  PeaksExtents<>(num_signals, num_shifts, n_kg)));
+    };
+
+    ReferencePageStats& stats = cache.stats();
+    const std::vector<int> order = pagedReferenceOrder(pages, cache, options.resident_first);
+
+    if (cache.capacity() == 0) {
+        // Запасной путь: страница декодируется на хосте, следующая — заранее
+        std::vector<ComplexFloat> buffers[2] = {std::vector<ComplexFloat>(bank.pageValues()),
+                                                std::vector<ComplexFloat>(bank.pageValues())};
+        bank.decodePage(order[0], buffers[0]);
+        int current = 0;
+        for (size_t i = 0; i < order.size(); ++i) {
+            std::future<void> prefetch;
+            if (i + 1 < order.size()) {
+                prefetch = std::async(std::launch::async, [&, next = order[i + 1], target = current ^ 1] {
+                    bank.decodePage(next, buffers[target]);
+                });
+            }
+            OperationTiming upload;
+            const bool loaded = backend.loadReferenceSpectra(buffers[current], num_shifts, upload);
+            ++stats.misses;
+            stats.page_in_bytes += bank.pageBytes();
+            stats.stall_ms += upload.total_gpu_ms;
+            const bool keep_going = loaded && correlate(order[i]);
+            if (prefetch.valid()) {
+                prefetch.get();
+            }
+            if (!keep_going) {
+                return loaded && ok;
+            }
+            current ^= 1;
+        }
+        return true;
+    }
+
+    const int depth = std::clamp(options.prefetch_depth, 0, cache.capacity() - 1);
+    size_t issued = 0;
+
+    // Снять блокировки уже подкачанных, но не обработанных страниц [first, issued)
+    auto unlock_pending = [&](size_t first) {
+        for (size_t j = first; j < issued; ++j) {
+            cache.unlock(cache.slotOf(order[j]));
+        }
+    };
+
+    // Подкачка страницы order[index]: слот блокируется до конца её Step 3
+    auto page_in = [&](size_t index, bool prefetch) {
+        const int page = order[index];
+        const ReferencePageCache::Lookup lookup = cache.acquire(page, bank.priority(page), prefetch);
+        if (lookup.slot < 0) {
+            return false;
+        }
+        if (!lookup.hit) {
+            OperationTiming staging;
+            if (!backend.pageInReference(lookup.slot, bank.pageData(page), staging)) {
+                cache.invalidate(lookup.slot);
+                return false;
+            }
+            stats.page_in_bytes += bank.pageBytes();
+            stats.staging_ms += staging.cpu_wait_ms + staging.execute_ms;
+        }
+        cache.lock(lookup.slot);
+        return true;
+    };
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        while (issued < order.size() && issued <= i + static_cast<size_t>(depth)) {
+            if (!page_in(issued, issued > i)) {
+                unlock_pending(i);
+                return false;
+            }
+            ++issued;
+        }
+
+        const int slot = cache.slotOf(order[i]);
+        OperationTiming activate;
+        const bool activated = backend.activateReferencePage(slot, activate);
+        stats.stall_ms += std::max(activate.total_gpu_ms - activate.execute_ms, 0.0);
+        const bool keep_going = activated && correlate(order[i]);
+        cache.unlock(slot);
+        if (!keep_going) {
+            unlock_pending(i + 1);
+            return activated && ok;
+        }
+    }
+    return true;
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_PAGED_REFERENCE_BANK_HPP
@@ -0,0 +1,118 @@
+#ifndef CORRELATOR_PAIRWISE_CORRELATION_HPP
+#define CORRELATOR_PAIRWISE_CORRELATION_HPP
+
+#include "CpuFFT.hpp"
+#include "IDataSnapshot.hpp"
+#include "ParallelChunks.hpp"
+#include <complex>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// Парная корреляция входов (TDOA)
+// ============================================================================
+
+/**
+ * Для пары каналов i ≤ j: r_ij[τ] = IFFT(X_i · conj(X_j))[τ] = Σ_n x_i[n + τ]·x_j[n]
+ * (циклически, масштаб IFFT 1/N), X — спектры Step 2. Пара i = j —
+ * автокорреляция IFFT(|X_i|²). Пары i > j не считаются: r_ji[τ] = conj(r_ij[-τ]),
+ * их пики — пики (j, i) в обратном порядке задержек.
+ *
+ * Раскладка пиков [pairs][num_lags]; пары — верхний треугольник по строкам:
+ * (0,0), (0,1), …, (0,S-1), (1,1), … Индекс задержки l ↔ τ = l - num_lags/2,
+ * так что задержка 0 стоит в середине окна. Максимум пары на τ < 0 значит,
+ * что x_j запаздывает относительно x_i на -τ отсчётов.
+ */
+inline size_t pairwisePairCount(int num_signals) {
+    return num_signals > 0 ? static_cast<size_t>(num_signals) * (num_signals + 1) / 2 : 0;
+}
+
+/**
+ * Индекс пары (i, j), i ≤ j < num_signals
+ */
+inline size_t pairwisePairIndex(int i, int j, int num_signals) {
+    const size_t row = static_cast<size_t>(i);
+    return row * num_signals - row * (row - 1) / 2 + static_cast<size_t>(j - i);
+}
+
+/**
+ * Таблица пар [pairs][2] = (i, j) для устройства и обхода по индексу пары
+ */
+inline std::vector<uint32_t> pairwisePairTable(int num_signals) {
+    std::vector<uint32_t> table;
+    table.reserve(2 * pairwisePairCount(num_signals));
+    for (int i = 0; i < num_signals; ++i) {
+        for (int j = i; j < num_signals; ++j) {
+            table.push_back(static_cast<uint32_t>(i));
+            table.push_back(static_cast<uint32_t>(j));
+        }
+    }
+    return table;
+}
+
+/**
+ * Задержка (в отсчётах) для индекса l окна из num_lags
+ */
+inline int pairwiseLag(int lag_index, int num_lags) {
+    return lag_index - num_lags / 2;
+}
+
+/**
+ * Задержка максимума корреляции пары (оценка TDOA в отсчётах)
+ */
+inline int pairwisePeakLag(std::span<const float> peaks, size_t pair, int num_lags) {
+    const float* row = peaks.data() + pair * num_lags;
+    int best = 0;
+    for (int l = 1; l < num_lags; ++l) {
+        if (row[l] > row[best]) best = l;
+    }
+    return pairwiseLag(best, num_lags);
+}
+
+/**
+ * @brief CPU реализация (эталон и запасной путь для бэкендов без парного Step 3)
+ * @param spectra [num_signals][fft_size] спектры Step 2 (getInputFFT)
+ * @param peaks [pairs][num_lags] модули r_ij на задержках окна
+ */
+inline bool computePairwisePeaks(std::span<const ComplexFloat> spectra, int num_signals, size_t fft_size,
+                                 int num_lags, std::span<float> peaks, unsigned threads = 0) {
+    const size_t pairs = pairwisePairCount(num_signals);
+    if (fft_size == 0 || num_lags <= 0 || static_cast<size_t>(num_lags) > fft_size ||
+        spectra.size() < static_cast<size_t>(num_signals) * fft_size ||
+        peaks.size() != pairs * static_cast<size_t>(num_lags)) {
+        return false;
+    }
+
+    using Complex = CpuFFTPlan::Complex;
+    const CpuFFTPlan plan(fft_size);
+    const std::vector<uint32_t> table = pairwisePairTable(num_signals);
+    const float inv_n = 1.0f / static_cast<float>(fft_size);
+    parallelChunks(pairs, threads, [&](size_t pair) {
+        thread_local std::vector<Complex> product, scratch;
+        product.resize(fft_size);
+        scratch.resize(plan.scratchSize());
+        const ComplexFloat* xi = spectra.data() + table[2 * pair] * fft_size;
+        const ComplexFloat* xj = spectra.data() + table[2 * pair + 1] * fft_size;
+        for (size_t k = 0; k < fft_size; ++k) {
+            product[k] = Complex(xi[k].real * xj[k].real + xi[k].imag * xj[k].imag,
+                                 xi[k].imag * xj[k].real - xi[k].real * xj[k].imag);
+        }
+        plan.inverse(product.data(), scratch.data());
+
+        float* out = peaks.data() + pair * num_lags;
+        for (int l = 0; l < num_lags; ++l) {
+            const long long lag = pairwiseLag(l, num_lags);
+            const size_t index = static_cast<size_t>((lag % static_cast<long long>(fft_size) +
+                                                      static_cast<long long>(fft_size)) % static_cast<long long>(fft_size));
+            out[l] = std::abs(product[index]) * inv_n;
+        }
+    });
+    return true;
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_PAIRWISE_CORRELATION_HPP
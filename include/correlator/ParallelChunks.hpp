@@ -0,0 +1,51 @@
+#ifndef CORRELATOR_PARALLEL_CHUNKS_HPP
+#define CORRELATOR_PARALLEL_CHUNKS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// parallelChunks - раздача независимых задач по потокам
+// ============================================================================
+
+/**
+ * @brief Выполнить fn(i) для i в [0, count) на threads потоках (0 = все ядра)
+ *
+ * Потоки создаются на вызов и берут индексы из общего счётчика, так что
+ * задачи разной длительности распределяются сами. При одном потоке (или
+ * одной задаче) fn выполняется в вызывающем потоке.
+ */
+template <class Fn>
+void parallelChunks(size_t count, unsigned threads, Fn&& fn) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, count));
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                fn(i);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_PARALLEL_CHUNKS_HPP
@@ -0,0 +1,458 @@
+#ifndef CORRELATOR_PEAKS_ENCODING_HPP
+#define CORRELATOR_PEAKS_ENCODING_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// Компактные кодировки результатов Step 3
+// ============================================================================
+
+/**
+ * Строка (row) = одна корреляция (signal, shift), n_kg значений |IFFT|.
+ * Кодирование выполняется на устройстве (FFTHandler::encode_correlation_results),
+ * скачивается и экспортируется уже сжатый payload. Форматы payload:
+ *
+ * - Float32:     rows * n_kg float (как без кодирования)
+ * - Float16:     rows * n_kg IEEE half (uint16), округление к ближайшему чётному
+ * - LogU16:      rows float (log1p(max строки)), затем rows * n_kg uint16:
+ *                code = round(log1p(m) / log1p(max) * 65535)
+ * - SparseDelta: rows записей фиксированного размера (1 + 2 * max_detections) uint16:
+ *                [count, (Δlag, half(m)) * max_detections]; отбираются до
+ *                max_detections наибольших значений >= threshold * max строки,
+ *                задержки по возрастанию, Δlag — от предыдущей (первая от 0)
+ */
+enum class PeaksEncoding : uint8_t {
+    Float32 = 0,
+    Float16 = 1,
+    LogU16 = 2,
+    SparseDelta = 3
+};
+
+inline const char* peaksEncodingName(PeaksEncoding encoding) {
+    switch (encoding) {
+        case PeaksEncoding::Float32:     return "f32";
+        case PeaksEncoding::Float16:     return "f16";
+        case PeaksEncoding::LogU16:      return "log-u16";
+        case PeaksEncoding::SparseDelta: return "sparse-delta";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Разбор имени кодировки (f32, f16, log-u16, sparse-delta)
+ * @return false для неизвестного имени
+ */
+inline bool parsePeaksEncoding(const std::string& name, PeaksEncoding& encoding) {
+    for (PeaksEncoding e : {PeaksEncoding::Float32, PeaksEncoding::Float16,
+                            PeaksEncoding::LogU16, PeaksEncoding::SparseDelta}) {
+        if (name == peaksEncodingName(e)) {
+            encoding = e;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @struct PeaksEncodingParams
+ * @brief Выбор кодировки и параметры детектора для SparseDelta
+ */
+struct PeaksEncodingParams {
+    PeaksEncoding encoding = PeaksEncoding::Float32;
+    float detection_threshold = 0.5f;  // Доля от максимума строки
+    int max_detections = 8;            // Слотов на строку
+
+    bool validate(int n_kg) const {
+        if (encoding != PeaksEncoding::SparseDelta) return true;
+        return max_detections > 0 && max_detections <= 64 &&
+               detection_threshold >= 0.0f && n_kg <= 65536;
+    }
+};
+
+/**
+ * @struct Detection
+ * @brief Декодированное обнаружение SparseDelta
+ */
+struct Detection {
+    uint32_t signal;
+    uint32_t shift;
+    uint32_t lag;
+    float magnitude;
+};
+
+/**
+ * @struct EncodedPeaks
+ * @brief Сжатые пики вместе с формой и параметрами кодирования
+ */
+struct EncodedPeaks {
+    PeaksEncoding encoding = PeaksEncoding::Float32;
+    uint32_t num_signals = 0;
+    uint32_t num_shifts = 0;
+    uint32_t n_kg = 0;
+    uint32_t max_detections = 0;       // Только SparseDelta
+    std::vector<uint8_t> payload;
+
+    size_t rows() const { return static_cast<size_t>(num_signals) * num_shifts; }
+    size_t rawBytes() const { return rows() * n_kg * sizeof(float); }
+    double compressionRatio() const {
+        return payload.empty() ? 0.0 : static_cast<double>(rawBytes()) / payload.size();
+    }
+};
+
+// ============================================================================
+// Размеры и IEEE half
+// ============================================================================
+
+inline size_t sparseRecordWords(int max_detections) {
+    return 1 + 2 * static_cast<size_t>(max_detections);
+}
+
+inline size_t encodedPeaksBytes(PeaksEncoding encoding, size_t rows, size_t n_kg, int max_detections) {
+    switch (encoding) {
+        case PeaksEncoding::Float32:     return rows * n_kg * sizeof(float);
+        case PeaksEncoding::Float16:     return rows * n_kg * sizeof(uint16_t);
+        case PeaksEncoding::LogU16:      return rows * sizeof(float) + rows * n_kg * sizeof(uint16_t);
+        case PeaksEncoding::SparseDelta: return rows * sparseRecordWords(max_detections) * sizeof(uint16_t);
+    }
+    return 0;
+}
+
+/**
+ * @brief float → IEEE half, округление к ближайшему чётному (как vstore_half)
+ */
+inline uint16_t floatToHalf(float value) {
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000u;
+    uint32_t abs = x & 0x7FFFFFFFu;
+
+    if (abs >= 0x7F800000u) {                          // Inf / NaN
+        return static_cast<uint16_t>(sign | 0x7C00u | (abs > 0x7F800000u ? 0x200u : 0u));
+    }
+    if (abs >= 0x477FF000u) {                          // >= 65520 → Inf
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    }
+    if (abs < 0x38800000u) {                           // Денормализованные half
+        if (abs < 0x33000000u) return static_cast<uint16_t>(sign);
+        uint32_t mantissa = (abs & 0x007FFFFFu) | 0x00800000u;
+        int shift = 126 - static_cast<int>(abs >> 23);  // 14..24
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1u))) ++half;
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = ((abs - 0x38000000u) >> 13);
+    uint32_t rest = abs & 0x1FFFu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) ++half;
+    return static_cast<uint16_t>(sign | half);
+}
+
+inline float halfToFloat(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+    uint32_t exponent = (h >> 10) & 0x1Fu;
+    uint32_t mantissa = h & 0x3FFu;
+    uint32_t x;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            x = sign;
+        } else {
+            float value = std::ldexp(static_cast<float>(mantissa), -24);
+            return sign ? -value : value;
+        }
+    } else if (exponent == 31) {
+        x = sign | 0x7F800000u | (mantissa << 13);
+    } else {
+        x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+// ============================================================================
+// Кодирование на CPU (эталон для устройства и путь для бэкендов без ядра)
+// ============================================================================
+
+namespace detail {
+
+inline void write_u16(std::vector<uint8_t>& out, size_t index, uint16_t value) {
+    std::memcpy(out.data() + index * sizeof(uint16_t), &value, sizeof(value));
+}
+
+inline uint16_t read_u16(const std::vector<uint8_t>& in, size_t offset_bytes, size_t index) {
+    uint16_t value;
+    std::memcpy(&value, in.data() + offset_bytes + index * sizeof(uint16_t), sizeof(value));
+    return value;
+}
+
+} // namespace detail
+
+/**
+ * @brief Закодировать пики [signals][shifts][n_kg]
+ *
+ * Алгоритм совпадает с ядрами FFTHandler; LogU16 может отличаться от
+ * устройства на 1 LSB из-за точности log1p.
+ */
+inline bool encodePeaks(std::span<const float> peaks, int num_signals, int num_shifts, int n_kg,
+                        const PeaksEncodingParams& params, EncodedPeaks& out) {
+    const size_t rows = static_cast<size_t>(num_signals) * num_shifts;
+    const size_t row_len = static_cast<size_t>(n_kg);
+    if (peaks.size() != rows * row_len || !params.validate(n_kg)) {
+        return false;
+    }
+
+    out.encoding = params.encoding;
+    out.num_signals = static_cast<uint32_t>(num_signals);
+    out.num_shifts = static_cast<uint32_t>(num_shifts);
+    out.n_kg = static_cast<uint32_t>(n_kg);
+    out.max_detections = params.encoding == PeaksEncoding::SparseDelta ? params.max_detections : 0;
+    out.payload.assign(encodedPeaksBytes(params.encoding, rows, row_len, params.max_detections), 0);
+
+    switch (params.encoding) {
+        case PeaksEncoding::Float32:
+            std::memcpy(out.payload.data(), peaks.data(), out.payload.size());
+            break;
+
+        case PeaksEncoding::Float16:
+            for (size_t i = 0; i < peaks.size(); ++i) {
+                detail::write_u16(out.payload, i, floatToHalf(peaks[i]));
+            }
+            break;
+
+        case PeaksEncoding::LogU16: {
+            const size_t codes_offset = rows;  // В uint16 словах после rows float = 2 * rows
+            for (size_t r = 0; r < rows; ++r) {
+                const float* row = peaks.data() + r * row_len;
+                float row_max = *std::max_element(row, row + row_len);
+                float log_max = std::log1p(std::max(row_max, 0.0f));
+                std::memcpy(out.payload.data() + r * sizeof(float), &log_max, sizeof(float));
+
+                float inv = log_max > 0.0f ? 65535.0f / log_max : 0.0f;
+                for (size_t k = 0; k < row_len; ++k) {
+                    float code = std::nearbyint(std::log1p(std::max(row[k], 0.0f)) * inv);
+                    detail::write_u16(out.payload, 2 * codes_offset + r * row_len + k,
+                                      static_cast<uint16_t>(std::clamp(code, 0.0f, 65535.0f)));
+                }
+            }
+            break;
+        }
+
+        case PeaksEncoding::SparseDelta: {
+            const int slots = params.max_detections;
+            const size_t record = sparseRecordWords(slots);
+            std::vector<uint32_t> lags(slots);
+            std::vector<float> mags(slots);
+
+            for (size_t r = 0; r < rows; ++r) {
+                const float* row = peaks.data() + r * row_len;
+                float threshold = params.detection_threshold * *std::max_element(row, row + row_len);
+
+                // Top-K по магнитуде (строгое сравнение: при равенстве выигрывает меньшая задержка)
+                int count = 0;
+                for (size_t k = 0; k < row_len; ++k) {
+                    float m = row[k];
+                    if (!(m > 0.0f) || m < threshold) continue;
+                    if (count == slots && m <= mags[slots - 1]) continue;
+                    int pos = count < slots ? count++ : slots - 1;
+                    while (pos > 0 && mags[pos - 1] < m) {
+                        mags[pos] = mags[pos - 1];
+                        lags[pos] = lags[pos - 1];
+                        --pos;
+                    }
+                    mags[pos] = m;
+                    lags[pos] = static_cast<uint32_t>(k);
+                }
+
+                // По возрастанию задержки для дельта-кодирования
+                for (int i = 1; i < count; ++i) {
+                    for (int j = i; j > 0 && lags[j - 1] > lags[j]; --j) {
+                        std::swap(lags[j - 1], lags[j]);
+                        std::swap(mags[j - 1], mags[j]);
+                    }
+                }
+
+                size_t base = r * record;
+                detail::write_u16(out.payload, base, static_cast<uint16_t>(count));
+                uint32_t previous = 0;
+                for (int i = 0; i < count; ++i) {
+                    detail::write_u16(out.payload, base + 1 + 2 * i, static_cast<uint16_t>(lags[i] - previous));
+                    detail::write_u16(out.payload, base + 2 + 2 * i, floatToHalf(mags[i]));
+                    previous = lags[i];
+                }
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+// ============================================================================
+// Декодирование (потребители: pipeline, валидация, офлайн-анализ)
+// ============================================================================
+
+/**
+ * @brief Восстановить плотный массив [signals][shifts][n_kg]
+ *
+ * Для SparseDelta точки без обнаружений заполняются нулями.
+ */
+inline bool decodePeaks(const EncodedPeaks& in, std::span<float> out) {
+    const size_t rows = in.rows();
+    const size_t row_len = in.n_kg;
+    if (out.size() != rows * row_len ||
+        in.payload.size() != encodedPeaksBytes(in.encoding, rows, row_len, static_cast<int>(in.max_detections))) {
+        return false;
+    }
+
+    switch (in.encoding) {
+        case PeaksEncoding::Float32:
+            std::memcpy(out.data(), in.payload.data(), in.payload.size());
+            break;
+
+        case PeaksEncoding::Float16:
+            for (size_t i = 0; i < out.size(); ++i) {
+                out[i] = halfToFloat(detail::read_u16(in.payload, 0, i));
+            }
+            break;
+
+        case PeaksEncoding::LogU16: {
+            const size_t codes_offset = rows * sizeof(float);
+            for (size_t r = 0; r < rows; ++r) {
+                float log_max;
+                std::memcpy(&log_max, in.payload.data() + r * sizeof(float), sizeof(float));
+                float step = log_max / 65535.0f;
+                for (size_t k = 0; k < row_len; ++k) {
+                    uint16_t code = detail::read_u16(in.payload, codes_offset, r * row_len + k);
+                    out[r * row_len + k] = std::expm1(code * step);
+                }
+            }
+            break;
+        }
+
+        case PeaksEncoding::SparseDelta: {
+            std::fill(out.begin(), out.end(), 0.0f);
+            const size_t record = sparseRecordWords(static_cast<int>(in.max_detections));
+            for (size_t r = 0; r < rows; ++r) {
+                size_t base = r * record;
+                uint16_t count = std::min<uint16_t>(detail::read_u16(in.payload, 0, base),
+                                                    static_cast<uint16_t>(in.max_detections));
+                uint32_t lag = 0;
+                for (uint16_t i = 0; i < count; ++i) {
+                    lag += detail::read_u16(in.payload, 0, base + 1 + 2 * i);
+                    if (lag >= row_len) break;
+                    out[r * row_len + lag] = halfToFloat(detail::read_u16(in.payload, 0, base + 2 + 2 * i));
+                }
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Список обнаружений SparseDelta (без восстановления плотного массива)
+ */
+inline bool decodeDetections(const EncodedPeaks& in, std::vector<Detection>& detections) {
+    detections.clear();
+    if (in.encoding != PeaksEncoding::SparseDelta ||
+        in.payload.size() != encodedPeaksBytes(in.encoding, in.rows(), in.n_kg, static_cast<int>(in.max_detections))) {
+        return false;
+    }
+
+    const size_t record = sparseRecordWords(static_cast<int>(in.max_detections));
+    for (size_t r = 0; r < in.rows(); ++r) {
+        size_t base = r * record;
+        uint16_t count = std::min<uint16_t>(detail::read_u16(in.payload, 0, base),
+                                            static_cast<uint16_t>(in.max_detections));
+        uint32_t lag = 0;
+        for (uint16_t i = 0; i < count; ++i) {
+            lag += detail::read_u16(in.payload, 0, base + 1 + 2 * i);
+            detections.push_back(Detection{
+                static_cast<uint32_t>(r / in.num_shifts),
+                static_cast<uint32_t>(r % in.num_shifts),
+                lag,
+                halfToFloat(detail::read_u16(in.payload, 0, base + 2 + 2 * i))});
+        }
+    }
+    return true;
+}
+
+// ============================================================================
+// Бинарный файл (ResultExporter::exportEncodedPeaks)
+// ============================================================================
+
+/**
+ * Заголовок файла .peaks: magic "CPKS", версия, кодировка, форма, размер payload.
+ * Порядок байт — порядок хоста (файлы читаются на той же архитектуре).
+ */
+struct EncodedPeaksFileHeader {
+    char magic[4] = {'C', 'P', 'K', 'S'};
+    uint16_t version = 1;
+    uint8_t encoding = 0;
+    uint8_t reserved = 0;
+    uint32_t num_signals = 0;
+    uint32_t num_shifts = 0;
+    uint32_t n_kg = 0;
+    uint32_t max_detections = 0;
+    uint64_t payload_bytes = 0;
+};
+
+inline bool writeEncodedPeaks(const std::string& path, const EncodedPeaks& peaks) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    EncodedPeaksFileHeader header;
+    header.encoding = static_cast<uint8_t>(peaks.encoding);
+    header.num_signals = peaks.num_signals;
+    header.num_shifts = peaks.num_shifts;
+    header.n_kg = peaks.n_kg;
+    header.max_detections = peaks.max_detections;
+    header.payload_bytes = peaks.payload.size();
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(peaks.payload.data()), static_cast<std::streamsize>(peaks.payload.size()));
+    return file.good();
+}
+
+inline bool readEncodedPeaks(const std::string& path, EncodedPeaks& peaks) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    EncodedPeaksFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, "CPKS", 4) != 0 || header.version != 1 ||
+        header.encoding > static_cast<uint8_t>(PeaksEncoding::SparseDelta)) {
+        return false;
+    }
+
+    peaks.encoding = static_cast<PeaksEncoding>(header.encoding);
+    peaks.num_signals = header.num_signals;
+    peaks.num_shifts = header.num_shifts;
+    peaks.n_kg = header.n_kg;
+    peaks.max_detections = header.max_detections;
+    if (header.payload_bytes != encodedPeaksBytes(peaks.encoding, peaks.rows(), peaks.n_kg,
+                                                  static_cast<int>(peaks.max_detections))) {
+        return false;
+    }
+    peaks.payload.resize(header.payload_bytes);
+    file.read(reinterpret_cast<char*>(peaks.payload.data()), static_cast<std::streamsize>(header.payload_bytes));
+    return static_cast<bool>(file);
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_PEAKS_ENCODING_HPP
@@ -0,0 +1,232 @@
+#ifndef CORRELATOR_PEAKS_VIEW_HPP
+#define CORRELATOR_PEAKS_VIEW_HPP
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <vector>
+#include <version>
+
+#if defined(__cpp_lib_mdspan)
+#include <mdspan>
+#endif
+
+namespace Correlator {
+
+// ============================================================================
+// Представление результатов корреляции [signals][shifts][n_kg]
+// ============================================================================
+
+/**
+ * Пики хранятся одним непрерывным блоком float в порядке row-major:
+ * индекс = (signal * num_shifts + shift) * n_kg + k — так их пишет
+ * post-callback IFFT, поэтому скачивание идёт одним clEnqueueReadBuffer
+ * прямо в память вызывающего кода.
+ *
+ * При наличии std::mdspan (C++23) PeaksView — это std::mdspan, иначе
+ * используется минимальная совместимая замена (extents / extent / size /
+ * data_handle). Индексирование для обоих вариантов: peakAt(view, s, sh, k).
+ */
+
+inline constexpr size_t kDynamicExtent = std::dynamic_extent;
+
+#if defined(__cpp_lib_mdspan)
+
+template <size_t Signals = kDynamicExtent, size_t Shifts = kDynamicExtent, size_t NKg = kDynamicExtent>
+using PeaksExtents = std::extents<size_t, Signals, Shifts, NKg>;
+
+template <class T, class Extents>
+using PeaksMdspan = std::mdspan<T, Extents>;
+
+#else
+
+/**
+ * @class PeaksExtents
+ * @brief Замена std::extents<size_t, S, Sh, K>: хранит только динамические размеры
+ */
+template <size_t Signals = kDynamicExtent, size_t Shifts = kDynamicExtent, size_t NKg = kDynamicExtent>
+class PeaksExtents {
+public:
+    using index_type = size_t;
+    using size_type = size_t;
+    using rank_type = size_t;
+
+    static constexpr rank_type rank() noexcept { return 3; }
+
+    static constexpr size_t static_extent(rank_type r) noexcept {
+        constexpr size_t statics[3] = {Signals, Shifts, NKg};
+        return statics[r];
+    }
+
+    static constexpr rank_type rank_dynamic() noexcept {
+        return (Signals == kDynamicExtent) + (Shifts == kDynamicExtent) + (NKg == kDynamicExtent);
+    }
+
+    constexpr PeaksExtents() noexcept = default;
+
+    /// Все три размера (статические должны совпадать с параметрами шаблона)
+    constexpr PeaksExtents(size_t signals, size_t shifts, size_t n_kg) noexcept {
+        const size_t all[3] = {signals, shifts, n_kg};
+        size_t d = 0;
+        for (rank_type r = 0; r < 3; ++r) {
+            if (static_extent(r) == kDynamicExtent) {
+                dynamic_[d++] = all[r];
+            }
+        }
+    }
+
+    constexpr index_type extent(rank_type r) const noexcept {
+        if (static_extent(r) != kDynamicExtent) {
+            return static_extent(r);
+        }
+        size_t d = 0;
+        for (rank_type i = 0; i < r; ++i) {
+            d += static_extent(i) == kDynamicExtent;
+        }
+        return dynamic_[d];
+    }
+
+private:
+    std::array<size_t, rank_dynamic()> dynamic_{};
+};
+
+/**
+ * @class PeaksMdspan
+ * @brief Замена std::mdspan<T, PeaksExtents<...>> (layout_right, без владения)
+ */
+template <class T, class Extents>
+class PeaksMdspan {
+public:
+    using extents_type = Extents;
+    using element_type = T;
+    using index_type = typename Extents::index_type;
+    using data_handle_type = T*;
+    using reference = T&;
+
+    constexpr PeaksMdspan() noexcept = default;
+    constexpr PeaksMdspan(T* data, const Extents& extents) noexcept : data_(data), extents_(extents) {}
+    constexpr PeaksMdspan(T* data, size_t signals, size_t shifts, size_t n_kg) noexcept
+        : data_(data), extents_(signals, shifts, n_kg) {}
+
+    static constexpr size_t rank() noexcept { return 3; }
+
+    constexpr const Extents& extents() const noexcept { return extents_; }
+    constexpr index_type extent(size_t r) const noexcept { return extents_.extent(r); }
+    constexpr size_t size() const noexcept { return extent(0) * extent(1) * extent(2); }
+    constexpr bool empty() const noexcept { return size() == 0; }
+    constexpr T* data_handle() const noexcept { return data_; }
+
+    constexpr reference operator()(index_type signal, index_type shift, index_type k) const noexcept {
+        return data_[(signal * extent(1) + shift) * extent(2) + k];
+    }
+
+#if defined(__cpp_multidimensional_subscript)
+    constexpr reference operator[](index_type signal, index_type shift, index_type k) const noexcept {
+        return (*this)(signal, shift, k);
+    }
+#endif
+
+private:
+    T* data_ = nullptr;
+    [[no_unique_address]] Extents extents_{};
+};
+
+#endif // __cpp_lib_mdspan
+
+// ============================================================================
+// Типы представлений
+// ============================================================================
+
+/// Форма из конфигурации времени выполнения
+using PeaksView = PeaksMdspan<float, PeaksExtents<>>;
+using ConstPeaksView = PeaksMdspan<const float, PeaksExtents<>>;
+
+/// Форма, зафиксированная при компиляции (StaticCorrelationPipeline)
+template <size_t Signals, size_t Shifts, size_t NKg>
+using StaticPeaksView = PeaksMdspan<float, PeaksExtents<Signals, Shifts, NKg>>;
+
+template <size_t Signals, size_t Shifts, size_t NKg>
+using ConstStaticPeaksView = PeaksMdspan<const float, PeaksExtents<Signals, Shifts, NKg>>;
+
+/**
+ * @brief Элемент [signal][shift][k] независимо от реализации mdspan
+ */
+template <class View>
+constexpr auto& peakAt(const View& view, size_t signal, size_t shift, size_t k) noexcept {
+#if defined(__cpp_lib_mdspan)
+    return view[signal, shift, k];
+#else
+    return view(signal, shift, k);
+#endif
+}
+
+/**
+ * @brief Пики одной корреляции (signal, shift) — n_kg подряд идущих значений
+ */
+template <class View>
+constexpr auto peaksOf(const View& view, size_t signal, size_t shift) noexcept {
+    using T = std::remove_reference_t<decltype(peakAt(view, 0, 0, 0))>;
+    return std::span<T>(&peakAt(view, signal, shift, 0), view.extent(2));
+}
+
+// ============================================================================
+// PeaksBuffer — переиспользуемое хранилище пиков
+// ============================================================================
+
+/**
+ * @class PeaksBuffer
+ * @brief Непрерывный буфер пиков, выделяемый один раз и переиспользуемый
+ *
+ * reshape() перевыделяет память только при росте формы; при повторных
+ * батчах той же конфигурации скачивание и доступ к результатам идут без
+ * аллокаций.
+ *
+ * Пример:
+ * @code
+ * PeaksBuffer peaks(num_signals, num_shifts, n_kg);
+ * backend->readCorrelationPeaks(peaks.span());
+ * float p = peakAt(peaks.view(), signal, shift, 0);
+ * @endcode
+ */
+class PeaksBuffer {
+public:
+    PeaksBuffer() = default;
+
+    PeaksBuffer(int num_signals, int num_shifts, int n_kg) {
+        reshape(num_signals, num_shifts, n_kg);
+    }
+
+    /**
+     * @brief Задать форму (аллокация только если ёмкости не хватает)
+     */
+    void reshape(int num_signals, int num_shifts, int n_kg) {
+        num_signals_ = static_cast<size_t>(num_signals);
+        num_shifts_ = static_cast<size_t>(num_shifts);
+        n_kg_ = static_cast<size_t>(n_kg);
+        if (storage_.size() < size()) {
+            storage_.resize(size());
+        }
+    }
+
+    size_t size() const { return num_signals_ * num_shifts_ * n_kg_; }
+    size_t capacity() const { return storage_.size(); }
+
+    std::span<float> span() { return {storage_.data(), size()}; }
+    std::span<const float> span() const { return {storage_.data(), size()}; }
+
+    PeaksView view() { return PeaksView(storage_.data(), PeaksExtents<>(num_signals_, num_shifts_, n_kg_)); }
+    ConstPeaksView view() const {
+        return ConstPeaksView(storage_.data(), PeaksExtents<>(num_signals_, num_shifts_, n_kg_));
+    }
+
+private:
+    std::vector<float> storage_;
+    size_t num_signals_ = 0;
+    size_t num_shifts_ = 0;
+    size_t n_kg_ = 0;
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_PEAKS_VIEW_HPP
@@ -0,0 +1,235 @@
+#ifndef CORRELATOR_PIPELINE_CHECKPOINT_HPP
+#define CORRELATOR_PIPELINE_CHECKPOINT_HPP
+
+#include "ChunkArchive.hpp"
+#include "IConfiguration.hpp"
+#include "IDataSnapshot.hpp"
+#include "PeaksEncoding.hpp"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// PipelineCheckpoint - тёплое состояние pipeline для быстрого перезапуска
+// ============================================================================
+
+/**
+ * Состояние, которое дорого восстанавливать с нуля и не зависит от
+ * нового батча входных данных.
+ *
+ * plan_keys — форма планов clFFT (размер FFT, батч) для Step 1/2/3.
+ * При восстановлении они сверяются с конфигурацией: совпадение гарантирует,
+ * что initialize() создаст те же планы и сохранённые спектры подходят к
+ * буферам устройства.
+ *
+ * tuning_* — настройки бэкенда (BackendTuning: путь и деление Step 2,
+ * слитый Step 2+3) с флагом kCheckpointTuning. Восстановление применяет их
+ * вместо автотюнинга и отвергает checkpoint, если они выбраны на другом
+ * устройстве или драйвере.
+ */
+struct CheckpointState {
+    char magic[4] = {'C', 'P', 'S', 'T'};
+    uint32_t version = 2;
+
+    uint64_t fft_size = 0;
+    int32_t num_shifts = 0;
+    int32_t num_signals = 0;
+    int32_t num_output_points = 0;
+    float scale_factor = 0.0f;
+
+    // Выбранные настройки
+    uint8_t peaks_encoding = 0;        // PeaksEncoding
+    uint8_t step_flags = 0;            // kCheckpointStep1 | Step2 | Step3 | Tuning
+    uint16_t reserved = 0;
+    float detection_threshold = 0.0f;
+    uint32_t max_detections = 0;
+
+    uint64_t plan_keys[3][2] = {};     // {fft_size, batch} для Step 1, 2, 3
+    char device_name[128] = {};
+    int64_t created_unix = 0;
+
+    // Настройки бэкенда (при kCheckpointTuning)
+    uint8_t tuning_step2_path = 0;
+    uint8_t tuning_fused = 0;
+    uint16_t tuning_reserved = 0;
+    int32_t tuning_step2_split = 1;
+    char tuning_device[192] = {};      // Устройство | драйвер, на которых выбраны настройки
+};
+
+enum CheckpointStepFlags : uint8_t {
+    kCheckpointStep1 = 1 << 0,
+    kCheckpointStep2 = 1 << 1,
+    kCheckpointStep3 = 1 << 2,
+    kCheckpointTuning = 1 << 3
+};
+
+/**
+ * @class PipelineCheckpoint
+ * @brief Бинарный checkpoint на базе ChunkArchive (чтение через mmap)
+ *
+ * Потоки:
+ *   State        [1] CheckpointState
+ *   ReferenceFFT [shifts][N] ComplexFloat   (после Step 1, с сопряжением)
+ *   InputFFT     [signals][N] ComplexFloat  (последний Step 2)
+ *   Peaks        [signals][shifts * n_kg]   (последний Step 3)
+ *
+ * Запись идёт во временный файл с последующим rename, поэтому при падении
+ * во время сохранения предыдущий checkpoint остаётся целым.
+ */
+class PipelineCheckpoint {
+public:
+    enum Stream : uint32_t {
+        State = 0,
+        ReferenceFFT = 1,
+        InputFFT = 2,
+        Peaks = 3
+    };
+
+    /**
+     * @brief Заполнить форму, настройки и ключи планов из конфигурации
+     */
+    static CheckpointState makeState(const IConfiguration& config, const std::string& device_name) {
+        CheckpointState state;
+        state.fft_size = config.getFFTSize();
+        state.num_shifts = config.getNumShifts();
+        state.num_signals = config.getNumSignals();
+        state.num_output_points = config.getNumOutputPoints();
+        state.scale_factor = config.getScaleFactor();
+
+        const PeaksEncodingParams& encoding = config.getPeaksEncoding();
+        state.peaks_encoding = static_cast<uint8_t>(encoding.encoding);
+        state.detection_threshold = encoding.detection_threshold;
+        state.max_detections = static_cast<uint32_t>(encoding.max_detections);
+
+        planKeys(config, state.plan_keys);
+        std::strncpy(state.device_name, device_name.c_str(), sizeof(state.device_name) - 1);
+        state.created_unix = static_cast<int64_t>(std::time(nullptr));
+        return state;
+    }
+
+    static void planKeys(const IConfiguration& config, uint64_t keys[3][2]) {
+        uint64_t n = config.getFFTSize();
+        keys[0][0] = n; keys[0][1] = static_cast<uint64_t>(config.getNumShifts());
+        keys[1][0] = n; keys[1][1] = static_cast<uint64_t>(config.getNumSignals());
+        keys[2][0] = n; keys[2][1] = static_cast<uint64_t>(config.getNumSignals()) * config.getNumShifts();
+    }
+
+    /**
+     * @brief Совпадает ли форма checkpoint с конфигурацией (иначе спектры не подходят)
+     */
+    static bool matches(const CheckpointState& state, const IConfiguration& config, std::string& reason) {
+        uint64_t keys[3][2];
+        planKeys(config, keys);
+        if (state.fft_size != config.getFFTSize() || state.num_shifts != config.getNumShifts() ||
+            state.num_signals != config.getNumSignals() || state.num_output_points != config.getNumOutputPoints()) {
+            reason = "shape mismatch";
+            return false;
+        }
+        if (std::memcmp(keys, state.plan_keys, sizeof(keys)) != 0) {
+            reason = "plan keys mismatch";
+            return false;
+        }
+        if (state.scale_factor != config.getScaleFactor()) {
+            reason = "scale factor mismatch";
+            return false;
+        }
+        return true;
+    }
+
+    static PeaksEncodingParams encodingOf(const CheckpointState& state) {
+        PeaksEncodingParams params;
+        params.encoding = static_cast<PeaksEncoding>(state.peaks_encoding);
+        params.detection_threshold = state.detection_threshold;
+        params.max_detections = static_cast<int>(state.max_detections);
+        return params;
+    }
+
+    /**
+     * @brief Сохранить checkpoint (пустые span пропускаются)
+     */
+    static bool save(const std::string& path, const CheckpointState& state,
+                     std::span<const ComplexFloat> reference_fft,
+                     std::span<const ComplexFloat> input_fft,
+                     std::span<const float> peaks,
+                     unsigned threads = 0) {
+        const std::string tmp_path = path + ".tmp";
+        const size_t n = state.fft_size;
+        const size_t row = static_cast<size_t>(state.num_shifts) * state.num_output_points;
+        bool ok;
+        {
+            ChunkArchiveWriter writer(tmp_path, threads);
+            writer.setMetadata("{\"type\": \"pipeline_checkpoint\", \"device\": \"" +
+                               std::string(state.device_name) + "\"}");
+            writer.setStreamShape(State, 1, sizeof(CheckpointState));
+            ok = writer.append(State, 0, &state, sizeof(state), 1, 1);
+
+            if (ok && !reference_fft.empty()) {
+                writer.setStreamShape(ReferenceFFT, state.num_shifts, static_cast<uint32_t>(n));
+                ok = reference_fft.size() == n * state.num_shifts &&
+                     writer.append(ReferenceFFT, 0, reference_fft.data(), n * sizeof(ComplexFloat),
+                                   state.num_shifts, sizeof(float));
+            }
+            if (ok && !input_fft.empty()) {
+                writer.setStreamShape(InputFFT, state.num_signals, static_cast<uint32_t>(n));
+                ok = input_fft.size() == n * state.num_signals &&
+                     writer.append(InputFFT, 0, input_fft.data(), n * sizeof(ComplexFloat),
+                                   state.num_signals, sizeof(float));
+            }
+            if (ok && !peaks.empty()) {
+                writer.setStreamShape(Peaks, state.num_signals, state.num_shifts, state.num_output_points);
+                ok = peaks.size() == row * state.num_signals &&
+                     writer.append(Peaks, 0, peaks.data(), row * sizeof(float), state.num_signals, sizeof(float));
+            }
+            ok = writer.finish() && ok;
+        }
+
+        if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // ------------------------------------------------------------------------
+    // Чтение
+    // ------------------------------------------------------------------------
+
+    bool open(const std::string& path) {
+        if (!reader_.open(path) ||
+            !reader_.read(State, 0, &state_, sizeof(state_)) ||
+            std::memcmp(state_.magic, "CPST", 4) != 0 || state_.version != 2) {
+            reader_.close();
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const { return reader_.isOpen(); }
+    const CheckpointState& state() const { return state_; }
+    bool has(Stream stream) const { return reader_.chunkCount(stream) > 0; }
+
+    bool readReferenceFFT(std::vector<ComplexFloat>& output, unsigned threads = 0) const {
+        return has(ReferenceFFT) && reader_.readStream(ReferenceFFT, output, threads);
+    }
+
+    bool readInputFFT(std::vector<ComplexFloat>& output, unsigned threads = 0) const {
+        return has(InputFFT) && reader_.readStream(InputFFT, output, threads);
+    }
+
+    bool readPeaks(std::vector<float>& output, unsigned threads = 0) const {
+        return has(Peaks) && reader_.readStream(Peaks, output, threads);
+    }
+
+private:
+    ChunkArchiveReader reader_;
+    CheckpointState state_;
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_PIPELINE_CHECKPOINT_HPP
@@ -0,0 +1,196 @@
+#ifndef CORRELATOR_PROMETHEUS_EXPORTER_HPP
+#define CORRELATOR_PROMETHEUS_EXPORTER_HPP
+
+#include "MetricsRegistry.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace Correlator {
+
+/**
+ * @class PrometheusExporter
+ * @brief Фоновая выдача MetricsRegistry в текстовом формате Prometheus
+ *
+ * Два режима (можно одновременно):
+ * - startHttp(port): GET на 127.0.0.1:port (любой путь, обычно /metrics)
+ * - startFile(path, interval): периодическая перезапись файла (tmp + rename,
+ *   подходит для node_exporter textfile collector)
+ *
+ * Рендеринг выполняется только в фоновом потоке по запросу/таймеру,
+ * горячий путь pipeline этим классом не затрагивается.
+ */
+class PrometheusExporter {
+public:
+    explicit PrometheusExporter(std::shared_ptr<const MetricsRegistry> registry)
+        : registry_(std::move(registry)) {}
+
+    ~PrometheusExporter() {
+        stop();
+    }
+
+    PrometheusExporter(const PrometheusExporter&) = delete;
+    PrometheusExporter& operator=(const PrometheusExporter&) = delete;
+
+    /**
+     * @brief Запустить HTTP сервер на localhost
+     * @return false, если порт занят или сокет не создан
+     */
+    bool startHttp(uint16_t port) {
+        if (http_thread_.joinable()) {
+            return false;
+        }
+
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+            close(fd);
+            fprintf(stderr, "[METRICS] Cannot listen on 127.0.0.1:%u\n", port);
+            return false;
+        }
+
+        listen_fd_ = fd;
+        running_ = true;
+        http_thread_ = std::thread([this]() { http_loop(); });
+        printf("[METRICS] Prometheus endpoint: http://127.0.0.1:%u/metrics\n", port);
+        return true;
+    }
+
+    /**
+     * @brief Периодически перезаписывать файл с метриками
+     */
+    bool startFile(const std::string& path, std::chrono::milliseconds interval = std::chrono::seconds(5)) {
+        if (file_thread_.joinable()) {
+            return false;
+        }
+        file_path_ = path;
+        running_ = true;
+        file_thread_ = std::thread([this, interval]() {
+            std::unique_lock<std::mutex> lock(stop_mutex_);
+            while (running_) {
+                lock.unlock();
+                writeFile();
+                lock.lock();
+                stop_cv_.wait_for(lock, interval, [this]() { return !running_; });
+            }
+        });
+        printf("[METRICS] Prometheus textfile: %s\n", path.c_str());
+        return true;
+    }
+
+    /**
+     * @brief Записать файл немедленно (также вызывается при stop)
+     */
+    bool writeFile() const {
+        if (file_path_.empty()) {
+            return false;
+        }
+        std::string tmp_path = file_path_ + ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::trunc);
+            if (!file.is_open()) {
+                return false;
+            }
+            file << registry_->renderPrometheus();
+        }
+        return std::rename(tmp_path.c_str(), file_path_.c_str()) == 0;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(stop_mutex_);
+            running_ = false;
+        }
+        stop_cv_.notify_all();
+
+        if (http_thread_.joinable()) {
+            http_thread_.join();
+        }
+        if (listen_fd_ >= 0) {
+            close(listen_fd_);
+            listen_fd_ = -1;
+        }
+        if (file_thread_.joinable()) {
+            file_thread_.join();
+            writeFile();  // Финальные значения после завершения работы
+        }
+    }
+
+private:
+    static constexpr int kClientTimeoutMs = 500;
+
+    std::shared_ptr<const MetricsRegistry> registry_;
+    std::atomic<bool> running_{false};
+
+    int listen_fd_ = -1;
+    std::thread http_thread_;
+
+    std::string file_path_;
+    std::thread file_thread_;
+    std::mutex stop_mutex_;
+    std::condition_variable stop_cv_;
+
+    void http_loop() {
+        while (running_) {
+            // poll с таймаутом, чтобы stop() не ждал следующего запроса
+            pollfd pfd{listen_fd_, POLLIN, 0};
+            if (poll(&pfd, 1, 200) <= 0) {
+                continue;
+            }
+            int client = accept(listen_fd_, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+
+            // Молчащий клиент не должен держать поток (и stop() в join):
+            // чтение и отправка ограничены таймаутом
+            timeval timeout{0, kClientTimeoutMs * 1000};
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+            // Запрос не разбираем: на любой GET отдаём метрики
+            char request[1024];
+            (void)recv(client, request, sizeof(request), 0);
+
+            std::string body = registry_->renderPrometheus();
+            std::string response =
+                "HTTP/1.1 200 OK\r\n"
+                "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                "Connection: close\r\n\r\n" + body;
+
+            size_t sent = 0;
+            while (sent < response.size()) {
+                ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) break;
+                sent += static_cast<size_t>(n);
+            }
+            close(client);
+        }
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_PROMETHEUS_EXPORTER_HPP
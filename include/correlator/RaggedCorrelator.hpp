@@ -0,0 +1,361 @@
+#ifndef CORRELATOR_RAGGED_CORRELATOR_HPP
+#define CORRELATOR_RAGGED_CORRELATOR_HPP
+
+#include "IConfiguration.hpp"
+#include "IFFTBackend.hpp"
+#include "PeaksView.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// Ragged батч: сигналы разной длины одним блоком
+// ============================================================================
+
+/**
+ * Не владеющее представление: сигнал i — samples[offsets[i], offsets[i] + lengths[i])
+ * Сигналы могут идти в samples в любом порядке и с промежутками.
+ */
+struct RaggedBatchView {
+    std::span<const int32_t> samples;
+    std::span<const size_t> offsets;
+    std::span<const size_t> lengths;
+
+    size_t size() const { return offsets.size(); }
+
+    std::span<const int32_t> signal(size_t i) const {
+        return samples.subspan(offsets[i], lengths[i]);
+    }
+
+    bool valid() const {
+        if (offsets.size() != lengths.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < offsets.size(); ++i) {
+            if (lengths[i] == 0 || offsets[i] > samples.size() || lengths[i] > samples.size() - offsets[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/**
+ * @class RaggedBatch
+ * @brief Хранилище ragged батча: сигналы дописываются подряд, таблица смещений строится сама
+ */
+class RaggedBatch {
+public:
+    void add(std::span<const int32_t> signal) {
+        offsets_.push_back(samples_.size());
+        lengths_.push_back(signal.size());
+        samples_.insert(samples_.end(), signal.begin(), signal.end());
+    }
+
+    void clear() {
+        samples_.clear();
+        offsets_.clear();
+        lengths_.clear();
+    }
+
+    size_t size() const { return offsets_.size(); }
+    RaggedBatchView view() const { return {samples_, offsets_, lengths_}; }
+
+private:
+    std::vector<int32_t> samples_;
+    std::vector<size_t> offsets_;
+    std::vector<size_t> lengths_;
+};
+
+// ============================================================================
+// Выбор размера FFT для сигнала
+// ============================================================================
+
+/**
+ * PowerOfTwo — ближайшая степень двойки (форма планов как в основном pipeline)
+ * Smooth     — ближайшее 2^a·3^b·5^c·7^d (радиксы clFFT): дополнение нулями
+ *              не больше нескольких процентов вместо до 2×
+ */
+enum class RaggedBucketing : uint8_t {
+    PowerOfTwo,
+    Smooth
+};
+
+inline bool isSmoothFFTSize(size_t n) {
+    if (n == 0) {
+        return false;
+    }
+    for (size_t radix : {2, 3, 5, 7}) {
+        while (n % radix == 0) {
+            n /= radix;
+        }
+    }
+    return n == 1;
+}
+
+inline size_t raggedFFTSize(size_t length, RaggedBucketing bucketing, size_t min_fft_size = 1) {
+    size_t n = std::max<size_t>({length, min_fft_size, 1});
+    if (bucketing == RaggedBucketing::Smooth) {
+        while (!isSmoothFFTSize(n)) {
+            ++n;
+        }
+        return n;
+    }
+    size_t pow2 = 1;
+    while (pow2 < n) {
+        pow2 <<= 1;
+    }
+    return pow2;
+}
+
+// ============================================================================
+// RaggedCorrelator
+// ============================================================================
+
+struct RaggedCorrelatorOptions {
+    RaggedBucketing bucketing = RaggedBucketing::PowerOfTwo;
+    size_t min_fft_size = 64;      // Короткие сигналы не дробят бакеты
+};
+
+/**
+ * Фабрика бэкенда бакета: fft_size — размер FFT бакета,
+ * bucket_signals — размер батча его планов
+ */
+using RaggedBackendFactory =
+    std::function<std::unique_ptr<IFFTBackend>(size_t fft_size, int bucket_signals)>;
+
+/**
+ * Статистика бакета за последний process()
+ */
+struct RaggedBucketStats {
+    size_t fft_size = 0;
+    int signals = 0;               // Сигналов батча в бакете
+    int capacity = 0;              // Размер батча плана (≥ signals)
+    size_t samples = 0;            // Реальных отсчётов
+    size_t padded_samples = 0;     // Отсчётов после дополнения (capacity × fft_size)
+    double step1_ms = 0.0;         // 0, если спектры опорного уже готовы
+    double step2_ms = 0.0;
+    double step3_ms = 0.0;
+};
+
+/**
+ * @class RaggedCorrelator
+ * @brief Корреляция батча сигналов разной длины без дополнения до максимальной
+ *
+ * Сигналы группируются по размеру FFT (raggedFFTSize). У каждого бакета свой
+ * бэкенд с планами под его размер и свои спектры опорного сигнала: опорный
+ * обрезается или дополняется нулями до размера бакета, Step 1 выполняется
+ * один раз на бакет (до смены опорного). Сигнал дополняется нулями только
+ * до размера своего бакета.
+ *
+ * Бэкенд бакета создаётся при первом появлении размера и пересоздаётся,
+ * только если сигналов в бакете стало больше размера батча его планов;
+ * недостающие строки батча заполняются нулями.
+ *
+ * Результат — пики [signals][shifts][n_kg] в исходном порядке сигналов.
+ *
+ * Пример:
+ * @code
+ * RaggedCorrelator ragged(*config, [&](size_t n, int batch) {
+ *     auto backend = std::make_unique<OpenCLFFTBackend>();
+ *     backend->setConfiguration(n, shifts, batch, n_kg, scale);
+ *     return std::unique_ptr<IFFTBackend>(std::move(backend));
+ * });
+ * ragged.setReference(reference_signal);
+ * ragged.process(batch.view());
+ * float p = peakAt(ragged.getPeaksView(), signal, shift, k);
+ * @endcode
+ */
+class RaggedCorrelator {
+public:
+    RaggedCorrelator(const IConfiguration& config, RaggedBackendFactory factory,
+                     RaggedCorrelatorOptions options = {})
+        : factory_(std::move(factory)), options_(options),
+          num_shifts_(config.getNumShifts()), n_kg_(config.getNumOutputPoints()) {}
+
+    ~RaggedCorrelator() {
+        release();
+    }
+
+    RaggedCorrelator(const RaggedCorrelator&) = delete;
+    RaggedCorrelator& operator=(const RaggedCorrelator&) = delete;
+
+    /**
+     * @brief Задать опорный сигнал (Step 1 бакетов выполнится при следующем process)
+     */
+    bool setReference(std::span<const int32_t> reference) {
+        if (reference.empty()) {
+            return false;
+        }
+        reference_.assign(reference.begin(), reference.end());
+        for (auto& [fft_size, bucket] : buckets_) {
+            bucket.reference_ready = false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Step 1 (при необходимости) + Step 2 + Step 3 по бакетам
+     * @return false при неверной таблице смещений или ошибке бэкенда
+     */
+    bool process(const RaggedBatchView& batch) {
+        if (reference_.empty() || !batch.valid()) {
+            return false;
+        }
+
+        // Распределить сигналы по размерам FFT (порядок внутри бакета — исходный)
+        std::map<size_t, std::vector<size_t>> groups;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            groups[raggedFFTSize(batch.lengths[i], options_.bucketing, options_.min_fft_size)].push_back(i);
+        }
+
+        peaks_.reshape(static_cast<int>(batch.size()), num_shifts_, n_kg_);
+        stats_.clear();
+        for (const auto& [fft_size, members] : groups) {
+            if (!process_bucket(fft_size, members, batch)) {
+                fprintf(stderr, "[RAGGED] Bucket N=%zu failed\n", fft_size);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ConstPeaksView getPeaksView() const { return peaks_.view(); }
+    std::span<const float> peaks() const { return peaks_.span(); }
+
+    const std::vector<RaggedBucketStats>& bucketStats() const { return stats_; }
+    size_t bucketCount() const { return buckets_.size(); }
+
+    /**
+     * @brief Отсчётов после дополнения за последний process() (для сравнения с max_length × signals)
+     */
+    size_t paddedSamples() const {
+        size_t total = 0;
+        for (const auto& bucket : stats_) total += bucket.padded_samples;
+        return total;
+    }
+
+    /**
+     * @brief Освободить бэкенды всех бакетов
+     */
+    void release() {
+        for (auto& [fft_size, bucket] : buckets_) {
+            if (bucket.backend) {
+                bucket.backend->cleanup();
+            }
+        }
+        buckets_.clear();
+    }
+
+private:
+    struct Bucket {
+        std::unique_ptr<IFFTBackend> backend;
+        int capacity = 0;
+        bool reference_ready = false;
+        std::vector<int32_t> staging;   // [capacity][fft_size], переиспользуется
+        PeaksBuffer peaks;
+    };
+
+    RaggedBackendFactory factory_;
+    RaggedCorrelatorOptions options_;
+    int num_shifts_;
+    int n_kg_;
+
+    std::vector<int32_t> reference_;
+    std::map<size_t, Bucket> buckets_;
+    PeaksBuffer peaks_;
+    std::vector<RaggedBucketStats> stats_;
+
+    using Clock = std::chrono::steady_clock;
+
+    static double elapsed_ms(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    bool ensure_backend(size_t fft_size, Bucket& bucket, int signals) {
+        if (bucket.backend && bucket.capacity >= signals) {
+            return true;
+        }
+        if (bucket.backend) {
+            printf("[RAGGED] Bucket N=%zu grows: %d -> %d signals\n", fft_size, bucket.capacity, signals);
+            bucket.backend->cleanup();
+        }
+        bucket.backend = factory_(fft_size, signals);
+        bucket.capacity = signals;
+        bucket.reference_ready = false;
+        return bucket.backend && bucket.backend->initialize();
+    }
+
+    bool process_bucket(size_t fft_size, const std::vector<size_t>& members, const RaggedBatchView& batch) {
+        Bucket& bucket = buckets_[fft_size];
+        const int signals = static_cast<int>(members.size());
+        if (!ensure_backend(fft_size, bucket, signals)) {
+            bucket.backend.reset();
+            bucket.capacity = 0;
+            return false;
+        }
+
+        RaggedBucketStats stats;
+        stats.fft_size = fft_size;
+        stats.signals = signals;
+        stats.capacity = bucket.capacity;
+        stats.padded_samples = static_cast<size_t>(bucket.capacity) * fft_size;
+
+        OperationTiming upload, fft;
+        if (!bucket.reference_ready) {
+            // Опорный под размер бакета: обрезка или дополнение нулями
+            std::vector<int32_t> reference(fft_size, 0);
+            std::copy_n(reference_.begin(), std::min(fft_size, reference_.size()), reference.begin());
+            auto start = Clock::now();
+            if (!bucket.backend->step1_ProcessReferenceSignals(reference, num_shifts_, upload, fft)) {
+                return false;
+            }
+            stats.step1_ms = elapsed_ms(start);
+            bucket.reference_ready = true;
+        }
+
+        bucket.staging.assign(static_cast<size_t>(bucket.capacity) * fft_size, 0);
+        for (int row = 0; row < signals; ++row) {
+            std::span<const int32_t> signal = batch.signal(members[row]);
+            std::copy(signal.begin(), signal.end(), bucket.staging.begin() + row * fft_size);
+            stats.samples += signal.size();
+        }
+
+        auto start = Clock::now();
+        if (!bucket.backend->step2_ProcessInputSignals(bucket.staging, bucket.capacity, upload, fft)) {
+            return false;
+        }
+        stats.step2_ms = elapsed_ms(start);
+
+        OperationTiming copy, ifft, download;
+        start = Clock::now();
+        bucket.peaks.reshape(bucket.capacity, num_shifts_, n_kg_);
+        if (!bucket.backend->step3_ComputeCorrelation(bucket.capacity, num_shifts_, n_kg_, copy, ifft, download) ||
+            !bucket.backend->readCorrelationPeaks(bucket.peaks.span())) {
+            return false;
+        }
+        stats.step3_ms = elapsed_ms(start);
+
+        // Строки бакета → исходные номера сигналов
+        const size_t row_size = static_cast<size_t>(num_shifts_) * n_kg_;
+        std::span<const float> source = bucket.peaks.span();
+        float* target = peaks_.span().data();
+        for (int row = 0; row < signals; ++row) {
+            std::copy_n(source.begin() + row * row_size, row_size, target + members[row] * row_size);
+        }
+
+        stats_.push_back(stats);
+        return true;
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_RAGGED_CORRELATOR_HPP
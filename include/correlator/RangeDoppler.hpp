@@ -0,0 +1,246 @@
+#ifndef CORRELATOR_RANGE_DOPPLER_HPP
+#define CORRELATOR_RANGE_DOPPLER_HPP
+
+#include "CpuFFT.hpp"
+#include "IDataSnapshot.hpp"
+#include "ParallelChunks.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// Импульсно-доплеровская обработка поверх Step 3 (карта дальность-доплер)
+// ============================================================================
+
+/**
+ * Входные сигналы батча — последовательные импульсы (медленное время),
+ * выход Step 3 для опорного сдвига s — профили дальности:
+ *
+ *   profile_p[r] = IFFT(R_s · conj(X_p))[r],  r < range_bins
+ *
+ * Step 3 сопрягает спектр входа, поэтому фаза цели по импульсам тоже
+ * сопряжена: при перестановке (corner turn) отсчёт сопрягается обратно,
+ * умножается на окно w[p] и дополняется нулями до doppler_size. FFT по
+ * медленному времени для каждого дальностного отсчёта, затем |·|².
+ *
+ * Карта [range_bins][doppler_size], доплер со сдвигом нуля в центр:
+ * столбец c ↔ доплеровский бин k = c − doppler_size/2 (частота k/doppler_size
+ * частоты повторения импульсов).
+ *
+ * CFAR — усредняющий (CA-CFAR) по дальности в каждом доплеровском столбце:
+ * training_cells обучающих ячеек с каждой стороны за guard_cells защитными
+ * (у краёв — только существующие), порог threshold_scale · среднее.
+ */
+
+enum class DopplerWindow : uint8_t {
+    Rectangular = 0,
+    Hann = 1,
+    Hamming = 2,
+    Blackman = 3
+};
+
+inline const char* dopplerWindowName(DopplerWindow window) {
+    switch (window) {
+        case DopplerWindow::Rectangular: return "rect";
+        case DopplerWindow::Hann: return "hann";
+        case DopplerWindow::Hamming: return "hamming";
+        case DopplerWindow::Blackman: return "blackman";
+    }
+    return "unknown";
+}
+
+inline bool parseDopplerWindow(const std::string& name, DopplerWindow& window) {
+    for (DopplerWindow candidate : {DopplerWindow::Rectangular, DopplerWindow::Hann,
+                                    DopplerWindow::Hamming, DopplerWindow::Blackman}) {
+        if (name == dopplerWindowName(candidate)) {
+            window = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Коэффициенты окна по num_pulses импульсам (симметричное окно)
+ */
+inline std::vector<float> dopplerWindowCoefficients(DopplerWindow window, size_t num_pulses) {
+    std::vector<float> w(num_pulses, 1.0f);
+    if (num_pulses < 2 || window == DopplerWindow::Rectangular) {
+        return w;
+    }
+    const double step = 2.0 * 3.14159265358979323846 / static_cast<double>(num_pulses - 1);
+    for (size_t p = 0; p < num_pulses; ++p) {
+        const double phase = step * static_cast<double>(p);
+        switch (window) {
+            case DopplerWindow::Hann: w[p] = static_cast<float>(0.5 - 0.5 * std::cos(phase)); break;
+            case DopplerWindow::Hamming: w[p] = static_cast<float>(0.54 - 0.46 * std::cos(phase)); break;
+            case DopplerWindow::Blackman:
+                w[p] = static_cast<float>(0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase));
+                break;
+            default: break;
+        }
+    }
+    return w;
+}
+
+/**
+ * @struct RangeDopplerParams
+ * @brief Параметры карты дальность-доплер и CFAR
+ */
+struct RangeDopplerParams {
+    int num_pulses = 0;             // Импульсов: первые строки батча Step 3
+    int shift = 0;                  // Опорный сдвиг (строка Step 3 внутри сигнала)
+    int range_bins = 0;             // Дальностных отсчётов с начала профиля (≤ N)
+    size_t doppler_size = 0;        // Длина FFT по импульсам (0 — num_pulses, больше — нули)
+    DopplerWindow window = DopplerWindow::Hann;
+
+    int guard_cells = 2;            // CFAR: защитные ячейки с каждой стороны
+    int training_cells = 0;         // CFAR: обучающие ячейки с каждой стороны (0 — CFAR выключен)
+    float threshold_scale = 10.0f;  // CFAR: порог = scale · средняя мощность обучающих ячеек
+    uint32_t max_detections = 4096; // Больше — отбрасываются (счётчик остаётся полным)
+
+    size_t dopplerSize() const {
+        return doppler_size ? doppler_size : static_cast<size_t>(std::max(num_pulses, 0));
+    }
+    bool cfarEnabled() const { return training_cells > 0; }
+};
+
+/**
+ * @struct RangeDopplerDetection
+ * @brief Ячейка карты выше порога CFAR
+ */
+struct RangeDopplerDetection {
+    uint32_t range = 0;             // Дальностный отсчёт
+    uint32_t doppler = 0;           // Столбец карты (бин k = doppler − doppler_size/2)
+    float power = 0.0f;             // |·|² в ячейке
+    float noise = 0.0f;             // Оценка шума (среднее обучающих ячеек)
+};
+
+/**
+ * Доплеровский бин (со знаком) для столбца карты
+ */
+inline int rangeDopplerBin(uint32_t column, size_t doppler_size) {
+    return static_cast<int>(column) - static_cast<int>(doppler_size / 2);
+}
+
+/**
+ * Детекции упорядочиваются по (дальность, доплер): устройство дописывает их в произвольном порядке
+ */
+inline void sortRangeDopplerDetections(std::vector<RangeDopplerDetection>& detections) {
+    std::sort(detections.begin(), detections.end(), [](const RangeDopplerDetection& a, const RangeDopplerDetection& b) {
+        return a.range != b.range ? a.range < b.range : a.doppler < b.doppler;
+    });
+}
+
+/**
+ * @brief CA-CFAR по дальности в каждом доплеровском столбце (CPU)
+ * @return Сколько ячеек прошло порог (детекций в выходе не больше max_detections)
+ */
+inline size_t detectRangeDopplerCFAR(std::span<const float> map, size_t range_bins, size_t doppler_size,
+                                     const RangeDopplerParams& params,
+                                     std::vector<RangeDopplerDetection>& detections) {
+    detections.clear();
+    size_t found = 0;
+    const long long guard = params.guard_cells;
+    const long long training = params.training_cells;
+    for (size_t r = 0; r < range_bins; ++r) {
+        for (size_t c = 0; c < doppler_size; ++c) {
+            double sum = 0.0;
+            int count = 0;
+            for (long long offset = guard + 1; offset <= guard + training; ++offset) {
+                const long long before = static_cast<long long>(r) - offset;
+                const long long after = static_cast<long long>(r) + offset;
+                if (before >= 0) {
+                    sum += map[static_cast<size_t>(before) * doppler_size + c];
+                    ++count;
+                }
+                if (after < static_cast<long long>(range_bins)) {
+                    sum += map[static_cast<size_t>(after) * doppler_size + c];
+                    ++count;
+                }
+            }
+            if (count == 0) continue;
+            const float noise = static_cast<float>(sum / count);
+            const float power = map[r * doppler_size + c];
+            if (power > params.threshold_scale * noise) {
+                if (found < params.max_detections) {
+                    detections.push_back({static_cast<uint32_t>(r), static_cast<uint32_t>(c), power, noise});
+                }
+                ++found;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief CPU реализация по спектрам Step 1/2 (эталон и запасной путь)
+ * @param reference_spectra [num_shifts][fft_size] в формате getReferenceFFT (R_s)
+ * @param input_spectra [num_signals][fft_size] в формате getInputFFT (X_p)
+ * @param map [range_bins][doppler_size] мощность, доплер со сдвигом нуля в центр
+ * @param detections_found Ячеек выше порога CFAR (0, если CFAR выключен)
+ */
+inline bool computeRangeDoppler(std::span<const ComplexFloat> reference_spectra,
+                                std::span<const ComplexFloat> input_spectra, size_t fft_size,
+                                const RangeDopplerParams& params, std::vector<float>& map,
+                                std::vector<RangeDopplerDetection>& detections, size_t& detections_found,
+                                unsigned threads = 0) {
+    const size_t pulses = static_cast<size_t>(std::max(params.num_pulses, 0));
+    const size_t doppler_size = params.dopplerSize();
+    const size_t range_bins = static_cast<size_t>(std::max(params.range_bins, 0));
+    if (pulses == 0 || range_bins == 0 || range_bins > fft_size || doppler_size < pulses || params.shift < 0 ||
+        reference_spectra.size() < (static_cast<size_t>(params.shift) + 1) * fft_size ||
+        input_spectra.size() < pulses * fft_size) {
+        return false;
+    }
+
+    using Complex = CpuFFTPlan::Complex;
+    const std::vector<float> window = dopplerWindowCoefficients(params.window, pulses);
+    const CpuFFTPlan range_plan(fft_size);
+    const CpuFFTPlan doppler_plan(doppler_size);
+    const ComplexFloat* reference = reference_spectra.data() + static_cast<size_t>(params.shift) * fft_size;
+    const float inv_n = 1.0f / static_cast<float>(fft_size);
+
+    // Профили дальности импульсов сразу в раскладке медленного времени [range][doppler_size]
+    std::vector<Complex> slow(range_bins * doppler_size, Complex(0.0f, 0.0f));
+    parallelChunks(pulses, threads, [&](size_t p) {
+        thread_local std::vector<Complex> profile, scratch;
+        profile.resize(fft_size);
+        scratch.resize(range_plan.scratchSize());
+        const ComplexFloat* x = input_spectra.data() + p * fft_size;
+        for (size_t k = 0; k < fft_size; ++k) {
+            profile[k] = Complex(reference[k].real * x[k].real + reference[k].imag * x[k].imag,
+                                 reference[k].imag * x[k].real - reference[k].real * x[k].imag);
+        }
+        range_plan.inverse(profile.data(), scratch.data());
+        for (size_t r = 0; r < range_bins; ++r) {
+            slow[r * doppler_size + p] = std::conj(profile[r]) * (inv_n * window[p]);
+        }
+    });
+
+    map.assign(range_bins * doppler_size, 0.0f);
+    const size_t half = doppler_size / 2;
+    parallelChunks(range_bins, threads, [&](size_t r) {
+        thread_local std::vector<Complex> scratch;
+        scratch.resize(doppler_plan.scratchSize());
+        Complex* row = slow.data() + r * doppler_size;
+        doppler_plan.forward(row, scratch.data());
+        for (size_t c = 0; c < doppler_size; ++c) {
+            map[r * doppler_size + c] = std::norm(row[(c + doppler_size - half) % doppler_size]);
+        }
+    });
+
+    detections.clear();
+    detections_found = params.cfarEnabled()
+        ? detectRangeDopplerCFAR(map, range_bins, doppler_size, params, detections) : 0;
+    return true;
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_RANGE_DOPPLER_HPP
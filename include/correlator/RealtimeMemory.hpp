@@ -0,0 +1,198 @@
+#ifndef CORRELATOR_REALTIME_MEMORY_HPP
+#define CORRELATOR_REALTIME_MEMORY_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <span>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace Correlator {
+
+// ============================================================================
+// Режим реального времени: память без page fault'ов на батче, закрепление потока
+// ============================================================================
+
+/**
+ * Хвост задержки батча (p99.9) дают page fault'ы и ленивые аллокации: первое
+ * касание большого вектора, malloc через mmap для больших блоков и возврат
+ * памяти ядру (trim) после free. Режим убирает их так:
+ *
+ *  1. Все буферы выделяются в initialize() на полный батч (pipeline и бэкенд);
+ *  2. enableRealtimeMode() после initialize():
+ *     - malloc без mmap и без trim (glibc) — освобождённая память остаётся
+ *       в куче, повторные аллокации не трогают новые страницы;
+ *     - mlockall(MCL_CURRENT | MCL_FUTURE) — текущие страницы резидентны,
+ *       будущие отображения заполняются сразу при создании;
+ *     - стек потока префолтится на stack_bytes;
+ *     - поток закрепляется за CPU, опционально SCHED_FIFO.
+ *
+ * mlockall требует RLIMIT_MEMLOCK (ulimit -l) или CAP_IPC_LOCK, SCHED_FIFO —
+ * CAP_SYS_NICE: при отказе режим продолжает работу без этой части, результат
+ * каждой части — в RealtimeStatus. mlockall действует на весь процесс и не
+ * отменяется до его завершения.
+ */
+
+/**
+ * @struct RealtimeOptions
+ * @brief Что включать в режиме реального времени
+ */
+struct RealtimeOptions {
+    bool lock_memory = true;            // mallopt + mlockall
+    bool prefault = true;               // Префолт буферов и стека
+    int cpu = -1;                       // Закрепить вызывающий поток за CPU (−1 — нет)
+    int fifo_priority = 0;              // SCHED_FIFO с этим приоритетом (0 — политика не меняется)
+    size_t stack_bytes = 256 * 1024;    // Префолт стека вызывающего потока
+};
+
+/**
+ * @struct RealtimeStatus
+ * @brief Что удалось включить (часть может не пройти по правам)
+ */
+struct RealtimeStatus {
+    bool malloc_tuned = false;
+    bool memory_locked = false;
+    bool thread_pinned = false;
+    bool fifo_scheduling = false;
+    size_t prefaulted_bytes = 0;        // Буферы pipeline + стек
+};
+
+/**
+ * @brief Коснуться каждой страницы диапазона на запись (значения не меняются)
+ */
+inline size_t prefaultRange(void* data, size_t bytes) {
+    if (!data || bytes == 0) {
+        return 0;
+    }
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    volatile unsigned char* bytes_ptr = static_cast<unsigned char*>(data);
+    for (size_t offset = 0; offset < bytes; offset += page) {
+        bytes_ptr[offset] = bytes_ptr[offset];
+    }
+    bytes_ptr[bytes - 1] = bytes_ptr[bytes - 1];
+    return bytes;
+}
+
+template <class T>
+size_t prefaultSpan(std::span<T> values) {
+    return prefaultRange(const_cast<std::remove_const_t<T>*>(values.data()), values.size_bytes());
+}
+
+/**
+ * @brief Префолт стека: глубина вызова не должна дойти до нетронутой страницы на батче
+ */
+[[gnu::noinline]] inline size_t prefaultStack(size_t bytes) {
+    constexpr size_t kChunk = 16 * 1024;
+    volatile unsigned char chunk[kChunk];
+    for (size_t offset = 0; offset < kChunk; offset += 1024) {
+        chunk[offset] = 0;  // volatile: запись не выбрасывается компилятором
+    }
+    static_cast<void>(chunk[0]);
+    return bytes > kChunk ? kChunk + prefaultStack(bytes - kChunk) : kChunk;
+}
+
+/**
+ * @brief malloc без mmap для больших блоков и без возврата памяти ядру (только glibc)
+ */
+inline bool tuneMallocForRealtime() {
+#if defined(__GLIBC__)
+    return mallopt(M_MMAP_MAX, 0) == 1 && mallopt(M_TRIM_THRESHOLD, -1) == 1;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Закрепить вызывающий поток за одним CPU
+ */
+inline bool pinCurrentThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        fprintf(stderr, "[RT] pthread_setaffinity_np(cpu %d) failed: %s\n", cpu, strerror(err));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief SCHED_FIFO для вызывающего потока
+ */
+inline bool setFifoPriority(int priority) {
+    sched_param param{};
+    param.sched_priority = priority;
+    const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+        fprintf(stderr, "[RT] SCHED_FIFO(%d) failed: %s\n", priority, strerror(err));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Процессные и потоковые настройки режима (буферы префолтит pipeline)
+ */
+inline RealtimeStatus enableRealtimeMode(const RealtimeOptions& options) {
+    RealtimeStatus status;
+    if (options.lock_memory) {
+        status.malloc_tuned = tuneMallocForRealtime();
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            status.memory_locked = true;
+        } else {
+            fprintf(stderr, "[RT] mlockall failed: %s (ulimit -l / CAP_IPC_LOCK)\n", strerror(errno));
+        }
+    }
+    if (options.prefault && options.stack_bytes > 0) {
+        status.prefaulted_bytes += prefaultStack(options.stack_bytes);
+    }
+    if (options.cpu >= 0) {
+        status.thread_pinned = pinCurrentThread(options.cpu);
+    }
+    if (options.fifo_priority > 0) {
+        status.fifo_scheduling = setFifoPriority(options.fifo_priority);
+    }
+    return status;
+}
+
+/**
+ * @struct PageFaultCounters
+ * @brief Page fault'ы вызывающего потока (getrusage RUSAGE_THREAD)
+ */
+struct PageFaultCounters {
+    uint64_t minor = 0;
+    uint64_t major = 0;
+
+    static PageFaultCounters current() {
+        PageFaultCounters counters;
+        rusage usage{};
+        if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+            counters.minor = static_cast<uint64_t>(usage.ru_minflt);
+            counters.major = static_cast<uint64_t>(usage.ru_majflt);
+        }
+        return counters;
+    }
+
+    PageFaultCounters operator-(const PageFaultCounters& start) const {
+        return {minor - start.minor, major - start.major};
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_REALTIME_MEMORY_HPP
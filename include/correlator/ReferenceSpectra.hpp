@@ -0,0 +1,212 @@
+#ifndef CORRELATOR_REFERENCE_SPECTRA_HPP
+#define CORRELATOR_REFERENCE_SPECTRA_HPP
+
+#include "CpuFFT.hpp"
+#include "IDataSnapshot.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// Аналитические спектры опорных сигналов (Step 1 без FFT по сдвигам)
+// ============================================================================
+
+/**
+ * Банк Step 1 — строка s = conj(FFT(scale·ref[(n + s) mod N])). Циклический
+ * сдвиг во времени — фазовый множитель в частоте, поэтому весь банк задаётся
+ * одним спектром X = FFT(ref):
+ *
+ *   R_s[k] = conj(scale·X[k]) · e^{−j2πks/N}
+ *
+ * Базовая строка R_0 = conj(scale·X) (referenceBaseSpectrum) загружается
+ * вместо N·num_shifts значений, остальные строки разворачиваются на месте
+ * (expandReferenceBank / kernel expand_reference_shifts) — O(N) на строку.
+ *
+ * Спектр X строится без FFT длины N там, где он известен заранее:
+ *  - ЛЧМ (chirp) — метод стационарной фазы, O(N); точный режим — одно FFT
+ *    синтезированного сигнала (всё равно одно вместо num_shifts);
+ *  - периодический код c длины P, N % P == 0 — спектр разрежен: ненулевые
+ *    только бины k = m·(N/P), X[k] = (N/P)·C[m], C = DFT_P(c), O(N + P log P).
+ *
+ * Частоты — в циклах на отсчёт (доли частоты дискретизации, 0 … 0.5).
+ */
+
+enum class ChirpSpectrumMethod : uint8_t {
+    Exact = 0,              // FFT синтезированного сигнала (без округления до int32)
+    StationaryPhase = 1     // Метод стационарной фазы, O(N); точен при B·L ≫ 1
+};
+
+/**
+ * @struct ChirpReference
+ * @brief Вещественный ЛЧМ: x[n] = A·cos(2π(f0·n + μn²/2)), μ = B/L, n < L, дальше нули
+ */
+struct ChirpReference {
+    double start_frequency = 0.0;   // f0, циклов на отсчёт
+    double bandwidth = 0.0;         // B (< 0 — убывающая частота), f0 + B ≤ 0.5
+    size_t length = 0;              // L (0 — весь кадр N)
+    double amplitude = 1.0;         // A в единицах отсчётов int32
+
+    size_t effectiveLength(size_t fft_size) const {
+        return (length == 0 || length > fft_size) ? fft_size : length;
+    }
+    double chirpRate(size_t fft_size) const {
+        return bandwidth / static_cast<double>(effectiveLength(fft_size));
+    }
+};
+
+/**
+ * Отсчёты ЛЧМ во времени, округлённые до int32 (для Step 0 и обычного Step 1)
+ */
+inline std::vector<int32_t> chirpReferenceSignal(const ChirpReference& chirp, size_t fft_size) {
+    std::vector<int32_t> signal(fft_size, 0);
+    const size_t length = chirp.effectiveLength(fft_size);
+    const double mu = chirp.chirpRate(fft_size);
+    const double two_pi = 2.0 * std::acos(-1.0);
+    for (size_t n = 0; n < length; ++n) {
+        const double t = static_cast<double>(n);
+        signal[n] = static_cast<int32_t>(std::lround(
+            chirp.amplitude * std::cos(two_pi * (chirp.start_frequency * t + 0.5 * mu * t * t))));
+    }
+    return signal;
+}
+
+/**
+ * @brief Спектр ЛЧМ X = FFT(x) длины fft_size (знаки clFFT, без масштаба)
+ *
+ * Стационарная фаза: для f = k/N точка n* = (f − f0)/μ, |X| = (A/2)/√|μ|,
+ * arg X = −πμn*² + sign(μ)·π/4; бины с n* вне [0, L) — нули. Верхняя
+ * половина спектра — эрмитово сопряжение нижней (сигнал вещественный).
+ */
+inline std::vector<CpuFFTPlan::Complex> chirpReferenceSpectrum(const ChirpReference& chirp, size_t fft_size,
+                                                               ChirpSpectrumMethod method) {
+    using Complex = CpuFFTPlan::Complex;
+    std::vector<Complex> spectrum(fft_size, Complex(0.0f, 0.0f));
+    if (fft_size == 0) {
+        return spectrum;
+    }
+
+    const size_t length = chirp.effectiveLength(fft_size);
+    const double mu = chirp.chirpRate(fft_size);
+    const double pi = std::acos(-1.0);
+
+    if (method == ChirpSpectrumMethod::Exact || mu == 0.0) {
+        for (size_t n = 0; n < length; ++n) {
+            const double t = static_cast<double>(n);
+            spectrum[n] = Complex(static_cast<float>(chirp.amplitude *
+                                  std::cos(2.0 * pi * (chirp.start_frequency * t + 0.5 * mu * t * t))), 0.0f);
+        }
+        const CpuFFTPlan plan(fft_size);
+        std::vector<Complex> scratch(plan.scratchSize());
+        plan.forward(spectrum.data(), scratch.data());
+        return spectrum;
+    }
+
+    const double magnitude = 0.5 * chirp.amplitude / std::sqrt(std::abs(mu));
+    const double quarter = mu > 0.0 ? 0.25 * pi : -0.25 * pi;
+    for (size_t k = 0; k <= fft_size / 2; ++k) {
+        const double f = static_cast<double>(k) / static_cast<double>(fft_size);
+        const double stationary = (f - chirp.start_frequency) / mu;
+        if (stationary < 0.0 || stationary >= static_cast<double>(length)) {
+            continue;
+        }
+        const double phase = -pi * mu * stationary * stationary + quarter;
+        spectrum[k] = Complex(static_cast<float>(magnitude * std::cos(phase)),
+                              static_cast<float>(magnitude * std::sin(phase)));
+    }
+    // Нулевой бин и Найквист вещественны у вещественного сигнала
+    spectrum[0] = Complex(spectrum[0].real(), 0.0f);
+    if (fft_size % 2 == 0) {
+        spectrum[fft_size / 2] = Complex(spectrum[fft_size / 2].real(), 0.0f);
+    }
+    for (size_t k = fft_size / 2 + 1; k < fft_size; ++k) {
+        spectrum[k] = std::conj(spectrum[fft_size - k]);
+    }
+    return spectrum;
+}
+
+/**
+ * Периодический код во времени: x[n] = code[n mod P]
+ */
+inline std::vector<int32_t> periodicCodeSignal(std::span<const int32_t> code, size_t fft_size) {
+    std::vector<int32_t> signal(fft_size, 0);
+    if (code.empty()) {
+        return signal;
+    }
+    for (size_t n = 0; n < fft_size; ++n) {
+        signal[n] = code[n % code.size()];
+    }
+    return signal;
+}
+
+/**
+ * @brief Спектр периодического кода длины fft_size
+ * При fft_size % P == 0 — разреженный (DFT длины P), иначе одно FFT длины N
+ */
+inline std::vector<CpuFFTPlan::Complex> periodicCodeSpectrum(std::span<const int32_t> code, size_t fft_size) {
+    using Complex = CpuFFTPlan::Complex;
+    std::vector<Complex> spectrum(fft_size, Complex(0.0f, 0.0f));
+    if (code.empty() || fft_size == 0) {
+        return spectrum;
+    }
+
+    const size_t period = code.size();
+    const bool sparse = period <= fft_size && fft_size % period == 0;
+    const size_t length = sparse ? period : fft_size;
+    std::vector<Complex> values(length);
+    for (size_t n = 0; n < length; ++n) {
+        values[n] = Complex(static_cast<float>(code[n % period]), 0.0f);
+    }
+    const CpuFFTPlan plan(length);
+    std::vector<Complex> scratch(plan.scratchSize());
+    plan.forward(values.data(), scratch.data());
+    if (!sparse) {
+        return values;
+    }
+
+    const size_t repeats = fft_size / period;
+    for (size_t m = 0; m < period; ++m) {
+        spectrum[m * repeats] = values[m] * static_cast<float>(repeats);
+    }
+    return spectrum;
+}
+
+/**
+ * Базовая строка банка R_0 = conj(scale·X) в формате getReferenceFFT
+ */
+inline std::vector<ComplexFloat> referenceBaseSpectrum(std::span<const CpuFFTPlan::Complex> spectrum, float scale) {
+    std::vector<ComplexFloat> base(spectrum.size());
+    for (size_t k = 0; k < spectrum.size(); ++k) {
+        base[k] = ComplexFloat{spectrum[k].real() * scale, -spectrum[k].imag() * scale};
+    }
+    return base;
+}
+
+/**
+ * @brief Развернуть базовую строку в банк [num_shifts][N]: R_s[k] = R_0[k]·e^{−j2πks/N}
+ * (запасной путь для бэкендов без kernel'а развёртки; угол — по (k·s) mod N)
+ */
+inline std::vector<ComplexFloat> expandReferenceBank(std::span<const ComplexFloat> base, int num_shifts) {
+    const size_t fft_size = base.size();
+    const size_t shifts = static_cast<size_t>(std::max(num_shifts, 0));
+    std::vector<ComplexFloat> bank(shifts * fft_size);
+    const double two_pi = 2.0 * std::acos(-1.0);
+    for (size_t s = 0; s < shifts; ++s) {
+        ComplexFloat* row = bank.data() + s * fft_size;
+        for (size_t k = 0; k < fft_size; ++k) {
+            const uint64_t turns = (static_cast<uint64_t>(k) * s) % fft_size;
+            const double angle = -two_pi * static_cast<double>(turns) / static_cast<double>(fft_size);
+            const float c = static_cast<float>(std::cos(angle));
+            const float sn = static_cast<float>(std::sin(angle));
+            row[k] = ComplexFloat{base[k].real * c - base[k].imag * sn, base[k].real * sn + base[k].imag * c};
+        }
+    }
+    return bank;
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_REFERENCE_SPECTRA_HPP
@@ -2,11 +2,13 @@
 #define CORRELATOR_RESULT_EXPORTER_HPP
 
 #include "IResultExporter.hpp"
+#include "SnapshotArchive.hpp"
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <ctime>
 #include <filesystem>
+#include <cstdio>
 
 namespace Correlator {
 
@@ -22,6 +24,10 @@ private:
     std::string export_path_;
     std::string timestamp_;
     std::string timestamp_dir_;
+    SnapshotFormat snapshot_format_ = SnapshotFormat::Json;
+    std::unique_ptr<ChunkArchiveWriter> archive_;  // Binary: создаётся при первой записи
+
+    static constexpr const char* kArchiveFile = "snapshot.cchk";
 
     std::string getCurrentTimestamp() const {
         auto now = std::time(nullptr);
@@ -49,6 +55,41 @@ private:
         }
     }
 
+    ChunkArchiveWriter* getArchive(const IConfiguration& config) {
+        if (!archive_) {
+            archive_ = std::make_unique<ChunkArchiveWriter>(timestamp_dir_ + "/" + kArchiveFile);
+            if (!archive_->isOpen()) {
+                fprintf(stderr, "[EXPORT] Cannot create %s\n", archive_->path().c_str());
+            }
+        }
+        archive_->setMetadata(config.toJSON());
+        return archive_->isOpen() ? archive_.get() : nullptr;
+    }
+
+    /**
+     * @brief Данные шага: JSON-массив или ссылка на поток архива
+     */
+    std::string stepDataJSON(const IDataSnapshot& snapshot, IDataSnapshot::Step step,
+                             SnapshotStream stream, const IConfiguration& config) {
+        if (snapshot_format_ == SnapshotFormat::Binary) {
+            ChunkArchiveWriter* archive = getArchive(config);
+            if (archive && SnapshotArchive::writeStep(*archive, snapshot, step, config)) {
+                return SnapshotArchive::referenceJSON(kArchiveFile, stream, *archive,
+                                                      SnapshotArchive::stepRows(step, config));
+            }
+        }
+        return snapshot.toJSON(step);
+    }
+
+    // Ссылка на уже записанный поток (финальный отчёт)
+    std::string archivedDataJSON(const IDataSnapshot& snapshot, IDataSnapshot::Step step,
+                                 SnapshotStream stream) const {
+        if (snapshot_format_ == SnapshotFormat::Binary && archive_) {
+            return SnapshotArchive::referenceJSON(kArchiveFile, stream, *archive_);
+        }
+        return snapshot.toJSON(step);
+    }
+
 public:
     ResultExporter() : export_path_("Report/Validation"), timestamp_(getCurrentTimestamp()) {
         // Создать каталог с timestamp: Validation/YYYY-MM-DD_HH-MM-SS
@@ -57,7 +98,25 @@ public:
         ensureDirectoryExists(export_path_);
     }
 
+    ~ResultExporter() override {
+        if (archive_) {
+            archive_->finish();
+        }
+    }
+
+    void setSnapshotFormat(SnapshotFormat format) override {
+        snapshot_format_ = format;
+    }
+
+    SnapshotFormat getSnapshotFormat() const override {
+        return snapshot_format_;
+    }
+
     void setExportPath(const std::string& path) override {
+        if (archive_) {
+            archive_->finish();  // Архив остаётся в прежнем каталоге
+            archive_.reset();
+        }
         export_path_ = path;
         // Пересоздать каталог с timestamp в новом пути
         timestamp_dir_ = export_path_ + "/" + timestamp_;
@@ -93,8 +152,21 @@ public:
         file << "{\n"
              << "  \"step\": \"STEP0_M_SEQUENCE\",\n"
              << "  \"timestamp\": \"" << timestamp_buffer << "\",\n"
-             << "  \"configuration\": " << config.toJSON() << ",\n"
-             << "  \"reference_signal\": [";
+             << "  \"configuration\": " << config.toJSON() << ",\n";
+
+        if (snapshot_format_ == SnapshotFormat::Binary) {
+            ChunkArchiveWriter* archive = getArchive(config);
+            if (archive && SnapshotArchive::writeSignals(*archive, reference_signal, input_signals, config)) {
+                file << "  \"reference_signal\": "
+                     << SnapshotArchive::referenceJSON(kArchiveFile, SnapshotStream::ReferenceSignal, *archive) << ",\n"
+                     << "  \"input_signals\": "
+                     << SnapshotArchive::referenceJSON(kArchiveFile, SnapshotStream::InputSignals, *archive) << "\n"
+                     << "}";
+                return;
+            }
+        }
+
+        file << "  \"reference_signal\": [";
 
         // Экспорт reference_signal
         for (size_t i = 0; i < reference_signal.size(); ++i) {
@@ -149,7 +221,8 @@ public:
              << "  \"step\": \"STEP1_REFERENCE_FFT\",\n"
              << "  \"timestamp\": \"" << snapshot.getTimestamp() << "\",\n"
              << "  \"configuration\": " << config.toJSON() << ",\n"
-             << "  \"data\": " << snapshot.toJSON(IDataSnapshot::Step::STEP1_REFERENCE_FFT) << ",\n"
+             << "  \"data\": " << stepDataJSON(snapshot, IDataSnapshot::Step::STEP1_REFERENCE_FFT,
+                                           SnapshotStream::ReferenceFFT, config) << ",\n"
              << "  \"validation\": " << validation.toJSON() << "\n"
              << "}";
         
@@ -170,7 +243,8 @@ public:
              << "  \"step\": \"STEP2_INPUT_FFT\",\n"
              << "  \"timestamp\": \"" << snapshot.getTimestamp() << "\",\n"
              << "  \"configuration\": " << config.toJSON() << ",\n"
-             << "  \"data\": " << snapshot.toJSON(IDataSnapshot::Step::STEP2_INPUT_FFT) << ",\n"
+             << "  \"data\": " << stepDataJSON(snapshot, IDataSnapshot::Step::STEP2_INPUT_FFT,
+                                           SnapshotStream::InputFFT, config) << ",\n"
              << "  \"validation\": " << validation.toJSON() << "\n"
              << "}";
         
@@ -191,13 +265,42 @@ public:
              << "  \"step\": \"STEP3_CORRELATION\",\n"
              << "  \"timestamp\": \"" << snapshot.getTimestamp() << "\",\n"
              << "  \"configuration\": " << config.toJSON() << ",\n"
-             << "  \"data\": " << snapshot.toJSON(IDataSnapshot::Step::STEP3_PEAKS) << ",\n"
+             << "  \"data\": " << stepDataJSON(snapshot, IDataSnapshot::Step::STEP3_PEAKS,
+                                           SnapshotStream::Peaks, config) << ",\n"
              << "  \"validation\": " << validation.toJSON() << "\n"
              << "}";
         
         file.close();
     }
 
+    void exportEncodedPeaks(const EncodedPeaks& peaks,
+                            const IConfiguration& config) override {
+        // Формат: Validation/YYYY-MM-DD_HH-MM-SS/Step3_peaks.<кодировка>.bin + описание в JSON
+        std::string base = timestamp_dir_ + "/Step3_peaks." + peaksEncodingName(peaks.encoding);
+        if (!writeEncodedPeaks(base + ".bin", peaks)) {
+            return;
+        }
+
+        std::ofstream file(base + ".json");
+        if (!file.is_open()) {
+            return;
+        }
+
+        file << "{\n"
+             << "  \"step\": \"STEP3_ENCODED_PEAKS\",\n"
+             << "  \"file\": \"Step3_peaks." << peaksEncodingName(peaks.encoding) << ".bin\",\n"
+             << "  \"encoding\": \"" << peaksEncodingName(peaks.encoding) << "\",\n"
+             << "  \"num_signals\": " << peaks.num_signals << ",\n"
+             << "  \"num_shifts\": " << peaks.num_shifts << ",\n"
+             << "  \"num_output_points\": " << peaks.n_kg << ",\n"
+             << "  \"max_detections\": " << peaks.max_detections << ",\n"
+             << "  \"payload_bytes\": " << peaks.payload.size() << ",\n"
+             << "  \"raw_bytes\": " << peaks.rawBytes() << ",\n"
+             << "  \"compression_ratio\": " << std::fixed << std::setprecision(2) << peaks.compressionRatio() << ",\n"
+             << "  \"configuration\": " << config.toJSON() << "\n"
+             << "}";
+    }
+
     void exportFinalReport(const IDataSnapshot& snapshot,
                           const IConfiguration& config) override {
         std::string filename = export_path_ + "/final_report_" + timestamp_ + ".json";
@@ -213,13 +316,26 @@ public:
              << "  \"configuration\": " << config.toJSON() << ",\n"
              << "  \"statistics\": \"" << snapshot.getStatistics() << "\",\n"
              << "  \"all_steps\": {\n"
-             << "    \"step1\": " << snapshot.toJSON(IDataSnapshot::Step::STEP1_REFERENCE_FFT) << ",\n"
-             << "    \"step2\": " << snapshot.toJSON(IDataSnapshot::Step::STEP2_INPUT_FFT) << ",\n"
-             << "    \"step3\": " << snapshot.toJSON(IDataSnapshot::Step::STEP3_PEAKS) << "\n"
+             << "    \"step1\": " << archivedDataJSON(snapshot, IDataSnapshot::Step::STEP1_REFERENCE_FFT,
+                                                SnapshotStream::ReferenceFFT) << ",\n"
+             << "    \"step2\": " << archivedDataJSON(snapshot, IDataSnapshot::Step::STEP2_INPUT_FFT,
+                                                SnapshotStream::InputFFT) << ",\n"
+             << "    \"step3\": " << archivedDataJSON(snapshot, IDataSnapshot::Step::STEP3_PEAKS,
+                                                SnapshotStream::Peaks) << "\n"
              << "  }\n"
              << "}";
         
         file.close();
+
+        // Отчёт — последняя запись прогона: дописать индекс архива
+        if (archive_) {
+            if (archive_->finish()) {
+                printf("[EXPORT] %s: %llu -> %llu bytes\n", archive_->path().c_str(),
+                       static_cast<unsigned long long>(archive_->rawBytes()),
+                       static_cast<unsigned long long>(archive_->storedBytes()));
+            }
+            archive_.reset();
+        }
     }
 };
 
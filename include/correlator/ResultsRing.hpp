@@ -0,0 +1,433 @@
+#ifndef CORRELATOR_RESULTS_RING_HPP
+#define CORRELATOR_RESULTS_RING_HPP
+
+#include "PeaksEncoding.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// Формат кольца результатов в разделяемой памяти (POSIX shm)
+// ============================================================================
+
+/**
+ * [ResultsRingHeader][слот 0]...[слот slot_count-1], слот —
+ * [ResultsSlotHeader][payload slot_capacity байт], шаг слота кратен 64.
+ *
+ * Батч с номером seq пишется в слот seq % slot_count под seqlock: версия
+ * слота 2·seq+1 на время записи и 2·seq+2 после неё. Читатель проверяет
+ * версию до и после чтения: совпадение с 2·seq+2 значит, что данные — ровно
+ * батч seq и не перезаписаны во время чтения. Атомики lock-free, поэтому
+ * корректны между процессами (как ShardRing в NumaShardedCorrelator).
+ */
+namespace ResultsRingFormat {
+
+constexpr char kMagic[4] = {'C', 'R', 'N', 'G'};
+constexpr uint32_t kVersion = 1;
+
+struct Header {
+    char magic[4];
+    std::atomic<uint32_t> version;                 // kVersion пишется последним (release)
+    uint32_t slot_count;
+    uint32_t reserved;
+    uint64_t slot_capacity;                        // Байт payload в слоте
+    uint64_t slot_stride;                          // Байт от слота до слота
+    alignas(64) std::atomic<uint64_t> published;   // Опубликовано батчей (номер следующего)
+    alignas(64) std::atomic<uint64_t> overrun_batches;  // Потеряно отстающими читателями (сумма)
+    std::atomic<uint64_t> overrun_events;          // Сколько раз читатели отстали
+};
+
+struct Slot {
+    alignas(64) std::atomic<uint64_t> version;     // seqlock: 2·seq+1 — пишется, 2·seq+2 — готов
+    uint64_t sequence;
+    int64_t timestamp_ns;                          // system_clock, нс от эпохи
+    uint8_t encoding;                              // PeaksEncoding payload
+    uint8_t reserved[3];
+    uint32_t num_signals;
+    uint32_t num_shifts;
+    uint32_t n_kg;
+    uint32_t max_detections;                       // Только SparseDelta
+    uint64_t payload_bytes;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ResultsRing requires lock-free 64-bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "ResultsRing requires lock-free 32-bit atomics");
+static_assert(std::is_standard_layout_v<Header> && std::is_standard_layout_v<Slot>,
+              "ResultsRing headers are shared between processes");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && offsetof(Header, slot_count) == 8,
+              "ResultsRing header layout changed");
+
+inline size_t slotStride(size_t slot_capacity) {
+    return (sizeof(Slot) + slot_capacity + 63) / 64 * 64;
+}
+
+inline size_t mappingSize(uint32_t slot_count, size_t slot_capacity) {
+    return (sizeof(Header) + 63) / 64 * 64 + static_cast<size_t>(slot_count) * slotStride(slot_capacity);
+}
+
+} // namespace ResultsRingFormat
+
+/**
+ * @struct ResultsRingView
+ * @brief Батч в слоте кольца без копирования (валиден до возврата из обработчика)
+ */
+struct ResultsRingView {
+    uint64_t sequence = 0;
+    int64_t timestamp_ns = 0;
+    PeaksEncoding encoding = PeaksEncoding::Float32;
+    uint32_t num_signals = 0;
+    uint32_t num_shifts = 0;
+    uint32_t n_kg = 0;
+    uint32_t max_detections = 0;
+    std::span<const uint8_t> payload;
+
+    /**
+     * Пики [signals][shifts][n_kg] для Float32 (пусто для сжатых кодировок)
+     */
+    std::span<const float> peaks() const {
+        if (encoding != PeaksEncoding::Float32) {
+            return {};
+        }
+        return {reinterpret_cast<const float*>(payload.data()), payload.size() / sizeof(float)};
+    }
+};
+
+enum class ResultsRingRead : uint8_t {
+    Ok = 0,         // Батч прочитан целиком
+    Empty = 1,      // Новых батчей нет
+    Overrun = 2     // Читатель отстал: батч(и) перезаписаны, позиция сдвинута вперёд
+};
+
+// ============================================================================
+// Запись (процесс коррелятора)
+// ============================================================================
+
+/**
+ * @class ResultsRingWriter
+ * @brief Публикует пики/детекции каждого Step 3 в кольцо в /dev/shm
+ *
+ * Один писатель, сколько угодно читателей-процессов. Писатель никогда не
+ * ждёт читателей: отстающий читатель теряет перезаписанные батчи и узнаёт
+ * об этом сам (ResultsRingRead::Overrun); потери суммируются в заголовке
+ * (readerOverruns). Имя — POSIX shm ("/correlator_peaks"); существующий
+ * сегмент с тем же именем пересоздаётся, сегмент удаляется деструктором.
+ */
+class ResultsRingWriter {
+public:
+    ResultsRingWriter(const std::string& name, uint32_t slot_count, size_t slot_capacity)
+        : name_(name) {
+        if (slot_count == 0 || slot_capacity == 0) {
+            return;
+        }
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "[RING] shm_open(%s) failed: %s\n", name.c_str(), strerror(errno));
+            return;
+        }
+        size_ = ResultsRingFormat::mappingSize(slot_count, slot_capacity);
+        void* mapped = MAP_FAILED;
+        if (ftruncate(fd, static_cast<off_t>(size_)) == 0) {
+            mapped = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            fprintf(stderr, "[RING] Failed to map %zu bytes for %s: %s\n", size_, name.c_str(), strerror(errno));
+            shm_unlink(name.c_str());
+            size_ = 0;
+            return;
+        }
+        base_ = static_cast<uint8_t*>(mapped);
+
+        // ftruncate заполнил сегмент нулями: версии слотов 0 — ни один батч не готов
+        auto* header = new (base_) ResultsRingFormat::Header{};
+        std::memcpy(header->magic, ResultsRingFormat::kMagic, sizeof(header->magic));
+        header->slot_count = slot_count;
+        header->slot_capacity = slot_capacity;
+        header->slot_stride = ResultsRingFormat::slotStride(slot_capacity);
+        for (uint32_t i = 0; i < slot_count; ++i) {
+            new (slot(i)) ResultsRingFormat::Slot{};
+        }
+        // Версия последней: читатель не примет заголовок, пока слоты не размечены
+        header->version.store(ResultsRingFormat::kVersion, std::memory_order_release);
+    }
+
+    ~ResultsRingWriter() {
+        if (base_) {
+            munmap(base_, size_);
+            shm_unlink(name_.c_str());
+        }
+    }
+
+    ResultsRingWriter(const ResultsRingWriter&) = delete;
+    ResultsRingWriter& operator=(const ResultsRingWriter&) = delete;
+
+    bool isOpen() const { return base_ != nullptr; }
+    const std::string& name() const { return name_; }
+    size_t slotCapacity() const { return base_ ? header()->slot_capacity : 0; }
+    uint64_t published() const { return base_ ? header()->published.load(std::memory_order_relaxed) : 0; }
+
+    /**
+     * @brief Батчей, потерянных отстающими читателями (сумма по всем читателям)
+     */
+    uint64_t readerOverruns() const {
+        return base_ ? header()->overrun_batches.load(std::memory_order_relaxed) : 0;
+    }
+
+    /**
+     * @brief Опубликовать пики Float32 [signals][shifts][n_kg]
+     */
+    bool publishPeaks(std::span<const float> peaks, uint32_t num_signals, uint32_t num_shifts, uint32_t n_kg) {
+        if (peaks.size() != static_cast<size_t>(num_signals) * num_shifts * n_kg) {
+            return false;
+        }
+        return publish(PeaksEncoding::Float32, num_signals, num_shifts, n_kg, 0,
+                       reinterpret_cast<const uint8_t*>(peaks.data()), peaks.size() * sizeof(float));
+    }
+
+    /**
+     * @brief Опубликовать сжатые пики (SparseDelta — только детекции)
+     */
+    bool publishEncoded(const EncodedPeaks& peaks) {
+        return publish(peaks.encoding, peaks.num_signals, peaks.num_shifts, peaks.n_kg, peaks.max_detections,
+                       peaks.payload.data(), peaks.payload.size());
+    }
+
+private:
+    std::string name_;
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+
+    ResultsRingFormat::Header* header() const { return reinterpret_cast<ResultsRingFormat::Header*>(base_); }
+
+    ResultsRingFormat::Slot* slot(uint64_t index) const {
+        const size_t header_bytes = (sizeof(ResultsRingFormat::Header) + 63) / 64 * 64;
+        return reinterpret_cast<ResultsRingFormat::Slot*>(base_ + header_bytes + index * header()->slot_stride);
+    }
+
+    bool publish(PeaksEncoding encoding, uint32_t num_signals, uint32_t num_shifts, uint32_t n_kg,
+                 uint32_t max_detections, const uint8_t* payload, size_t bytes) {
+        if (!base_ || bytes > header()->slot_capacity) {
+            return false;
+        }
+        ResultsRingFormat::Header* h = header();
+        const uint64_t seq = h->published.load(std::memory_order_relaxed);
+        ResultsRingFormat::Slot* s = slot(seq % h->slot_count);
+
+        s->version.store(2 * seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        s->sequence = seq;
+        s->timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        s->encoding = static_cast<uint8_t>(encoding);
+        s->num_signals = num_signals;
+        s->num_shifts = num_shifts;
+        s->n_kg = n_kg;
+        s->max_detections = max_detections;
+        s->payload_bytes = bytes;
+        std::memcpy(reinterpret_cast<uint8_t*>(s) + sizeof(ResultsRingFormat::Slot), payload, bytes);
+        s->version.store(2 * seq + 2, std::memory_order_release);
+
+        h->published.store(seq + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// ============================================================================
+// Чтение (процессы-потребители: трекеры, регистраторы)
+// ============================================================================
+
+/**
+ * @class ResultsRingReader
+ * @brief Читает батчи по порядку прямо из разделяемой памяти (без копий и системных вызовов)
+ *
+ * Пример:
+ * @code
+ * ResultsRingReader reader("/correlator_peaks");
+ * reader.seekLatest();
+ * for (;;) {
+ *     ResultsRingRead status = reader.next([&](const ResultsRingView& batch) {
+ *         track(batch.sequence, batch.peaks());
+ *     });
+ *     if (status == ResultsRingRead::Overrun) rollbackTrack();  // результат обработчика недействителен
+ * }
+ * @endcode
+ */
+class ResultsRingReader {
+public:
+    ResultsRingReader() = default;
+
+    explicit ResultsRingReader(const std::string& name) {
+        open(name);
+    }
+
+    ~ResultsRingReader() {
+        close();
+    }
+
+    ResultsRingReader(const ResultsRingReader&) = delete;
+    ResultsRingReader& operator=(const ResultsRingReader&) = delete;
+
+    bool open(const std::string& name) {
+        close();
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ResultsRingFormat::Header)) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        // PROT_WRITE — только для счётчиков отставания в заголовке
+        void* mapped = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            size_ = 0;
+            return false;
+        }
+        base_ = static_cast<uint8_t*>(mapped);
+
+        const ResultsRingFormat::Header* h = header();
+        const uint32_t version = h->version.load(std::memory_order_acquire);
+        if (std::memcmp(h->magic, ResultsRingFormat::kMagic, sizeof(h->magic)) != 0 ||
+            version != ResultsRingFormat::kVersion || h->slot_count == 0 ||
+            ResultsRingFormat::mappingSize(h->slot_count, h->slot_capacity) > size_) {
+            fprintf(stderr, "[RING] %s: not a results ring\n", name.c_str());
+            close();
+            return false;
+        }
+        next_ = 0;
+        return true;
+    }
+
+    void close() {
+        if (base_) {
+            munmap(base_, size_);
+        }
+        base_ = nullptr;
+        size_ = 0;
+    }
+
+    bool isOpen() const { return base_ != nullptr; }
+
+    /**
+     * @brief Пропустить накопленное: читать начиная со следующего опубликованного батча
+     */
+    void seekLatest() {
+        if (base_) next_ = header()->published.load(std::memory_order_acquire);
+    }
+
+    uint64_t position() const { return next_; }
+    uint64_t overrunBatches() const { return overrun_batches_; }
+    uint64_t overrunEvents() const { return overrun_events_; }
+
+    /**
+     * @brief Передать следующий батч обработчику прямо из слота
+     *
+     * Обработчик видит данные в разделяемой памяти; после его возврата
+     * seqlock проверяется ещё раз. Overrun означает, что писатель обогнал
+     * читателя (до или во время обработки): результат обработчика надо
+     * отбросить, позиция уже сдвинута на самый старый доступный батч.
+     */
+    template <class Fn>
+    ResultsRingRead next(Fn&& fn) {
+        if (!base_) {
+            return ResultsRingRead::Empty;
+        }
+        ResultsRingFormat::Header* h = header();
+        const uint64_t published = h->published.load(std::memory_order_acquire);
+        if (next_ >= published) {
+            return ResultsRingRead::Empty;
+        }
+        if (published - next_ > h->slot_count) {
+            skip_to(published - h->slot_count);
+            return ResultsRingRead::Overrun;
+        }
+
+        const ResultsRingFormat::Slot* s = slot(next_ % h->slot_count);
+        const uint64_t expected = 2 * next_ + 2;
+        if (s->version.load(std::memory_order_acquire) != expected) {
+            skip_to(next_ + 1);
+            return ResultsRingRead::Overrun;
+        }
+
+        ResultsRingView view;
+        view.sequence = s->sequence;
+        view.timestamp_ns = s->timestamp_ns;
+        view.encoding = static_cast<PeaksEncoding>(s->encoding);
+        view.num_signals = s->num_signals;
+        view.num_shifts = s->num_shifts;
+        view.n_kg = s->n_kg;
+        view.max_detections = s->max_detections;
+        const size_t bytes = std::min<uint64_t>(s->payload_bytes, h->slot_capacity);
+        view.payload = {reinterpret_cast<const uint8_t*>(s) + sizeof(ResultsRingFormat::Slot), bytes};
+        fn(static_cast<const ResultsRingView&>(view));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s->version.load(std::memory_order_relaxed) != expected) {
+            skip_to(next_ + 1);
+            return ResultsRingRead::Overrun;
+        }
+        ++next_;
+        return ResultsRingRead::Ok;
+    }
+
+    /**
+     * @brief Скопировать следующий батч (для потребителей, которым нужны данные после обработки)
+     */
+    ResultsRingRead copyNext(ResultsRingView& meta, std::vector<uint8_t>& payload) {
+        return next([&](const ResultsRingView& view) {
+            meta = view;
+            payload.assign(view.payload.begin(), view.payload.end());
+            meta.payload = payload;
+        });
+    }
+
+private:
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    uint64_t next_ = 0;
+    uint64_t overrun_batches_ = 0;
+    uint64_t overrun_events_ = 0;
+
+    ResultsRingFormat::Header* header() const { return reinterpret_cast<ResultsRingFormat::Header*>(base_); }
+
+    const ResultsRingFormat::Slot* slot(uint64_t index) const {
+        const size_t header_bytes = (sizeof(ResultsRingFormat::Header) + 63) / 64 * 64;
+        return reinterpret_cast<const ResultsRingFormat::Slot*>(base_ + header_bytes + index * header()->slot_stride);
+    }
+
+    /**
+     * Отставание: батчи [next_, target) потеряны — счётчики читателя и общие в заголовке
+     */
+    void skip_to(uint64_t target) {
+        const uint64_t lost = target - next_;
+        overrun_batches_ += lost;
+        ++overrun_events_;
+        header()->overrun_batches.fetch_add(lost, std::memory_order_relaxed);
+        header()->overrun_events.fetch_add(1, std::memory_order_relaxed);
+        next_ = target;
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_RESULTS_RING_HPP
@@ -0,0 +1,189 @@
+#ifndef CORRELATOR_SNAPSHOT_ARCHIVE_HPP
+#define CORRELATOR_SNAPSHOT_ARCHIVE_HPP
+
+#include "ChunkArchive.hpp"
+#include "IConfiguration.hpp"
+#include "IDataSnapshot.hpp"
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// SnapshotArchive - полные дампы шагов в ChunkArchive
+// ============================================================================
+
+/**
+ * Потоки архива снимка. Один чанк = одно преобразование (сигнал/сдвиг),
+ * поэтому отдельный спектр читается без распаковки остальных:
+ *
+ *   ReferenceSignal  [1][N] int32
+ *   InputSignals     [signals][N] int32
+ *   ReferenceFFT     [shifts][N] ComplexFloat
+ *   InputFFT         [signals][N] ComplexFloat
+ *   Peaks            [signals][shifts * n_kg] float
+ *
+ * Каждая запись шага дописывает строки в конец потока: батч b занимает
+ * чанки [b * signals, (b + 1) * signals), dims[0] — строки всех батчей.
+ */
+enum class SnapshotStream : uint32_t {
+    ReferenceSignal = 0,
+    InputSignals = 1,
+    ReferenceFFT = 2,
+    InputFFT = 3,
+    Peaks = 4
+};
+
+inline const char* snapshotStreamName(SnapshotStream stream) {
+    switch (stream) {
+        case SnapshotStream::ReferenceSignal: return "reference_signal";
+        case SnapshotStream::InputSignals:    return "input_signals";
+        case SnapshotStream::ReferenceFFT:    return "reference_fft";
+        case SnapshotStream::InputFFT:        return "input_fft";
+        case SnapshotStream::Peaks:           return "peaks";
+    }
+    return "unknown";
+}
+
+/**
+ * @class SnapshotArchive
+ * @brief Запись шагов pipeline в архив и загрузка обратно в IDataSnapshot
+ *
+ * Пример офлайн-проверки:
+ * @code
+ * ChunkArchiveReader reader("Report/Validation/<ts>/snapshot.cchk");
+ * std::vector<ComplexFloat> spectrum;
+ * reader.read(static_cast<uint32_t>(SnapshotStream::InputFFT), 17, spectrum);  // сигнал 17
+ *
+ * reader.read(static_cast<uint32_t>(SnapshotStream::InputFFT),
+ *             batch * num_signals + 17, spectrum);                             // сигнал 17 батча batch
+ *
+ * DataSnapshot snapshot;
+ * SnapshotArchive::load(reader, snapshot);                                     // все батчи подряд
+ * @endcode
+ */
+class SnapshotArchive {
+public:
+    static bool writeSignals(ChunkArchiveWriter& writer, const std::vector<int32_t>& reference_signal,
+                             const std::vector<int32_t>& input_signals, const IConfiguration& config) {
+        size_t n = config.getFFTSize();
+        int num_signals = config.getNumSignals();
+        if (reference_signal.size() < n || input_signals.size() < n * num_signals) {
+            return false;
+        }
+        return append(writer, SnapshotStream::ReferenceSignal, reference_signal.data(), n * sizeof(int32_t), 1, n) &&
+               append(writer, SnapshotStream::InputSignals, input_signals.data(), n * sizeof(int32_t), num_signals, n);
+    }
+
+    static bool writeStep(ChunkArchiveWriter& writer, const IDataSnapshot& snapshot,
+                          IDataSnapshot::Step step, const IConfiguration& config) {
+        size_t n = config.getFFTSize();
+        int num_shifts = config.getNumShifts();
+        int num_signals = config.getNumSignals();
+        size_t row = static_cast<size_t>(num_shifts) * config.getNumOutputPoints();
+
+        switch (step) {
+            case IDataSnapshot::Step::STEP1_REFERENCE_FFT: {
+                const auto& data = snapshot.getReferenceFFT();
+                if (data.size() != n * num_shifts) return false;
+                return append(writer, SnapshotStream::ReferenceFFT, data.data(), n * sizeof(ComplexFloat), num_shifts, n);
+            }
+            case IDataSnapshot::Step::STEP2_INPUT_FFT: {
+                const auto& data = snapshot.getInputFFT();
+                if (data.size() != n * num_signals) return false;
+                return append(writer, SnapshotStream::InputFFT, data.data(), n * sizeof(ComplexFloat), num_signals, n);
+            }
+            case IDataSnapshot::Step::STEP3_PEAKS: {
+                const auto& data = snapshot.getPeaks();
+                if (data.size() != row * num_signals) return false;
+                return append(writer, SnapshotStream::Peaks, data.data(), row * sizeof(float), num_signals,
+                              num_shifts, config.getNumOutputPoints());
+            }
+            default:
+                return false;  // Промежуточные спектры Step 3 в pipeline не сохраняются
+        }
+    }
+
+    /**
+     * @brief Восстановить спектры и пики в snapshot (отсутствующие потоки пропускаются)
+     *
+     * Строки всех записанных батчей идут подряд (num_signals = dims[0]).
+     */
+    static bool load(const ChunkArchiveReader& reader, IDataSnapshot& snapshot, unsigned threads = 0) {
+        if (!reader.isOpen()) {
+            return false;
+        }
+
+        if (const auto* shape = reader.streamShape(id(SnapshotStream::ReferenceFFT))) {
+            std::vector<ComplexFloat> data;
+            if (!reader.readStream(id(SnapshotStream::ReferenceFFT), data, threads)) return false;
+            snapshot.saveReferenceFFT(data, static_cast<int>(shape->dims[0]), shape->dims[1]);
+        }
+        if (const auto* shape = reader.streamShape(id(SnapshotStream::InputFFT))) {
+            std::vector<ComplexFloat> data;
+            if (!reader.readStream(id(SnapshotStream::InputFFT), data, threads)) return false;
+            snapshot.saveInputFFT(data, static_cast<int>(shape->dims[0]), shape->dims[1]);
+        }
+        if (const auto* shape = reader.streamShape(id(SnapshotStream::Peaks))) {
+            std::vector<float> data;
+            if (!reader.readStream(id(SnapshotStream::Peaks), data, threads)) return false;
+            snapshot.savePeaks(data, static_cast<int>(shape->dims[0]), static_cast<int>(shape->dims[1]),
+                               static_cast<int>(shape->dims[2]));
+        }
+        return true;
+    }
+
+    /**
+     * @brief JSON-ссылка на поток архива (вместо массива в отчёте шага)
+     * @param batch_rows Строк последней записи шага (0 — ссылка на весь поток)
+     */
+    static std::string referenceJSON(const std::string& archive_file, SnapshotStream stream,
+                                     const ChunkArchiveWriter& writer, size_t batch_rows = 0) {
+        const size_t rows = writer.chunkCount(id(stream));
+        std::string json = std::string("{\"archive\": \"") + archive_file + "\", \"stream\": \"" +
+                           snapshotStreamName(stream) + "\", \"stream_id\": " + std::to_string(id(stream)) +
+                           ", \"rows\": " + std::to_string(rows);
+        if (batch_rows > 0 && batch_rows <= rows) {
+            json += ", \"first_row\": " + std::to_string(rows - batch_rows) +
+                    ", \"batch_rows\": " + std::to_string(batch_rows);
+        }
+        return json + ", \"archive_raw_bytes\": " + std::to_string(writer.rawBytes()) +
+               ", \"archive_stored_bytes\": " + std::to_string(writer.storedBytes()) + "}";
+    }
+
+    static uint32_t id(SnapshotStream stream) { return static_cast<uint32_t>(stream); }
+
+    /// Строк одной записи шага: сдвиги для Step 1, сигналы для Step 2/3
+    static size_t stepRows(IDataSnapshot::Step step, const IConfiguration& config) {
+        return static_cast<size_t>(step == IDataSnapshot::Step::STEP1_REFERENCE_FFT ? config.getNumShifts()
+                                                                                    : config.getNumSignals());
+    }
+
+private:
+    /**
+     * Дописать count строк [d1][d2] в конец потока и обновить его форму.
+     * Строка другой формы, чем уже записанные, отвергается.
+     * Элемент shuffle = 4 байта (int32 / float / половина ComplexFloat)
+     */
+    static bool append(ChunkArchiveWriter& writer, SnapshotStream stream, const void* data,
+                       size_t chunk_bytes, size_t count, size_t d1, size_t d2 = 1) {
+        const size_t rows = writer.chunkCount(id(stream));
+        const auto* shape = writer.streamShape(id(stream));
+        if (rows > 0 && (!shape || shape->dims[0] != rows || shape->dims[1] != d1 || shape->dims[2] != d2)) {
+            return false;
+        }
+        if (rows + count > std::numeric_limits<uint32_t>::max() ||
+            !writer.append(id(stream), static_cast<uint32_t>(rows), data, chunk_bytes, count, sizeof(float))) {
+            return false;
+        }
+        writer.setStreamShape(id(stream), static_cast<uint32_t>(rows + count), static_cast<uint32_t>(d1),
+                              static_cast<uint32_t>(d2));
+        return true;
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_SNAPSHOT_ARCHIVE_HPP
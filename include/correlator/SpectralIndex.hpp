@@ -0,0 +1,295 @@
+#ifndef CORRELATOR_SPECTRAL_INDEX_HPP
+#define CORRELATOR_SPECTRAL_INDEX_HPP
+
+#include "ChunkArchive.hpp"
+#include "IFFTBackend.hpp"
+#include "PeaksEncoding.hpp"
+#include "PeaksView.hpp"
+#include <atomic>
+#include <functional>
+#include <future>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// SpectralIndex - архив спектров Step 2 для ретроспективного поиска
+// ============================================================================
+
+/**
+ * Спектры входных сигналов (результат Step 2) сохраняются в ChunkArchive:
+ * один чанк = спектр одного сигнала, индекс чанка = сквозной номер сигнала
+ * по всем записанным батчам. Новый опорный сигнал коррелируется с архивом
+ * через Step 1 + Step 3: спектры читаются с диска (mmap) и загружаются в
+ * input_fft без повторного Forward FFT.
+ *
+ * Точность хранения:
+ *   Float32 — без потерь (shuffle + delta + LZ)
+ *   Float16 — вдвое меньше до сжатия, относительная ошибка ≈ 5e-4
+ *             (на уровне шума после масштабирования scale_factor)
+ */
+enum class SpectralPrecision : uint8_t {
+    Float32,
+    Float16
+};
+
+inline const char* spectralPrecisionName(SpectralPrecision precision) {
+    return precision == SpectralPrecision::Float16 ? "f16" : "f32";
+}
+
+struct SpectralIndexFormat {
+    static constexpr uint32_t kSpectraStream = 0;
+    static constexpr uint32_t kPrecisionStream = 1;  // dims[0] = SpectralPrecision (без данных)
+};
+
+// ============================================================================
+// Запись
+// ============================================================================
+
+/**
+ * @class SpectralIndexWriter
+ * @brief Дописывает спектры Step 2 в индекс (подключается к CorrelationPipeline)
+ *
+ * ArchiveOpenMode::Append продолжает существующий индекс: нумерация сигналов
+ * идёт с его signalCount(), размер FFT и точность должны совпадать (иначе
+ * isOpen() == false, файл не меняется). Номер сигнала — индекс чанка
+ * uint32_t: батч, выходящий за 2^32 − 1 сигналов, отклоняется.
+ */
+class SpectralIndexWriter {
+public:
+    SpectralIndexWriter(const std::string& path, size_t fft_size,
+                        SpectralPrecision precision = SpectralPrecision::Float32, unsigned threads = 0,
+                        ArchiveOpenMode mode = ArchiveOpenMode::Truncate)
+        : archive_(path, threads, mode), fft_size_(fft_size), precision_(precision) {
+        const auto* spectra = archive_.streamShape(SpectralIndexFormat::kSpectraStream);
+        const auto* stored_precision = archive_.streamShape(SpectralIndexFormat::kPrecisionStream);
+        if (spectra || stored_precision) {
+            compatible_ = spectra && stored_precision && spectra->dims[1] == fft_size_ &&
+                          stored_precision->dims[0] == static_cast<uint32_t>(precision_);
+            if (!compatible_) {
+                fprintf(stderr, "[INDEX] %s: existing index has a different FFT size or precision\n",
+                        path.c_str());
+                return;
+            }
+            signals_ = spectra->dims[0];
+        }
+        archive_.setStreamShape(SpectralIndexFormat::kPrecisionStream, static_cast<uint32_t>(precision));
+        update_metadata();
+    }
+
+    bool isOpen() const { return archive_.isOpen() && compatible_; }
+    const std::string& path() const { return archive_.path(); }
+    uint64_t signalCount() const { return signals_; }
+    uint64_t rawBytes() const { return archive_.rawBytes(); }
+    uint64_t storedBytes() const { return archive_.storedBytes(); }
+
+    /**
+     * @brief Добавить спектры батча [num_signals][fft_size]
+     */
+    bool append(std::span<const ComplexFloat> spectra, int num_signals) {
+        if (!isOpen() || num_signals <= 0 || spectra.size() != fft_size_ * num_signals ||
+            signals_ + static_cast<uint64_t>(num_signals) > std::numeric_limits<uint32_t>::max()) {
+            return false;
+        }
+
+        bool ok;
+        if (precision_ == SpectralPrecision::Float16) {
+            const float* values = reinterpret_cast<const float*>(spectra.data());
+            half_.resize(spectra.size() * 2);
+            for (size_t i = 0; i < half_.size(); ++i) {
+                half_[i] = floatToHalf(values[i]);
+            }
+            ok = archive_.append(SpectralIndexFormat::kSpectraStream, static_cast<uint32_t>(signals_),
+                                 half_.data(), fft_size_ * 2 * sizeof(uint16_t), num_signals, sizeof(uint16_t));
+        } else {
+            ok = archive_.append(SpectralIndexFormat::kSpectraStream, static_cast<uint32_t>(signals_),
+                                 spectra.data(), fft_size_ * sizeof(ComplexFloat), num_signals, sizeof(float));
+        }
+        if (ok) {
+            signals_ += num_signals;
+            update_metadata();
+        }
+        return ok;
+    }
+
+    bool finish() { return archive_.finish(); }
+
+private:
+    ChunkArchiveWriter archive_;
+    size_t fft_size_;
+    SpectralPrecision precision_;
+    bool compatible_ = true;
+    uint64_t signals_ = 0;
+    std::vector<uint16_t> half_;
+
+    void update_metadata() {
+        archive_.setStreamShape(SpectralIndexFormat::kSpectraStream, static_cast<uint32_t>(signals_),
+                                static_cast<uint32_t>(fft_size_));
+        archive_.setMetadata(std::string("{\"type\": \"spectral_index\", \"fft_size\": ") + std::to_string(fft_size_) +
+                             ", \"precision\": \"" + spectralPrecisionName(precision_) +
+                             "\", \"signals\": " + std::to_string(signals_) + "}");
+    }
+};
+
+// ============================================================================
+// Чтение
+// ============================================================================
+
+/**
+ * @class SpectralIndexReader
+ * @brief Произвольный доступ к спектрам архива по номеру сигнала
+ */
+class SpectralIndexReader {
+public:
+    SpectralIndexReader() = default;
+
+    explicit SpectralIndexReader(const std::string& path) {
+        open(path);
+    }
+
+    bool open(const std::string& path) {
+        if (!archive_.open(path)) {
+            return false;
+        }
+        const auto* spectra = archive_.streamShape(SpectralIndexFormat::kSpectraStream);
+        const auto* precision = archive_.streamShape(SpectralIndexFormat::kPrecisionStream);
+        if (!spectra || !precision) {
+            archive_.close();
+            return false;
+        }
+        signals_ = spectra->dims[0];
+        fft_size_ = spectra->dims[1];
+        precision_ = static_cast<SpectralPrecision>(precision->dims[0]);
+        return true;
+    }
+
+    bool isOpen() const { return archive_.isOpen(); }
+    size_t fftSize() const { return fft_size_; }
+    uint64_t signalCount() const { return signals_; }
+    SpectralPrecision precision() const { return precision_; }
+
+    /**
+     * @brief Распаковать спектры сигналов [first, first + count) в out (параллельно)
+     */
+    bool readSpectra(uint64_t first, int count, std::span<ComplexFloat> out, unsigned threads = 0) const {
+        if (count <= 0 || first + count > signals_ || out.size() < fft_size_ * count) {
+            return false;
+        }
+
+        std::atomic<bool> ok{true};
+        parallelChunks(static_cast<size_t>(count), threads, [&](size_t i) {
+            ComplexFloat* target = out.data() + i * fft_size_;
+            uint32_t index = static_cast<uint32_t>(first + i);
+            if (precision_ == SpectralPrecision::Float16) {
+                std::vector<uint16_t> half(fft_size_ * 2);
+                if (!archive_.read(SpectralIndexFormat::kSpectraStream, index, half.data(),
+                                   half.size() * sizeof(uint16_t))) {
+                    ok = false;
+                    return;
+                }
+                float* values = reinterpret_cast<float*>(target);
+                for (size_t j = 0; j < half.size(); ++j) {
+                    values[j] = halfToFloat(half[j]);
+                }
+            } else if (!archive_.read(SpectralIndexFormat::kSpectraStream, index, target,
+                                      fft_size_ * sizeof(ComplexFloat))) {
+                ok = false;
+            }
+        });
+        return ok;
+    }
+
+private:
+    ChunkArchiveReader archive_;
+    size_t fft_size_ = 0;
+    uint64_t signals_ = 0;
+    SpectralPrecision precision_ = SpectralPrecision::Float32;
+};
+
+// ============================================================================
+// Ретроспективный поиск
+// ============================================================================
+
+/**
+ * Результат одного батча поиска: пики сигналов архива
+ * [first_signal, first_signal + peaks.extent(0)).
+ * Возврат false из обработчика останавливает поиск.
+ */
+using SpectralSearchCallback = std::function<bool(uint64_t first_signal, ConstPeaksView peaks)>;
+
+/**
+ * @brief Коррелировать опорный сигнал (Step 1 уже выполнен) со всем архивом
+ *
+ * Батчи по batch_signals спектров (размер батча плана бэкенда). Распаковка
+ * следующего батча идёт в фоне, пока GPU считает Step 3 текущего, поэтому
+ * время поиска определяется чтением/распаковкой, а не FFT.
+ *
+ * @param stats_upload_ms, stats_step3_ms Суммарные времена (могут быть nullptr)
+ */
+inline bool correlateSpectralIndex(IFFTBackend& backend, const SpectralIndexReader& index,
+                                   int batch_signals, int num_shifts, int n_kg,
+                                   const SpectralSearchCallback& on_batch,
+                                   double* stats_upload_ms = nullptr, double* stats_step3_ms = nullptr) {
+    if (!index.isOpen() || batch_signals <= 0) {
+        return false;
+    }
+
+    const size_t n = index.fftSize();
+    const uint64_t total = index.signalCount();
+    std::vector<ComplexFloat> buffers[2] = {std::vector<ComplexFloat>(n * batch_signals),
+                                            std::vector<ComplexFloat>(n * batch_signals)};
+    PeaksBuffer peaks(batch_signals, num_shifts, n_kg);
+
+    auto load = [&](uint64_t first, std::vector<ComplexFloat>& buffer) {
+        int count = static_cast<int>(std::min<uint64_t>(batch_signals, total - first));
+        if (!index.readSpectra(first, count, buffer)) {
+            return false;
+        }
+        // Хвостовой батч: лишние строки обнуляются (план рассчитан на batch_signals)
+        std::fill(buffer.begin() + n * count, buffer.end(), ComplexFloat{});
+        return true;
+    };
+
+    if (total == 0) {
+        return true;
+    }
+    if (!load(0, buffers[0])) {
+        return false;
+    }
+
+    int current = 0;
+    for (uint64_t first = 0; first < total; first += batch_signals) {
+        uint64_t next = first + batch_signals;
+        std::future<bool> prefetch;
+        if (next < total) {
+            prefetch = std::async(std::launch::async, load, next, std::ref(buffers[current ^ 1]));
+        }
+
+        OperationTiming upload, copy, ifft, download;
+        bool ok = backend.loadInputSpectra(buffers[current], batch_signals, upload) &&
+                  backend.step3_ComputeCorrelation(batch_signals, num_shifts, n_kg, copy, ifft, download) &&
+                  backend.readCorrelationPeaks(peaks.span());
+        if (stats_upload_ms) *stats_upload_ms += upload.total_gpu_ms;
+        if (stats_step3_ms) *stats_step3_ms += copy.total_gpu_ms + ifft.total_gpu_ms + download.total_gpu_ms;
+
+        int count = static_cast<int>(std::min<uint64_t>(batch_signals, total - first));
+        bool keep_going = ok && on_batch(first, ConstPeaksView(peaks.view().data_handle(),
+                                                               PeaksExtents<>(count, num_shifts, n_kg)));
+        bool prefetched = !prefetch.valid() || prefetch.get();
+        if (!keep_going) {
+            return ok;
+        }
+        if (!prefetched) {
+            return false;
+        }
+        current ^= 1;
+    }
+    return true;
+}
+
+} // namespace Correlator
+
+#endif // CORRELATOR_SPECTRAL_INDEX_HPP
@@ -0,0 +1,280 @@
+#ifndef CORRELATOR_STATIC_PIPELINE_HPP
+#define CORRELATOR_STATIC_PIPELINE_HPP
+
+#include "IFFTBackend.hpp"
+#include "Configuration.hpp"
+#include "DataSnapshot.hpp"
+#include "DataValidator.hpp"
+#include "ResultExporter.hpp"
+#include "PeaksView.hpp"
+#include "RealtimeMemory.hpp"
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace Correlator {
+
+// ============================================================================
+// Политики валидации и экспорта (выбираются при компиляции)
+// ============================================================================
+
+/// Без валидации: snapshot и чтение спектров с устройства не компилируются
+struct NoValidation { static constexpr bool enabled = false; };
+
+/// Валидация шагов через DataValidator (требует скачивания спектров)
+struct SnapshotValidation { static constexpr bool enabled = true; };
+
+/// Без экспорта JSON
+struct NoExport { static constexpr bool enabled = false; };
+
+/// Экспорт JSON через ResultExporter (как в CorrelationPipeline)
+struct JsonExport { static constexpr bool enabled = true; };
+
+/**
+ * @concept StaticFFTBackend
+ * @brief Бэкенд, пригодный для статического pipeline
+ *
+ * Конкретный тип (желательно final) с настройкой формы до initialize() и
+ * перегрузками step1/step2, принимающими указатель и размер.
+ */
+template <class B>
+concept StaticFFTBackend = std::derived_from<B, IFFTBackend> &&
+    std::default_initializable<B> &&
+    requires(B backend, const int32_t* data, OperationTiming& timing) {
+        backend.setConfiguration(size_t{}, int{}, int{}, int{}, float{});
+        { backend.step1_ProcessReferenceSignals(data, size_t{}, int{}, timing, timing) } -> std::same_as<bool>;
+        { backend.step2_ProcessInputSignals(data, size_t{}, int{}, timing, timing) } -> std::same_as<bool>;
+    };
+
+/**
+ * @class StaticCorrelationPipeline
+ * @brief Pipeline с формой, зафиксированной при компиляции
+ *
+ * Для фиксированных production конфигураций: размеры — параметры шаблона,
+ * размеры буферов — constexpr, бэкенд хранится по значению (вызовы
+ * девиртуализируются для final бэкенда), политики NoValidation/NoExport
+ * не оставляют в бинарнике ни кода, ни данных.
+ *
+ * Пример:
+ * @code
+ * using Pipeline = StaticCorrelationPipeline<OpenCLFFTBackend, 32768, 40, 50, 5>;
+ * Pipeline pipeline;
+ * pipeline.initialize();
+ * pipeline.execute(std::span<const int32_t, Pipeline::kReferenceSamples>(reference),
+ *                  std::span<const int32_t, Pipeline::kInputSamples>(inputs));
+ * auto peaks = pipeline.getPeaksView();      // [kNumSignals][kNumShifts][kNumOutputPoints]
+ * float p = peakAt(peaks, signal, shift, 0);
+ * @endcode
+ */
+template <class Backend, size_t N, int Shifts, int Signals, int NKg,
+          class Validation = NoValidation, class Export = NoExport>
+    requires StaticFFTBackend<Backend>
+class StaticCorrelationPipeline {
+public:
+    // ========================================================================
+    // Форма (compile-time)
+    // ========================================================================
+
+    static constexpr size_t kFFTSize = N;
+    static constexpr int kNumShifts = Shifts;
+    static constexpr int kNumSignals = Signals;
+    static constexpr int kNumOutputPoints = NKg;
+
+    static constexpr size_t kReferenceSamples = N;
+    static constexpr size_t kInputSamples = N * Signals;
+    static constexpr size_t kCorrelations = static_cast<size_t>(Shifts) * Signals;
+    static constexpr size_t kPeaksCount = kCorrelations * NKg;
+
+    // Буферы FFTHandler::initialize() (без userdata callback'ов и буферов clFFT)
+    static constexpr size_t kReferenceBytes = N * sizeof(int32_t) + Shifts * N * sizeof(cl_float2);
+    static constexpr size_t kInputBytes = kInputSamples * (sizeof(int32_t) + sizeof(cl_float2));
+    static constexpr size_t kCorrelationBytes = 2 * kCorrelations * N * sizeof(cl_float2);
+    static constexpr size_t kDeviceBytes = kReferenceBytes + kInputBytes + kCorrelationBytes;
+
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "FFT size must be a power of 2");
+    static_assert(Shifts > 0 && Signals > 0 && NKg > 0, "Shape dimensions must be positive");
+    static_assert(static_cast<size_t>(Shifts) <= N, "More shifts than samples");
+    static_assert(static_cast<size_t>(NKg) <= N, "n_kg exceeds FFT size");
+
+    using ReferenceSpan = std::span<const int32_t, kReferenceSamples>;
+    using InputSpan = std::span<const int32_t, kInputSamples>;
+    using PeaksSpan = std::span<float, kPeaksCount>;
+    using PeaksViewType = ConstStaticPeaksView<Signals, Shifts, NKg>;
+
+    explicit StaticCorrelationPipeline(float scale_factor = 1.0f / 32768.0f)
+        : scale_factor_(scale_factor), peaks_(kPeaksCount) {
+        if constexpr (kNeedsSnapshot) {
+            state_.config.setScaleFactor(scale_factor);
+        }
+    }
+
+    bool initialize() {
+        backend_.setConfiguration(N, Shifts, Signals, NKg, scale_factor_);
+        return backend_.initialize();
+    }
+
+    /**
+     * @brief Режим реального времени (после initialize): mlockall, префолт
+     * буфера пиков и стека, закрепление потока (RealtimeMemory.hpp)
+     *
+     * С NoValidation/NoExport батч (executeStep2 + executeStep3) не выделяет
+     * больших буферов; мелкие аллокации учёта событий OpenCL берутся из уже
+     * заблокированной кучи (malloc без trim).
+     */
+    RealtimeStatus enableRealtimeMode(const RealtimeOptions& options = {}) {
+        RealtimeStatus status = Correlator::enableRealtimeMode(options);
+        if (options.prefault) {
+            status.prefaulted_bytes += prefaultSpan(std::span(peaks_));
+        }
+        return status;
+    }
+
+    /**
+     * @brief Step 1: опорный сигнал (Shifts циклических сдвигов)
+     */
+    bool executeStep1(ReferenceSpan reference) {
+        if (!backend_.step1_ProcessReferenceSignals(reference.data(), kReferenceSamples, Shifts,
+                                                    step1_upload_timing_, step1_fft_timing_)) {
+            return false;
+        }
+
+        if constexpr (kNeedsSnapshot) {
+            std::vector<ComplexFloat> reference_fft;
+            if (!backend_.getReferenceFFT(reference_fft)) {
+                return false;
+            }
+            state_.snapshot.saveReferenceFFT(reference_fft, Shifts, N);
+            finish_step([&](auto& validator) { return validator.validateStep1(state_.snapshot, state_.config); },
+                        [&](auto& exporter, const ValidationResult& v) { exporter.exportStep1(state_.snapshot, state_.config, v); });
+        }
+        return true;
+    }
+
+    /**
+     * @brief Step 2: Signals входных сигналов
+     */
+    bool executeStep2(InputSpan inputs) {
+        if (!backend_.step2_ProcessInputSignals(inputs.data(), kInputSamples, Signals,
+                                                step2_upload_timing_, step2_fft_timing_)) {
+            return false;
+        }
+
+        if constexpr (kNeedsSnapshot) {
+            std::vector<ComplexFloat> input_fft;
+            if (!backend_.getInputFFT(input_fft)) {
+                return false;
+            }
+            state_.snapshot.saveInputFFT(input_fft, Signals, N);
+            finish_step([&](auto& validator) { return validator.validateStep2(state_.snapshot, state_.config); },
+                        [&](auto& exporter, const ValidationResult& v) { exporter.exportStep2(state_.snapshot, state_.config, v); });
+        }
+        return true;
+    }
+
+    /**
+     * @brief Step 3: корреляция, пики скачиваются во внутренний буфер (выделен в конструкторе)
+     */
+    bool executeStep3() {
+        return executeStep3(PeaksSpan(peaks_));
+    }
+
+    /**
+     * @brief Step 3 с выгрузкой пиков прямо в буфер вызывающего кода
+     *
+     * Внутренний буфер (getPeaks/getPeaksView) при этом не обновляется.
+     */
+    bool executeStep3(PeaksSpan output) {
+        if (!backend_.step3_ComputeCorrelation(Signals, Shifts, NKg, step3_copy_timing_,
+                                               step3_ifft_timing_, step3_download_timing_)) {
+            return false;
+        }
+        if (!backend_.readCorrelationPeaks(output)) {
+            return false;
+        }
+
+        if constexpr (kNeedsSnapshot) {
+            state_.snapshot.savePeaks(output, Signals, Shifts, NKg);
+            finish_step([&](auto& validator) { return validator.validateStep3(state_.snapshot, state_.config); },
+                        [&](auto& exporter, const ValidationResult& v) { exporter.exportStep3(state_.snapshot, state_.config, v); });
+        }
+        return true;
+    }
+
+    /**
+     * @brief Полный батч: Step 1 → Step 2 → Step 3
+     */
+    bool execute(ReferenceSpan reference, InputSpan inputs) {
+        return executeStep1(reference) && executeStep2(inputs) && executeStep3();
+    }
+
+    // ========================================================================
+    // Getters
+    // ========================================================================
+
+    const std::vector<float>& getPeaks() const { return peaks_; }
+    PeaksViewType getPeaksView() const { return PeaksViewType(peaks_.data(), PeaksExtents<Signals, Shifts, NKg>()); }
+    Backend& getBackend() { return backend_; }
+    const Backend& getBackend() const { return backend_; }
+
+    void getStep1Timings(OperationTiming& upload, OperationTiming& fft) const {
+        upload = step1_upload_timing_;
+        fft = step1_fft_timing_;
+    }
+
+    void getStep2Timings(OperationTiming& upload, OperationTiming& fft) const {
+        upload = step2_upload_timing_;
+        fft = step2_fft_timing_;
+    }
+
+    void getStep3Timings(OperationTiming& copy, OperationTiming& ifft, OperationTiming& download) const {
+        copy = step3_copy_timing_;
+        ifft = step3_ifft_timing_;
+        download = step3_download_timing_;
+    }
+
+private:
+    static constexpr bool kNeedsSnapshot = Validation::enabled || Export::enabled;
+
+    struct Empty {};
+
+    /**
+     * Состояние валидации/экспорта — существует только при включённых политиках
+     */
+    struct SnapshotState {
+        Configuration config{N, Shifts, Signals, NKg, 1.0f / 32768.0f};  // scale задаётся в конструкторе pipeline
+        DataSnapshot snapshot;
+        [[no_unique_address]] std::conditional_t<Validation::enabled, DataValidator, Empty> validator;
+        [[no_unique_address]] std::conditional_t<Export::enabled, ResultExporter, Empty> exporter;
+    };
+
+    Backend backend_;
+    float scale_factor_;
+    std::vector<float> peaks_;         // kPeaksCount значений, размер не меняется
+    [[no_unique_address]] std::conditional_t<kNeedsSnapshot, SnapshotState, Empty> state_;
+
+    OperationTiming step1_upload_timing_;
+    OperationTiming step1_fft_timing_;
+    OperationTiming step2_upload_timing_;
+    OperationTiming step2_fft_timing_;
+    OperationTiming step3_copy_timing_;
+    OperationTiming step3_ifft_timing_;
+    OperationTiming step3_download_timing_;
+
+    template <class ValidateFn, class ExportFn>
+    void finish_step(ValidateFn&& validate, ExportFn&& export_step) {
+        ValidationResult validation;
+        if constexpr (Validation::enabled) {
+            validation = validate(state_.validator);
+        }
+        if constexpr (Export::enabled) {
+            export_step(state_.exporter, validation);
+        }
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_STATIC_PIPELINE_HPP
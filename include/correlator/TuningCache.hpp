@@ -0,0 +1,132 @@
+#ifndef CORRELATOR_TUNING_CACHE_HPP
+#define CORRELATOR_TUNING_CACHE_HPP
+
+#include "../../include/fft_handler.hpp"
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace Correlator {
+
+// ============================================================================
+// TuningCache - результаты автотюнинга Step 2 по хосту, устройству и форме
+// ============================================================================
+
+/**
+ * Текстовый файл, одна строка на форму:
+ *   <ключ>\t<путь конвертации>\t<split>\t<время, мс>
+ * Ключ: host|device|driver|N|signals|shifts|n_kg. Смена драйвера или формы
+ * даёт новый ключ — калибровка повторится один раз и допишется в файл.
+ *
+ * Путь по умолчанию: $XDG_CACHE_HOME/correlator/tuning.txt
+ * (или ~/.cache/correlator/tuning.txt).
+ */
+class TuningCache {
+public:
+    explicit TuningCache(std::string path = defaultPath()) : path_(std::move(path)) {
+        load();
+    }
+
+    static std::string defaultPath() {
+        std::filesystem::path base;
+        if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+            base = xdg;
+        } else if (const char* home = std::getenv("HOME"); home && *home) {
+            base = std::filesystem::path(home) / ".cache";
+        } else {
+            base = std::filesystem::temp_directory_path();
+        }
+        return (base / "correlator" / "tuning.txt").string();
+    }
+
+    static std::string makeKey(const std::string& device, const std::string& driver,
+                               size_t fft_size, int num_signals, int num_shifts, int n_kg) {
+        char host[256] = {0};
+        if (gethostname(host, sizeof(host) - 1) != 0) {
+            std::snprintf(host, sizeof(host), "unknown");
+        }
+        std::string key = std::string(host) + "|" + device + "|" + driver + "|" + std::to_string(fft_size) +
+                          "|" + std::to_string(num_signals) + "|" + std::to_string(num_shifts) +
+                          "|" + std::to_string(n_kg);
+        // Разделители формата файла не должны попасть в ключ
+        for (char& c : key) {
+            if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+        }
+        return key;
+    }
+
+    const std::string& path() const { return path_; }
+
+    bool lookup(const std::string& key, Step2TuningResult& result) const {
+        auto it = entries_.find(key);
+        if (it == entries_.end()) {
+            return false;
+        }
+        result = it->second;
+        return true;
+    }
+
+    /**
+     * @brief Запомнить результат и переписать файл (временный файл + rename)
+     */
+    bool store(const std::string& key, const Step2TuningResult& result) {
+        entries_[key] = result;
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path_).parent_path(), ec);
+        const std::string tmp_path = path_ + ".tmp";
+        {
+            std::ofstream out(tmp_path, std::ios::trunc);
+            if (!out) {
+                return false;
+            }
+            for (const auto& [entry_key, entry] : entries_) {
+                out << entry_key << '\t' << Step2PlanTuning::pathName(entry.tuning.path) << '\t'
+                    << entry.tuning.split << '\t' << entry.time_ms << '\n';
+            }
+            if (!out) {
+                return false;
+            }
+        }
+        if (std::rename(tmp_path.c_str(), path_.c_str()) != 0) {
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string path_;
+    std::map<std::string, Step2TuningResult> entries_;
+
+    void load() {
+        std::ifstream in(path_);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string key, path, split, time_ms;
+            if (!std::getline(fields, key, '\t') || !std::getline(fields, path, '\t') ||
+                !std::getline(fields, split, '\t') || !std::getline(fields, time_ms)) {
+                continue;  // Повреждённая строка — форма будет откалибрована заново
+            }
+
+            Step2TuningResult entry;
+            entry.tuning.path = path == Step2PlanTuning::pathName(Step2PlanTuning::Converter)
+                                    ? Step2PlanTuning::Converter : Step2PlanTuning::Callback;
+            entry.tuning.split = std::atoi(split.c_str());
+            entry.time_ms = std::atof(time_ms.c_str());
+            if (entry.tuning.split > 0) {
+                entries_[key] = entry;
+            }
+        }
+    }
+};
+
+} // namespace Correlator
+
+#endif // CORRELATOR_TUNING_CACHE_HPP
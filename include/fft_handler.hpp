@@ -4,9 +4,14 @@
 #include <CL/opencl.h>
 #include <clFFT.h>
 #include <cstdint>
+#include <span>
 #include <vector>
 #include <string>
 #include <stdexcept>
+#include <chrono>
+#include "cl_resource_tracker.hpp"
+#include "correlator/PeaksEncoding.hpp"
+#include "correlator/RangeDoppler.hpp"
 
 // ============================================================================
 // FFT Handler для коррелятора
@@ -37,6 +42,84 @@ struct FFTContext {
     cl_mem pre_callback_userdata_correlation; // Userdata для pre-callback Complex Multiply (Step 3)
     cl_mem post_callback_userdata;  // Userdata для post-callback
     
+    cl_mem reference_callback_userdata; // Userdata pre-callback плана Step 1 (scale_factor)
+    cl_mem input_callback_userdata;     // Userdata pre-callback плана Step 2 (scale_factor)
+    
+    // Кодирование пиков на устройстве (создаются при первом encode_correlation_results)
+    cl_program peaks_encode_program;
+    cl_kernel encode_f16_kernel;
+    cl_kernel encode_log_u16_kernel;
+    cl_kernel encode_sparse_kernel;
+    cl_mem encoded_peaks;               // Сжатый payload (растёт по требованию)
+    size_t encoded_peaks_size;
+    
+    // Step 2 без callback'а (см. Step2PlanTuning): ядро int32→float2 + in-place план
+    cl_program converter_program;
+    cl_kernel convert_kernel;
+    
+    // Sub-buffer'ы input_data / input_fft при делении батча Step 2 на части
+    // (создаются clCreateSubBuffer, трекером не учитываются — память родителя)
+    std::vector<cl_mem> input_data_parts;
+    std::vector<cl_mem> input_fft_parts;
+    
+    // Формирование лучей (создаются при первом set_beam_weights)
+    cl_program beamform_program;
+    cl_kernel beamform_kernel;
+    cl_mem beam_weights;                // [channels][beams][N] complex
+    cl_mem beam_fft;                    // Спектры лучей [num_signals][N] до копирования в input_fft
+    
+    // Слитый Step 2+3: FFT → умножение → IFFT → пики в локальной памяти (собирается под N)
+    cl_program fused_program;
+    cl_kernel fused_kernel;
+    
+    // Парный режим Step 3 (создаются при первом step3_pairwise_correlation)
+    cl_program pairwise_program;
+    cl_kernel pairwise_products_kernel;
+    cl_kernel pairwise_lags_kernel;
+    cl_mem pair_table;                  // [pairs][2] = (i, j)
+    cl_mem pairwise_peaks;              // [pairs][num_lags]
+    clfftPlanHandle pairwise_ifft_plan; // In-place IFFT по строкам correlation_fft
+    
+    // 2D корреляция (создаются при первом set_templates_2d, см. Correlation2D.hpp)
+    cl_program correlation2d_program;
+    cl_kernel correlation2d_multiply_kernel;
+    cl_kernel correlation2d_argmax_kernel;
+    cl_mem corr2d_input;                // Вещественные кадры/шаблоны [count][H][W]
+    cl_mem corr2d_template_spectra;     // [templates][H][W/2 + 1]
+    cl_mem corr2d_image_spectra;        // [images][H][W/2 + 1]
+    cl_mem corr2d_products;             // [images · templates][H][W/2 + 1]
+    cl_mem corr2d_surfaces;             // [images · templates][H][W]
+    cl_mem corr2d_records;              // [images · templates][kPeak2DRecordFloats]
+    clfftPlanHandle corr2d_template_plan; // R2C батч шаблонов
+    clfftPlanHandle corr2d_image_plan;    // R2C батч кадров
+    clfftPlanHandle corr2d_inverse_plan;  // C2R батч произведений
+    
+    // Карта дальность-доплер по спектрам Step 1/2 (создаются при первом step4_range_doppler)
+    cl_program range_doppler_program;
+    cl_kernel range_profiles_kernel;
+    cl_kernel corner_turn_kernel;
+    cl_kernel doppler_power_kernel;
+    cl_kernel cfar_kernel;
+    cl_mem doppler_window;              // [num_pulses] коэффициенты окна
+    cl_mem range_profiles;              // [num_pulses][N] complex профили дальности (in-place IFFT)
+    cl_mem slow_time;                   // [range_bins][doppler_size] complex (in-place FFT)
+    cl_mem range_doppler_map;           // [range_bins][doppler_size] |·|²
+    cl_mem cfar_detections;             // [0] счётчик, далее записи (range, doppler, power, noise)
+    clfftPlanHandle doppler_fft_plan;   // In-place FFT по строкам slow_time
+    clfftPlanHandle range_profile_plan; // In-place IFFT по строкам range_profiles (без callback'ов)
+    
+    // Развёртка банка опорных из базового спектра (создаётся при первом вызове)
+    cl_program reference_expand_program;
+    cl_kernel reference_expand_kernel;
+    cl_kernel reference_decode_kernel;       // Страница fp16 → float2 (тот же program)
+    
+    // Страничный банк опорных: слоты на устройстве + pinned staging (configure_reference_cache)
+    cl_command_queue transfer_queue;         // Отдельная in-order очередь: подкачка параллельно Step 3
+    cl_mem reference_pages;                  // [slots][num_shifts][N] float2
+    cl_mem reference_page_half;              // [num_shifts][N] half2 перед декодированием (только fp16)
+    cl_mem reference_page_staging[2];        // CL_MEM_ALLOC_HOST_PTR, отображены на всё время работы
+    void* reference_page_staging_ptr[2];
+    
     bool initialized;
     bool is_cleaned_up;  //флаг очистки
 
@@ -47,6 +130,27 @@ struct FFTContext {
           input_data(nullptr), input_fft(nullptr),
           correlation_fft(nullptr), correlation_ifft(nullptr),
           pre_callback_userdata(nullptr), pre_callback_userdata_correlation(nullptr), post_callback_userdata(nullptr),
+          reference_callback_userdata(nullptr), input_callback_userdata(nullptr),
+          peaks_encode_program(nullptr), encode_f16_kernel(nullptr),
+          encode_log_u16_kernel(nullptr), encode_sparse_kernel(nullptr),
+          encoded_peaks(nullptr), encoded_peaks_size(0),
+          converter_program(nullptr), convert_kernel(nullptr),
+          beamform_program(nullptr), beamform_kernel(nullptr),
+          beam_weights(nullptr), beam_fft(nullptr),
+          fused_program(nullptr), fused_kernel(nullptr),
+          pairwise_program(nullptr), pairwise_products_kernel(nullptr), pairwise_lags_kernel(nullptr),
+          pair_table(nullptr), pairwise_peaks(nullptr), pairwise_ifft_plan(0),
+          correlation2d_program(nullptr), correlation2d_multiply_kernel(nullptr),
+          correlation2d_argmax_kernel(nullptr), corr2d_input(nullptr), corr2d_template_spectra(nullptr),
+          corr2d_image_spectra(nullptr), corr2d_products(nullptr), corr2d_surfaces(nullptr),
+          corr2d_records(nullptr), corr2d_template_plan(0), corr2d_image_plan(0), corr2d_inverse_plan(0),
+          range_doppler_program(nullptr), range_profiles_kernel(nullptr), corner_turn_kernel(nullptr),
+          doppler_power_kernel(nullptr), cfar_kernel(nullptr), doppler_window(nullptr), range_profiles(nullptr),
+          slow_time(nullptr), range_doppler_map(nullptr), cfar_detections(nullptr), doppler_fft_plan(0),
+          range_profile_plan(0),
+          reference_expand_program(nullptr), reference_expand_kernel(nullptr), reference_decode_kernel(nullptr),
+          transfer_queue(nullptr), reference_pages(nullptr), reference_page_half(nullptr),
+          reference_page_staging{nullptr, nullptr}, reference_page_staging_ptr{nullptr, nullptr},
           initialized(false), is_cleaned_up(false) {}
 };
 
@@ -98,6 +202,34 @@ struct ComplexMultiplyPreCallbackParams {
     }
 };
 
+/**
+ * Конфигурация Step 2 (Forward FFT входных сигналов), выбираемая автотюнингом
+ *   Callback  — int32→float2 в pre-callback плана clFFT, out-of-place input_data → input_fft
+ *   Converter — ядро convert_int32_to_float2 (input_data → input_fft) + обычный in-place план
+ * split — на сколько последовательных clfftEnqueueTransform делится батч num_signals
+ */
+struct Step2PlanTuning {
+    enum Path : uint8_t {
+        Callback = 0,
+        Converter = 1
+    };
+    
+    Path path = Callback;
+    int split = 1;
+    
+    static const char* pathName(Path path) {
+        return path == Converter ? "converter" : "callback";
+    }
+};
+
+/**
+ * Замер одного кандидата автотюнинга (медиана времени Step 2 без upload)
+ */
+struct Step2TuningResult {
+    Step2PlanTuning tuning;
+    double time_ms = 0.0;
+};
+
 // ============================================================================
 // FFT Handler Class
 // ============================================================================
@@ -107,7 +239,8 @@ public:
     /**
      * Конструктор
      */
-    FFTHandler(cl_context ctx, cl_command_queue q, cl_device_id dev) {
+    FFTHandler(cl_context ctx, cl_command_queue q, cl_device_id dev)
+        : resources_("FFTHandler") {
 
         if (!ctx || !q || !dev) {
             throw std::runtime_error("Invalid OpenCL context/queue/device");
@@ -159,8 +292,42 @@ public:
         double total_gpu_ms = 0.0;     // Общее GPU время (QUEUED to END)
     };
     
+    /**
+     * Время одной фазы инициализации (host-время, std::chrono)
+     */
+    struct InitPhaseTiming {
+        std::string phase;             // Название фазы (буфер, план, userdata)
+        double time_ms = 0.0;          // Длительность фазы
+    };
+    
+    /**
+     * Получить разбивку времени initialize() по фазам (в порядке выполнения)
+     */
+    const std::vector<InitPhaseTiming>& getInitTimings() const { return init_timings_; }
+    
+    /**
+     * Ленивая сборка плана/программы после initialize() (host-время)
+     */
+    struct BuildPhaseTiming {
+        std::string step;              // Шаг трекера, вызвавший сборку (Step2, Autotune, ...)
+        std::string phase;             // Название фазы (план, программа)
+        double time_ms = 0.0;          // Длительность фазы
+    };
+    
+    /**
+     * Получить ленивые сборки (в порядке выполнения); в getInitTimings() не попадают
+     */
+    const std::vector<BuildPhaseTiming>& getBuildTimings() const { return build_timings_; }
+    
+    /**
+     * Учёт OpenCL объектов handler'а: память по шагам, high-water, утечки
+     */
+    const CLResourceTracker& getResourceTracker() const { return resources_; }
+    
     /**
      * ШАГ 1: Загрузить опорный сигнал и запустить Forward FFT с pre-callback
+     * Одно FFT строки 0; строки s ≥ 1 (опорный, сдвинутый на s) разворачиваются
+     * фазовым множителем — как step1_expand_reference_spectrum
      */
     void step1_reference_signals(
         const int32_t* host_reference,  // входной опорный сигнал
@@ -189,6 +356,130 @@ public:
         OperationTiming& fft_timing
     );
     
+    /**
+     * ШАГ 1 (из checkpoint): загрузить готовые спектры опорных сигналов в reference_fft
+     * Спектры в том виде, в каком их вернул getReferenceFFTData (после сопряжения)
+     */
+    void step1_load_reference_spectra(
+        const cl_float2* host_spectra,
+        size_t N,
+        int num_shifts,
+        OperationTiming& upload_timing
+    );
+    
+    /**
+     * ШАГ 1 (аналитический опорный): загрузить базовую строку R_0 и развернуть банк на устройстве
+     * R_s[k] = R_0[k]·e^{−j2πks/N} — передаётся N значений вместо N·num_shifts,
+     * FFT не выполняется. Соглашения — correlator/ReferenceSpectra.hpp
+     * @param base_spectrum N комплексных значений в формате строки getReferenceFFTData
+     */
+    void step1_expand_reference_spectrum(
+        const cl_float2* base_spectrum,
+        size_t N,
+        int num_shifts,
+        OperationTiming& upload_timing,
+        OperationTiming& expand_timing
+    );
+    
+    /**
+     * Страничный банк опорных (correlator/PagedReferenceBank.hpp): slots страниц
+     * [num_shifts][N] на устройстве, подкачка с хоста через pinned staging по
+     * отдельной очереди. Повторный вызов пересоздаёт кэш (содержимое слотов теряется)
+     * @param half_precision Страницы на хосте в fp16 (декодируются kernel'ом на устройстве)
+     */
+    void configure_reference_cache(int slots, bool half_precision);
+    
+    /**
+     * Поставить подкачку страницы в слот и вернуться, не дожидаясь передачи
+     * @param host_page Страница в формате банка (float2 или half2), копируется в staging до возврата
+     * @param staging_timing cpu_wait_ms — ожидание свободного staging, execute_ms — memcpy в staging
+     */
+    void page_in_reference(int slot, const void* host_page, OperationTiming& staging_timing);
+    
+    /**
+     * Сделать страницу слота банком Step 1: копия на устройстве в reference_fft
+     * после окончания её подкачки
+     * @param activate_timing total_gpu_ms − execute_ms — ожидание подкачки (простой Step 3)
+     */
+    void activate_reference_page(int slot, OperationTiming& activate_timing);
+    
+    /**
+     * ШАГ 2 (из архива): загрузить готовые спектры входных сигналов в input_fft
+     * Forward FFT не выполняется — спектры взяты из спектрального индекса
+     * @param host_spectra num_signals × N комплексных значений
+     */
+    void step2_load_input_spectra(
+        const cl_float2* host_spectra,
+        size_t N,
+        int num_signals,
+        OperationTiming& upload_timing
+    );
+    
+    /**
+     * Перестроить план Step 2 под конфигурацию (после initialize)
+     * split должен делить num_signals, смещения частей — выравнивание устройства
+     */
+    void apply_step2_tuning(const Step2PlanTuning& tuning);
+    
+    /**
+     * Калибровка Step 2: замерить путь конвертации и деление батча на текущей форме,
+     * применить самую быструю конфигурацию
+     * @param iterations Число замеров на кандидата (плюс один прогрев)
+     * @param results Все замеренные кандидаты (может быть nullptr)
+     * @return Выбранная конфигурация
+     */
+    Step2PlanTuning autotune_step2(int iterations = 5, std::vector<Step2TuningResult>* results = nullptr);
+    
+    const Step2PlanTuning& getStep2Tuning() const { return step2_tuning_; }
+    
+    /**
+     * Загрузить весовые коэффициенты лучей (один раз, до step2_form_beams)
+     * @param weights channels × beams × N комплексных значений (раскладка BeamWeights)
+     * @param channels Должно совпадать с num_signals (каналы — батч Step 2)
+     * @param beams Не больше num_signals (лучи занимают строки input_fft)
+     */
+    void set_beam_weights(const cl_float2* weights, int channels, int beams);
+    
+    /**
+     * ШАГ 2б: сформировать лучи из спектров каналов и записать их в input_fft
+     * Строки input_fft с номером ≥ beams обнуляются (их пики Step 3 нулевые)
+     */
+    void step2_form_beams(OperationTiming& beam_timing);
+    
+    int getBeamCount() const { return beam_count_; }
+    
+    /**
+     * Включить слитый Step 2+3: одна work-group на сигнал делает прямой FFT,
+     * умножение на спектры опорного, обратный FFT и извлечение пиков
+     * в локальной памяти; промежуточные спектры не пишутся в global.
+     * Step 2 тогда только загружает сигналы, Step 3 — один запуск на батч.
+     * Требования: N — степень двойки в [16, 4096], N комплексных значений
+     * помещаются в локальную память устройства
+     * @return false, если форма или устройство не подходят (остаётся путь clFFT)
+     */
+    bool enable_fused_correlation();
+    
+    /**
+     * Вернуться на путь clFFT (программа слитого kernel'а остаётся до cleanup).
+     * Отложенные спектры входа досчитываются
+     */
+    void disable_fused_correlation();
+    
+    bool isFusedCorrelationEnabled() const { return fused_enabled_; }
+    
+    /**
+     * Step 2 слитого пути загрузил сигналы, а input_fft ещё не посчитан
+     */
+    bool isInputSpectraDeferred() const { return fused_input_pending_; }
+    
+    /**
+     * Досчитать спектры входа (план Step 2), если слитый путь их пропустил.
+     * Нужен перед чтением input_fft (экспорт, формирование лучей)
+     * @param fft_timing Время досчёта; не меняется, если досчитывать нечего
+     * @return true, если FFT был выполнен
+     */
+    bool materialize_input_spectra(OperationTiming& fft_timing);
+    
     /**
      * ШАГ 3: Запустить корреляцию (multiplication + IFFT + post-callback)
      */
@@ -207,14 +498,85 @@ public:
     );
     
     /**
-     * Получить результаты корреляции
-     * Формат: [num_signals][num_shifts][n_kg]
+     * ШАГ 3 (парный режим, TDOA): корреляция каждой пары входов i ≤ j по input_fft
+     * Произведения X_i·conj(X_j) пишутся в correlation_fft (он вмещает
+     * num_signals × num_shifts строк), один батчевый in-place IFFT на все пары,
+     * затем модули num_lags задержек вокруг нуля. Если пар больше, чем строк,
+     * тот же план запускается на частях. Раскладка — PairwiseCorrelation.hpp
+     * @param peaks [pairs][num_lags], pairs = num_signals·(num_signals + 1)/2
+     */
+    void step3_pairwise_correlation(
+        int num_signals,
+        int num_lags,
+        std::vector<float>& peaks,
+        OperationTiming& multiply_timing,
+        OperationTiming& ifft_timing,
+        OperationTiming& download_timing
+    );
+    
+    /**
+     * 2D корреляция, шаг шаблонов: батчевый R2C FFT спектров шаблонов
+     * Шаблоны остаются на устройстве до следующего вызова; размер кадра
+     * задаётся здесь же (планы пересоздаются при смене формы).
+     * @param templates [num_templates][height][width], дополнены нулями до кадра
+     */
+    void set_templates_2d(
+        std::span<const float> templates,
+        int num_templates,
+        size_t height,
+        size_t width,
+        OperationTiming& fft_timing
+    );
+    
+    /**
+     * 2D корреляция кадров со всеми шаблонами: R2C кадров → произведения
+     * X·conj(T) всех пар одним kernel'ом → батчевый C2R (1/(H·W)) → максимум
+     * и окно 3 × 3 на пару (work-group на пару)
+     * @param records [num_images][num_templates][kPeak2DRecordFloats] (refinePeak2D)
      */
-    std::vector<std::vector<std::vector<float>>> get_correlation_results(
+    void correlate_2d(
+        std::span<const float> images,
+        int num_images,
+        std::vector<float>& records,
+        OperationTiming& fft_timing,
+        OperationTiming& multiply_timing,
+        OperationTiming& ifft_timing
+    );
+    
+    /**
+     * ШАГ 4 (импульсно-доплеровский): карта дальность-доплер на устройстве
+     * Импульсы — первые num_pulses сигналов последнего step3_correlation.
+     * Комплексные профили Step 3 не сохраняются (post-callback пишет только
+     * пики), поэтому профили дальности для сдвига params.shift считаются
+     * заново из reference_fft и input_fft: R_s·conj(X_p) → IFFT без callback'ов.
+     * Перестановка (corner turn) тайлами в локальной памяти с окном →
+     * батчевый in-place FFT по импульсам → |·|² → CA-CFAR по дальности.
+     * Соглашения — correlator/RangeDoppler.hpp
+     * @param map Если не nullptr — скачать карту [range_bins][doppler_size]
+     * @param detections Детекции CFAR (пусто, если CFAR выключен)
+     * @return Ячеек выше порога (может превышать max_detections)
+     */
+    size_t step4_range_doppler(
+        const Correlator::RangeDopplerParams& params,
+        std::vector<float>* map,
+        std::vector<Correlator::RangeDopplerDetection>& detections,
+        OperationTiming& corner_turn_timing,
+        OperationTiming& fft_timing,
+        OperationTiming& detect_timing
+    );
+    
+    /**
+     * Скачать результаты корреляции в буфер вызывающего кода (без аллокаций)
+     * Формат: [num_signals][num_shifts][n_kg] одним непрерывным блоком
+     * @param output Буфер ровно на num_signals * num_shifts * n_kg значений
+     * @return false, если размер не совпадает или чтение не удалось
+     */
+    bool get_correlation_results(
+        std::span<float> output,
         int num_signals,
         int num_shifts,
         int n_kg
-    );
+    ) const;
     
     /**
      * Получить reference FFT данные (для валидации)
@@ -241,6 +603,35 @@ public:
      */
     bool getCorrelationPeaksData(std::vector<float>& output, int num_signals, int num_shifts, int n_kg) const;
     
+    /**
+     * Закодировать пики на устройстве и скачать только сжатый payload
+     * Форматы: см. correlator/PeaksEncoding.hpp (Float32 читается без ядра)
+     * @param params Кодировка и параметры детектора SparseDelta
+     * @param output Результат (ёмкость payload переиспользуется)
+     * @param download_timing Время кодирования + чтения (по событиям OpenCL)
+     */
+    bool encode_correlation_results(
+        const Correlator::PeaksEncodingParams& params,
+        int num_signals,
+        int num_shifts,
+        int n_kg,
+        Correlator::EncodedPeaks& output,
+        OperationTiming& download_timing
+    );
+    
+    /**
+     * Кодировка пиков для step3_correlation: при значении, отличном от Float32,
+     * Step 3 кодирует пики на устройстве и скачивает только сжатый payload
+     * (результат — getEncodedResults()), полный float32 массив не читается
+     */
+    void setPeaksEncoding(const Correlator::PeaksEncodingParams& params) { peaks_encoding_ = params; }
+    const Correlator::PeaksEncodingParams& getPeaksEncoding() const { return peaks_encoding_; }
+    
+    /**
+     * Сжатые пики последнего step3_correlation (пусто для Float32)
+     */
+    const Correlator::EncodedPeaks& getEncodedResults() const { return encoded_result_; }
+    
     /**
      * Получить размер FFT
      */
@@ -268,6 +659,110 @@ private:
     int n_kg_;
     float scale_factor_;
     
+    // Кодирование результатов Step 3
+    Correlator::PeaksEncodingParams peaks_encoding_;
+    Correlator::EncodedPeaks encoded_result_;
+    
+    // Текущая конфигурация плана Step 2
+    Step2PlanTuning step2_tuning_;
+    
+    // Формирование лучей: 0 — не настроено
+    int beam_channels_ = 0;
+    int beam_count_ = 0;
+    
+    // Страничный банк опорных: 0 слотов — кэш не настроен
+    int reference_cache_slots_ = 0;
+    bool reference_cache_half_ = false;
+    int reference_staging_next_ = 0;
+    cl_event reference_staging_events_[2] = {nullptr, nullptr};  // Передача из staging (transfer_queue)
+    std::vector<cl_event> reference_slot_ready_;                  // Подкачка слота завершена
+    
+    // Слитый Step 2+3: input_data загружен, а input_fft ещё не посчитан
+    bool fused_enabled_ = false;
+    bool fused_input_pending_ = false;
+    size_t fused_work_group_ = 0;
+    
+    // Парный режим: строк в батче pairwise_ifft_plan и число сигналов в pair_table
+    size_t pairwise_batch_ = 0;
+    int pairwise_signals_ = 0;
+    
+    // Сигналов последнего Step 3: Step 4 берёт импульсы из их спектров в input_fft
+    // (0 — Step 3 не выполнялся)
+    int step3_signals_ = 0;
+    
+    // Карта дальность-доплер: длина и батч doppler_fft_plan, батч range_profile_plan
+    size_t doppler_plan_size_ = 0;
+    size_t doppler_plan_batch_ = 0;
+    size_t range_profile_plan_batch_ = 0;
+    
+    // 2D корреляция: форма кадра, число шаблонов и кадров в планах
+    size_t corr2d_height_ = 0;
+    size_t corr2d_width_ = 0;
+    int corr2d_templates_ = 0;
+    int corr2d_images_ = 0;
+    
+    // Handler держит ссылку на библиотеку clFFT (clfftSetup/clfftTeardown по счётчику)
+    bool clfft_acquired_ = false;
+    
+    // Буферы и события handler'а (создаются/освобождаются через трекер)
+    CLResourceTracker resources_;
+    
+    // Разбивка времени инициализации по фазам
+    using InitClock = std::chrono::high_resolution_clock;
+    std::vector<InitPhaseTiming> init_timings_;
+    std::vector<BuildPhaseTiming> build_timings_;
+    
+    /**
+     * clfftSetup при первом handler'е процесса, clfftTeardown — при освобождении последнего
+     */
+    void acquire_clfft_library();
+    void release_clfft_library();
+    
+    /**
+     * Записать фазу инициализации (от start до текущего момента).
+     * После initialize() фаза — ленивая сборка: уходит в build_timings_ под текущим шагом
+     */
+    void record_init_phase(const std::string& phase, InitClock::time_point start);
+    
+    /**
+     * Записать готовые спектры в буфер устройства (блокирующе, с профилированием)
+     */
+    void upload_spectra(
+        cl_mem target,
+        const cl_float2* host_spectra,
+        size_t count,
+        const char* label,
+        OperationTiming& upload_timing
+    );
+    
+    /**
+     * Описание FFT плана произвольной размерности и раскладки
+     * (длины, шаги и расстояния — в элементах, быстрая ось первой, как в clFFT)
+     */
+    struct FFTPlanDesc {
+        clfftDim dim = CLFFT_1D;
+        size_t lengths[3] = {1, 1, 1};
+        clfftLayout in_layout = CLFFT_COMPLEX_INTERLEAVED;
+        clfftLayout out_layout = CLFFT_COMPLEX_INTERLEAVED;
+        size_t in_strides[3] = {1, 1, 1};
+        size_t out_strides[3] = {1, 1, 1};
+        size_t in_distance = 0;
+        size_t out_distance = 0;
+        clfftResultLocation location = CLFFT_OUTOFPLACE;
+        int batch_size = 1;
+        
+        /**
+         * Батч вещественных 2D кадров height × width: R2C (forward) или C2R
+         * Эрмитова половина — height × (width/2 + 1), строки подряд.
+         */
+        static FFTPlanDesc real2D(size_t height, size_t width, int batch_size, bool forward);
+    };
+    
+    /**
+     * Создать FFT план по описанию (без callback'ов)
+     */
+    clfftPlanHandle create_fft_plan(const FFTPlanDesc& desc, const std::string& plan_name);
+    
     /**
      * Создать 1D FFT план для батча
      */
@@ -277,6 +772,15 @@ private:
         const std::string& plan_name
     );
     
+    /**
+     * Создать 1D in-place FFT план без callback'ов (Step 2, путь Converter)
+     */
+    clfftPlanHandle create_fft_plan_1d_inplace(
+        size_t fft_size,
+        int batch_size,
+        const std::string& plan_name
+    );
+    
     /**
      * Создать 1D FFT план с встроенным pre-callback
      */
@@ -344,6 +848,84 @@ private:
         const PostCallbackParams& params
     );
     
+    /**
+     * Собрать программу кодирования пиков (один раз)
+     */
+    bool build_peaks_encode_program();
+    
+    /**
+     * Собрать программу конвертации int32→float2 (один раз)
+     */
+    bool build_converter_program();
+    
+    /**
+     * Собрать программу формирования лучей (один раз)
+     */
+    bool build_beamform_program();
+    
+    /**
+     * Собрать слитую программу Step 2+3 под текущие N и размер work-group
+     */
+    bool build_fused_program();
+    
+    /**
+     * Собрать kernel'ы парного режима (произведения пар, выборка задержек)
+     */
+    bool build_pairwise_program();
+    
+    /**
+     * Собрать kernel'ы 2D корреляции (произведения пар, максимум с окном 3 × 3)
+     */
+    bool build_correlation2d_program();
+    
+    /**
+     * Собрать kernel'ы карты дальность-доплер (профили, corner turn, |·|², CFAR)
+     */
+    bool build_range_doppler_program();
+    
+    /**
+     * Собрать kernel развёртки банка опорных по сдвигам
+     */
+    bool build_reference_expand_program();
+    
+    /**
+     * Развернуть строки 1..num_shifts−1 reference_fft из строки 0 на месте
+     */
+    void expand_reference_shifts(int num_shifts, OperationTiming& expand_timing);
+    
+    /**
+     * Дождаться подкачек и освободить слоты, staging и очередь передачи
+     */
+    void release_reference_cache();
+    
+    /**
+     * Выделить буфер заново, если его размер отличается от bytes
+     */
+    void ensure_buffer_size(cl_mem& buffer, size_t bytes, cl_mem_flags flags, const char* label);
+    
+    /**
+     * Step 3 слитым kernel'ом по загруженному input_data (пики — в post_callback_userdata)
+     */
+    void step3_fused_correlation(
+        int num_signals,
+        int num_shifts,
+        int n_kg,
+        OperationTiming& kernel_timing,
+        OperationTiming& download_timing
+    );
+    
+    /**
+     * Освободить план Step 2, его userdata и sub-buffer'ы частей батча
+     */
+    void release_step2_plan();
+    
+    /**
+     * Поставить в очередь Step 2 по текущей конфигурации (конвертация + FFT частей)
+     * @param wait_event Событие, которого ждёт первая команда (может быть nullptr)
+     * @return События команд в порядке выполнения (зарегистрированы в трекере)
+     */
+    std::vector<cl_event> enqueue_step2_transform(cl_event wait_event);
+    
     /**
      * Профилировать OpenCL событие
      */
@@ -140,6 +140,11 @@ cl_int gpu_convert_cyclic_shifts_batch(
 // Utility Functions
 // ============================================================================
 
+/**
+ * Текстовое имя кода ошибки OpenCL
+ */
+const char* get_cl_error_string(cl_int error);
+
 /**
  * Заполнить GPU буфер тестовыми данными
  */
@@ -407,7 +407,7 @@ public:
     /**
      * Экспортировать профилирование в Markdown файл
      * @param filename путь к файлу для сохранения (будет переименован с timestamp)
-     * @param step_details дополнительные детали по шагам (Step1, Step2, Step3)
+     * @param step_details дополнительные детали по шагам (Init, Step1, Step2, Step3)
      * @param gpu_info информация о GPU
      * @param config_params параметры конфигурации теста
      */
@@ -522,6 +522,38 @@ public:
         file << "| Количество профилированных операций | " << timings.size() << " |\n";
         file << "\n";
         
+        // Инициализация (время до первого результата)
+        if (timings.find("Init_Total") != timings.end()) {
+            file << "## 🚀 Инициализация\n\n";
+            double init_total_ms = get_avg("Init_Total") / 1000.0;
+            
+            file << "**Общее время инициализации:** " << std::fixed << std::setprecision(3) 
+                 << init_total_ms << " ms\n\n";
+            
+            file << "*Примечание: Времена фаз измерены на CPU (std::chrono). Многие драйверы выделяют память лениво, поэтому стоимость clCreateBuffer частично переносится на первый Step.*\n\n";
+            
+            if (step_details.find("Init") != step_details.end() && !step_details.at("Init").empty()) {
+                file << "| Фаза | Время (ms) | Доля |\n";
+                file << "|------|------------|------|\n";
+                double init_sum = 0.0;
+                for (const auto& [phase, time_ms] : step_details.at("Init")) {
+                    double share = init_total_ms > 0.0 ? time_ms / init_total_ms * 100.0 : 0.0;
+                    file << "| " << phase << " | " << std::fixed << std::setprecision(3) 
+                         << time_ms << " | " << std::setprecision(1) << share << "% |\n";
+                    init_sum += time_ms;
+                }
+                double init_overhead = init_total_ms - init_sum;
+                if (init_overhead > 0.001) {
+                    file << "| **Overhead** | " << std::fixed << std::setprecision(3) 
+                         << init_overhead << " | |\n";
+                }
+                file << "| **ИТОГО** | **" << std::fixed << std::setprecision(3) 
+                     << init_total_ms << "** | |\n\n";
+            } else {
+                file << "*Детальные данные по фазам инициализации отсутствуют*\n\n";
+            }
+        }
+        
         // Профилирование по шагам
         file << "## 🔄 Профилирование по шагам\n\n";
         
@@ -811,7 +843,7 @@ public:
     /**
      * Экспортировать профилирование в JSON файл
      * @param base_filename путь к файлу для сохранения (будет переименован с timestamp)
-     * @param step_details дополнительные детали по шагам (Step1, Step2, Step3)
+     * @param step_details дополнительные детали по шагам (Init, Step1, Step2, Step3)
      * @param gpu_info информация о GPU
      */
     bool export_to_json(
@@ -938,6 +970,29 @@ public:
         file << "    \"gpu_execution_time_ms\": " << format_double(total_gpu_time) << "\n";
         file << "  },\n";
         
+        // Инициализация
+        if (timings.find("Init_Total") != timings.end()) {
+            double init_total_ms = get_avg("Init_Total") / 1000.0;
+            
+            file << "  \"init\": {\n";
+            file << "    \"description\": \"Инициализация бэкенда (host-время)\",\n";
+            file << "    \"total_time_ms\": " << format_double(init_total_ms) << ",\n";
+            file << "    \"phases\": {\n";
+            
+            if (step_details.find("Init") != step_details.end()) {
+                size_t phase_count = 0;
+                size_t total_phases = step_details.at("Init").size();
+                for (const auto& [phase, time_ms] : step_details.at("Init")) {
+                    file << "      \"" << escape_json(phase) << "\": " << format_double(time_ms);
+                    if (++phase_count < total_phases) file << ",";
+                    file << "\n";
+                }
+            }
+            
+            file << "    }\n";
+            file << "  },\n";
+        }
+        
         // Профилирование по шагам
         file << "  \"steps\": {\n";
         
@@ -1,5 +1,10 @@
 #include "include/correlator/Correlator.hpp"
 #include "include/correlator/OpenCLFFTBackend.hpp"
+#include "include/correlator/DirectCorrelationBackend.hpp"
+#include "include/correlator/HostFusedBackend.hpp"
+#include "include/correlator/NumaShardedCorrelator.hpp"
+#include "include/correlator/RaggedCorrelator.hpp"
+#include "include/correlator/PrometheusExporter.hpp"
 #include "include/profiler.hpp"
 #include <iostream>
 #include <vector>
@@ -7,6 +12,10 @@
 #include <map>
 #include <string>
 #include <cstdio>
+#include <filesystem>
+#include <cstdlib>
+#include <numeric>
+#include <random>
 
 using namespace Correlator;
 
@@ -30,6 +39,46 @@ std::vector<int32_t> generateMSequence(size_t length, uint32_t seed = 0x1) {
     return sequence;
 }
 
+// Самопроверка бинарного снимка: Step 2/3 двух батчей в архив и обратно.
+// Строки второго батча дописываются после первого, форма потока растёт
+bool verifySnapshotArchive(const IDataSnapshot& snapshot, const IConfiguration& config, const std::string& path) {
+    {
+        ChunkArchiveWriter writer(path);
+        for (int batch = 0; batch < 2; ++batch) {
+            if (!SnapshotArchive::writeStep(writer, snapshot, IDataSnapshot::Step::STEP2_INPUT_FFT, config) ||
+                !SnapshotArchive::writeStep(writer, snapshot, IDataSnapshot::Step::STEP3_PEAKS, config)) {
+                return false;
+            }
+        }
+        if (!writer.finish()) {
+            return false;
+        }
+    }
+
+    ChunkArchiveReader reader(path);
+    DataSnapshot loaded;
+    const uint32_t rows = 2 * static_cast<uint32_t>(config.getNumSignals());
+    const auto* spectra_shape = reader.streamShape(SnapshotArchive::id(SnapshotStream::InputFFT));
+    const auto* peaks_shape = reader.streamShape(SnapshotArchive::id(SnapshotStream::Peaks));
+    bool ok = spectra_shape && peaks_shape && spectra_shape->dims[0] == rows && peaks_shape->dims[0] == rows &&
+              reader.chunkCount(SnapshotArchive::id(SnapshotStream::InputFFT)) == rows &&
+              SnapshotArchive::load(reader, loaded);
+
+    const auto& spectra = snapshot.getInputFFT();
+    const auto& peaks = snapshot.getPeaks();
+    ok = ok && loaded.getInputFFT().size() == 2 * spectra.size() && loaded.getPeaks().size() == 2 * peaks.size();
+    for (size_t batch = 0; ok && batch < 2; ++batch) {
+        ok = std::equal(spectra.begin(), spectra.end(), loaded.getInputFFT().begin() + batch * spectra.size(),
+                        [](const ComplexFloat& a, const ComplexFloat& b) {
+                            return a.real == b.real && a.imag == b.imag;
+                        }) &&
+             std::equal(peaks.begin(), peaks.end(), loaded.getPeaks().begin() + batch * peaks.size());
+    }
+    reader.close();
+    std::filesystem::remove(path);
+    return ok;
+}
+
 int main() {
     std::cout << "╔══════════════════════════════════════════════════════════════╗\n";
     std::cout << "║     FFT CORRELATOR - Пример использования архитектуры       ║\n";
@@ -57,6 +106,16 @@ int main() {
 
          config->setScaleFactor(1.0f / 32768.0f);
 
+        // Кодировка пиков Step 3: CORRELATOR_PEAKS_ENCODING=f16 | log-u16 | sparse-delta
+        if (const char* encoding_name = std::getenv("CORRELATOR_PEAKS_ENCODING")) {
+            PeaksEncodingParams encoding;
+            if (parsePeaksEncoding(encoding_name, encoding.encoding)) {
+                config->setPeaksEncoding(encoding);
+            } else {
+                std::cerr << "Неизвестная кодировка пиков: " << encoding_name << " (используется f32)\n";
+            }
+        }
+
         if (!config->validate()) {
             std::cerr << "Ошибка валидации конфигурации: " << config->getValidationErrors() << "\n";
             return 1;
@@ -65,18 +124,69 @@ int main() {
 
         // 2. Создать бэкенд (OpenCL)
         std::cout << "[2] Создание OpenCL бэкенда...\n";
-        auto backend = IFFTBackend::createOpenCLBackend();
-
-        // Установить конфигурацию в бэкенд
-        auto opencl_backend = dynamic_cast<OpenCLFFTBackend*>(backend.get());
-        if (opencl_backend) {
-            opencl_backend->setConfiguration(
-                config->getFFTSize(),
-                config->getNumShifts(),
-                config->getNumSignals(),
-                config->getNumOutputPoints(),
-                config->getScaleFactor()
-            );
+        // Настроить конкретный бэкенд до передачи в pipeline как IFFTBackend
+        auto opencl_backend = std::make_unique<OpenCLFFTBackend>();
+        opencl_backend->setConfiguration(
+            config->getFFTSize(),
+            config->getNumShifts(),
+            config->getNumSignals(),
+            config->getNumOutputPoints(),
+            config->getScaleFactor()
+        );
+        // Калибровка Step 2 при инициализации: CORRELATOR_AUTOTUNE=1
+        // (кэш: CORRELATOR_TUNING_CACHE или ~/.cache/correlator/tuning.txt)
+        const char* autotune = std::getenv("CORRELATOR_AUTOTUNE");
+        const bool autotune_enabled = autotune && std::string(autotune) != "0";
+        const char* tuning_cache = std::getenv("CORRELATOR_TUNING_CACHE");
+        const std::string tuning_cache_path = tuning_cache ? tuning_cache : "";
+        opencl_backend->setAutotune(autotune_enabled, tuning_cache_path);
+        // Слитый Step 2+3 в локальной памяти (N — степень двойки ≤ 4096): CORRELATOR_FUSED=1
+        const char* fused = std::getenv("CORRELATOR_FUSED");
+        opencl_backend->setFusedCorrelation(fused && std::string(fused) != "0");
+        std::unique_ptr<IFFTBackend> backend = std::move(opencl_backend);
+
+        // Малые N (≤ 256): прямой GEMM вместо FFT, если он быстрее на этой машине.
+        // CORRELATOR_DIRECT=cpu (по умолчанию) | opencl | off; CORRELATOR_DIRECT_CROSSOVER=<N> — без замера.
+        // Режимы, загружающие готовые спектры (лучи, checkpoint, поиск по индексу, страничный банк),
+        // остаются на FFT; NUMA режим — тоже: замер поднял бы OpenCL до fork воркеров
+        const char* direct_mode = std::getenv("CORRELATOR_DIRECT");
+        const bool keep_fft = std::getenv("CORRELATOR_BEAMS") || std::getenv("CORRELATOR_CHECKPOINT") ||
+                              std::getenv("CORRELATOR_SEARCH_INDEX") || std::getenv("CORRELATOR_NUMA_SHARDS") ||
+                              std::getenv("CORRELATOR_PAGED_REFERENCES");
+        if (config->getFFTSize() <= kDirectMaxFFTSize && !keep_fft &&
+            !(direct_mode && std::string(direct_mode) == "off")) {
+            const DirectCorrelationDevice direct_device = direct_mode && std::string(direct_mode) == "opencl"
+                                                              ? DirectCorrelationDevice::OpenCL
+                                                              : DirectCorrelationDevice::CPU;
+            size_t crossover = 0;
+            if (const char* crossover_env = std::getenv("CORRELATOR_DIRECT_CROSSOVER")) {
+                crossover = static_cast<size_t>(std::atoll(crossover_env));
+            } else {
+                crossover = measureDirectCrossover(*config, [&](size_t n, int n_kg) {
+                    auto probe = std::make_unique<OpenCLFFTBackend>();
+                    probe->setConfiguration(n, config->getNumShifts(), config->getNumSignals(), n_kg,
+                                            config->getScaleFactor());
+                    return std::unique_ptr<IFFTBackend>(std::move(probe));
+                }, direct_device);
+            }
+            if (config->getFFTSize() <= crossover) {
+                auto direct_backend = std::make_unique<DirectCorrelationBackend>(direct_device);
+                direct_backend->setConfiguration(config->getFFTSize(), config->getNumShifts(),
+                                                 config->getNumSignals(), config->getNumOutputPoints(),
+                                                 config->getScaleFactor());
+                backend = std::move(direct_backend);
+                std::cout << "[DIRECT] N=" << config->getFFTSize() << " ≤ " << crossover
+                          << ": прямой GEMM (" << directCorrelationDeviceName(direct_device) << ")\n";
+            }
+        }
+        // Хост без GPU: Step 2 + Step 3 на CPU сигнал за сигналом, пока спектр в кэше: CORRELATOR_HOST_FUSED=1
+        const char* host_fused = std::getenv("CORRELATOR_HOST_FUSED");
+        if (host_fused && std::string(host_fused) != "0") {
+            auto host_backend = std::make_unique<HostFusedBackend>();
+            host_backend->setConfiguration(config->getFFTSize(), config->getNumShifts(), config->getNumSignals(),
+                                           config->getNumOutputPoints(), config->getScaleFactor());
+            backend = std::move(host_backend);
+            std::cout << "[HOST FUSED] Step 2 + Step 3 на CPU по сигналам\n";
         }
         std::cout << "✓ Бэкенд создан\n\n";
 
@@ -98,9 +208,134 @@ int main() {
         }
         std::cout << "✓ Данные сгенерированы\n\n";
 
+        // Аналитический опорный (Step 1 без FFT по сдвигам):
+        //   CORRELATOR_REFERENCE=chirp:<f0>,<полоса>[,spa] — ЛЧМ на весь кадр (циклов на отсчёт),
+        //     spa — спектр методом стационарной фазы вместо точного FFT
+        //   CORRELATOR_REFERENCE=code:<период> — M-последовательность периода P, повторённая до N
+        // Во времени опорный тоже подменяется (Step 0, запасной обычный Step 1)
+        std::vector<CpuFFTPlan::Complex> reference_spectrum;
+        if (const char* reference_env = std::getenv("CORRELATOR_REFERENCE")) {
+            const std::string reference_mode(reference_env);
+            if (reference_mode.rfind("chirp:", 0) == 0) {
+                ChirpReference chirp;
+                chirp.amplitude = 10000.0;
+                char method[8] = "";
+                if (std::sscanf(reference_env + 6, "%lf,%lf,%7s", &chirp.start_frequency, &chirp.bandwidth,
+                                method) < 2) {
+                    std::cerr << "Неверный ЛЧМ CORRELATOR_REFERENCE=" << reference_env << " (ожидается chirp:f0,B[,spa])\n";
+                    return 1;
+                }
+                const bool spa = std::string(method) == "spa";
+                reference_signal = chirpReferenceSignal(chirp, fft_size);
+                reference_spectrum = chirpReferenceSpectrum(
+                    chirp, fft_size, spa ? ChirpSpectrumMethod::StationaryPhase : ChirpSpectrumMethod::Exact);
+                std::cout << "✓ Опорный — ЛЧМ f0=" << chirp.start_frequency << ", B=" << chirp.bandwidth
+                          << (spa ? " (стационарная фаза)" : " (точный спектр)") << "\n";
+            } else if (reference_mode.rfind("code:", 0) == 0) {
+                const size_t period = std::strtoul(reference_env + 5, nullptr, 10);
+                if (period == 0 || period > fft_size) {
+                    std::cerr << "Неверный период CORRELATOR_REFERENCE=" << reference_env << "\n";
+                    return 1;
+                }
+                const std::vector<int32_t> code = generateMSequence(period);
+                reference_signal = periodicCodeSignal(code, fft_size);
+                reference_spectrum = periodicCodeSpectrum(code, fft_size);
+                std::cout << "✓ Опорный — код периода " << period
+                          << (fft_size % period == 0 ? " (разреженный спектр)" : " (FFT, N не кратно периоду)") << "\n";
+            } else {
+                std::cerr << "Неизвестный опорный CORRELATOR_REFERENCE=" << reference_env << "\n";
+                return 1;
+            }
+        }
+
+        // Многопроцессный режим по NUMA узлам: CORRELATOR_NUMA_SHARDS=<процессов на узел>
+        // (запускается до любой инициализации OpenCL в этом процессе)
+        if (const char* numa_shards = std::getenv("CORRELATOR_NUMA_SHARDS")) {
+            NumaShardingOptions options;
+            options.workers_per_node = std::max(1, std::atoi(numa_shards));
+            const float scale_factor = config->getScaleFactor();
+            NumaShardedCorrelator sharded(*config, [&](int worker, const NumaNode&, int batch_signals) {
+                auto worker_backend = std::make_unique<OpenCLFFTBackend>();
+                worker_backend->setDeviceIndex(worker);
+                worker_backend->setAutotune(autotune_enabled, tuning_cache_path);
+                worker_backend->setConfiguration(fft_size, num_shifts, batch_signals,
+                                                 num_output_points, scale_factor);
+                return std::unique_ptr<IFFTBackend>(std::move(worker_backend));
+            }, options);
+
+            std::cout << "[NUMA] Узлов: " << sharded.nodes().size() << ", воркеров: " << sharded.workerCount()
+                      << ", сигналов в шарде: " << sharded.shardSignals() << "\n";
+            profiler.start("NUMA_Start");
+            if (!sharded.start(reference_signal)) {
+                std::cerr << "Ошибка запуска NUMA воркеров\n";
+                return 1;
+            }
+            profiler.stop("NUMA_Start", Profiler::MILLISECONDS);
+            profiler.start("NUMA_Process");
+            if (!sharded.process(input_signals)) {
+                std::cerr << "Ошибка обработки шардов\n";
+                return 1;
+            }
+            profiler.stop("NUMA_Process", Profiler::MILLISECONDS);
+            std::cout << "✓ Получено " << sharded.peaks().size() << " пиков от "
+                      << sharded.workerCount() << " процессов\n";
+            profiler.print_all("NUMA SHARDED CORRELATOR");
+            return 0;
+        }
+
+        // Сигналы разной длины без дополнения до максимальной: CORRELATOR_RAGGED=pow2 | smooth
+        // (демо: сигнал i укорочен до N, N/2 или 3N/8 по кругу)
+        if (const char* ragged_mode = std::getenv("CORRELATOR_RAGGED")) {
+            RaggedCorrelatorOptions options;
+            if (std::string(ragged_mode) == "smooth") {
+                options.bucketing = RaggedBucketing::Smooth;
+            }
+            const float scale_factor = config->getScaleFactor();
+            RaggedCorrelator ragged(*config, [&](size_t bucket_fft_size, int bucket_signals) {
+                auto bucket_backend = std::make_unique<OpenCLFFTBackend>();
+                bucket_backend->setConfiguration(bucket_fft_size, num_shifts, bucket_signals,
+                                                 num_output_points, scale_factor);
+                bucket_backend->setAutotune(autotune_enabled, tuning_cache_path);
+                return std::unique_ptr<IFFTBackend>(std::move(bucket_backend));
+            }, options);
+
+            const size_t lengths[] = {fft_size, fft_size / 2, fft_size * 3 / 8};
+            RaggedBatch batch;
+            for (int i = 0; i < num_signals; ++i) {
+                batch.add(std::span<const int32_t>(input_signals.data() + i * fft_size, lengths[i % 3]));
+            }
+
+            profiler.start("Ragged_Process");
+            if (!ragged.setReference(reference_signal) || !ragged.process(batch.view())) {
+                std::cerr << "Ошибка обработки ragged батча\n";
+                return 1;
+            }
+            profiler.stop("Ragged_Process", Profiler::MILLISECONDS);
+            for (const auto& bucket : ragged.bucketStats()) {
+                std::cout << "[RAGGED] N=" << bucket.fft_size << ": сигналов " << bucket.signals
+                          << ", Step1 " << bucket.step1_ms << " мс, Step2 " << bucket.step2_ms
+                          << " мс, Step3 " << bucket.step3_ms << " мс\n";
+            }
+            std::cout << "✓ Отсчётов после дополнения: " << ragged.paddedSamples() << " вместо "
+                      << fft_size * num_signals << "\n";
+            profiler.print_all("RAGGED CORRELATOR");
+            return 0;
+        }
+
         // 4.5. Создать exporter для экспорта Step0 (и использования в pipeline)
         std::cout << "[4.5] Создание exporter...\n";
         auto exporter = IResultExporter::createDefault();
+
+        // Полные дампы шагов в сжатый архив: CORRELATOR_SNAPSHOT_FORMAT=binary
+        bool binary_snapshot = false;
+        if (const char* snapshot_format = std::getenv("CORRELATOR_SNAPSHOT_FORMAT")) {
+            if (std::string(snapshot_format) == "binary") {
+                exporter->setSnapshotFormat(SnapshotFormat::Binary);
+                binary_snapshot = true;
+            } else if (std::string(snapshot_format) != "json") {
+                std::cerr << "Неизвестный формат снимка: " << snapshot_format << " (используется json)\n";
+            }
+        }
         
         // Экспорт M-последовательности (Step0)
         exporter->exportStep0(reference_signal, input_signals, *config);
@@ -112,6 +347,84 @@ int main() {
         
         // Установить тот же exporter в pipeline для использования одного timestamp каталога
         pipeline.setExporter(std::move(exporter));
+
+        // Без снимка/экспорта спектров Step 2 (слитому пути не нужен отдельный FFT входа):
+        // CORRELATOR_STEP2_EXPORT=0
+        if (const char* step2_export = std::getenv("CORRELATOR_STEP2_EXPORT")) {
+            pipeline.setInputSpectraExport(std::string(step2_export) != "0");
+        }
+
+        // Метрики Prometheus (включаются переменными окружения):
+        //   CORRELATOR_METRICS_PORT=9464            → http://127.0.0.1:9464/metrics
+        //   CORRELATOR_METRICS_FILE=path.prom       → периодически перезаписываемый файл
+        std::unique_ptr<PrometheusExporter> metrics_exporter;
+        const char* metrics_port = std::getenv("CORRELATOR_METRICS_PORT");
+        const char* metrics_file = std::getenv("CORRELATOR_METRICS_FILE");
+        if (metrics_port || metrics_file) {
+            auto metrics = std::make_shared<MetricsRegistry>();
+            pipeline.setMetrics(metrics);
+            metrics_exporter = std::make_unique<PrometheusExporter>(metrics);
+            if (metrics_port) {
+                metrics_exporter->startHttp(static_cast<uint16_t>(std::atoi(metrics_port)));
+            }
+            if (metrics_file) {
+                metrics_exporter->startFile(metrics_file);
+            }
+        }
+
+        // Спектральный индекс архива (спектры каждого Step 2):
+        //   CORRELATOR_SPECTRAL_INDEX=path.cchk, CORRELATOR_SPECTRAL_PRECISION=f16 (по умолчанию f32),
+        //   CORRELATOR_SPECTRAL_INDEX_APPEND=1 — дописать в существующий индекс
+        if (const char* index_path = std::getenv("CORRELATOR_SPECTRAL_INDEX")) {
+            const char* precision_name = std::getenv("CORRELATOR_SPECTRAL_PRECISION");
+            SpectralPrecision precision = precision_name && std::string(precision_name) == "f16"
+                ? SpectralPrecision::Float16 : SpectralPrecision::Float32;
+            const char* append_env = std::getenv("CORRELATOR_SPECTRAL_INDEX_APPEND");
+            const ArchiveOpenMode index_mode = append_env && std::string(append_env) != "0"
+                ? ArchiveOpenMode::Append : ArchiveOpenMode::Truncate;
+            auto index = std::make_shared<SpectralIndexWriter>(index_path, fft_size, precision, 0, index_mode);
+            if (index->isOpen()) {
+                pipeline.setSpectralIndex(index);
+            } else {
+                std::cerr << "Не удалось создать спектральный индекс: " << index_path << "\n";
+            }
+        }
+        // Кольцо результатов в разделяемой памяти для локальных потребителей:
+        //   CORRELATOR_RESULTS_RING=/correlator_peaks, CORRELATOR_RESULTS_RING_SLOTS=<число слотов> (16)
+        std::shared_ptr<ResultsRingWriter> results_ring;
+        if (const char* ring_name = std::getenv("CORRELATOR_RESULTS_RING")) {
+            const char* slots_env = std::getenv("CORRELATOR_RESULTS_RING_SLOTS");
+            const uint32_t slots = slots_env ? static_cast<uint32_t>(std::max(1, std::atoi(slots_env))) : 16;
+            // Слот вмещает и Float32 (на случай отката), и выбранную кодировку:
+            // SparseDelta и LogU16 при малом n_kg больше Float32
+            const PeaksEncodingParams& ring_encoding = pipeline.getConfiguration().getPeaksEncoding();
+            const size_t rows = static_cast<size_t>(num_signals) * num_shifts;
+            const size_t capacity = std::max(
+                encodedPeaksBytes(ring_encoding.encoding, rows, num_output_points, ring_encoding.max_detections),
+                encodedPeaksBytes(PeaksEncoding::Float32, rows, num_output_points, 0));
+            results_ring = std::make_shared<ResultsRingWriter>(ring_name, slots, capacity);
+            if (results_ring->isOpen()) {
+                pipeline.setResultsRing(results_ring);
+            } else {
+                std::cerr << "Не удалось создать кольцо результатов: " << ring_name << "\n";
+                results_ring.reset();
+            }
+        }
+        // Лучи перед Step 3: CORRELATOR_BEAMS=<число лучей>
+        // (демо: линейная решётка, задержка канала c для луча b = c·(b − B/2)/B отсчётов)
+        if (const char* beams_env = std::getenv("CORRELATOR_BEAMS")) {
+            const int beams = std::clamp(std::atoi(beams_env), 1, num_signals);
+            std::vector<std::vector<double>> delays(beams, std::vector<double>(num_signals));
+            for (int b = 0; b < beams; ++b) {
+                for (int c = 0; c < num_signals; ++c) {
+                    delays[b][c] = c * (b - beams / 2.0) / beams;
+                }
+            }
+            auto weights = std::make_shared<BeamWeights>(BeamWeights::delayAndSum(fft_size, delays));
+            if (!pipeline.setBeamforming(weights)) {
+                std::cerr << "Веса лучей не подходят к конфигурации\n";
+            }
+        }
         const auto& config_ref = pipeline.getConfiguration();
         std::cout << "✓ Pipeline создан\n\n";
 
@@ -121,20 +434,89 @@ int main() {
         std::cout << "   Step 2: Input FFT\n";
         std::cout << "   Step 3: Correlation\n\n";
 
-        // Инициализация pipeline
+        // Инициализация pipeline с профилированием (контекст, буферы, планы)
+        // Checkpoint тёплого состояния: CORRELATOR_CHECKPOINT=path.cchk
+        // (если файл есть — Step 1 восстанавливается из него, в конце состояние сохраняется)
+        const char* checkpoint_path = std::getenv("CORRELATOR_CHECKPOINT");
+        if (checkpoint_path && std::filesystem::exists(checkpoint_path)) {
+            profiler.start("Checkpoint_Restore");
+            if (pipeline.restoreCheckpoint(checkpoint_path)) {
+                std::cout << "✓ Состояние восстановлено из " << checkpoint_path << "\n";
+            } else {
+                std::cerr << "Checkpoint не подходит, выполняется полный Step 1\n";
+            }
+            profiler.stop("Checkpoint_Restore", Profiler::MILLISECONDS);
+        }
+
+        profiler.start("Init_Total");
         if (!pipeline.initialize()) {
             std::cerr << "Ошибка инициализации pipeline\n";
             return 1;
         }
+        profiler.stop("Init_Total", Profiler::MILLISECONDS);
+
+        // Режим реального времени: CORRELATOR_REALTIME=<cpu>[,<приоритет SCHED_FIFO>]
+        // (mlockall, префолт буферов батча и стека, закрепление основного потока)
+        if (const char* realtime_env = std::getenv("CORRELATOR_REALTIME")) {
+            RealtimeOptions realtime;
+            std::sscanf(realtime_env, "%d,%d", &realtime.cpu, &realtime.fifo_priority);
+            const RealtimeStatus status = pipeline.enableRealtimeMode(realtime);
+            std::cout << "✓ Режим реального времени: mlockall " << (status.memory_locked ? "да" : "нет")
+                      << ", CPU " << (status.thread_pinned ? std::to_string(realtime.cpu) : std::string("—"))
+                      << ", префолт " << status.prefaulted_bytes / 1024 << " КБ\n";
+        }
 
         // Step 1 с профилированием
         profiler.start("Step1_Total");
-        if (!pipeline.executeStep1(reference_signal, config_ref.getNumShifts())) {
+        bool step1_ok = false;
+        if (!reference_spectrum.empty()) {
+            const auto base = referenceBaseSpectrum(reference_spectrum, config_ref.getScaleFactor());
+            step1_ok = pipeline.executeStep1FromSpectrum(base, config_ref.getNumShifts());
+            if (!step1_ok) {
+                std::cerr << "Бэкенд не принимает спектры, выполняется обычный Step 1\n";
+            }
+        }
+        if (!step1_ok && !pipeline.executeStep1(reference_signal, config_ref.getNumShifts())) {
             std::cerr << "Ошибка выполнения Step 1\n";
             return 1;
         }
         profiler.stop("Step1_Total", Profiler::MILLISECONDS);
 
+        // Ретроспективный поиск: CORRELATOR_SEARCH_INDEX=path.cchk — Step 3 по архиву вместо Step 2/3
+        if (const char* search_path = std::getenv("CORRELATOR_SEARCH_INDEX")) {
+            SpectralIndexReader index(search_path);
+            if (!index.isOpen()) {
+                std::cerr << "Не удалось открыть спектральный индекс: " << search_path << "\n";
+                return 1;
+            }
+            float best_peak = 0.0f;
+            uint64_t best_signal = 0;
+            profiler.start("Archive_Search");
+            bool searched = pipeline.searchSpectralIndex(index, [&](uint64_t first_signal, ConstPeaksView peaks) {
+                for (size_t s = 0; s < peaks.extent(0); ++s) {
+                    for (size_t sh = 0; sh < peaks.extent(1); ++sh) {
+                        for (float value : peaksOf(peaks, s, sh)) {
+                            if (value > best_peak) {
+                                best_peak = value;
+                                best_signal = first_signal + s;
+                            }
+                        }
+                    }
+                }
+                return true;
+            });
+            profiler.stop("Archive_Search", Profiler::MILLISECONDS);
+            if (!searched) {
+                std::cerr << "Ошибка поиска по спектральному индексу\n";
+                return 1;
+            }
+            std::cout << "✓ Поиск по " << index.signalCount() << " сигналам архива ("
+                      << spectralPrecisionName(index.precision()) << "): максимум " << best_peak
+                      << " в сигнале " << best_signal << "\n";
+            profiler.print_all("ARCHIVE SEARCH");
+            return 0;
+        }
+
         // Step 2 с профилированием
         profiler.start("Step2_Total");
         if (!pipeline.executeStep2(input_signals, config_ref.getNumSignals())) {
@@ -151,6 +533,174 @@ int main() {
             return 1;
         }
         profiler.stop("Step3_Total", Profiler::MILLISECONDS);
+        if (results_ring) {
+            std::cout << "[RING] " << results_ring->name() << ": опубликовано " << results_ring->published()
+                      << ", потеряно отстающими читателями " << results_ring->readerOverruns() << "\n";
+        }
+
+        // Страничный банк опорных: CORRELATOR_PAGED_REFERENCES=<опорных>[,<слотов>[,f16]]
+        // (демо: каталог M-последовательностей, опорный p совпадает с входным сигналом p)
+        if (const char* paged_env = std::getenv("CORRELATOR_PAGED_REFERENCES")) {
+            int num_references = 0, slots = 4;
+            char precision_name[8] = "";
+            if (std::sscanf(paged_env, "%d,%d,%7s", &num_references, &slots, precision_name) < 1 ||
+                num_references <= 0 || slots <= 0) {
+                std::cerr << "Неверный CORRELATOR_PAGED_REFERENCES=" << paged_env
+                          << " (ожидается <опорных>[,<слотов>[,f16]])\n";
+                return 1;
+            }
+            const SpectralPrecision precision = std::string(precision_name) == "f16"
+                ? SpectralPrecision::Float16 : SpectralPrecision::Float32;
+            PagedReferenceBank bank(fft_size, num_shifts, precision);
+            for (int p = 0; p < num_references; ++p) {
+                bank.addReference(generateMSequence(fft_size, 0x1 + p), config_ref.getScaleFactor());
+            }
+            if (!bank.lockHostMemory()) {
+                std::cerr << "[PAGED] mlock страниц не удался (ulimit -l), страницы не закреплены\n";
+            }
+            const bool device_cache = pipeline.configureReferenceCache(slots, precision);
+            std::vector<int> pages(num_references);
+            std::iota(pages.begin(), pages.end(), 0);
+
+            std::vector<int> best_signal(num_references, -1);
+            profiler.start("Step3_Paged");
+            bool paged_ok = pipeline.executePagedStep3(bank, pages, [&](int page, ConstPeaksView peaks) {
+                float best_peak = 0.0f;
+                for (size_t s = 0; s < peaks.extent(0); ++s) {
+                    for (float value : peaksOf(peaks, s, 0)) {
+                        if (value > best_peak) {
+                            best_peak = value;
+                            best_signal[page] = static_cast<int>(s);
+                        }
+                    }
+                }
+                return true;
+            });
+            profiler.stop("Step3_Paged", Profiler::MILLISECONDS);
+            if (!paged_ok) {
+                std::cerr << "Ошибка Step 3 по страничному банку опорных\n";
+                return 1;
+            }
+            const ReferencePageStats& stats = pipeline.getReferencePageStats();
+            std::cout << "[PAGED] " << num_references << " опорных × " << bank.pageBytes() / (1024.0 * 1024.0)
+                      << " MB (" << spectralPrecisionName(precision) << "), "
+                      << (device_cache ? std::to_string(slots) + " слотов на устройстве" : std::string("без кэша устройства"))
+                      << ": hit " << stats.hits << ", miss " << stats.misses << ", prefetch " << stats.prefetches
+                      << ", вытеснений " << stats.evictions << ", ожидание подкачки " << stats.stall_ms << " ms\n";
+            for (int p = 0; p < std::min(num_references, 4); ++p) {
+                std::cout << "   Опорный " << p << ": лучший входной сигнал " << best_signal[p] << "\n";
+            }
+        }
+
+        // Парная корреляция входов (TDOA): CORRELATOR_PAIRWISE=<окно задержек>
+        if (const char* pairwise_env = std::getenv("CORRELATOR_PAIRWISE")) {
+            const int num_lags = std::atoi(pairwise_env);
+            profiler.start("Step3_Pairwise");
+            if (num_lags <= 0 || !pipeline.executePairwiseStep3(config_ref.getNumSignals(), num_lags)) {
+                std::cerr << "Ошибка парной корреляции (CORRELATOR_PAIRWISE=" << pairwise_env << ")\n";
+                return 1;
+            }
+            profiler.stop("Step3_Pairwise", Profiler::MILLISECONDS);
+            const auto& pairwise_peaks = pipeline.getPairwisePeaks();
+            std::cout << "[PAIRWISE] Пар: " << pairwisePairCount(config_ref.getNumSignals()) << " × " << num_lags
+                      << " задержек\n";
+            for (int j = 1; j < std::min(config_ref.getNumSignals(), 4); ++j) {
+                std::cout << "   TDOA(0, " << j << ") = "
+                          << pairwisePeakLag(pairwise_peaks, pairwisePairIndex(0, j, config_ref.getNumSignals()), num_lags)
+                          << " отсчётов\n";
+            }
+        }
+
+        // Карта дальность-доплер (сигналы — импульсы): CORRELATOR_RANGE_DOPPLER=<дальностных отсчётов>,
+        //   CORRELATOR_DOPPLER_WINDOW=rect|hann|hamming|blackman, CORRELATOR_CFAR=<обучающих>,<защитных>,<порог>
+        if (const char* range_env = std::getenv("CORRELATOR_RANGE_DOPPLER")) {
+            RangeDopplerParams range_doppler;
+            range_doppler.num_pulses = config_ref.getNumSignals();
+            range_doppler.range_bins = std::clamp(std::atoi(range_env), 1, static_cast<int>(fft_size));
+            if (const char* window_env = std::getenv("CORRELATOR_DOPPLER_WINDOW");
+                window_env && !parseDopplerWindow(window_env, range_doppler.window)) {
+                std::cerr << "Неизвестное окно CORRELATOR_DOPPLER_WINDOW=" << window_env << "\n";
+                return 1;
+            }
+            if (const char* cfar_env = std::getenv("CORRELATOR_CFAR")) {
+                std::sscanf(cfar_env, "%d,%d,%f", &range_doppler.training_cells, &range_doppler.guard_cells,
+                            &range_doppler.threshold_scale);
+            }
+            profiler.start("Step4_RangeDoppler");
+            if (!pipeline.executeRangeDoppler(range_doppler)) {
+                std::cerr << "Ошибка построения карты дальность-доплер\n";
+                return 1;
+            }
+            profiler.stop("Step4_RangeDoppler", Profiler::MILLISECONDS);
+            const auto& map = pipeline.getRangeDopplerMap();
+            const size_t doppler_size = range_doppler.dopplerSize();
+            const size_t best = std::max_element(map.begin(), map.end()) - map.begin();
+            std::cout << "[RANGE-DOPPLER] " << range_doppler.range_bins << " × " << doppler_size
+                      << ", максимум: дальность " << best / doppler_size << ", доплер "
+                      << rangeDopplerBin(static_cast<uint32_t>(best % doppler_size), doppler_size)
+                      << ", детекций CFAR " << pipeline.getRangeDopplerDetectionCount() << "\n";
+
+            // Сверка карты устройства с CPU эталоном по спектрам того же батча
+            const auto& snapshot_ref = pipeline.getSnapshot();
+            std::vector<float> cpu_map;
+            std::vector<RangeDopplerDetection> cpu_detections;
+            size_t cpu_found = 0;
+            if (!snapshot_ref.getReferenceFFT().empty() && !snapshot_ref.getInputFFT().empty() &&
+                computeRangeDoppler(snapshot_ref.getReferenceFFT(), snapshot_ref.getInputFFT(), fft_size,
+                                    range_doppler, cpu_map, cpu_detections, cpu_found) &&
+                cpu_map.size() == map.size()) {
+                double max_diff = 0.0, max_value = 0.0;
+                for (size_t i = 0; i < map.size(); ++i) {
+                    max_diff = std::max(max_diff, static_cast<double>(std::abs(map[i] - cpu_map[i])));
+                    max_value = std::max(max_value, static_cast<double>(cpu_map[i]));
+                }
+                std::cout << "[RANGE-DOPPLER] Отклонение от CPU: "
+                          << (max_value > 0.0 ? max_diff / max_value : max_diff)
+                          << " (детекций CFAR на CPU " << cpu_found << ")\n";
+            }
+        }
+
+        // 2D корреляция (сопоставление с шаблоном): CORRELATOR_2D=<высота>x<ширина>
+        // (демо: два шумовых кадра, шаблон — фрагмент первого кадра в точке (H/4, W/3))
+        if (const char* corr2d_env = std::getenv("CORRELATOR_2D")) {
+            size_t height = 0, width = 0;
+            if (std::sscanf(corr2d_env, "%zux%zu", &height, &width) != 2 || height < 4 || width < 4) {
+                std::cerr << "Неверный размер кадра CORRELATOR_2D=" << corr2d_env << " (ожидается HxW)\n";
+                return 1;
+            }
+            std::mt19937 rng(2024);
+            std::normal_distribution<float> noise;
+            std::vector<float> frames(2 * height * width);
+            for (float& value : frames) value = noise(rng);
+
+            const size_t patch_height = std::min<size_t>(32, height / 2);
+            const size_t patch_width = std::min<size_t>(32, width / 2);
+            const size_t row = height / 4, col = width / 3;
+            std::vector<float> patch(patch_height * patch_width);
+            for (size_t y = 0; y < patch_height; ++y) {
+                std::copy_n(frames.data() + (row + y) * width + col, patch_width, patch.data() + y * patch_width);
+            }
+
+            profiler.start("Correlation2D");
+            if (!pipeline.setTemplates2D(padTemplate2D(patch, patch_height, patch_width, height, width), 1,
+                                         height, width) ||
+                !pipeline.executeCorrelation2D(frames, 2)) {
+                std::cerr << "Ошибка 2D корреляции\n";
+                return 1;
+            }
+            profiler.stop("Correlation2D", Profiler::MILLISECONDS);
+            const auto& peaks_2d = pipeline.getCorrelation2DPeaks();
+            std::cout << "[2D] Шаблон " << patch_height << "×" << patch_width << " в точке (" << row << ", " << col
+                      << ") кадра " << height << "×" << width << "\n";
+            for (size_t frame = 0; frame < peaks_2d.size(); ++frame) {
+                std::cout << "   Кадр " << frame << ": сдвиг (" << peaks_2d[frame].dy << ", " << peaks_2d[frame].dx
+                          << "), корреляция " << peaks_2d[frame].value << "\n";
+            }
+        }
+
+        if (checkpoint_path && !pipeline.saveCheckpoint(checkpoint_path)) {
+            std::cerr << "Не удалось сохранить checkpoint: " << checkpoint_path << "\n";
+        }
 
         std::cout << "✓ Pipeline выполнен успешно\n\n";
 
@@ -164,7 +714,19 @@ int main() {
                   << config_ref.getNumShifts() << " сдвигов][" 
                   << config_ref.getNumOutputPoints() << " точек] = "
                   << (config_ref.getNumSignals() * config_ref.getNumShifts() * config_ref.getNumOutputPoints()) 
-                  << " значений\n\n";
+                  << " значений\n";
+        const auto& encoded_peaks = pipeline.getEncodedPeaks();
+        if (!encoded_peaks.payload.empty()) {
+            std::cout << "   Кодировка: " << peaksEncodingName(encoded_peaks.encoding) << ", "
+                      << encoded_peaks.payload.size() << " байт вместо " << encoded_peaks.rawBytes()
+                      << " (" << encoded_peaks.compressionRatio() << "x)\n";
+        }
+        if (binary_snapshot && !snapshot.getInputFFT().empty()) {
+            const auto check_path = std::filesystem::temp_directory_path() / "correlator_snapshot_check.cchk";
+            std::cout << "   Архив снимка (2 батча, запись → чтение): "
+                      << (verifySnapshotArchive(snapshot, config_ref, check_path.string()) ? "OK" : "ОШИБКА") << "\n";
+        }
+        std::cout << "\n";
 
         // 7. Экспорт в JSON (уже выполнен автоматически на каждом этапе)
         std::cout << "[7] JSON файлы сохранены в Report/Validation/\n";
@@ -181,6 +743,20 @@ int main() {
         std::cout << "   Драйвер: " << backend_info.getDriverVersion() << "\n";
         std::cout << "   API: " << backend_info.getAPIVersion() << "\n\n";
 
+        // 9. Память устройства по шагам (для подбора размера батча)
+        std::vector<DeviceMemoryStep> memory_steps;
+        size_t memory_current = 0, memory_high_water = 0;
+        if (pipeline.getDeviceMemoryUsage(memory_steps, memory_current, memory_high_water)) {
+            const double mb = 1024.0 * 1024.0;
+            std::cout << "[9] Память устройства (буферы коррелятора):\n";
+            for (const auto& step : memory_steps) {
+                std::printf("   %-8s high-water %9.2f MB, выделено %9.2f MB, освобождено %9.2f MB\n",
+                            step.step.c_str(), step.high_water_bytes / mb,
+                            step.allocated_bytes / mb, step.released_bytes / mb);
+            }
+            std::printf("   Текущий объём: %.2f MB, пик: %.2f MB\n\n", memory_current / mb, memory_high_water / mb);
+        }
+
         std::cout << "═══════════════════════════════════════════════════════════\n";
         std::cout << "✨ ВСЕ ЭТАПЫ ВЫПОЛНЕНЫ УСПЕШНО! ✨\n";
         std::cout << "═══════════════════════════════════════════════════════════\n\n";
@@ -200,6 +776,27 @@ int main() {
         // Сформировать step_details аналогично CorrelatorW
         std::map<std::string, std::map<std::string, double>> step_details;
         
+        // Init детали (номер фазы сохраняет порядок выполнения в std::map)
+        std::vector<InitPhaseTiming> init_phases;
+        if (pipeline.getInitTimings(init_phases)) {
+            for (size_t i = 0; i < init_phases.size(); ++i) {
+                char init_label[128];
+                std::snprintf(init_label, sizeof(init_label), "%02zu. %s", i + 1, init_phases[i].phase.c_str());
+                step_details["Init"][init_label] = init_phases[i].time_ms;
+            }
+        }
+        
+        // Ленивые сборки планов — в шаг, который их вызвал (сборки внутри Init/Autotune
+        // уже входят в фазы инициализации бэкенда)
+        std::vector<BuildPhaseTiming> builds;
+        if (pipeline.getBuildTimings(builds)) {
+            for (const auto& build : builds) {
+                if (build.step == "Step1" || build.step == "Step2" || build.step == "Step3") {
+                    step_details[build.step]["Build: " + build.phase] += build.time_ms;
+                }
+            }
+        }
+        
         // Step 1 детали
         char step1_label[64];
         std::snprintf(step1_label, sizeof(step1_label), "FFT (%d) total GPU time", config_ref.getNumShifts());
@@ -0,0 +1,247 @@
+#include "cl_resource_tracker.hpp"
+#include <algorithm>
+#include <cstdio>
+
+// ============================================================================
+// Constructor / helpers
+// ============================================================================
+
+CLResourceTracker::CLResourceTracker(const std::string& scope)
+    : scope_(scope), start_time_(Clock::now()) {
+    steps_.push_back(StepMemory{"Setup"});
+}
+
+double CLResourceTracker::elapsed_ms() const {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start_time_).count();
+}
+
+CLResourceTracker::StepMemory& CLResourceTracker::current_step() {
+    return steps_.back();
+}
+
+void CLResourceTracker::add_record(Kind kind, const void* handle, const std::string& owner, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Record record;
+    record.kind = kind;
+    record.handle = handle;
+    record.owner = owner;
+    record.bytes = bytes;
+    record.step = current_step().step;
+    record.created_ms = elapsed_ms();
+    live_[handle] = record;
+
+    StepMemory& step = current_step();
+    if (kind == Kind::Buffer) {
+        current_bytes_ += bytes;
+        high_water_bytes_ = std::max(high_water_bytes_, current_bytes_);
+        step.allocated_bytes += bytes;
+        step.buffers_created++;
+        step.high_water_bytes = std::max(step.high_water_bytes, current_bytes_);
+    } else if (kind == Kind::Event) {
+        step.events_created++;
+    }
+}
+
+bool CLResourceTracker::remove_record(const void* handle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = live_.find(handle);
+    if (it == live_.end()) {
+        return false;
+    }
+    if (it->second.kind == Kind::Buffer) {
+        current_bytes_ -= it->second.bytes;
+        current_step().released_bytes += it->second.bytes;
+    }
+    live_.erase(it);
+    return true;
+}
+
+const char* CLResourceTracker::kindName(Kind kind) {
+    switch (kind) {
+        case Kind::Buffer:  return "cl_mem";
+        case Kind::Program: return "cl_program";
+        case Kind::Kernel:  return "cl_kernel";
+        case Kind::Event:   return "cl_event";
+    }
+    return "unknown";
+}
+
+// ============================================================================
+// Creation
+// ============================================================================
+
+cl_mem CLResourceTracker::createBuffer(
+    cl_context context,
+    cl_mem_flags flags,
+    size_t size,
+    void* host_ptr,
+    cl_int* errcode_ret,
+    const std::string& owner
+) {
+    cl_int err = CL_SUCCESS;
+    cl_mem buffer = clCreateBuffer(context, flags, size, host_ptr, &err);
+    if (errcode_ret) *errcode_ret = err;
+
+    if (err == CL_SUCCESS && buffer) {
+        add_record(Kind::Buffer, buffer, owner, size);
+    }
+    return buffer;
+}
+
+cl_program CLResourceTracker::createProgramWithSource(
+    cl_context context,
+    cl_uint count,
+    const char** strings,
+    const size_t* lengths,
+    cl_int* errcode_ret,
+    const std::string& owner
+) {
+    cl_int err = CL_SUCCESS;
+    cl_program program = clCreateProgramWithSource(context, count, strings, lengths, &err);
+    if (errcode_ret) *errcode_ret = err;
+
+    if (err == CL_SUCCESS && program) {
+        add_record(Kind::Program, program, owner, 0);
+    }
+    return program;
+}
+
+cl_kernel CLResourceTracker::createKernel(cl_program program, const char* kernel_name, cl_int* errcode_ret) {
+    cl_int err = CL_SUCCESS;
+    cl_kernel kernel = clCreateKernel(program, kernel_name, &err);
+    if (errcode_ret) *errcode_ret = err;
+
+    if (err == CL_SUCCESS && kernel) {
+        add_record(Kind::Kernel, kernel, kernel_name, 0);
+    }
+    return kernel;
+}
+
+void CLResourceTracker::trackEvent(cl_event event, const std::string& owner) {
+    if (event) {
+        add_record(Kind::Event, event, owner, 0);
+    }
+}
+
+// ============================================================================
+// Release
+// ============================================================================
+
+// Неучтённые объекты (созданные в обход трекера) освобождаются как обычно
+
+cl_int CLResourceTracker::releaseMemObject(cl_mem buffer) {
+    if (!buffer) return CL_INVALID_MEM_OBJECT;
+    cl_int status = clReleaseMemObject(buffer);
+    if (status == CL_SUCCESS) remove_record(buffer);
+    return status;
+}
+
+cl_int CLResourceTracker::releaseProgram(cl_program program) {
+    if (!program) return CL_INVALID_PROGRAM;
+    cl_int status = clReleaseProgram(program);
+    if (status == CL_SUCCESS) remove_record(program);
+    return status;
+}
+
+cl_int CLResourceTracker::releaseKernel(cl_kernel kernel) {
+    if (!kernel) return CL_INVALID_KERNEL;
+    cl_int status = clReleaseKernel(kernel);
+    if (status == CL_SUCCESS) remove_record(kernel);
+    return status;
+}
+
+cl_int CLResourceTracker::releaseEvent(cl_event event) {
+    if (!event) return CL_INVALID_EVENT;
+    cl_int status = clReleaseEvent(event);
+    if (status == CL_SUCCESS) remove_record(event);
+    return status;
+}
+
+// ============================================================================
+// Steps and reports
+// ============================================================================
+
+void CLResourceTracker::beginStep(const std::string& step) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    StepMemory memory;
+    memory.step = step;
+    memory.high_water_bytes = current_bytes_;  // Память, унаследованная от предыдущих шагов
+    steps_.push_back(memory);
+}
+
+std::string CLResourceTracker::currentStep() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return steps_.back().step;
+}
+
+size_t CLResourceTracker::currentBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_bytes_;
+}
+
+size_t CLResourceTracker::highWaterBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return high_water_bytes_;
+}
+
+std::vector<CLResourceTracker::StepMemory> CLResourceTracker::getStepMemory() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Пустой "Setup" (до первого beginStep) не показываем
+    std::vector<StepMemory> result;
+    for (const auto& step : steps_) {
+        if (step.step == "Setup" && step.buffers_created == 0 && step.events_created == 0) continue;
+        result.push_back(step);
+    }
+    return result;
+}
+
+std::vector<CLResourceTracker::Record> CLResourceTracker::getLiveObjects() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<Record> result;
+    result.reserve(live_.size());
+    for (const auto& [handle, record] : live_) {
+        result.push_back(record);
+    }
+    std::sort(result.begin(), result.end(),
+              [](const Record& a, const Record& b) { return a.created_ms < b.created_ms; });
+    return result;
+}
+
+void CLResourceTracker::printMemoryReport() const {
+    const double mb = 1024.0 * 1024.0;
+
+    printf("[MEM] %s device memory by step:\n", scope_.c_str());
+    printf("  %-12s %12s %12s %12s %8s %8s\n", "Step", "High-water", "Allocated", "Released", "Buffers", "Events");
+    for (const auto& step : getStepMemory()) {
+        printf("  %-12s %9.2f MB %9.2f MB %9.2f MB %8zu %8zu\n",
+               step.step.c_str(),
+               step.high_water_bytes / mb,
+               step.allocated_bytes / mb,
+               step.released_bytes / mb,
+               step.buffers_created,
+               step.events_created);
+    }
+    printf("  Current: %.2f MB, high-water: %.2f MB\n", currentBytes() / mb, highWaterBytes() / mb);
+}
+
+size_t CLResourceTracker::reportLeaks() const {
+    std::vector<Record> leaks = getLiveObjects();
+    if (leaks.empty()) {
+        printf("[MEM] %s: no leaked OpenCL objects\n", scope_.c_str());
+        return 0;
+    }
+
+    double now_ms = elapsed_ms();
+    fprintf(stderr, "[MEM] %s: %zu leaked OpenCL object(s):\n", scope_.c_str(), leaks.size());
+    for (const auto& leak : leaks) {
+        fprintf(stderr, "  ✗ %-10s %-40s %12zu bytes  created in %-8s alive %.1f ms\n",
+                kindName(leak.kind), leak.owner.c_str(), leak.bytes,
+                leak.step.c_str(), now_ms - leak.created_ms);
+    }
+    return leaks.size();
+}
@@ -1,10 +1,15 @@
 ﻿#include "fft_handler.hpp"
+#include <algorithm>
 #include <cstdio>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <chrono>
+#include <mutex>
 #include <thread>
+#include "correlator/Correlation2D.hpp"
+#include "correlator/PairwiseCorrelation.hpp"
 
 // ============================================================================
 // Helper: Load OpenCL kernel source from file
@@ -65,6 +70,78 @@ EventTiming profile_event_detailed(cl_event event) {
     return timing;
 }
 
+/**
+ * Профилировать цепочку событий одной операции (Step 2 из нескольких команд):
+ * ожидание всех, QUEUED/SUBMIT/START по первому событию, END по последнему
+ */
+static EventTiming profile_events_span(const std::vector<cl_event>& events) {
+    EventTiming timing;
+    if (events.empty()) return timing;
+    
+    auto wait_start = std::chrono::high_resolution_clock::now();
+    cl_int err = clWaitForEvents(static_cast<cl_uint>(events.size()), events.data());
+    auto wait_end = std::chrono::high_resolution_clock::now();
+    
+    if (err != CL_SUCCESS) return timing;
+    
+    timing.wait_ms = std::chrono::duration_cast<std::chrono::microseconds>(
+        wait_end - wait_start).count() / 1000.0;
+    
+    cl_ulong time_queued = 0, time_submit = 0, time_start = 0, time_end = 0;
+    
+    clGetEventProfilingInfo(events.front(), CL_PROFILING_COMMAND_QUEUED, sizeof(time_queued), &time_queued, nullptr);
+    clGetEventProfilingInfo(events.front(), CL_PROFILING_COMMAND_SUBMIT, sizeof(time_submit), &time_submit, nullptr);
+    clGetEventProfilingInfo(events.front(), CL_PROFILING_COMMAND_START, sizeof(time_start), &time_start, nullptr);
+    clGetEventProfilingInfo(events.back(), CL_PROFILING_COMMAND_END, sizeof(time_end), &time_end, nullptr);
+    
+    timing.queued_ms = (time_submit - time_queued) / 1e6;
+    timing.queue_wait_ms = (time_start - time_submit) / 1e6;
+    timing.execute_ms = (time_end - time_start) / 1e6;
+    timing.total_ms = (time_end - time_queued) / 1e6;
+    timing.submit_ms = timing.queued_ms;
+    
+    return timing;
+}
+
+// ============================================================================
+// clFFT library lifetime (one per process, shared by all FFTHandler instances)
+// ============================================================================
+
+static std::mutex clfft_library_mutex;
+static int clfft_library_users = 0;
+
+void FFTHandler::acquire_clfft_library() {
+    if (clfft_acquired_) return;
+    std::lock_guard<std::mutex> lock(clfft_library_mutex);
+    if (clfft_library_users == 0) {
+        clfftSetupData setup_data;
+        clfftInitSetupData(&setup_data);
+        clfftStatus status = clfftSetup(&setup_data);
+        if (status != CLFFT_SUCCESS) {
+            throw std::runtime_error("clfftSetup failed: " + std::to_string(status));
+        }
+    }
+    ++clfft_library_users;
+    clfft_acquired_ = true;
+}
+
+void FFTHandler::release_clfft_library() {
+    if (!clfft_acquired_) return;
+    std::lock_guard<std::mutex> lock(clfft_library_mutex);
+    clfft_acquired_ = false;
+    // Teardown только последним handler'ом: планы других handler'ов ещё живы
+    if (--clfft_library_users > 0) {
+        printf("     ✓ clFFT library kept (%d handler(s) still active)\n", clfft_library_users);
+        return;
+    }
+    clfftStatus teardown_status = clfftTeardown();
+    if (teardown_status == CLFFT_SUCCESS) {
+        printf("     ✓ clFFT library torn down\n");
+    } else {
+        printf("     ✗ Failed to teardown clFFT library (code: %d)\n", teardown_status);
+    }
+}
+
 double FFTHandler::profile_event(cl_event event, const std::string& label) {
     EventTiming timing = profile_event_detailed(event);
     double elapsed_ms = timing.execute_ms;
@@ -72,6 +149,18 @@ double FFTHandler::profile_event(cl_event event, const std::string& label) {
     return elapsed_ms;
 }
 
+void FFTHandler::record_init_phase(const std::string& phase, InitClock::time_point start) {
+    double elapsed_ms = std::chrono::duration<double, std::milli>(InitClock::now() - start).count();
+    if (ctx_.initialized) {
+        std::string step = resources_.currentStep();
+        printf("  [BUILD %s] %s: %.3f ms\n", step.c_str(), phase.c_str(), elapsed_ms);
+        build_timings_.push_back({std::move(step), phase, elapsed_ms});
+        return;
+    }
+    init_timings_.push_back({phase, elapsed_ms});
+    printf("  [INIT] %s: %.3f ms\n", phase.c_str(), elapsed_ms);
+}
+
 // ============================================================================
 // Initialize FFT Handler
 // ============================================================================
@@ -102,6 +191,13 @@ void FFTHandler::initialize(
     n_kg_ = n_kg;
     scale_factor_ = scale_factor;
     
+    init_timings_.clear();
+    build_timings_.clear();
+    resources_.beginStep("Init");
+    auto phase_start = InitClock::now();
+    
+    acquire_clfft_library();
+    
     cl_int err = CL_SUCCESS;
     
     // ========================================================================
@@ -110,62 +206,83 @@ void FFTHandler::initialize(
     
     printf("[FFT] Allocating GPU buffers...\n");
     
+    // Примечание: многие драйверы выделяют память лениво (при первом использовании),
+    // поэтому время clCreateBuffer может быть меньше реальной стоимости аллокации
+    
     // Reference signals buffers
-    ctx_.reference_data = clCreateBuffer(
+    phase_start = InitClock::now();
+    ctx_.reference_data = resources_.createBuffer(
         ctx_.context,
         CL_MEM_READ_WRITE,
         N * sizeof(int32_t),
         nullptr,
-        &err
+        &err,
+        "reference_data"
     );
     if (err != CL_SUCCESS) throw std::runtime_error("Failed to allocate reference_data buffer");
+    record_init_phase("clCreateBuffer reference_data", phase_start);
     
-    ctx_.reference_fft = clCreateBuffer(
+    phase_start = InitClock::now();
+    ctx_.reference_fft = resources_.createBuffer(
         ctx_.context,
         CL_MEM_READ_WRITE,
         num_shifts * N * sizeof(cl_float2),
         nullptr,
-        &err
+        &err,
+        "reference_fft"
     );
     if (err != CL_SUCCESS) throw std::runtime_error("Failed to allocate reference_fft buffer");
+    record_init_phase("clCreateBuffer reference_fft", phase_start);
     
     // Input signals buffers
-    ctx_.input_data = clCreateBuffer(
+    phase_start = InitClock::now();
+    ctx_.input_data = resources_.createBuffer(
         ctx_.context,
         CL_MEM_READ_WRITE,
         num_signals * N * sizeof(int32_t),
         nullptr,
-        &err
+        &err,
+        "input_data"
     );
     if (err != CL_SUCCESS) throw std::runtime_error("Failed to allocate input_data buffer");
+    record_init_phase("clCreateBuffer input_data", phase_start);
     
-    ctx_.input_fft = clCreateBuffer(
+    phase_start = InitClock::now();
+    ctx_.input_fft = resources_.createBuffer(
         ctx_.context,
         CL_MEM_READ_WRITE,
         num_signals * N * sizeof(cl_float2),
         nullptr,
-        &err
+        &err,
+        "input_fft"
     );
     if (err != CL_SUCCESS) throw std::runtime_error("Failed to allocate input_fft buffer");
+    record_init_phase("clCreateBuffer input_fft", phase_start);
     
     // Correlation buffers
-    ctx_.correlation_fft = clCreateBuffer(
+    phase_start = InitClock::now();
+    ctx_.correlation_fft = resources_.createBuffer(
         ctx_.context,
         CL_MEM_READ_WRITE,
         num_signals * num_shifts * N * sizeof(cl_float2),
         nullptr,
-        &err
+        &err,
+        "correlation_fft"
     );
     if (err != CL_SUCCESS) throw std::runtime_error("Failed to allocate correlation_fft buffer");
+    record_init_phase("clCreateBuffer correlation_fft", phase_start);
     
-    ctx_.correlation_ifft = clCreateBuffer(
+    phase_start = InitClock::now();
+    ctx_.correlation_ifft = resources_.createBuffer(
         ctx_.context,
         CL_MEM_READ_WRITE,
         num_signals * num_shifts * N * sizeof(cl_float2),
         nullptr,
-        &err
+        &err,
+        "correlation_ifft"
     );
     if (err != CL_SUCCESS) throw std::runtime_error("Failed to allocate correlation_ifft buffer");
+    record_init_phase("clCreateBuffer correlation_ifft", phase_start);
     
     printf("[OK] GPU buffers allocated\n\n");
     
@@ -175,8 +292,9 @@ void FFTHandler::initialize(
     
     printf("[FFT] Creating FFT plans...\n");
     
-    // Plan for reference signals (batch of num_shifts) with pre-callback (int32→float2) and post-callback (conjugate)
-    ctx_.reference_fft_plan = create_fft_plan_1d_with_pre_and_post_callback_conjugate(N, num_shifts, scale_factor, "Reference FFT Plan");
+    // Plan for the reference signal (one FFT) with pre-callback (int32→float2) and post-callback (conjugate);
+    // строки s ≥ 1 банка Step 1 разворачивает expand_reference_shifts
+    ctx_.reference_fft_plan = create_fft_plan_1d_with_pre_and_post_callback_conjugate(N, 1, scale_factor, "Reference FFT Plan");
     
     // Plan for input signals (batch of num_signals) with pre-callback
     ctx_.input_fft_plan = create_fft_plan_1d_with_precallback(N, num_signals, scale_factor, "Input FFT Plan");
@@ -189,6 +307,7 @@ void FFTHandler::initialize(
     
     printf("[FFT] Creating post-callback userdata...\n");
     
+    phase_start = InitClock::now();
     PostCallbackParams post_params = {
         (cl_uint)num_signals,
         (cl_uint)num_shifts,
@@ -198,6 +317,7 @@ void FFTHandler::initialize(
     };
     
     create_post_callback_userdata(N, num_signals, num_shifts, n_kg, post_params);
+    record_init_phase("Post-callback userdata (create + write)", phase_start);
     
     printf("[OK] Post-callback userdata created\n\n");
     
@@ -214,6 +334,7 @@ void FFTHandler::initialize(
     
     printf("[FFT] Creating pre-callback userdata...\n");
     
+    phase_start = InitClock::now();
     PreCallbackParams pre_params = {
         (cl_uint)num_shifts,
         (cl_uint)N,
@@ -222,6 +343,7 @@ void FFTHandler::initialize(
     };
     
     create_pre_callback_userdata(N, num_shifts, pre_params, nullptr);
+    record_init_phase("Pre-callback userdata (create + write)", phase_start);
     
     printf("[OK] Pre-callback userdata created\n\n");
     
@@ -241,6 +363,7 @@ clfftPlanHandle FFTHandler::create_fft_plan_1d(
 ) {
     clfftPlanHandle plan_handle;
     cl_int err = CL_SUCCESS;
+    auto setup_start = InitClock::now();
     
     size_t clLengths[1] = {fft_size};
     
@@ -264,11 +387,14 @@ clfftPlanHandle FFTHandler::create_fft_plan_1d(
     
     // Bake the plan
     printf("  [DEBUG] Baking FFT plan: fft_size=%zu, batch_size=%d\n", fft_size, batch_size);
+    record_init_phase("Plan setup: " + plan_name, setup_start);
+    auto bake_start = InitClock::now();
     err = clfftBakePlan(plan_handle, 1, &ctx_.queue, nullptr, nullptr);
     if (err != CL_SUCCESS) {
         fprintf(stderr, "ERROR: clfftBakePlan failed for %s with error %d\n", plan_name.c_str(), err);
         throw std::runtime_error("clfftBakePlan failed for " + plan_name);
     }
+    record_init_phase("clfftBakePlan: " + plan_name, bake_start);
     printf("  [DEBUG] FFT plan baked successfully\n");
     
     printf("  ✓ %s created (size=%zu, batch=%d)\n", plan_name.c_str(), fft_size, batch_size);
@@ -276,6 +402,109 @@ clfftPlanHandle FFTHandler::create_fft_plan_1d(
     return plan_handle;
 }
 
+clfftPlanHandle FFTHandler::create_fft_plan_1d_inplace(
+    size_t fft_size,
+    int batch_size,
+    const std::string& plan_name
+) {
+    clfftPlanHandle plan_handle;
+    cl_int err = CL_SUCCESS;
+    auto setup_start = InitClock::now();
+    
+    size_t clLengths[1] = {fft_size};
+    
+    err = clfftCreateDefaultPlan(&plan_handle, ctx_.context, CLFFT_1D, clLengths);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("clfftCreateDefaultPlan failed for " + plan_name);
+    }
+    
+    // Данные уже float2 (ядро конвертации), FFT на месте в input_fft
+    clfftSetPlanPrecision(plan_handle, CLFFT_SINGLE);
+    clfftSetLayout(plan_handle, CLFFT_COMPLEX_INTERLEAVED, CLFFT_COMPLEX_INTERLEAVED);
+    clfftSetResultLocation(plan_handle, CLFFT_INPLACE);
+    clfftSetPlanBatchSize(plan_handle, batch_size);
+    
+    size_t strides[1] = {1};
+    size_t dist = fft_size;
+    clfftSetPlanInStride(plan_handle, CLFFT_1D, strides);
+    clfftSetPlanOutStride(plan_handle, CLFFT_1D, strides);
+    clfftSetPlanDistance(plan_handle, dist, dist);
+    
+    record_init_phase("Plan setup: " + plan_name, setup_start);
+    auto bake_start = InitClock::now();
+    err = clfftBakePlan(plan_handle, 1, &ctx_.queue, nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        clfftDestroyPlan(&plan_handle);
+        throw std::runtime_error("clfftBakePlan failed for " + plan_name);
+    }
+    record_init_phase("clfftBakePlan: " + plan_name, bake_start);
+    
+    printf("  ✓ %s created in-place (size=%zu, batch=%d)\n", plan_name.c_str(), fft_size, batch_size);
+    
+    return plan_handle;
+}
+
+FFTHandler::FFTPlanDesc FFTHandler::FFTPlanDesc::real2D(size_t height, size_t width, int batch_size, bool forward) {
+    const size_t half = width / 2 + 1;
+    FFTPlanDesc desc;
+    desc.dim = CLFFT_2D;
+    desc.lengths[0] = width;
+    desc.lengths[1] = height;
+    desc.batch_size = batch_size;
+    desc.location = CLFFT_OUTOFPLACE;
+    if (forward) {
+        desc.in_layout = CLFFT_REAL;
+        desc.out_layout = CLFFT_HERMITIAN_INTERLEAVED;
+        desc.in_strides[1] = width;
+        desc.out_strides[1] = half;
+        desc.in_distance = height * width;
+        desc.out_distance = height * half;
+    } else {
+        desc.in_layout = CLFFT_HERMITIAN_INTERLEAVED;
+        desc.out_layout = CLFFT_REAL;
+        desc.in_strides[1] = half;
+        desc.out_strides[1] = width;
+        desc.in_distance = height * half;
+        desc.out_distance = height * width;
+    }
+    return desc;
+}
+
+clfftPlanHandle FFTHandler::create_fft_plan(const FFTPlanDesc& desc, const std::string& plan_name) {
+    clfftPlanHandle plan_handle;
+    auto setup_start = InitClock::now();
+    
+    size_t lengths[3] = {desc.lengths[0], desc.lengths[1], desc.lengths[2]};
+    clfftStatus status = clfftCreateDefaultPlan(&plan_handle, ctx_.context, desc.dim, lengths);
+    if (status != CLFFT_SUCCESS) {
+        throw std::runtime_error("clfftCreateDefaultPlan failed for " + plan_name);
+    }
+    
+    size_t in_strides[3] = {desc.in_strides[0], desc.in_strides[1], desc.in_strides[2]};
+    size_t out_strides[3] = {desc.out_strides[0], desc.out_strides[1], desc.out_strides[2]};
+    clfftSetPlanPrecision(plan_handle, CLFFT_SINGLE);
+    clfftSetLayout(plan_handle, desc.in_layout, desc.out_layout);
+    clfftSetResultLocation(plan_handle, desc.location);
+    clfftSetPlanBatchSize(plan_handle, desc.batch_size);
+    clfftSetPlanInStride(plan_handle, desc.dim, in_strides);
+    clfftSetPlanOutStride(plan_handle, desc.dim, out_strides);
+    clfftSetPlanDistance(plan_handle, desc.in_distance, desc.out_distance);
+    
+    record_init_phase("Plan setup: " + plan_name, setup_start);
+    auto bake_start = InitClock::now();
+    status = clfftBakePlan(plan_handle, 1, &ctx_.queue, nullptr, nullptr);
+    if (status != CLFFT_SUCCESS) {
+        clfftDestroyPlan(&plan_handle);
+        throw std::runtime_error("clfftBakePlan failed for " + plan_name);
+    }
+    record_init_phase("clfftBakePlan: " + plan_name, bake_start);
+    
+    printf("  ✓ %s created (%zu × %zu × %zu, batch=%d)\n", plan_name.c_str(),
+           desc.lengths[0], desc.lengths[1], desc.lengths[2], desc.batch_size);
+    
+    return plan_handle;
+}
+
 clfftPlanHandle FFTHandler::create_fft_plan_1d_with_precallback(
     size_t fft_size,
     int batch_size,
@@ -284,6 +513,7 @@ clfftPlanHandle FFTHandler::create_fft_plan_1d_with_precallback(
 ) {
     clfftPlanHandle plan_handle;
     cl_int err = CL_SUCCESS;
+    auto setup_start = InitClock::now();
     
     size_t clLengths[1] = {fft_size};
     
@@ -336,14 +566,15 @@ float2 pre_callback(__global void* input, uint inoffset, __global void* userdata
     };
     PreCallbackParams pre_cb_params = {scale_factor, {0, 0, 0}};
     
-    cl_mem callback_userdata = clCreateBuffer(ctx_.context, CL_MEM_READ_ONLY, sizeof(PreCallbackParams), nullptr, &err);
+    cl_mem callback_userdata = resources_.createBuffer(ctx_.context, CL_MEM_READ_ONLY, sizeof(PreCallbackParams), nullptr, &err,
+                                                       plan_name + " pre-callback userdata");
     if (err != CL_SUCCESS) {
         throw std::runtime_error("Failed to create callback userdata buffer");
     }
     
     err = clEnqueueWriteBuffer(ctx_.queue, callback_userdata, CL_TRUE, 0, sizeof(PreCallbackParams), &pre_cb_params, 0, nullptr, nullptr);
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(callback_userdata);
+        resources_.releaseMemObject(callback_userdata);
         throw std::runtime_error("Failed to write callback userdata");
     }
     
@@ -352,18 +583,23 @@ float2 pre_callback(__global void* input, uint inoffset, __global void* userdata
     err = clfftSetPlanCallback(plan_handle, "pre_callback", callback_func_source.c_str(), 
                                 0, PRECALLBACK, &callback_userdata, 1);
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(callback_userdata);
+        resources_.releaseMemObject(callback_userdata);
         throw std::runtime_error("clfftSetPlanCallback failed for " + plan_name);
     }
     
     // Bake the plan (callback will be embedded)
+    record_init_phase("Plan setup: " + plan_name, setup_start);
+    auto bake_start = InitClock::now();
     err = clfftBakePlan(plan_handle, 1, &ctx_.queue, nullptr, nullptr);
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(callback_userdata);
+        resources_.releaseMemObject(callback_userdata);
         throw std::runtime_error("clfftBakePlan failed for " + plan_name);
     }
+    record_init_phase("clfftBakePlan: " + plan_name, bake_start);
     
-    // Note: callback_userdata is managed by clFFT plan, don't release it here
+    // clFFT не удерживает userdata (нет clRetainMemObject) — храним в контексте
+    // и освобождаем в cleanup() после уничтожения плана
+    ctx_.input_callback_userdata = callback_userdata;
     
     printf("  ✓ %s created with pre-callback (size=%zu, batch=%d)\n", plan_name.c_str(), fft_size, batch_size);
     
@@ -378,6 +614,7 @@ clfftPlanHandle FFTHandler::create_fft_plan_1d_with_pre_and_post_callback_conjug
 ) {
     clfftPlanHandle plan_handle;
     cl_int err = CL_SUCCESS;
+    auto setup_start = InitClock::now();
     
     size_t clLengths[1] = {fft_size};
     
@@ -430,14 +667,15 @@ float2 pre_callback(__global void* input, uint inoffset, __global void* userdata
     };
     PreCallbackParams pre_cb_params = {scale_factor, {0, 0, 0}};
     
-    cl_mem pre_callback_userdata = clCreateBuffer(ctx_.context, CL_MEM_READ_ONLY, sizeof(PreCallbackParams), nullptr, &err);
+    cl_mem pre_callback_userdata = resources_.createBuffer(ctx_.context, CL_MEM_READ_ONLY, sizeof(PreCallbackParams), nullptr, &err,
+                                                           plan_name + " pre-callback userdata");
     if (err != CL_SUCCESS) {
         throw std::runtime_error("Failed to create pre-callback userdata buffer");
     }
     
     err = clEnqueueWriteBuffer(ctx_.queue, pre_callback_userdata, CL_TRUE, 0, sizeof(PreCallbackParams), &pre_cb_params, 0, nullptr, nullptr);
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(pre_callback_userdata);
+        resources_.releaseMemObject(pre_callback_userdata);
         throw std::runtime_error("Failed to write pre-callback userdata");
     }
     
@@ -445,7 +683,7 @@ float2 pre_callback(__global void* input, uint inoffset, __global void* userdata
     err = clfftSetPlanCallback(plan_handle, "pre_callback", pre_callback_source.c_str(), 
                                 0, PRECALLBACK, &pre_callback_userdata, 1);
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(pre_callback_userdata);
+        resources_.releaseMemObject(pre_callback_userdata);
         throw std::runtime_error("clfftSetPlanCallback failed for pre-callback in " + plan_name);
     }
     
@@ -470,18 +708,22 @@ void post_callback_conjugate(__global void* output, uint outoffset, __global voi
     err = clfftSetPlanCallback(plan_handle, "post_callback_conjugate", post_callback_source.c_str(), 
                                 0, POSTCALLBACK, post_callback_userdata_array, 0);
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(pre_callback_userdata);
+        resources_.releaseMemObject(pre_callback_userdata);
         throw std::runtime_error("clfftSetPlanCallback failed for post-callback in " + plan_name);
     }
     
     // Bake the plan (callbacks will be embedded)
+    record_init_phase("Plan setup: " + plan_name, setup_start);
+    auto bake_start = InitClock::now();
     err = clfftBakePlan(plan_handle, 1, &ctx_.queue, nullptr, nullptr);
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(pre_callback_userdata);
+        resources_.releaseMemObject(pre_callback_userdata);
         throw std::runtime_error("clfftBakePlan failed for " + plan_name);
     }
+    record_init_phase("clfftBakePlan: " + plan_name, bake_start);
     
-    // Note: pre_callback_userdata is managed by clFFT plan, don't release it here
+    // clFFT не удерживает userdata — освобождается в cleanup() после уничтожения плана
+    ctx_.reference_callback_userdata = pre_callback_userdata;
     
     printf("  ✓ %s created with pre-callback (int32→float2) and post-callback (conjugate) (size=%zu, batch=%d)\n", 
            plan_name.c_str(), fft_size, batch_size);
@@ -499,6 +741,7 @@ clfftPlanHandle FFTHandler::create_fft_plan_1d_with_postcallback(
 ) {
     clfftPlanHandle plan_handle;
     cl_int err = CL_SUCCESS;
+    auto setup_start = InitClock::now();
     
     size_t clLengths[1] = {fft_size};
     
@@ -589,10 +832,13 @@ void post_callback(__global void* output, uint outoffset, __global void* userdat
     }
     
     // Bake the plan (callback will be embedded)
+    record_init_phase("Plan setup: " + plan_name, setup_start);
+    auto bake_start = InitClock::now();
     err = clfftBakePlan(plan_handle, 1, &ctx_.queue, nullptr, nullptr);
     if (err != CL_SUCCESS) {
         throw std::runtime_error("clfftBakePlan failed for " + plan_name);
     }
+    record_init_phase("clfftBakePlan: " + plan_name, bake_start);
     
     printf("  ✓ %s created with post-callback (size=%zu, batch=%d)\n", plan_name.c_str(), fft_size, batch_size);
     
@@ -613,6 +859,7 @@ clfftPlanHandle FFTHandler::create_fft_plan_1d_with_pre_and_post_callback(
 ) {
     clfftPlanHandle plan_handle;
     cl_int err = CL_SUCCESS;
+    auto setup_start = InitClock::now();
     
     size_t clLengths[1] = {fft_size};
     
@@ -701,12 +948,13 @@ float2 pre_callback(__global void* input, uint inoffset, __global void* userdata
     size_t input_size = num_signals * fft_size * sizeof(cl_float2);
     size_t pre_cb_userdata_size = params_size + reference_size + input_size;
     
-    cl_mem pre_callback_userdata = clCreateBuffer(
+    cl_mem pre_callback_userdata = resources_.createBuffer(
         ctx_.context,
         CL_MEM_READ_WRITE,
         pre_cb_userdata_size,
         nullptr,
-        &err
+        &err,
+        "pre_callback_userdata_correlation"
     );
     
     if (err != CL_SUCCESS) {
@@ -725,7 +973,7 @@ float2 pre_callback(__global void* input, uint inoffset, __global void* userdata
     );
     
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(pre_callback_userdata);
+        resources_.releaseMemObject(pre_callback_userdata);
         throw std::runtime_error("Failed to write pre-callback params");
     }
     
@@ -736,13 +984,10 @@ float2 pre_callback(__global void* input, uint inoffset, __global void* userdata
     err = clfftSetPlanCallback(plan_handle, "pre_callback", pre_callback_source.c_str(), 
                                 0, PRECALLBACK, &pre_callback_userdata, 1);
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(pre_callback_userdata);
+        resources_.releaseMemObject(pre_callback_userdata);
         throw std::runtime_error("clfftSetPlanCallback failed for pre-callback in " + plan_name);
     }
     
-    // Сохранить userdata в контексте для использования в step3
-    ctx_.pre_callback_userdata_correlation = pre_callback_userdata;
-    
     // ========================================================================
     // POST-CALLBACK: Find Peaks
     // ========================================================================
@@ -787,7 +1032,7 @@ void post_callback(__global void* output, uint outoffset, __global void* userdat
     // Use existing post_callback_userdata buffer
     cl_mem post_callback_userdata = ctx_.post_callback_userdata;
     if (!post_callback_userdata) {
-        clReleaseMemObject(pre_callback_userdata);
+        resources_.releaseMemObject(pre_callback_userdata);
         throw std::runtime_error("post_callback_userdata buffer not initialized");
     }
     
@@ -795,19 +1040,22 @@ void post_callback(__global void* output, uint outoffset, __global void* userdat
     err = clfftSetPlanCallback(plan_handle, "post_callback", post_callback_source.c_str(), 
                                 0, POSTCALLBACK, &post_callback_userdata, 1);
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(pre_callback_userdata);
+        resources_.releaseMemObject(pre_callback_userdata);
         throw std::runtime_error("clfftSetPlanCallback failed for post-callback in " + plan_name);
     }
     
     // Bake the plan
+    record_init_phase("Plan setup: " + plan_name, setup_start);
+    auto bake_start = InitClock::now();
     err = clfftBakePlan(plan_handle, 1, &ctx_.queue, nullptr, nullptr);
     if (err != CL_SUCCESS) {
-        clReleaseMemObject(pre_callback_userdata);
+        resources_.releaseMemObject(pre_callback_userdata);
         throw std::runtime_error("clfftBakePlan failed for " + plan_name);
     }
+    record_init_phase("clfftBakePlan: " + plan_name, bake_start);
     
-    // Note: pre_callback_userdata is managed by clFFT plan, but we may need to release it
-    // For now, keep it for potential future use
+    // Сохранить userdata в контексте для использования в step3 (освобождается в cleanup())
+    ctx_.pre_callback_userdata_correlation = pre_callback_userdata;
     
     printf("  ✓ %s created with PRE-CALLBACK (Complex Multiply) and POST-CALLBACK (Find Peaks)\n", plan_name.c_str());
     printf("    Note: Оба callback'а встроены в план для минимального времени выполнения!\n");
@@ -834,12 +1082,13 @@ void FFTHandler::create_pre_callback_userdata(
                           + N * sizeof(int32_t);  // Space for input signal
     
     cl_int err = CL_SUCCESS;
-    ctx_.pre_callback_userdata = clCreateBuffer(
+    ctx_.pre_callback_userdata = resources_.createBuffer(
         ctx_.context,
         CL_MEM_READ_WRITE,
         userdata_size,
         nullptr,
-        &err
+        &err,
+        "pre_callback_userdata"
     );
     
     if (err != CL_SUCCESS) {
@@ -884,12 +1133,13 @@ void FFTHandler::create_post_callback_userdata(
     size_t userdata_size = params_size_in_buffer + output_size;
     
     cl_int err = CL_SUCCESS;
-    ctx_.post_callback_userdata = clCreateBuffer(
+    ctx_.post_callback_userdata = resources_.createBuffer(
         ctx_.context,
         CL_MEM_READ_WRITE,
         userdata_size,
         nullptr,
-        &err
+        &err,
+        "post_callback_userdata"
     );
     
     if (err != CL_SUCCESS) {
@@ -930,6 +1180,7 @@ void FFTHandler::step1_reference_signals(
     OperationTiming& fft_timing
 ) {
     printf("[STEP 1] Processing reference signals...\n");
+    resources_.beginStep("Step1");
     
     // ВАЖНО: Проверить соответствие параметров с параметрами инициализации
     printf("  [DEBUG] Step1 parameters check:\n");
@@ -982,7 +1233,7 @@ void FFTHandler::step1_reference_signals(
     }
 
     cl_int err = CL_SUCCESS;
-    cl_event event_upload, event_fft;
+    cl_event event_upload = nullptr, event_fft = nullptr;
 
     // ========================================================================
     // 1. Upload reference signal to GPU
@@ -1004,6 +1255,7 @@ void FFTHandler::step1_reference_signals(
     if (err != CL_SUCCESS) {
         throw std::runtime_error("Failed to upload reference signal");
     }
+    resources_.trackEvent(event_upload, "Step1 upload");
 
     // Wait for upload and measure detailed time
     EventTiming upload_event_timing = profile_event_detailed(event_upload);
@@ -1069,14 +1321,15 @@ void FFTHandler::step1_reference_signals(
         &ctx_.reference_fft,   // Output: float2 FFT results
         nullptr
     );
+    resources_.trackEvent(event_fft, "Step1 forward FFT");
 
     printf("  [DEBUG] clfftEnqueueTransform status: %d (CLFFT_SUCCESS=%d)\n", fft_status, CLFFT_SUCCESS);
     printf("  [DEBUG] event_fft after enqueue: %p\n", (void*)event_fft);
 
     if (fft_status != CLFFT_SUCCESS) {
         fprintf(stderr, "ERROR: clfftEnqueueTransform failed with status %d\n", fft_status);
-        if (event_upload) clReleaseEvent(event_upload);
-        if (event_fft) clReleaseEvent(event_fft);
+        if (event_upload) resources_.releaseEvent(event_upload);
+        if (event_fft) resources_.releaseEvent(event_fft);
         throw std::runtime_error("clfftEnqueueTransform failed for reference FFT");
     }
 
@@ -1120,8 +1373,17 @@ void FFTHandler::step1_reference_signals(
     }
 
     // Release events
-    clReleaseEvent(event_upload);
-    if (event_fft) clReleaseEvent(event_fft);
+    resources_.releaseEvent(event_upload);
+    if (event_fft) resources_.releaseEvent(event_fft);
+
+    // Строки s ≥ 1: conj(FFT(ref[(n + s) mod N])) = R_0·e^{−j2πks/N} (очередь in-order)
+    OperationTiming expand_timing;
+    expand_reference_shifts(num_shifts, expand_timing);
+    fft_timing.execute_ms += expand_timing.execute_ms;
+    fft_timing.queue_wait_ms += expand_timing.queue_wait_ms;
+    fft_timing.cpu_wait_ms += expand_timing.cpu_wait_ms;
+    fft_timing.total_gpu_ms += expand_timing.total_gpu_ms;
+    time_fft_ms += expand_timing.execute_ms;
     
     // Дополнительно: убедиться, что все операции в очереди завершены
     // Это важно для гарантии, что данные готовы для чтения
@@ -1149,9 +1411,10 @@ void FFTHandler::step2_input_signals(
     OperationTiming& fft_timing
 ) {
     printf("[STEP 2] Processing input signals...\n");
+    resources_.beginStep("Step2");
 
     cl_int err = CL_SUCCESS;
-    cl_event event_upload, event_fft;
+    cl_event event_upload = nullptr;
 
     // Upload input signals
     printf("  1. Uploading input signals to GPU...\n");
@@ -1171,6 +1434,7 @@ void FFTHandler::step2_input_signals(
     if (err != CL_SUCCESS) {
         throw std::runtime_error("Failed to upload input signals");
     }
+    resources_.trackEvent(event_upload, "Step2 upload");
 
     // Wait for upload to complete and measure detailed time
     EventTiming upload_event_timing = profile_event_detailed(event_upload);
@@ -1182,128 +1446,1244 @@ void FFTHandler::step2_input_signals(
     printf("  [PROFILE] Upload input: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n", 
            upload_event_timing.execute_ms, upload_event_timing.queue_wait_ms, upload_event_timing.wait_ms);
 
-    // Pre-callback встроен в clFFT план, выполняется автоматически
-    // Измеряем только время выполнения FFT (callback включен в FFT время)
-    printf("  2. Pre-callback встроен в clFFT план (выполняется автоматически)...\n");
-    
-    // Время callback включается в общее время FFT, так как он встроен
-    // Для отдельного измерения нужно было бы использовать события, но callback встроен
-    time_callback_ms = 0.0;  // Callback встроен в FFT, измеряется как часть FFT
+    // Слитый путь: FFT входа выполнит Step 3 в локальной памяти
+    if (fused_enabled_) {
+        resources_.releaseEvent(event_upload);
+        time_callback_ms = 0.0;
+        time_fft_ms = 0.0;
+        fft_timing = OperationTiming{};
+        fused_input_pending_ = true;
+        printf("[OK] Step 2 completed (FFT deferred to fused Step 3)!\n\n");
+        return;
+    }
 
-    // Execute Forward FFT (callback выполнится автоматически через clFFT)
-    printf("  3. Executing forward FFT (batch of %d) with embedded pre-callback...\n", num_signals);
+    // Путь Callback: конвертация встроена в clFFT план (время входит в FFT)
+    // Путь Converter: отдельное ядро int32→float2, его время тоже входит в fft_timing
+    printf("  2. Conversion path: %s\n", Step2PlanTuning::pathName(step2_tuning_.path));
+    time_callback_ms = 0.0;
 
-    clfftStatus fft_status = clfftEnqueueTransform(
-        ctx_.input_fft_plan,
-        CLFFT_FORWARD,
-        1,
-        &ctx_.queue,
-        1,  // Wait for upload to complete
-        &event_upload,
-        &event_fft,
-        &ctx_.input_data,  // Input: int32 data (callback конвертирует в float2)
-        &ctx_.input_fft,   // Output: float2 FFT results
-        nullptr
-    );
+    printf("  3. Executing forward FFT (batch of %d, split %d)...\n", num_signals, step2_tuning_.split);
+
+    std::vector<cl_event> fft_events;
+    try {
+        fft_events = enqueue_step2_transform(event_upload);
+    } catch (...) {
+        resources_.releaseEvent(event_upload);
+        throw;
+    }
 
-    printf("  FFT status: %d\n", fft_status);
+    // Время от начала первой команды (конвертация / первая часть) до конца последней
+    EventTiming fft_event_timing = profile_events_span(fft_events);
+    time_fft_ms = fft_event_timing.execute_ms;
+    fft_timing.execute_ms = fft_event_timing.execute_ms;
+    fft_timing.queue_wait_ms = fft_event_timing.queue_wait_ms;
+    fft_timing.cpu_wait_ms = fft_event_timing.wait_ms;
+    fft_timing.total_gpu_ms = fft_event_timing.total_ms;
+    printf("  [PROFILE] Forward FFT: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n", 
+           fft_event_timing.execute_ms, fft_event_timing.queue_wait_ms, fft_event_timing.wait_ms);
 
-    if (fft_status != CLFFT_SUCCESS) {
-        clReleaseEvent(event_upload);
-        char error_msg[256];
-        snprintf(error_msg, sizeof(error_msg), "clfftEnqueueTransform failed for input FFT: %d", fft_status);
-        throw std::runtime_error(error_msg);
+    // Clean up events
+    resources_.releaseEvent(event_upload);
+    for (cl_event event : fft_events) {
+        resources_.releaseEvent(event);
+    }
+
+    printf("[OK] Step 2 completed!\n\n");
+}
+
+// ============================================================================
+// STEP 2: Plan tuning (conversion path + batch split)
+// ============================================================================
+
+// convert_int32_to_float2 из gpu_converter_kernel.cl (встроен: handler не знает путь к .cl)
+static const char* step2_converter_source = R"(
+__kernel void convert_int32_to_float2(
+    __global const int* input,
+    __global float2* output,
+    const float scale,
+    const unsigned int num_elements
+) {
+    unsigned int gid = get_global_id(0);
+    if (gid >= num_elements) return;
+    output[gid] = (float2)((float)input[gid] * scale, 0.0f);
+}
+)";
+
+// Кандидаты деления батча Step 2 при автотюнинге
+static constexpr int kStep2TuningSplits[] = {1, 2, 4, 8};
+
+bool FFTHandler::build_converter_program() {
+    if (ctx_.converter_program) {
+        return true;
     }
 
-    if (!event_fft) {
-        clReleaseEvent(event_upload);
-        throw std::runtime_error("FFT event is null");
+    cl_int err = CL_SUCCESS;
+    const char* source = step2_converter_source;
+    cl_program program = resources_.createProgramWithSource(ctx_.context, 1, &source, nullptr, &err, "step2_converter");
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create converter program: %d\n", err);
+        return false;
     }
 
-    // Wait for FFT to complete and measure time
-    if (event_fft) {
-        err = clWaitForEvents(1, &event_fft);
+    err = clBuildProgram(program, 1, &ctx_.device, "", nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+        std::vector<char> log(log_size + 1, '\0');
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
+        fprintf(stderr, "[ERROR] Converter program build failed:\n%s\n", log.data());
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    cl_kernel kernel = resources_.createKernel(program, "convert_int32_to_float2", &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create converter kernel: %d\n", err);
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    ctx_.converter_program = program;
+    ctx_.convert_kernel = kernel;
+    return true;
+}
+
+void FFTHandler::release_step2_plan() {
+    // Sub-buffer'ы удерживают родителя — освобождаются до input_data/input_fft
+    for (std::vector<cl_mem>* parts : {&ctx_.input_data_parts, &ctx_.input_fft_parts}) {
+        for (cl_mem part : *parts) {
+            clReleaseMemObject(part);
+        }
+        parts->clear();
+    }
+
+    if (ctx_.input_fft_plan) {
+        clfftDestroyPlan(&ctx_.input_fft_plan);
+        ctx_.input_fft_plan = 0;
+    }
+    // Userdata pre-callback'а живёт до уничтожения плана
+    if (ctx_.input_callback_userdata) {
+        resources_.releaseMemObject(ctx_.input_callback_userdata);
+        ctx_.input_callback_userdata = nullptr;
+    }
+}
+
+std::vector<cl_event> FFTHandler::enqueue_step2_transform(cl_event wait_event) {
+    std::vector<cl_event> events;
+    auto fail = [&](const std::string& message) {
+        for (cl_event event : events) {
+            resources_.releaseEvent(event);
+        }
+        throw std::runtime_error(message);
+    };
+    // Каждая команда ждёт предыдущую (первая — wait_event)
+    auto previous = [&]() -> cl_event* {
+        if (!events.empty()) return &events.back();
+        return wait_event ? &wait_event : nullptr;
+    };
+
+    const bool converter = step2_tuning_.path == Step2PlanTuning::Converter;
+    if (converter) {
+        const cl_uint num_elements = static_cast<cl_uint>(num_signals_ * fft_size_);
+        cl_int err = clSetKernelArg(ctx_.convert_kernel, 0, sizeof(cl_mem), &ctx_.input_data);
+        err |= clSetKernelArg(ctx_.convert_kernel, 1, sizeof(cl_mem), &ctx_.input_fft);
+        err |= clSetKernelArg(ctx_.convert_kernel, 2, sizeof(float), &scale_factor_);
+        err |= clSetKernelArg(ctx_.convert_kernel, 3, sizeof(cl_uint), &num_elements);
         if (err != CL_SUCCESS) {
-            clReleaseEvent(event_upload);
-            clReleaseEvent(event_fft);
-            throw std::runtime_error("Failed to wait for FFT completion");
+            fail("Failed to set converter kernel arguments");
         }
-    } else {
-        printf("  Warning: FFT event is null, skipping wait\n");
+
+        size_t global_size = num_elements;
+        cl_event* wait = previous();
+        cl_event event_convert = nullptr;
+        err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.convert_kernel, 1, nullptr, &global_size, nullptr,
+                                     wait ? 1 : 0, wait, &event_convert);
+        if (err != CL_SUCCESS) {
+            fail("Failed to enqueue int32->float2 conversion: " + std::to_string(err));
+        }
+        resources_.trackEvent(event_convert, "Step2 int32->float2");
+        events.push_back(event_convert);
     }
 
-    // Measure FFT time (detailed)
-    if (event_fft) {
-        EventTiming fft_event_timing = profile_event_detailed(event_fft);
-        time_fft_ms = fft_event_timing.execute_ms;
-        fft_timing.execute_ms = fft_event_timing.execute_ms;
-        fft_timing.queue_wait_ms = fft_event_timing.queue_wait_ms;
-        fft_timing.cpu_wait_ms = fft_event_timing.wait_ms;
-        fft_timing.total_gpu_ms = fft_event_timing.total_ms;
-        printf("  [PROFILE] Forward FFT: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n", 
-               fft_event_timing.execute_ms, fft_event_timing.queue_wait_ms, fft_event_timing.wait_ms);
-    } else {
-        time_fft_ms = 0.0;
-        fft_timing = OperationTiming{};
+    const int parts = step2_tuning_.split;
+    for (int part = 0; part < parts; ++part) {
+        cl_mem* input = parts > 1 ? &ctx_.input_data_parts[part] : &ctx_.input_data;
+        cl_mem* output = parts > 1 ? &ctx_.input_fft_parts[part] : &ctx_.input_fft;
+        cl_event* wait = previous();
+        cl_event event_fft = nullptr;
+
+        // Converter: in-place по уже сконвертированному input_fft
+        clfftStatus fft_status = clfftEnqueueTransform(
+            ctx_.input_fft_plan,
+            CLFFT_FORWARD,
+            1,
+            &ctx_.queue,
+            wait ? 1 : 0,
+            wait,
+            &event_fft,
+            converter ? output : input,
+            converter ? nullptr : output,
+            nullptr
+        );
+        if (fft_status != CLFFT_SUCCESS || !event_fft) {
+            fail("clfftEnqueueTransform failed for input FFT: " + std::to_string(fft_status));
+        }
+        resources_.trackEvent(event_fft, "Step2 forward FFT");
+        events.push_back(event_fft);
     }
 
-    // Clean up events
-    clReleaseEvent(event_upload);
-    if (event_fft) clReleaseEvent(event_fft);
+    return events;
+}
 
-    printf("[OK] Step 2 completed!\n\n");
+void FFTHandler::apply_step2_tuning(const Step2PlanTuning& tuning) {
+    if (!ctx_.initialized) {
+        throw std::runtime_error("apply_step2_tuning: FFT handler is not initialized");
+    }
+    if (tuning.split <= 0 || num_signals_ % tuning.split != 0) {
+        throw std::runtime_error("apply_step2_tuning: split " + std::to_string(tuning.split) +
+                                 " does not divide num_signals " + std::to_string(num_signals_));
+    }
+
+    const int batch = num_signals_ / tuning.split;
+    const size_t part_data_bytes = batch * fft_size_ * sizeof(int32_t);
+    const size_t part_fft_bytes = batch * fft_size_ * sizeof(cl_float2);
+
+    // Начало sub-buffer'а должно быть кратно CL_DEVICE_MEM_BASE_ADDR_ALIGN
+    if (tuning.split > 1) {
+        cl_uint align_bits = 0;
+        clGetDeviceInfo(ctx_.device, CL_DEVICE_MEM_BASE_ADDR_ALIGN, sizeof(align_bits), &align_bits, nullptr);
+        const size_t align = std::max<size_t>(align_bits / 8, 1);
+        if (part_data_bytes % align != 0 || part_fft_bytes % align != 0) {
+            throw std::runtime_error("apply_step2_tuning: part offset is not aligned to " +
+                                     std::to_string(align) + " bytes");
+        }
+    }
+    if (tuning.path == Step2PlanTuning::Converter && !build_converter_program()) {
+        throw std::runtime_error("apply_step2_tuning: converter program is unavailable");
+    }
+
+    const Step2PlanTuning previous = step2_tuning_;
+    release_step2_plan();
+
+    try {
+        const std::string plan_name = std::string("Input FFT Plan (") + Step2PlanTuning::pathName(tuning.path) +
+                                      ", split " + std::to_string(tuning.split) + ")";
+        if (tuning.path == Step2PlanTuning::Converter) {
+            ctx_.input_fft_plan = create_fft_plan_1d_inplace(fft_size_, batch, plan_name);
+        } else {
+            ctx_.input_fft_plan = create_fft_plan_1d_with_precallback(fft_size_, batch, scale_factor_, plan_name);
+        }
+
+        for (int part = 1; tuning.split > 1 && part <= tuning.split; ++part) {
+            cl_int err = CL_SUCCESS;
+            cl_buffer_region data_region = {(part - 1) * part_data_bytes, part_data_bytes};
+            cl_mem data_part = clCreateSubBuffer(ctx_.input_data, CL_MEM_READ_WRITE,
+                                                 CL_BUFFER_CREATE_TYPE_REGION, &data_region, &err);
+            if (err != CL_SUCCESS) {
+                throw std::runtime_error("clCreateSubBuffer failed for input_data part: " + std::to_string(err));
+            }
+            ctx_.input_data_parts.push_back(data_part);
+
+            cl_buffer_region fft_region = {(part - 1) * part_fft_bytes, part_fft_bytes};
+            cl_mem fft_part = clCreateSubBuffer(ctx_.input_fft, CL_MEM_READ_WRITE,
+                                                CL_BUFFER_CREATE_TYPE_REGION, &fft_region, &err);
+            if (err != CL_SUCCESS) {
+                throw std::runtime_error("clCreateSubBuffer failed for input_fft part: " + std::to_string(err));
+            }
+            ctx_.input_fft_parts.push_back(fft_part);
+        }
+    } catch (...) {
+        // Step 2 не должен остаться без плана: вернуть предыдущую конфигурацию
+        release_step2_plan();
+        step2_tuning_ = Step2PlanTuning{};
+        if (previous.path != tuning.path || previous.split != tuning.split) {
+            apply_step2_tuning(previous);
+        }
+        throw;
+    }
+
+    step2_tuning_ = tuning;
+}
+
+Step2PlanTuning FFTHandler::autotune_step2(int iterations, std::vector<Step2TuningResult>* results) {
+    if (!ctx_.initialized) {
+        throw std::runtime_error("autotune_step2: FFT handler is not initialized");
+    }
+
+    printf("[TUNE] Step 2 autotune (N=%zu, signals=%d, %d iterations)...\n", fft_size_, num_signals_, iterations);
+    resources_.beginStep("Autotune");
+    iterations = std::max(iterations, 1);
+
+    // Содержимое input_data не важно для времени: замеряется только конвертация + FFT
+    std::vector<Step2TuningResult> measured;
+    for (Step2PlanTuning::Path path : {Step2PlanTuning::Callback, Step2PlanTuning::Converter}) {
+        for (int split : kStep2TuningSplits) {
+            if (split > num_signals_ || num_signals_ % split != 0) {
+                continue;
+            }
+            Step2PlanTuning candidate;
+            candidate.path = path;
+            candidate.split = split;
+
+            try {
+                apply_step2_tuning(candidate);
+
+                // Первый прогон — прогрев (компиляция ядер, ленивые аллокации драйвера)
+                std::vector<double> times;
+                for (int i = 0; i <= iterations; ++i) {
+                    std::vector<cl_event> events = enqueue_step2_transform(nullptr);
+                    EventTiming timing = profile_events_span(events);
+                    for (cl_event event : events) {
+                        resources_.releaseEvent(event);
+                    }
+                    if (i > 0) {
+                        times.push_back(timing.execute_ms);
+                    }
+                }
+                std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+                measured.push_back({candidate, times[times.size() / 2]});
+                printf("  [TUNE] %-9s split=%d: %.3f ms\n", Step2PlanTuning::pathName(path), split,
+                       measured.back().time_ms);
+            } catch (const std::exception& e) {
+                printf("  [TUNE] %-9s split=%d: skipped (%s)\n", Step2PlanTuning::pathName(path), split, e.what());
+            }
+        }
+    }
+
+    Step2PlanTuning best;
+    if (!measured.empty()) {
+        best = std::min_element(measured.begin(), measured.end(), [](const auto& a, const auto& b) {
+            return a.time_ms < b.time_ms;
+        })->tuning;
+    }
+    if (best.path != step2_tuning_.path || best.split != step2_tuning_.split) {
+        apply_step2_tuning(best);
+    }
+    if (results) {
+        *results = std::move(measured);
+    }
+
+    printf("[TUNE] Selected Step 2: %s, split %d\n\n", Step2PlanTuning::pathName(best.path), best.split);
+    return best;
 }
 
 // ============================================================================
-// STEP 3: Correlation (Multiply + IFFT + Post-callback)
+// STEP 1/2 (archive, checkpoint): Upload precomputed spectra
 // ============================================================================
 
-void FFTHandler::step3_correlation(
-    int num_signals,
-    int num_shifts,
-    size_t N,
-    int n_kg,
-    double& time_multiply_ms,
-    double& time_ifft_ms,
-    double& time_download_ms,
-    double& time_post_callback_ms,
-    OperationTiming& multiply_timing,
-    OperationTiming& ifft_timing,
-    OperationTiming& download_timing
+void FFTHandler::upload_spectra(
+    cl_mem target,
+    const cl_float2* host_spectra,
+    size_t count,
+    const char* label,
+    OperationTiming& upload_timing
 ) {
-    printf("[STEP 3] Computing correlation...\n");
-    printf("  Total correlations: %d × %d = %d\n", num_signals, num_shifts, num_signals * num_shifts);
-    printf("  Operation: 1. Pre-callback (Complex Multiply) → 2. IFFT → 3. Post-callback (Find Peaks) → 4. Download results\n\n");
-    
-    cl_int err = CL_SUCCESS;
-    cl_event event_copy_data = nullptr, event_ifft = nullptr, event_download = nullptr;
-    
-    // Initialize output times to 0
-    time_multiply_ms = 0.0;  // Теперь это время копирования данных в userdata (включено в IFFT время)
-    time_ifft_ms = 0.0;
-    time_download_ms = 0.0;
-    time_post_callback_ms = 0.0;
-    
-    // ========================================================================
-    // 1. PRE-CALLBACK: Подготовка данных для Complex Multiply
-    // ========================================================================
-    // Данные УЖЕ на GPU (ctx_.reference_fft из Step 1, ctx_.input_fft из Step 2)
-    // Копируем их в userdata (GPU->GPU копирование) для PRE-CALLBACK
-    // clFFT PRE-CALLBACK может читать данные только из userdata буфера
-    // PRE-CALLBACK автоматически выполнит Complex Multiply при вызове IFFT
-    
-    printf("  1. Pre-callback: Preparing data from GPU buffers (reference_fft + input_fft) for Complex Multiply...\n");
-    printf("     Note: Данные уже на GPU, выполняем быстрое GPU->GPU копирование в userdata\n");
-    
-    if (!ctx_.pre_callback_userdata_correlation) {
-        throw std::runtime_error("pre_callback_userdata_correlation not initialized");
-    }
-    
-    if (!ctx_.reference_fft || !ctx_.input_fft) {
-        throw std::runtime_error("reference_fft or input_fft buffers not initialized (call Step 1 and Step 2 first)");
+    if (!target) {
+        throw std::runtime_error(std::string(label) + ": buffer not initialized");
     }
-    
-    // Вычислить размеры и смещения
+
+    cl_event event_upload = nullptr;
+    cl_int err = clEnqueueWriteBuffer(
+        ctx_.queue,
+        target,
+        CL_FALSE,
+        0,
+        count * sizeof(cl_float2),
+        host_spectra,
+        0, nullptr,
+        &event_upload
+    );
+
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error(std::string(label) + ": failed to upload spectra");
+    }
+    resources_.trackEvent(event_upload, label);
+
+    EventTiming upload_event_timing = profile_event_detailed(event_upload);
+    upload_timing.execute_ms = upload_event_timing.execute_ms;
+    upload_timing.queue_wait_ms = upload_event_timing.queue_wait_ms;
+    upload_timing.cpu_wait_ms = upload_event_timing.wait_ms;
+    upload_timing.total_gpu_ms = upload_event_timing.total_ms;
+    printf("  [PROFILE] %s: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n", label,
+           upload_event_timing.execute_ms, upload_event_timing.queue_wait_ms, upload_event_timing.wait_ms);
+
+    resources_.releaseEvent(event_upload);
+}
+
+void FFTHandler::step1_load_reference_spectra(
+    const cl_float2* host_spectra,
+    size_t N,
+    int num_shifts,
+    OperationTiming& upload_timing
+) {
+    printf("[STEP 1] Loading %d precomputed reference spectra...\n", num_shifts);
+    resources_.beginStep("Step1");
+
+    if (N != fft_size_ || num_shifts <= 0 || num_shifts > num_shifts_) {
+        throw std::runtime_error("Spectra shape does not match reference_fft buffer");
+    }
+    upload_spectra(ctx_.reference_fft, host_spectra, num_shifts * N, "Step1 upload spectra", upload_timing);
+    printf("[OK] Step 1 (precomputed spectra) completed!\n\n");
+}
+
+// expand_reference_shifts: строка s ≥ 1 банка из строки 0 на месте,
+// R_s[k] = R_0[k]·e^{−j2πks/N}; угол по (k·s) mod N — без потери точности при больших k·s
+static const char* reference_expand_source = R"(
+__kernel void expand_reference_shifts(
+    __global float2* bank,
+    const uint N
+) {
+    const uint k = get_global_id(0);
+    const uint shift = get_global_id(1) + 1;
+    if (k >= N) return;
+
+    const uint turns = (uint)(((ulong)k * shift) % N);
+    float c;
+    const float s = sincos(-2.0f * M_PI_F * (float)turns / (float)N, &c);
+    const float2 base = bank[k];
+    bank[(size_t)shift * N + k] = (float2)(base.x * c - base.y * s, base.x * s + base.y * c);
+}
+
+// decode_reference_page: страница банка fp16 (half2 на значение) → слот кэша float2
+__kernel void decode_reference_page(
+    __global const half* page,
+    __global float2* pages,
+    const ulong slot_offset,
+    const uint count
+) {
+    const uint i = get_global_id(0);
+    if (i >= count) return;
+    pages[slot_offset + i] = vload_half2(i, page);
+}
+)";
+
+bool FFTHandler::build_reference_expand_program() {
+    if (ctx_.reference_expand_program) {
+        return true;
+    }
+
+    cl_int err = CL_SUCCESS;
+    const char* source = reference_expand_source;
+    cl_program program = resources_.createProgramWithSource(ctx_.context, 1, &source, nullptr, &err,
+                                                            "reference_expand");
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create reference expand program: %d\n", err);
+        return false;
+    }
+
+    err = clBuildProgram(program, 1, &ctx_.device, "", nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+        std::vector<char> log(log_size + 1, '\0');
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
+        fprintf(stderr, "[ERROR] Reference expand program build failed:\n%s\n", log.data());
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    cl_kernel kernel = resources_.createKernel(program, "expand_reference_shifts", &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create expand_reference_shifts kernel: %d\n", err);
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    cl_kernel decode_kernel = resources_.createKernel(program, "decode_reference_page", &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create decode_reference_page kernel: %d\n", err);
+        resources_.releaseKernel(kernel);
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    ctx_.reference_expand_program = program;
+    ctx_.reference_expand_kernel = kernel;
+    ctx_.reference_decode_kernel = decode_kernel;
+    return true;
+}
+
+void FFTHandler::step1_expand_reference_spectrum(
+    const cl_float2* base_spectrum,
+    size_t N,
+    int num_shifts,
+    OperationTiming& upload_timing,
+    OperationTiming& expand_timing
+) {
+    printf("[STEP 1] Expanding analytic reference spectrum into %d shift(s)...\n", num_shifts);
+    resources_.beginStep("Step1");
+
+    if (N != fft_size_ || num_shifts <= 0 || num_shifts > num_shifts_) {
+        throw std::runtime_error("Base spectrum shape does not match reference_fft buffer");
+    }
+
+    upload_spectra(ctx_.reference_fft, base_spectrum, N, "Step1 upload base spectrum", upload_timing);
+    expand_reference_shifts(num_shifts, expand_timing);
+    printf("[OK] Step 1 (analytic spectrum) completed!\n\n");
+}
+
+void FFTHandler::expand_reference_shifts(int num_shifts, OperationTiming& expand_timing) {
+    expand_timing = OperationTiming{};
+    if (num_shifts <= 1) {
+        return;
+    }
+    if (!build_reference_expand_program()) {
+        throw std::runtime_error("expand_reference_shifts: expand program is unavailable");
+    }
+
+    const cl_uint n_arg = static_cast<cl_uint>(fft_size_);
+    cl_int err = clSetKernelArg(ctx_.reference_expand_kernel, 0, sizeof(cl_mem), &ctx_.reference_fft);
+    err |= clSetKernelArg(ctx_.reference_expand_kernel, 1, sizeof(cl_uint), &n_arg);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to set expand_reference_shifts kernel arguments");
+    }
+
+    // Очередь in-order: kernel видит загруженную строку 0
+    size_t global[2] = {fft_size_, static_cast<size_t>(num_shifts - 1)};
+    cl_event event_expand = nullptr;
+    err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.reference_expand_kernel, 2, nullptr, global, nullptr,
+                                 0, nullptr, &event_expand);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to enqueue expand_reference_shifts kernel: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_expand, "Step1 expand shifts");
+
+    EventTiming expand_event_timing = profile_event_detailed(event_expand);
+    expand_timing.execute_ms = expand_event_timing.execute_ms;
+    expand_timing.queue_wait_ms = expand_event_timing.queue_wait_ms;
+    expand_timing.cpu_wait_ms = expand_event_timing.wait_ms;
+    expand_timing.total_gpu_ms = expand_event_timing.total_ms;
+    printf("  [PROFILE] Step1 expand shifts: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n",
+           expand_event_timing.execute_ms, expand_event_timing.queue_wait_ms, expand_event_timing.wait_ms);
+    resources_.releaseEvent(event_expand);
+}
+
+// ============================================================================
+// Страничный банк опорных: кэш страниц на устройстве
+// ============================================================================
+//
+// Страница — банк одного опорного [num_shifts][N]. Подкачка идёт по
+// transfer_queue: memcpy в отображённый staging (pinned), асинхронная запись
+// в слот, для fp16 — декодирование в float2 там же. Step 3 остаётся на
+// ctx_.queue: activate копирует слот в reference_fft, дождавшись события
+// подкачки, поэтому передача следующей страницы идёт параллельно Step 3
+// текущей. Два staging-буфера: memcpy следующей страницы не ждёт передачу
+// предыдущей.
+
+void FFTHandler::configure_reference_cache(int slots, bool half_precision) {
+    if (!ctx_.initialized || !ctx_.reference_fft) {
+        throw std::runtime_error("configure_reference_cache: FFTHandler is not initialized");
+    }
+    if (slots <= 0) {
+        throw std::runtime_error("configure_reference_cache: slots must be positive");
+    }
+
+    release_reference_cache();
+    resources_.beginStep("ReferenceCache");
+    if (half_precision && !build_reference_expand_program()) {
+        throw std::runtime_error("configure_reference_cache: decode program is unavailable");
+    }
+
+    const size_t values = static_cast<size_t>(num_shifts_) * fft_size_;
+    const size_t page_bytes = values * sizeof(cl_float2);
+    const size_t host_page_bytes = half_precision ? values * 2 * sizeof(cl_half) : page_bytes;
+
+    cl_int err = CL_SUCCESS;
+    ctx_.transfer_queue = clCreateCommandQueue(ctx_.context, ctx_.device, CL_QUEUE_PROFILING_ENABLE, &err);
+    if (err != CL_SUCCESS) {
+        ctx_.transfer_queue = nullptr;
+        throw std::runtime_error("configure_reference_cache: failed to create transfer queue: " + std::to_string(err));
+    }
+
+    ensure_buffer_size(ctx_.reference_pages, static_cast<size_t>(slots) * page_bytes, CL_MEM_READ_WRITE,
+                       "reference_pages");
+    if (half_precision) {
+        ensure_buffer_size(ctx_.reference_page_half, host_page_bytes, CL_MEM_READ_ONLY, "reference_page_half");
+    }
+    for (int i = 0; i < 2; ++i) {
+        ensure_buffer_size(ctx_.reference_page_staging[i], host_page_bytes,
+                           CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, "reference_page_staging");
+        ctx_.reference_page_staging_ptr[i] = clEnqueueMapBuffer(ctx_.transfer_queue, ctx_.reference_page_staging[i],
+                                                                CL_TRUE, CL_MAP_WRITE, 0, host_page_bytes,
+                                                                0, nullptr, nullptr, &err);
+        if (err != CL_SUCCESS) {
+            ctx_.reference_page_staging_ptr[i] = nullptr;
+            throw std::runtime_error("configure_reference_cache: failed to map staging buffer: " + std::to_string(err));
+        }
+    }
+
+    reference_slot_ready_.assign(static_cast<size_t>(slots), nullptr);
+    reference_cache_slots_ = slots;
+    reference_cache_half_ = half_precision;
+    reference_staging_next_ = 0;
+    printf("[OK] Reference cache: %d slot(s) × %.2f MB on device, host pages %s\n", slots,
+           static_cast<double>(page_bytes) / (1024.0 * 1024.0), half_precision ? "f16" : "f32");
+}
+
+void FFTHandler::page_in_reference(int slot, const void* host_page, OperationTiming& staging_timing) {
+    if (slot < 0 || slot >= reference_cache_slots_ || !host_page) {
+        throw std::runtime_error("page_in_reference: invalid slot or page");
+    }
+
+    const size_t values = static_cast<size_t>(num_shifts_) * fft_size_;
+    const size_t host_page_bytes = reference_cache_half_ ? values * 2 * sizeof(cl_half) : values * sizeof(cl_float2);
+    const int staging = reference_staging_next_;
+    reference_staging_next_ ^= 1;
+    staging_timing = OperationTiming{};
+
+    // Staging свободен, когда завершилась его предыдущая передача
+    const auto wait_start = std::chrono::steady_clock::now();
+    cl_int err = CL_SUCCESS;
+    if (reference_staging_events_[staging]) {
+        err = clWaitForEvents(1, &reference_staging_events_[staging]);
+        resources_.releaseEvent(reference_staging_events_[staging]);
+        reference_staging_events_[staging] = nullptr;
+        if (err != CL_SUCCESS) {
+            throw std::runtime_error("page_in_reference: previous transfer failed: " + std::to_string(err));
+        }
+    }
+    const auto copy_start = std::chrono::steady_clock::now();
+    std::memcpy(ctx_.reference_page_staging_ptr[staging], host_page, host_page_bytes);
+    const auto copy_end = std::chrono::steady_clock::now();
+    staging_timing.cpu_wait_ms = std::chrono::duration<double, std::milli>(copy_start - wait_start).count();
+    staging_timing.execute_ms = std::chrono::duration<double, std::milli>(copy_end - copy_start).count();
+
+    // Слот читается только activate (с ожиданием на хосте), поэтому запись в
+    // него не ждёт ctx_.queue; fp16 проходит через общий half-буфер — очередь
+    // in-order, следующая запись в него идёт после декодирования
+    cl_mem target = reference_cache_half_ ? ctx_.reference_page_half : ctx_.reference_pages;
+    const size_t offset = reference_cache_half_ ? 0 : static_cast<size_t>(slot) * values * sizeof(cl_float2);
+    cl_event event_write = nullptr;
+    err = clEnqueueWriteBuffer(ctx_.transfer_queue, target, CL_FALSE, offset, host_page_bytes,
+                               ctx_.reference_page_staging_ptr[staging], 0, nullptr, &event_write);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("page_in_reference: failed to enqueue page write: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_write, "Reference page-in");
+    reference_staging_events_[staging] = event_write;
+
+    cl_event event_ready = nullptr;
+    if (reference_cache_half_) {
+        const cl_ulong slot_offset = static_cast<cl_ulong>(slot) * values;
+        const cl_uint count = static_cast<cl_uint>(values);
+        err = clSetKernelArg(ctx_.reference_decode_kernel, 0, sizeof(cl_mem), &ctx_.reference_page_half);
+        err |= clSetKernelArg(ctx_.reference_decode_kernel, 1, sizeof(cl_mem), &ctx_.reference_pages);
+        err |= clSetKernelArg(ctx_.reference_decode_kernel, 2, sizeof(cl_ulong), &slot_offset);
+        err |= clSetKernelArg(ctx_.reference_decode_kernel, 3, sizeof(cl_uint), &count);
+        if (err != CL_SUCCESS) {
+            throw std::runtime_error("Failed to set decode_reference_page kernel arguments");
+        }
+        size_t global_size = values;
+        err = clEnqueueNDRangeKernel(ctx_.transfer_queue, ctx_.reference_decode_kernel, 1, nullptr, &global_size,
+                                     nullptr, 0, nullptr, &event_ready);
+    } else {
+        err = clEnqueueMarkerWithWaitList(ctx_.transfer_queue, 0, nullptr, &event_ready);
+    }
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("page_in_reference: failed to enqueue page completion: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_ready, "Reference page ready");
+
+    if (reference_slot_ready_[slot]) {
+        resources_.releaseEvent(reference_slot_ready_[slot]);
+    }
+    reference_slot_ready_[slot] = event_ready;
+    clFlush(ctx_.transfer_queue);
+}
+
+void FFTHandler::activate_reference_page(int slot, OperationTiming& activate_timing) {
+    if (slot < 0 || slot >= reference_cache_slots_) {
+        throw std::runtime_error("activate_reference_page: invalid slot");
+    }
+    resources_.beginStep("Step1");
+
+    const size_t page_bytes = static_cast<size_t>(num_shifts_) * fft_size_ * sizeof(cl_float2);
+    cl_event ready = reference_slot_ready_[slot];
+    cl_event event_copy = nullptr;
+    cl_int err = clEnqueueCopyBuffer(ctx_.queue, ctx_.reference_pages, ctx_.reference_fft,
+                                     static_cast<size_t>(slot) * page_bytes, 0, page_bytes,
+                                     ready ? 1 : 0, ready ? &ready : nullptr, &event_copy);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("activate_reference_page: failed to enqueue slot copy: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_copy, "Reference page activate");
+
+    // Ожидание на хосте: после него слот можно перезаписывать без зависимости от ctx_.queue
+    EventTiming copy_event_timing = profile_event_detailed(event_copy);
+    activate_timing.execute_ms = copy_event_timing.execute_ms;
+    activate_timing.queue_wait_ms = copy_event_timing.queue_wait_ms;
+    activate_timing.cpu_wait_ms = copy_event_timing.wait_ms;
+    activate_timing.total_gpu_ms = copy_event_timing.total_ms;
+    resources_.releaseEvent(event_copy);
+
+    if (ready) {
+        resources_.releaseEvent(ready);
+        reference_slot_ready_[slot] = nullptr;
+    }
+}
+
+void FFTHandler::release_reference_cache() {
+    if (ctx_.transfer_queue) {
+        clFinish(ctx_.transfer_queue);
+    }
+    for (cl_event& event : reference_staging_events_) {
+        if (event) {
+            resources_.releaseEvent(event);
+            event = nullptr;
+        }
+    }
+    for (cl_event& event : reference_slot_ready_) {
+        if (event) {
+            resources_.releaseEvent(event);
+            event = nullptr;
+        }
+    }
+    reference_slot_ready_.clear();
+
+    for (int i = 0; i < 2; ++i) {
+        if (ctx_.reference_page_staging_ptr[i] && ctx_.transfer_queue) {
+            clEnqueueUnmapMemObject(ctx_.transfer_queue, ctx_.reference_page_staging[i],
+                                    ctx_.reference_page_staging_ptr[i], 0, nullptr, nullptr);
+        }
+        ctx_.reference_page_staging_ptr[i] = nullptr;
+    }
+    if (ctx_.transfer_queue) {
+        clFinish(ctx_.transfer_queue);
+    }
+    cl_mem* buffers[] = {&ctx_.reference_pages, &ctx_.reference_page_half,
+                         &ctx_.reference_page_staging[0], &ctx_.reference_page_staging[1]};
+    for (cl_mem* buffer : buffers) {
+        if (*buffer) {
+            resources_.releaseMemObject(*buffer);
+            *buffer = nullptr;
+        }
+    }
+    if (ctx_.transfer_queue) {
+        clReleaseCommandQueue(ctx_.transfer_queue);
+        ctx_.transfer_queue = nullptr;
+    }
+    reference_cache_slots_ = 0;
+    reference_cache_half_ = false;
+    reference_staging_next_ = 0;
+}
+
+void FFTHandler::step2_load_input_spectra(
+    const cl_float2* host_spectra,
+    size_t N,
+    int num_signals,
+    OperationTiming& upload_timing
+) {
+    printf("[STEP 2] Loading %d precomputed input spectra...\n", num_signals);
+    resources_.beginStep("Step2");
+
+    if (N != fft_size_ || num_signals <= 0 || num_signals > num_signals_) {
+        throw std::runtime_error("Spectra shape does not match input_fft buffer");
+    }
+    upload_spectra(ctx_.input_fft, host_spectra, num_signals * N, "Step2 upload spectra", upload_timing);
+    fused_input_pending_ = false;  // Step 3 идёт по загруженным спектрам (путь clFFT)
+    printf("[OK] Step 2 (precomputed spectra) completed!\n\n");
+}
+
+// ============================================================================
+// STEP 2b: Frequency-domain beamforming (channels → beams)
+// ============================================================================
+
+// Один work-item = (бин k, луч b). Соседние k читают соседние адреса спектров
+// и весов (раскладка [channels][beams][N]), спектр канала переиспользуется
+// всеми лучами через кэш. Строки b ≥ num_beams заполняются нулями.
+static const char* beamform_source = R"(
+__kernel void form_beams(
+    __global const float2* spectra,
+    __global const float2* weights,
+    __global float2* beams,
+    const uint fft_size,
+    const uint channels,
+    const uint num_beams
+) {
+    const uint k = get_global_id(0);
+    const uint b = get_global_id(1);
+    if (k >= fft_size) return;
+
+    float2 acc = (float2)(0.0f, 0.0f);
+    if (b < num_beams) {
+        const size_t weight_stride = (size_t)num_beams * fft_size;
+        __global const float2* w = weights + (size_t)b * fft_size + k;
+        for (uint c = 0; c < channels; ++c) {
+            const float2 x = spectra[(size_t)c * fft_size + k];
+            const float2 wc = w[c * weight_stride];
+            acc += (float2)(wc.x * x.x - wc.y * x.y, wc.x * x.y + wc.y * x.x);
+        }
+    }
+    beams[(size_t)b * fft_size + k] = acc;
+}
+)";
+
+bool FFTHandler::build_beamform_program() {
+    if (ctx_.beamform_program) {
+        return true;
+    }
+
+    cl_int err = CL_SUCCESS;
+    const char* source = beamform_source;
+    cl_program program = resources_.createProgramWithSource(ctx_.context, 1, &source, nullptr, &err, "beamform");
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create beamform program: %d\n", err);
+        return false;
+    }
+
+    err = clBuildProgram(program, 1, &ctx_.device, "", nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+        std::vector<char> log(log_size + 1, '\0');
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
+        fprintf(stderr, "[ERROR] Beamform program build failed:\n%s\n", log.data());
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    cl_kernel kernel = resources_.createKernel(program, "form_beams", &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create beamform kernel: %d\n", err);
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    ctx_.beamform_program = program;
+    ctx_.beamform_kernel = kernel;
+    return true;
+}
+
+void FFTHandler::set_beam_weights(const cl_float2* weights, int channels, int beams) {
+    if (!ctx_.initialized) {
+        throw std::runtime_error("set_beam_weights: FFT handler is not initialized");
+    }
+    if (channels != num_signals_ || beams <= 0 || beams > num_signals_) {
+        throw std::runtime_error("set_beam_weights: expected " + std::to_string(num_signals_) +
+                                 " channels and 1.." + std::to_string(num_signals_) + " beams");
+    }
+    if (!build_beamform_program()) {
+        throw std::runtime_error("set_beam_weights: beamform program is unavailable");
+    }
+
+    cl_int err = CL_SUCCESS;
+    const size_t weights_bytes = static_cast<size_t>(channels) * beams * fft_size_ * sizeof(cl_float2);
+    size_t current_bytes = 0;
+    if (ctx_.beam_weights) {
+        clGetMemObjectInfo(ctx_.beam_weights, CL_MEM_SIZE, sizeof(current_bytes), &current_bytes, nullptr);
+    }
+    if (current_bytes != weights_bytes) {
+        if (ctx_.beam_weights) {
+            resources_.releaseMemObject(ctx_.beam_weights);
+            ctx_.beam_weights = nullptr;
+        }
+        ctx_.beam_weights = resources_.createBuffer(ctx_.context, CL_MEM_READ_ONLY, weights_bytes, nullptr, &err,
+                                                    "beam_weights");
+        if (err != CL_SUCCESS) throw std::runtime_error("Failed to allocate beam_weights buffer");
+    }
+    if (!ctx_.beam_fft) {
+        ctx_.beam_fft = resources_.createBuffer(ctx_.context, CL_MEM_READ_WRITE,
+                                                num_signals_ * fft_size_ * sizeof(cl_float2), nullptr, &err,
+                                                "beam_fft");
+        if (err != CL_SUCCESS) throw std::runtime_error("Failed to allocate beam_fft buffer");
+    }
+
+    err = clEnqueueWriteBuffer(ctx_.queue, ctx_.beam_weights, CL_TRUE, 0, weights_bytes, weights, 0, nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to upload beam weights");
+    }
+
+    beam_channels_ = channels;
+    beam_count_ = beams;
+    printf("[FFT] Beam weights loaded: %d channels -> %d beams (%.2f MB)\n",
+           channels, beams, weights_bytes / (1024.0 * 1024.0));
+}
+
+void FFTHandler::step2_form_beams(OperationTiming& beam_timing) {
+    printf("[STEP 2b] Forming %d beams from %d channels...\n", beam_count_, beam_channels_);
+    resources_.beginStep("Step2");
+
+    if (beam_count_ == 0 || !ctx_.beamform_kernel) {
+        throw std::runtime_error("step2_form_beams: beam weights are not set");
+    }
+
+    // Лучи строятся из спектров каналов: слитый путь отложил их — досчитать
+    // (pipeline делает это раньше и учитывает время в Step 2)
+    OperationTiming deferred_fft;
+    materialize_input_spectra(deferred_fft);
+
+    const cl_uint fft_size = static_cast<cl_uint>(fft_size_);
+    const cl_uint channels = static_cast<cl_uint>(beam_channels_);
+    const cl_uint beams = static_cast<cl_uint>(beam_count_);
+    cl_int err = clSetKernelArg(ctx_.beamform_kernel, 0, sizeof(cl_mem), &ctx_.input_fft);
+    err |= clSetKernelArg(ctx_.beamform_kernel, 1, sizeof(cl_mem), &ctx_.beam_weights);
+    err |= clSetKernelArg(ctx_.beamform_kernel, 2, sizeof(cl_mem), &ctx_.beam_fft);
+    err |= clSetKernelArg(ctx_.beamform_kernel, 3, sizeof(cl_uint), &fft_size);
+    err |= clSetKernelArg(ctx_.beamform_kernel, 4, sizeof(cl_uint), &channels);
+    err |= clSetKernelArg(ctx_.beamform_kernel, 5, sizeof(cl_uint), &beams);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to set beamform kernel arguments");
+    }
+
+    // Все строки input_fft (лучи + нули), чтобы Step 3 не видел спектры каналов
+    std::vector<cl_event> events(2, nullptr);
+    size_t global_size[2] = {fft_size_, static_cast<size_t>(num_signals_)};
+    err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.beamform_kernel, 2, nullptr, global_size, nullptr,
+                                 0, nullptr, &events[0]);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to enqueue beamform kernel: " + std::to_string(err));
+    }
+    resources_.trackEvent(events[0], "Step2 beamform");
+
+    err = clEnqueueCopyBuffer(ctx_.queue, ctx_.beam_fft, ctx_.input_fft, 0, 0,
+                              num_signals_ * fft_size_ * sizeof(cl_float2), 1, &events[0], &events[1]);
+    if (err != CL_SUCCESS) {
+        resources_.releaseEvent(events[0]);
+        throw std::runtime_error("Failed to copy beam spectra to input_fft: " + std::to_string(err));
+    }
+    resources_.trackEvent(events[1], "Step2 copy beams");
+
+    EventTiming timing = profile_events_span(events);
+    beam_timing.execute_ms = timing.execute_ms;
+    beam_timing.queue_wait_ms = timing.queue_wait_ms;
+    beam_timing.cpu_wait_ms = timing.wait_ms;
+    beam_timing.total_gpu_ms = timing.total_ms;
+    printf("  [PROFILE] Beamform + copy: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n",
+           timing.execute_ms, timing.queue_wait_ms, timing.wait_ms);
+
+    for (cl_event event : events) {
+        resources_.releaseEvent(event);
+    }
+    printf("[OK] Step 2b completed!\n\n");
+}
+
+// ============================================================================
+// STEP 2+3: Fused correlation (local-memory Stockham FFT, N ≤ 4096)
+// ============================================================================
+
+// Одна work-group = один входной сигнал. Radix-2 Stockham (autosort) в одном
+// локальном буфере: на каждой стадии work-item читает свои пары в регистры,
+// barrier, пишет результаты бабочек, barrier. Спектр входа после прямого FFT
+// хранится в регистрах (бин lid + i·WG_SIZE) и переиспользуется всеми сдвигами;
+// спектры опорного читаются из global (shifts × N не помещаются в constant).
+// Результат совпадает с цепочкой clFFT: ref·conj(inp), IFFT с масштабом 1/N,
+// модуль первых n_kg отсчётов. FFT_N и WG_SIZE задаются при сборке.
+static const char* fused_correlation_source = R"(
+#define HALF_N (FFT_N / 2)
+#define PAIRS (HALF_N / WG_SIZE)
+#define BINS (FFT_N / WG_SIZE)
+
+// sign = -1: прямой FFT, +1: обратный (без масштаба)
+void stockham_fft(__local float2* buf, const float sign, const uint lid) {
+    for (uint ns = 1; ns < FFT_N; ns <<= 1) {
+        float2 a[PAIRS], b[PAIRS];
+        for (uint p = 0; p < PAIRS; ++p) {
+            const uint j = lid + p * WG_SIZE;
+            a[p] = buf[j];
+            b[p] = buf[j + HALF_N];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (uint p = 0; p < PAIRS; ++p) {
+            const uint j = lid + p * WG_SIZE;
+            const uint k = j & (ns - 1);
+            const float phase = sign * (float)k / (float)ns;   // угол / π
+            const float c = cospi(phase);
+            const float s = sinpi(phase);
+            const float2 t = (float2)(b[p].x * c - b[p].y * s, b[p].x * s + b[p].y * c);
+            const uint out = ((j - k) << 1) + k;
+            buf[out] = a[p] + t;
+            buf[out + ns] = a[p] - t;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+__kernel __attribute__((reqd_work_group_size(WG_SIZE, 1, 1)))
+void fused_correlation(
+    __global const int* inputs,             // [num_signals][FFT_N]
+    __global const float2* reference_fft,   // [num_shifts][FFT_N], после Step 1 (сопряжённые)
+    __global float* peaks,                  // post_callback_userdata
+    const uint peaks_offset,                // Пики после PostCallbackParams (в float)
+    const uint num_shifts,
+    const uint n_kg,
+    const float scale
+) {
+    __local float2 buf[FFT_N];
+    const uint signal = get_group_id(0);
+    const uint lid = get_local_id(0);
+
+    // Step 2: int32 → float2 и прямой FFT
+    __global const int* x = inputs + (size_t)signal * FFT_N;
+    for (uint i = 0; i < BINS; ++i) {
+        const uint n = lid + i * WG_SIZE;
+        buf[n] = (float2)((float)x[n] * scale, 0.0f);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    stockham_fft(buf, -1.0f, lid);
+
+    float2 spectrum[BINS];
+    for (uint i = 0; i < BINS; ++i) {
+        spectrum[i] = buf[lid + i * WG_SIZE];
+    }
+
+    // Step 3 по сдвигам: work-item пишет те же бины, что прочитал, — barrier не нужен
+    __global float* out = peaks + peaks_offset + (size_t)signal * num_shifts * n_kg;
+    for (uint shift = 0; shift < num_shifts; ++shift) {
+        __global const float2* ref = reference_fft + (size_t)shift * FFT_N;
+        for (uint i = 0; i < BINS; ++i) {
+            const uint k = lid + i * WG_SIZE;
+            const float2 r = ref[k];
+            const float2 v = spectrum[i];
+            buf[k] = (float2)(r.x * v.x + r.y * v.y, r.y * v.x - r.x * v.y);   // ref · conj(inp)
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        stockham_fft(buf, 1.0f, lid);
+
+        for (uint k = lid; k < n_kg; k += WG_SIZE) {
+            out[shift * n_kg + k] = length(buf[k]) * (1.0f / FFT_N);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+)";
+
+static constexpr size_t kFusedMinFFTSize = 16;
+static constexpr size_t kFusedMaxFFTSize = 4096;
+static constexpr size_t kFusedMaxWorkGroup = 256;
+
+bool FFTHandler::build_fused_program() {
+    if (ctx_.fused_program) {
+        return true;
+    }
+
+    cl_int err = CL_SUCCESS;
+    const char* source = fused_correlation_source;
+    cl_program program = resources_.createProgramWithSource(ctx_.context, 1, &source, nullptr, &err, "fused_correlation");
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create fused correlation program: %d\n", err);
+        return false;
+    }
+
+    const std::string options = "-D FFT_N=" + std::to_string(fft_size_) +
+                                " -D WG_SIZE=" + std::to_string(fused_work_group_);
+    err = clBuildProgram(program, 1, &ctx_.device, options.c_str(), nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+        std::vector<char> log(log_size + 1, '\0');
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
+        fprintf(stderr, "[ERROR] Fused correlation program build failed:\n%s\n", log.data());
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    cl_kernel kernel = resources_.createKernel(program, "fused_correlation", &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create fused correlation kernel: %d\n", err);
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    ctx_.fused_program = program;
+    ctx_.fused_kernel = kernel;
+    return true;
+}
+
+bool FFTHandler::enable_fused_correlation() {
+    if (!ctx_.initialized) {
+        return false;
+    }
+    if (fused_enabled_) {
+        return true;
+    }
+
+    const size_t n = fft_size_;
+    if (n < kFusedMinFFTSize || n > kFusedMaxFFTSize || (n & (n - 1)) != 0) {
+        printf("[FUSED] N=%zu is not a power of two in [%zu, %zu], using clFFT path\n",
+               n, kFusedMinFFTSize, kFusedMaxFFTSize);
+        return false;
+    }
+
+    cl_ulong local_mem = 0;
+    size_t max_work_group = 0;
+    clGetDeviceInfo(ctx_.device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(local_mem), &local_mem, nullptr);
+    clGetDeviceInfo(ctx_.device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(max_work_group), &max_work_group, nullptr);
+    if (local_mem < n * sizeof(cl_float2)) {
+        printf("[FUSED] Local memory %llu B < %zu B for N=%zu, using clFFT path\n",
+               static_cast<unsigned long long>(local_mem), n * sizeof(cl_float2), n);
+        return false;
+    }
+
+    // Степень двойки: не больше N/2 пар бабочек и лимита устройства
+    size_t work_group = std::min(n / 2, kFusedMaxWorkGroup);
+    while (work_group > max_work_group && work_group > 1) {
+        work_group /= 2;
+    }
+    fused_work_group_ = work_group;
+
+    auto build_start = InitClock::now();
+    if (!build_fused_program()) {
+        return false;
+    }
+    record_init_phase("Fused correlation program", build_start);
+
+    fused_enabled_ = true;
+    printf("[FUSED] Step 2+3 fused: N=%zu, work-group %zu, %zu B local memory\n",
+           n, work_group, n * sizeof(cl_float2));
+    return true;
+}
+
+void FFTHandler::disable_fused_correlation() {
+    if (!fused_enabled_) {
+        return;
+    }
+    OperationTiming deferred_fft;
+    materialize_input_spectra(deferred_fft);
+    fused_enabled_ = false;
+    printf("[FUSED] Step 2+3 fused path disabled, using clFFT path\n");
+}
+
+bool FFTHandler::materialize_input_spectra(OperationTiming& fft_timing) {
+    if (!fused_input_pending_) {
+        return false;
+    }
+    std::vector<cl_event> events = enqueue_step2_transform(nullptr);
+    cl_int err = events.empty() ? CL_SUCCESS : clWaitForEvents(static_cast<cl_uint>(events.size()), events.data());
+    if (err == CL_SUCCESS) {
+        EventTiming timing = profile_events_span(events);
+        fft_timing.execute_ms = timing.execute_ms;
+        fft_timing.queue_wait_ms = timing.queue_wait_ms;
+        fft_timing.cpu_wait_ms = timing.wait_ms;
+        fft_timing.total_gpu_ms = timing.total_ms;
+        printf("  [PROFILE] Deferred input FFT: execute=%.3f ms, queue_wait=%.3f ms\n",
+               timing.execute_ms, timing.queue_wait_ms);
+    }
+    for (cl_event event : events) {
+        resources_.releaseEvent(event);
+    }
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to compute deferred input spectra: " + std::to_string(err));
+    }
+    fused_input_pending_ = false;
+    return true;
+}
+
+void FFTHandler::step3_fused_correlation(
+    int num_signals,
+    int num_shifts,
+    int n_kg,
+    OperationTiming& kernel_timing,
+    OperationTiming& download_timing
+) {
+    printf("  Fused kernel: %d work-groups × %zu items (FFT → multiply × %d → IFFT → peaks)\n",
+           num_signals, fused_work_group_, num_shifts);
+
+    // Пики в post_callback_userdata после PostCallbackParams (см. get_correlation_results)
+    const cl_uint peaks_offset = 6;
+    const cl_uint shifts = static_cast<cl_uint>(num_shifts);
+    const cl_uint points = static_cast<cl_uint>(n_kg);
+    cl_int err = clSetKernelArg(ctx_.fused_kernel, 0, sizeof(cl_mem), &ctx_.input_data);
+    err |= clSetKernelArg(ctx_.fused_kernel, 1, sizeof(cl_mem), &ctx_.reference_fft);
+    err |= clSetKernelArg(ctx_.fused_kernel, 2, sizeof(cl_mem), &ctx_.post_callback_userdata);
+    err |= clSetKernelArg(ctx_.fused_kernel, 3, sizeof(cl_uint), &peaks_offset);
+    err |= clSetKernelArg(ctx_.fused_kernel, 4, sizeof(cl_uint), &shifts);
+    err |= clSetKernelArg(ctx_.fused_kernel, 5, sizeof(cl_uint), &points);
+    err |= clSetKernelArg(ctx_.fused_kernel, 6, sizeof(float), &scale_factor_);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to set fused correlation kernel arguments");
+    }
+
+    cl_event event_kernel = nullptr;
+    size_t global_size = static_cast<size_t>(num_signals) * fused_work_group_;
+    size_t local_size = fused_work_group_;
+    err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.fused_kernel, 1, nullptr, &global_size, &local_size,
+                                 0, nullptr, &event_kernel);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to enqueue fused correlation kernel: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_kernel, "Step3 fused");
+
+    EventTiming timing = profile_event_detailed(event_kernel);
+    kernel_timing.execute_ms = timing.execute_ms;
+    kernel_timing.queue_wait_ms = timing.queue_wait_ms;
+    kernel_timing.cpu_wait_ms = timing.wait_ms;
+    kernel_timing.total_gpu_ms = timing.total_ms;
+    printf("  [PROFILE] Fused correlation: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n",
+           timing.execute_ms, timing.queue_wait_ms, timing.wait_ms);
+    resources_.releaseEvent(event_kernel);
+
+    // Пики читаются по запросу (get_correlation_results); кодирование — как в обычном Step 3
+    download_timing = OperationTiming{};
+    if (peaks_encoding_.encoding != Correlator::PeaksEncoding::Float32 &&
+        !encode_correlation_results(peaks_encoding_, num_signals, num_shifts, n_kg, encoded_result_, download_timing)) {
+        throw std::runtime_error("Failed to encode correlation results");
+    }
+}
+
+// ============================================================================
+// STEP 3: Correlation (Multiply + IFFT + Post-callback)
+// ============================================================================
+
+void FFTHandler::step3_correlation(
+    int num_signals,
+    int num_shifts,
+    size_t N,
+    int n_kg,
+    double& time_multiply_ms,
+    double& time_ifft_ms,
+    double& time_download_ms,
+    double& time_post_callback_ms,
+    OperationTiming& multiply_timing,
+    OperationTiming& ifft_timing,
+    OperationTiming& download_timing
+) {
+    printf("[STEP 3] Computing correlation...\n");
+    resources_.beginStep("Step3");
+    
+    if (fused_input_pending_) {
+        time_multiply_ms = 0.0;
+        time_post_callback_ms = 0.0;
+        multiply_timing = OperationTiming{};
+        step3_fused_correlation(num_signals, num_shifts, n_kg, ifft_timing, download_timing);
+        step3_signals_ = num_signals;
+        time_ifft_ms = ifft_timing.execute_ms;
+        time_download_ms = download_timing.execute_ms;
+        printf("[OK] Step 3 completed (fused)!\n\n");
+        return;
+    }
+    printf("  Total correlations: %d × %d = %d\n", num_signals, num_shifts, num_signals * num_shifts);
+    printf("  Operation: 1. Pre-callback (Complex Multiply) → 2. IFFT → 3. Post-callback (Find Peaks) → 4. Download results\n\n");
+    
+    cl_int err = CL_SUCCESS;
+    cl_event event_copy_data = nullptr, event_ifft = nullptr;
+    
+    // Initialize output times to 0
+    time_multiply_ms = 0.0;  // Теперь это время копирования данных в userdata (включено в IFFT время)
+    time_ifft_ms = 0.0;
+    time_download_ms = 0.0;
+    time_post_callback_ms = 0.0;
+    
+    // ========================================================================
+    // 1. PRE-CALLBACK: Подготовка данных для Complex Multiply
+    // ========================================================================
+    // Данные УЖЕ на GPU (ctx_.reference_fft из Step 1, ctx_.input_fft из Step 2)
+    // Копируем их в userdata (GPU->GPU копирование) для PRE-CALLBACK
+    // clFFT PRE-CALLBACK может читать данные только из userdata буфера
+    // PRE-CALLBACK автоматически выполнит Complex Multiply при вызове IFFT
+    
+    printf("  1. Pre-callback: Preparing data from GPU buffers (reference_fft + input_fft) for Complex Multiply...\n");
+    printf("     Note: Данные уже на GPU, выполняем быстрое GPU->GPU копирование в userdata\n");
+    
+    if (!ctx_.pre_callback_userdata_correlation) {
+        throw std::runtime_error("pre_callback_userdata_correlation not initialized");
+    }
+    
+    if (!ctx_.reference_fft || !ctx_.input_fft) {
+        throw std::runtime_error("reference_fft or input_fft buffers not initialized (call Step 1 and Step 2 first)");
+    }
+    
+    // Вычислить размеры и смещения
     // Используем тот же тип структуры, что и в create_fft_plan_1d_with_pre_and_post_callback
     struct ComplexMultiplyParams {
         cl_uint num_signals;
@@ -1311,196 +2691,1527 @@ void FFTHandler::step3_correlation(
         cl_uint fft_size;
         cl_uint padding;
     };
-    size_t params_size = sizeof(ComplexMultiplyParams);
-    size_t reference_size = num_shifts * N * sizeof(cl_float2);
-    size_t input_size = num_signals * N * sizeof(cl_float2);
-    
-    // Копировать reference_fft (уже на GPU из Step 1) в userdata (после параметров)
-    cl_event event_copy_ref = nullptr;
-    err = clEnqueueCopyBuffer(
-        ctx_.queue,                              // command_queue
-        ctx_.reference_fft,                      // src_buffer
-        ctx_.pre_callback_userdata_correlation,  // dst_buffer
-        0,                                       // src_offset
-        params_size,                             // dst_offset (после параметров)
-        reference_size,                          // size
-        0,                                       // num_events_in_wait_list
-        nullptr,                                 // event_wait_list
-        &event_copy_ref                          // event
-    );
+    size_t params_size = sizeof(ComplexMultiplyParams);
+    size_t reference_size = num_shifts * N * sizeof(cl_float2);
+    size_t input_size = num_signals * N * sizeof(cl_float2);
+    
+    // Копировать reference_fft (уже на GPU из Step 1) в userdata (после параметров)
+    cl_event event_copy_ref = nullptr;
+    err = clEnqueueCopyBuffer(
+        ctx_.queue,                              // command_queue
+        ctx_.reference_fft,                      // src_buffer
+        ctx_.pre_callback_userdata_correlation,  // dst_buffer
+        0,                                       // src_offset
+        params_size,                             // dst_offset (после параметров)
+        reference_size,                          // size
+        0,                                       // num_events_in_wait_list
+        nullptr,                                 // event_wait_list
+        &event_copy_ref                          // event
+    );
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to copy reference_fft to userdata");
+    }
+    resources_.trackEvent(event_copy_ref, "Step3 copy reference_fft");
+    
+    // Копировать input_fft (уже на GPU из Step 2) в userdata (после reference_fft)
+    err = clEnqueueCopyBuffer(
+        ctx_.queue,                              // command_queue
+        ctx_.input_fft,                          // src_buffer (уже на GPU)
+        ctx_.pre_callback_userdata_correlation,  // dst_buffer (userdata для PRE-CALLBACK)
+        0,                                       // src_offset
+        params_size + reference_size,            // dst_offset (после параметров + reference_fft)
+        input_size,                              // size
+        1,                                       // num_events_in_wait_list
+        &event_copy_ref,                         // event_wait_list (ждать копирования reference_fft)
+        &event_copy_data                         // event
+    );
+    if (err != CL_SUCCESS) {
+        resources_.releaseEvent(event_copy_ref);
+        throw std::runtime_error("Failed to copy input_fft to userdata");
+    }
+    resources_.trackEvent(event_copy_data, "Step3 copy input_fft");
+    
+    // Measure copy time (detailed) - это GPU->GPU копирование, очень быстрое
+    EventTiming copy_event_timing = profile_event_detailed(event_copy_data);
+    time_multiply_ms = copy_event_timing.execute_ms;  // Время GPU->GPU копирования
+    multiply_timing.execute_ms = copy_event_timing.execute_ms;
+    multiply_timing.queue_wait_ms = copy_event_timing.queue_wait_ms;
+    multiply_timing.cpu_wait_ms = copy_event_timing.wait_ms;
+    multiply_timing.total_gpu_ms = copy_event_timing.total_ms;
+    printf("  [PROFILE] GPU->GPU copy to userdata: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n", 
+           copy_event_timing.execute_ms, copy_event_timing.queue_wait_ms, copy_event_timing.wait_ms);
+    
+    resources_.releaseEvent(event_copy_ref);
+    
+    printf("  [OK] Data prepared in userdata (PRE-CALLBACK will perform Complex Multiply during IFFT)\n");
+    
+    // ========================================================================
+    // 2. EXECUTE INVERSE FFT (PRE-CALLBACK и POST-CALLBACK встроены в план)
+    // ========================================================================
+    
+    printf("  2. Executing IFFT (batch of 2000) with embedded PRE-CALLBACK (Complex Multiply) and POST-CALLBACK (Find Peaks)...\n");
+    
+    // PRE-CALLBACK автоматически выполнит Complex Multiply из userdata
+    // POST-CALLBACK автоматически запишет пики в post_callback_userdata
+    clfftStatus fft_status = clfftEnqueueTransform(
+        ctx_.correlation_ifft_plan,
+        CLFFT_BACKWARD,
+        1,
+        &ctx_.queue,
+        1,
+        &event_copy_data,  // Ждать копирования данных в userdata
+        &event_ifft,
+        &ctx_.correlation_fft,  // Входной буфер (PRE-CALLBACK заполнит его результатом умножения)
+        &ctx_.correlation_ifft,  // Выходной буфер (результаты IFFT)
+        nullptr
+    );
+    resources_.trackEvent(event_ifft, "Step3 inverse FFT");
+    
+    if (fft_status != CLFFT_SUCCESS) {
+        if (event_copy_data) resources_.releaseEvent(event_copy_data);
+        throw std::runtime_error("clfftEnqueueTransform failed for correlation IFFT");
+    }
+    step3_signals_ = num_signals;
+    
+    EventTiming ifft_event_timing = profile_event_detailed(event_ifft);
+    time_ifft_ms = ifft_event_timing.execute_ms;
+    ifft_timing.execute_ms = ifft_event_timing.execute_ms;
+    ifft_timing.queue_wait_ms = ifft_event_timing.queue_wait_ms;
+    ifft_timing.cpu_wait_ms = ifft_event_timing.wait_ms;
+    ifft_timing.total_gpu_ms = ifft_event_timing.total_ms;
+    printf("  [PROFILE] Inverse FFT: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n", 
+           ifft_event_timing.execute_ms, ifft_event_timing.queue_wait_ms, ifft_event_timing.wait_ms);
+    
+    // ========================================================================
+    // 3.5. DEVICE-SIDE ENCODING (скачивается только сжатый payload)
+    // ========================================================================
+    
+    if (peaks_encoding_.encoding != Correlator::PeaksEncoding::Float32) {
+        printf("  3. Encoding correlation results on device (%s)...\n",
+               Correlator::peaksEncodingName(peaks_encoding_.encoding));
+        bool encoded = encode_correlation_results(peaks_encoding_, num_signals, num_shifts, n_kg,
+                                                  encoded_result_, download_timing);
+        time_download_ms = download_timing.execute_ms;
+        time_post_callback_ms = 0.0;
+        
+        if (event_copy_data) resources_.releaseEvent(event_copy_data);
+        if (event_ifft) resources_.releaseEvent(event_ifft);
+        if (!encoded) {
+            throw std::runtime_error("Failed to encode correlation results");
+        }
+        
+        printf("\n[OK] Step 3 completed!\n");
+        printf("  Output: %d × %d × %d correlations, %zu bytes encoded\n\n",
+               num_signals, num_shifts, n_kg, encoded_result_.payload.size());
+        return;
+    }
+    
+    // ========================================================================
+    // 4. RESULTS STAY ON DEVICE
+    // ========================================================================
+    
+    // Пики остаются в post_callback_userdata: их скачивает readCorrelationPeaks
+    // (getCorrelationPeaksData) прямо в буфер вызывающего — второй копии на хосте нет.
+    // IFFT уже завершён (profile_event_detailed дождался event_ifft)
+    download_timing = OperationTiming{};
+    time_download_ms = 0.0;
+    
+    // Post-callback (find peaks) встроен в IFFT план, выполняется автоматически
+    // Извлечение пиков происходит внутри IFFT операции через clFFT callback
+    printf("  4. Post-callback (find peaks) встроен в IFFT план (выполняется автоматически)...\n");
+    
+    // Callback встроен в IFFT, его время включено в IFFT время
+    time_post_callback_ms = 0.0;
+    
+    // Release events
+    if (event_copy_data) resources_.releaseEvent(event_copy_data);
+    if (event_ifft) resources_.releaseEvent(event_ifft);
+    
+    printf("\n[OK] Step 3 completed!\n");
+    printf("  Output: %d × %d × %d correlations\n",
+           num_signals, num_shifts, n_kg);
+    printf("  Ready for results analysis\n\n");
+}
+
+// ============================================================================
+// STEP 3 (pairwise): All-pairs cross-correlation of input signals (TDOA)
+// ============================================================================
+
+// Произведения: work-item = (бин k, пара в части). Пара (i, i) даёт |X_i|² —
+// автокорреляцию. Выборка задержек: work-item = (задержка l, пара), τ = l - num_lags/2
+static const char* pairwise_source = R"(
+__kernel void pairwise_products(
+    __global const float2* spectra,
+    __global const uint2* pairs,
+    __global float2* products,
+    const uint fft_size,
+    const uint first_pair,
+    const uint pair_count
+) {
+    const uint k = get_global_id(0);
+    const uint p = get_global_id(1);
+    if (k >= fft_size || p >= pair_count) return;
+
+    const uint2 pair = pairs[first_pair + p];
+    const float2 a = spectra[(size_t)pair.x * fft_size + k];
+    const float2 b = spectra[(size_t)pair.y * fft_size + k];
+    products[(size_t)p * fft_size + k] = (float2)(a.x * b.x + a.y * b.y, a.y * b.x - a.x * b.y);
+}
+
+__kernel void pairwise_lags(
+    __global const float2* correlation,
+    __global float* peaks,
+    const uint fft_size,
+    const uint num_lags,
+    const uint first_pair,
+    const uint pair_count
+) {
+    const uint l = get_global_id(0);
+    const uint p = get_global_id(1);
+    if (l >= num_lags || p >= pair_count) return;
+
+    const int lag = (int)l - (int)(num_lags / 2);
+    const uint index = (uint)((lag % (int)fft_size + (int)fft_size) % (int)fft_size);
+    peaks[(size_t)(first_pair + p) * num_lags + l] = length(correlation[(size_t)p * fft_size + index]);
+}
+)";
+
+bool FFTHandler::build_pairwise_program() {
+    if (ctx_.pairwise_program) {
+        return true;
+    }
+
+    cl_int err = CL_SUCCESS;
+    const char* source = pairwise_source;
+    cl_program program = resources_.createProgramWithSource(ctx_.context, 1, &source, nullptr, &err, "pairwise");
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create pairwise program: %d\n", err);
+        return false;
+    }
+
+    err = clBuildProgram(program, 1, &ctx_.device, "", nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+        std::vector<char> log(log_size + 1, '\0');
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
+        fprintf(stderr, "[ERROR] Pairwise program build failed:\n%s\n", log.data());
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    cl_kernel products_kernel = resources_.createKernel(program, "pairwise_products", &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create pairwise_products kernel: %d\n", err);
+        resources_.releaseProgram(program);
+        return false;
+    }
+    cl_kernel lags_kernel = resources_.createKernel(program, "pairwise_lags", &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create pairwise_lags kernel: %d\n", err);
+        resources_.releaseKernel(products_kernel);
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    ctx_.pairwise_program = program;
+    ctx_.pairwise_products_kernel = products_kernel;
+    ctx_.pairwise_lags_kernel = lags_kernel;
+    return true;
+}
+
+void FFTHandler::step3_pairwise_correlation(
+    int num_signals,
+    int num_lags,
+    std::vector<float>& peaks,
+    OperationTiming& multiply_timing,
+    OperationTiming& ifft_timing,
+    OperationTiming& download_timing
+) {
+    if (!ctx_.initialized) {
+        throw std::runtime_error("step3_pairwise_correlation: FFT handler is not initialized");
+    }
+    if (num_signals <= 0 || num_signals > num_signals_ || num_lags <= 0 || static_cast<size_t>(num_lags) > fft_size_) {
+        throw std::runtime_error("step3_pairwise_correlation: expected 1.." + std::to_string(num_signals_) +
+                                 " signals and 1.." + std::to_string(fft_size_) + " lags");
+    }
+
+    const size_t pairs = Correlator::pairwisePairCount(num_signals);
+    printf("[STEP 3] Pairwise correlation: %d signals -> %zu pairs × %d lags...\n", num_signals, pairs, num_lags);
+    resources_.beginStep("Step3");
+
+    if (!build_pairwise_program()) {
+        throw std::runtime_error("step3_pairwise_correlation: pairwise program is unavailable");
+    }
+    // Пары строятся из спектров Step 2: слитый путь отложил их — досчитать
+    OperationTiming deferred_fft;
+    materialize_input_spectra(deferred_fft);
+
+    // Строки correlation_fft — рабочий буфер: num_signals × num_shifts спектров
+    const size_t batch = std::min(pairs, static_cast<size_t>(num_signals_) * num_shifts_);
+    if (ctx_.pairwise_ifft_plan && pairwise_batch_ != batch) {
+        clfftDestroyPlan(&ctx_.pairwise_ifft_plan);
+        ctx_.pairwise_ifft_plan = 0;
+    }
+    if (!ctx_.pairwise_ifft_plan) {
+        ctx_.pairwise_ifft_plan = create_fft_plan_1d_inplace(fft_size_, static_cast<int>(batch), "Pairwise IFFT Plan");
+        pairwise_batch_ = batch;
+    }
+
+    cl_int err = CL_SUCCESS;
+    if (pairwise_signals_ != num_signals) {
+        if (ctx_.pair_table) {
+            resources_.releaseMemObject(ctx_.pair_table);
+            ctx_.pair_table = nullptr;
+        }
+        const std::vector<uint32_t> table = Correlator::pairwisePairTable(num_signals);
+        ctx_.pair_table = resources_.createBuffer(ctx_.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                                  table.size() * sizeof(uint32_t),
+                                                  const_cast<uint32_t*>(table.data()), &err, "pair_table");
+        if (err != CL_SUCCESS) throw std::runtime_error("Failed to allocate pair_table buffer");
+        pairwise_signals_ = num_signals;
+    }
+
+    const size_t peaks_bytes = pairs * num_lags * sizeof(float);
+    size_t current_bytes = 0;
+    if (ctx_.pairwise_peaks) {
+        clGetMemObjectInfo(ctx_.pairwise_peaks, CL_MEM_SIZE, sizeof(current_bytes), &current_bytes, nullptr);
+    }
+    if (current_bytes != peaks_bytes) {
+        if (ctx_.pairwise_peaks) {
+            resources_.releaseMemObject(ctx_.pairwise_peaks);
+            ctx_.pairwise_peaks = nullptr;
+        }
+        ctx_.pairwise_peaks = resources_.createBuffer(ctx_.context, CL_MEM_WRITE_ONLY, peaks_bytes, nullptr, &err,
+                                                      "pairwise_peaks");
+        if (err != CL_SUCCESS) throw std::runtime_error("Failed to allocate pairwise_peaks buffer");
+    }
+
+    // Части по batch пар: произведения → IFFT (1/N) на месте → модули задержек
+    const cl_uint fft_size = static_cast<cl_uint>(fft_size_);
+    const cl_uint lags = static_cast<cl_uint>(num_lags);
+    std::vector<cl_event> product_events, transform_events;
+    auto release_all = [&]() {
+        for (cl_event event : product_events) resources_.releaseEvent(event);
+        for (cl_event event : transform_events) resources_.releaseEvent(event);
+    };
+    for (size_t first = 0; first < pairs; first += batch) {
+        const cl_uint first_pair = static_cast<cl_uint>(first);
+        const cl_uint pair_count = static_cast<cl_uint>(std::min(batch, pairs - first));
+
+        err = clSetKernelArg(ctx_.pairwise_products_kernel, 0, sizeof(cl_mem), &ctx_.input_fft);
+        err |= clSetKernelArg(ctx_.pairwise_products_kernel, 1, sizeof(cl_mem), &ctx_.pair_table);
+        err |= clSetKernelArg(ctx_.pairwise_products_kernel, 2, sizeof(cl_mem), &ctx_.correlation_fft);
+        err |= clSetKernelArg(ctx_.pairwise_products_kernel, 3, sizeof(cl_uint), &fft_size);
+        err |= clSetKernelArg(ctx_.pairwise_products_kernel, 4, sizeof(cl_uint), &first_pair);
+        err |= clSetKernelArg(ctx_.pairwise_products_kernel, 5, sizeof(cl_uint), &pair_count);
+        err |= clSetKernelArg(ctx_.pairwise_lags_kernel, 0, sizeof(cl_mem), &ctx_.correlation_fft);
+        err |= clSetKernelArg(ctx_.pairwise_lags_kernel, 1, sizeof(cl_mem), &ctx_.pairwise_peaks);
+        err |= clSetKernelArg(ctx_.pairwise_lags_kernel, 2, sizeof(cl_uint), &fft_size);
+        err |= clSetKernelArg(ctx_.pairwise_lags_kernel, 3, sizeof(cl_uint), &lags);
+        err |= clSetKernelArg(ctx_.pairwise_lags_kernel, 4, sizeof(cl_uint), &first_pair);
+        err |= clSetKernelArg(ctx_.pairwise_lags_kernel, 5, sizeof(cl_uint), &pair_count);
+        if (err != CL_SUCCESS) {
+            release_all();
+            throw std::runtime_error("Failed to set pairwise kernel arguments");
+        }
+
+        cl_event event_products = nullptr, event_ifft = nullptr, event_lags = nullptr;
+        size_t products_size[2] = {fft_size_, pair_count};
+        err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.pairwise_products_kernel, 2, nullptr, products_size, nullptr,
+                                     0, nullptr, &event_products);
+        if (err != CL_SUCCESS) {
+            release_all();
+            throw std::runtime_error("Failed to enqueue pairwise_products kernel: " + std::to_string(err));
+        }
+        resources_.trackEvent(event_products, "Step3 pairwise products");
+        product_events.push_back(event_products);
+
+        clfftStatus fft_status = clfftEnqueueTransform(ctx_.pairwise_ifft_plan, CLFFT_BACKWARD, 1, &ctx_.queue,
+                                                       1, &event_products, &event_ifft,
+                                                       &ctx_.correlation_fft, nullptr, nullptr);
+        if (fft_status != CLFFT_SUCCESS) {
+            release_all();
+            throw std::runtime_error("clfftEnqueueTransform failed for pairwise IFFT");
+        }
+        resources_.trackEvent(event_ifft, "Step3 pairwise inverse FFT");
+        transform_events.push_back(event_ifft);
+
+        size_t lags_size[2] = {static_cast<size_t>(num_lags), pair_count};
+        err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.pairwise_lags_kernel, 2, nullptr, lags_size, nullptr,
+                                     1, &event_ifft, &event_lags);
+        if (err != CL_SUCCESS) {
+            release_all();
+            throw std::runtime_error("Failed to enqueue pairwise_lags kernel: " + std::to_string(err));
+        }
+        resources_.trackEvent(event_lags, "Step3 pairwise lags");
+        transform_events.push_back(event_lags);
+    }
+
+    EventTiming products_span = profile_events_span(product_events);
+    multiply_timing.execute_ms = products_span.execute_ms;
+    multiply_timing.queue_wait_ms = products_span.queue_wait_ms;
+    multiply_timing.cpu_wait_ms = products_span.wait_ms;
+    multiply_timing.total_gpu_ms = products_span.total_ms;
+    EventTiming transform_span = profile_events_span(transform_events);
+    ifft_timing.execute_ms = transform_span.execute_ms;
+    ifft_timing.queue_wait_ms = transform_span.queue_wait_ms;
+    ifft_timing.cpu_wait_ms = transform_span.wait_ms;
+    ifft_timing.total_gpu_ms = transform_span.total_ms;
+    printf("  [PROFILE] Pairwise products: execute=%.3f ms; IFFT + lags: execute=%.3f ms (%zu part(s))\n",
+           products_span.execute_ms, transform_span.execute_ms, product_events.size());
+    release_all();
+
+    peaks.resize(pairs * num_lags);
+    cl_event event_download = nullptr;
+    err = clEnqueueReadBuffer(ctx_.queue, ctx_.pairwise_peaks, CL_FALSE, 0, peaks_bytes, peaks.data(),
+                              0, nullptr, &event_download);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to download pairwise peaks: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_download, "Step3 pairwise download");
+    EventTiming download_event_timing = profile_event_detailed(event_download);
+    download_timing.execute_ms = download_event_timing.execute_ms;
+    download_timing.queue_wait_ms = download_event_timing.queue_wait_ms;
+    download_timing.cpu_wait_ms = download_event_timing.wait_ms;
+    download_timing.total_gpu_ms = download_event_timing.total_ms;
+    resources_.releaseEvent(event_download);
+
+    printf("[OK] Step 3 (pairwise) completed: %zu × %d lag peaks\n\n", pairs, num_lags);
+}
+
+// ============================================================================
+// 2D correlation (template matching) with batched R2C / C2R plans
+// ============================================================================
+
+// Произведения X·conj(T): work-item = (бин эрмитовой половины, пара кадр × шаблон),
+// пара p = кадр · num_templates + шаблон. Максимум: work-group на пару, редукция
+// (значение, индекс) в локальной памяти, при равенстве — меньший индекс.
+// clFFT применяет callback'и только к 1D планам, поэтому произведение и поиск
+// максимума — отдельные kernel'ы между батчевыми 2D преобразованиями.
+static const char* correlation2d_source = R"(
+__kernel void correlation2d_multiply(
+    __global const float2* image_spectra,
+    __global const float2* template_spectra,
+    __global float2* products,
+    const uint bins,
+    const uint num_templates,
+    const uint pair_count
+) {
+    const uint k = get_global_id(0);
+    const uint p = get_global_id(1);
+    if (k >= bins || p >= pair_count) return;
+
+    const float2 a = image_spectra[(size_t)(p / num_templates) * bins + k];
+    const float2 b = template_spectra[(size_t)(p % num_templates) * bins + k];
+    products[(size_t)p * bins + k] = (float2)(a.x * b.x + a.y * b.y, a.y * b.x - a.x * b.y);
+}
+
+__kernel __attribute__((reqd_work_group_size(CORR2D_LOCAL, 1, 1)))
+void correlation2d_argmax(
+    __global const float* surfaces,
+    __global float* records,
+    const uint height,
+    const uint width
+) {
+    __local float best_values[CORR2D_LOCAL];
+    __local uint best_indices[CORR2D_LOCAL];
+
+    const uint pair = get_group_id(0);
+    const uint lid = get_local_id(0);
+    const uint size = height * width;
+    __global const float* surface = surfaces + (size_t)pair * size;
+
+    float best = -INFINITY;
+    uint best_index = 0;
+    for (uint i = lid; i < size; i += CORR2D_LOCAL) {
+        const float value = surface[i];
+        if (value > best) {
+            best = value;
+            best_index = i;
+        }
+    }
+    best_values[lid] = best;
+    best_indices[lid] = best_index;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (uint stride = CORR2D_LOCAL / 2; stride > 0; stride >>= 1) {
+        if (lid < stride) {
+            const float other = best_values[lid + stride];
+            const uint other_index = best_indices[lid + stride];
+            if (other > best_values[lid] || (other == best_values[lid] && other_index < best_indices[lid])) {
+                best_values[lid] = other;
+                best_indices[lid] = other_index;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    __global float* record = records + (size_t)pair * 12;
+    if (lid < 9) {
+        const uint index = best_indices[0];
+        const uint y = index / width;
+        const uint x = index % width;
+        const uint ny = (y + height + (lid / 3) - 1) % height;
+        const uint nx = (x + width + (lid % 3) - 1) % width;
+        record[2 + lid] = surface[ny * width + nx];
+        if (lid == 0) {
+            record[0] = best_values[0];
+            record[1] = as_float(index);
+            record[11] = 0.0f;
+        }
+    }
+}
+)";
+
+static constexpr size_t kCorrelation2DLocalSize = 256;
+
+bool FFTHandler::build_correlation2d_program() {
+    if (ctx_.correlation2d_program) {
+        return true;
+    }
+
+    cl_int err = CL_SUCCESS;
+    const char* source = correlation2d_source;
+    cl_program program = resources_.createProgramWithSource(ctx_.context, 1, &source, nullptr, &err, "correlation2d");
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create 2D correlation program: %d\n", err);
+        return false;
+    }
+
+    const std::string options = "-DCORR2D_LOCAL=" + std::to_string(kCorrelation2DLocalSize);
+    err = clBuildProgram(program, 1, &ctx_.device, options.c_str(), nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+        std::vector<char> log(log_size + 1, '\0');
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
+        fprintf(stderr, "[ERROR] 2D correlation program build failed:\n%s\n", log.data());
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    cl_kernel multiply_kernel = resources_.createKernel(program, "correlation2d_multiply", &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create correlation2d_multiply kernel: %d\n", err);
+        resources_.releaseProgram(program);
+        return false;
+    }
+    cl_kernel argmax_kernel = resources_.createKernel(program, "correlation2d_argmax", &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create correlation2d_argmax kernel: %d\n", err);
+        resources_.releaseKernel(multiply_kernel);
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    ctx_.correlation2d_program = program;
+    ctx_.correlation2d_multiply_kernel = multiply_kernel;
+    ctx_.correlation2d_argmax_kernel = argmax_kernel;
+    return true;
+}
+
+void FFTHandler::ensure_buffer_size(cl_mem& buffer, size_t bytes, cl_mem_flags flags, const char* label) {
+    size_t current_bytes = 0;
+    if (buffer) {
+        clGetMemObjectInfo(buffer, CL_MEM_SIZE, sizeof(current_bytes), &current_bytes, nullptr);
+    }
+    if (current_bytes == bytes) {
+        return;
+    }
+    if (buffer) {
+        resources_.releaseMemObject(buffer);
+        buffer = nullptr;
+    }
+    cl_int err = CL_SUCCESS;
+    buffer = resources_.createBuffer(ctx_.context, flags, bytes, nullptr, &err, label);
+    if (err != CL_SUCCESS) {
+        buffer = nullptr;
+        throw std::runtime_error(std::string("Failed to allocate ") + label + " buffer");
+    }
+}
+
+void FFTHandler::set_templates_2d(
+    std::span<const float> templates,
+    int num_templates,
+    size_t height,
+    size_t width,
+    OperationTiming& fft_timing
+) {
+    if (!ctx_.initialized) {
+        throw std::runtime_error("set_templates_2d: FFT handler is not initialized");
+    }
+    if (num_templates <= 0 || height == 0 || width == 0 ||
+        templates.size() != static_cast<size_t>(num_templates) * height * width) {
+        throw std::runtime_error("set_templates_2d: expected " + std::to_string(num_templates) + " × " +
+                                 std::to_string(height) + " × " + std::to_string(width) + " values");
+    }
+
+    printf("[2D] Templates: %d × %zu × %zu...\n", num_templates, height, width);
+    resources_.beginStep("Step1");
+    if (!build_correlation2d_program()) {
+        throw std::runtime_error("set_templates_2d: 2D correlation program is unavailable");
+    }
+
+    // Смена формы кадра: все 2D планы строятся заново
+    if (corr2d_height_ != height || corr2d_width_ != width) {
+        clfftPlanHandle* plans[] = {&ctx_.corr2d_template_plan, &ctx_.corr2d_image_plan, &ctx_.corr2d_inverse_plan};
+        for (clfftPlanHandle* plan : plans) {
+            if (*plan) {
+                clfftDestroyPlan(plan);
+                *plan = 0;
+            }
+        }
+        corr2d_height_ = height;
+        corr2d_width_ = width;
+        corr2d_images_ = 0;
+    }
+    if (ctx_.corr2d_template_plan && corr2d_templates_ != num_templates) {
+        clfftDestroyPlan(&ctx_.corr2d_template_plan);
+        ctx_.corr2d_template_plan = 0;
+    }
+    if (ctx_.corr2d_inverse_plan && corr2d_templates_ != num_templates) {
+        clfftDestroyPlan(&ctx_.corr2d_inverse_plan);
+        ctx_.corr2d_inverse_plan = 0;
+    }
+    if (!ctx_.corr2d_template_plan) {
+        ctx_.corr2d_template_plan = create_fft_plan(FFTPlanDesc::real2D(height, width, num_templates, true),
+                                                    "2D Template FFT Plan");
+    }
+    corr2d_templates_ = num_templates;
+
+    const size_t bins = Correlator::correlation2DSpectrumBins(height, width);
+    const size_t input_bytes = templates.size() * sizeof(float);
+    size_t input_capacity = 0;
+    if (ctx_.corr2d_input) {
+        clGetMemObjectInfo(ctx_.corr2d_input, CL_MEM_SIZE, sizeof(input_capacity), &input_capacity, nullptr);
+    }
+    if (input_capacity < input_bytes) {
+        ensure_buffer_size(ctx_.corr2d_input, input_bytes, CL_MEM_READ_ONLY, "corr2d_input");
+    }
+    ensure_buffer_size(ctx_.corr2d_template_spectra, num_templates * bins * sizeof(cl_float2),
+                       CL_MEM_READ_WRITE, "corr2d_template_spectra");
+
+    cl_event event_upload = nullptr, event_fft = nullptr;
+    cl_int err = clEnqueueWriteBuffer(ctx_.queue, ctx_.corr2d_input, CL_FALSE, 0, input_bytes, templates.data(),
+                                      0, nullptr, &event_upload);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to upload 2D templates: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_upload, "2D template upload");
+
+    clfftStatus fft_status = clfftEnqueueTransform(ctx_.corr2d_template_plan, CLFFT_FORWARD, 1, &ctx_.queue,
+                                                   1, &event_upload, &event_fft,
+                                                   &ctx_.corr2d_input, &ctx_.corr2d_template_spectra, nullptr);
+    if (fft_status != CLFFT_SUCCESS) {
+        resources_.releaseEvent(event_upload);
+        throw std::runtime_error("clfftEnqueueTransform failed for 2D template FFT");
+    }
+    resources_.trackEvent(event_fft, "2D template FFT");
+
+    EventTiming fft_event_timing = profile_event_detailed(event_fft);
+    fft_timing.execute_ms = fft_event_timing.execute_ms;
+    fft_timing.queue_wait_ms = fft_event_timing.queue_wait_ms;
+    fft_timing.cpu_wait_ms = fft_event_timing.wait_ms;
+    fft_timing.total_gpu_ms = fft_event_timing.total_ms;
+    resources_.releaseEvent(event_upload);
+    resources_.releaseEvent(event_fft);
+
+    printf("[OK] 2D templates ready: %d spectra of %zu bins\n", num_templates, bins);
+}
+
+void FFTHandler::correlate_2d(
+    std::span<const float> images,
+    int num_images,
+    std::vector<float>& records,
+    OperationTiming& fft_timing,
+    OperationTiming& multiply_timing,
+    OperationTiming& ifft_timing
+) {
+    if (corr2d_templates_ == 0 || !ctx_.corr2d_template_spectra) {
+        throw std::runtime_error("correlate_2d: set_templates_2d must be called first");
+    }
+    const size_t height = corr2d_height_;
+    const size_t width = corr2d_width_;
+    if (num_images <= 0 || images.size() != static_cast<size_t>(num_images) * height * width) {
+        throw std::runtime_error("correlate_2d: expected " + std::to_string(num_images) + " × " +
+                                 std::to_string(height) + " × " + std::to_string(width) + " values");
+    }
+    if (height * width > UINT32_MAX) {
+        throw std::runtime_error("correlate_2d: frame is too large for 32-bit peak indices");
+    }
+
+    const size_t pairs = static_cast<size_t>(num_images) * corr2d_templates_;
+    printf("[2D] Correlation: %d frame(s) × %d template(s) (%zu × %zu)...\n",
+           num_images, corr2d_templates_, height, width);
+    resources_.beginStep("Step3");
+
+    if (corr2d_images_ != num_images) {
+        clfftPlanHandle* plans[] = {&ctx_.corr2d_image_plan, &ctx_.corr2d_inverse_plan};
+        for (clfftPlanHandle* plan : plans) {
+            if (*plan) {
+                clfftDestroyPlan(plan);
+                *plan = 0;
+            }
+        }
+        corr2d_images_ = num_images;
+    }
+    if (!ctx_.corr2d_image_plan) {
+        ctx_.corr2d_image_plan = create_fft_plan(FFTPlanDesc::real2D(height, width, num_images, true),
+                                                 "2D Image FFT Plan");
+    }
+    if (!ctx_.corr2d_inverse_plan) {
+        ctx_.corr2d_inverse_plan = create_fft_plan(FFTPlanDesc::real2D(height, width, static_cast<int>(pairs), false),
+                                                   "2D Correlation IFFT Plan");
+    }
+
+    const size_t bins = Correlator::correlation2DSpectrumBins(height, width);
+    const size_t input_bytes = images.size() * sizeof(float);
+    size_t input_capacity = 0;
+    if (ctx_.corr2d_input) {
+        clGetMemObjectInfo(ctx_.corr2d_input, CL_MEM_SIZE, sizeof(input_capacity), &input_capacity, nullptr);
+    }
+    if (input_capacity < input_bytes) {
+        ensure_buffer_size(ctx_.corr2d_input, input_bytes, CL_MEM_READ_ONLY, "corr2d_input");
+    }
+    ensure_buffer_size(ctx_.corr2d_image_spectra, num_images * bins * sizeof(cl_float2),
+                       CL_MEM_READ_WRITE, "corr2d_image_spectra");
+    ensure_buffer_size(ctx_.corr2d_products, pairs * bins * sizeof(cl_float2), CL_MEM_READ_WRITE, "corr2d_products");
+    ensure_buffer_size(ctx_.corr2d_surfaces, pairs * height * width * sizeof(float), CL_MEM_READ_WRITE,
+                       "corr2d_surfaces");
+    ensure_buffer_size(ctx_.corr2d_records, pairs * Correlator::kPeak2DRecordFloats * sizeof(float),
+                       CL_MEM_WRITE_ONLY, "corr2d_records");
+
+    const cl_uint bins_arg = static_cast<cl_uint>(bins);
+    const cl_uint templates_arg = static_cast<cl_uint>(corr2d_templates_);
+    const cl_uint pairs_arg = static_cast<cl_uint>(pairs);
+    const cl_uint height_arg = static_cast<cl_uint>(height);
+    const cl_uint width_arg = static_cast<cl_uint>(width);
+    cl_int err = clSetKernelArg(ctx_.correlation2d_multiply_kernel, 0, sizeof(cl_mem), &ctx_.corr2d_image_spectra);
+    err |= clSetKernelArg(ctx_.correlation2d_multiply_kernel, 1, sizeof(cl_mem), &ctx_.corr2d_template_spectra);
+    err |= clSetKernelArg(ctx_.correlation2d_multiply_kernel, 2, sizeof(cl_mem), &ctx_.corr2d_products);
+    err |= clSetKernelArg(ctx_.correlation2d_multiply_kernel, 3, sizeof(cl_uint), &bins_arg);
+    err |= clSetKernelArg(ctx_.correlation2d_multiply_kernel, 4, sizeof(cl_uint), &templates_arg);
+    err |= clSetKernelArg(ctx_.correlation2d_multiply_kernel, 5, sizeof(cl_uint), &pairs_arg);
+    err |= clSetKernelArg(ctx_.correlation2d_argmax_kernel, 0, sizeof(cl_mem), &ctx_.corr2d_surfaces);
+    err |= clSetKernelArg(ctx_.correlation2d_argmax_kernel, 1, sizeof(cl_mem), &ctx_.corr2d_records);
+    err |= clSetKernelArg(ctx_.correlation2d_argmax_kernel, 2, sizeof(cl_uint), &height_arg);
+    err |= clSetKernelArg(ctx_.correlation2d_argmax_kernel, 3, sizeof(cl_uint), &width_arg);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to set 2D correlation kernel arguments");
+    }
+
+    // Загрузка → R2C кадров → произведения → C2R → максимумы, одной цепочкой событий
+    std::vector<cl_event> events;
+    auto release_all = [&]() {
+        for (cl_event event : events) resources_.releaseEvent(event);
+    };
+    cl_event event_upload = nullptr, event_fft = nullptr, event_multiply = nullptr;
+    cl_event event_ifft = nullptr, event_argmax = nullptr;
+
+    err = clEnqueueWriteBuffer(ctx_.queue, ctx_.corr2d_input, CL_FALSE, 0, input_bytes, images.data(),
+                               0, nullptr, &event_upload);
     if (err != CL_SUCCESS) {
-        throw std::runtime_error("Failed to copy reference_fft to userdata");
+        throw std::runtime_error("Failed to upload 2D frames: " + std::to_string(err));
     }
-    
-    // Копировать input_fft (уже на GPU из Step 2) в userdata (после reference_fft)
-    err = clEnqueueCopyBuffer(
-        ctx_.queue,                              // command_queue
-        ctx_.input_fft,                          // src_buffer (уже на GPU)
-        ctx_.pre_callback_userdata_correlation,  // dst_buffer (userdata для PRE-CALLBACK)
-        0,                                       // src_offset
-        params_size + reference_size,            // dst_offset (после параметров + reference_fft)
-        input_size,                              // size
-        1,                                       // num_events_in_wait_list
-        &event_copy_ref,                         // event_wait_list (ждать копирования reference_fft)
-        &event_copy_data                         // event
-    );
+    resources_.trackEvent(event_upload, "2D frame upload");
+    events.push_back(event_upload);
+
+    clfftStatus fft_status = clfftEnqueueTransform(ctx_.corr2d_image_plan, CLFFT_FORWARD, 1, &ctx_.queue,
+                                                   1, &event_upload, &event_fft,
+                                                   &ctx_.corr2d_input, &ctx_.corr2d_image_spectra, nullptr);
+    if (fft_status != CLFFT_SUCCESS) {
+        release_all();
+        throw std::runtime_error("clfftEnqueueTransform failed for 2D frame FFT");
+    }
+    resources_.trackEvent(event_fft, "2D frame FFT");
+    events.push_back(event_fft);
+
+    size_t multiply_size[2] = {bins, pairs};
+    err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.correlation2d_multiply_kernel, 2, nullptr, multiply_size, nullptr,
+                                 1, &event_fft, &event_multiply);
     if (err != CL_SUCCESS) {
-        clReleaseEvent(event_copy_ref);
-        throw std::runtime_error("Failed to copy input_fft to userdata");
+        release_all();
+        throw std::runtime_error("Failed to enqueue correlation2d_multiply kernel: " + std::to_string(err));
     }
-    
-    // Measure copy time (detailed) - это GPU->GPU копирование, очень быстрое
-    EventTiming copy_event_timing = profile_event_detailed(event_copy_data);
-    time_multiply_ms = copy_event_timing.execute_ms;  // Время GPU->GPU копирования
-    multiply_timing.execute_ms = copy_event_timing.execute_ms;
-    multiply_timing.queue_wait_ms = copy_event_timing.queue_wait_ms;
-    multiply_timing.cpu_wait_ms = copy_event_timing.wait_ms;
-    multiply_timing.total_gpu_ms = copy_event_timing.total_ms;
-    printf("  [PROFILE] GPU->GPU copy to userdata: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n", 
-           copy_event_timing.execute_ms, copy_event_timing.queue_wait_ms, copy_event_timing.wait_ms);
-    
-    clReleaseEvent(event_copy_ref);
-    
-    printf("  [OK] Data prepared in userdata (PRE-CALLBACK will perform Complex Multiply during IFFT)\n");
-    
-    // ========================================================================
-    // 2. EXECUTE INVERSE FFT (PRE-CALLBACK и POST-CALLBACK встроены в план)
-    // ========================================================================
-    
-    printf("  2. Executing IFFT (batch of 2000) with embedded PRE-CALLBACK (Complex Multiply) and POST-CALLBACK (Find Peaks)...\n");
-    
-    // PRE-CALLBACK автоматически выполнит Complex Multiply из userdata
-    // POST-CALLBACK автоматически запишет пики в post_callback_userdata
-    clfftStatus fft_status = clfftEnqueueTransform(
-        ctx_.correlation_ifft_plan,
-        CLFFT_BACKWARD,
-        1,
-        &ctx_.queue,
-        1,
-        &event_copy_data,  // Ждать копирования данных в userdata
-        &event_ifft,
-        &ctx_.correlation_fft,  // Входной буфер (PRE-CALLBACK заполнит его результатом умножения)
-        &ctx_.correlation_ifft,  // Выходной буфер (результаты IFFT)
-        nullptr
-    );
-    
+    resources_.trackEvent(event_multiply, "2D products");
+    events.push_back(event_multiply);
+
+    fft_status = clfftEnqueueTransform(ctx_.corr2d_inverse_plan, CLFFT_BACKWARD, 1, &ctx_.queue,
+                                       1, &event_multiply, &event_ifft,
+                                       &ctx_.corr2d_products, &ctx_.corr2d_surfaces, nullptr);
     if (fft_status != CLFFT_SUCCESS) {
-        if (event_copy_data) clReleaseEvent(event_copy_data);
-        throw std::runtime_error("clfftEnqueueTransform failed for correlation IFFT");
+        release_all();
+        throw std::runtime_error("clfftEnqueueTransform failed for 2D correlation IFFT");
     }
-    
-    EventTiming ifft_event_timing = profile_event_detailed(event_ifft);
-    time_ifft_ms = ifft_event_timing.execute_ms;
-    ifft_timing.execute_ms = ifft_event_timing.execute_ms;
-    ifft_timing.queue_wait_ms = ifft_event_timing.queue_wait_ms;
-    ifft_timing.cpu_wait_ms = ifft_event_timing.wait_ms;
-    ifft_timing.total_gpu_ms = ifft_event_timing.total_ms;
-    printf("  [PROFILE] Inverse FFT: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n", 
-           ifft_event_timing.execute_ms, ifft_event_timing.queue_wait_ms, ifft_event_timing.wait_ms);
-    
-    // ========================================================================
-    // 4. DOWNLOAD RESULTS
-    // ========================================================================
-    
-    printf("  3. Downloading correlation results (peaks) from POST-CALLBACK userdata...\n");
-    printf("     Size: %d × %d × %d elements = %.2f KB\n",
-           num_signals, num_shifts, n_kg,
-           num_signals * num_shifts * n_kg * sizeof(float) / 1024.0f);
-    
-    // Download peaks from post_callback_userdata (POST-CALLBACK уже записал туда пики)
-    std::vector<float> peaks_data(num_signals * num_shifts * n_kg);
-    
-    // Вычислить смещение для данных в post_callback_userdata (после параметров)
-    // ВАЖНО: Размер должен совпадать с OpenCL kernel структурой, которая имеет padding[1]
-    // OpenCL struct: {uint num_signals, uint num_shifts, uint fft_size, uint n_kg, uint search_range, uint padding[1]}
-    // = 6 * sizeof(uint) = 24 байта
-    // Но при создании буфера использовался PostCallbackParams::to_vector() который возвращает 5 элементов = 20 байт
-    // Нужно учесть padding[1], поэтому размер структуры = 6 * sizeof(cl_uint) = 24 байта
-    size_t post_params_size = 6 * sizeof(cl_uint);  // n_signals, n_correlators, fft_size, n_kg, peak_search_range, padding[1]
-    size_t peaks_size = num_signals * num_shifts * n_kg * sizeof(float);
-    
-    err = clEnqueueReadBuffer(
-        ctx_.queue,
-        ctx_.post_callback_userdata,  // Читаем из post_callback_userdata
-        CL_FALSE,
-        post_params_size,  // Смещение (после параметров)
-        peaks_size,
-        peaks_data.data(),
-        1,
-        &event_ifft,  // Ждать завершения IFFT (POST-CALLBACK выполнится внутри)
-        &event_download
-    );
-    
+    resources_.trackEvent(event_ifft, "2D inverse FFT");
+    events.push_back(event_ifft);
+
+    size_t argmax_global = pairs * kCorrelation2DLocalSize;
+    size_t argmax_local = kCorrelation2DLocalSize;
+    err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.correlation2d_argmax_kernel, 1, nullptr, &argmax_global,
+                                 &argmax_local, 1, &event_ifft, &event_argmax);
+    if (err != CL_SUCCESS) {
+        release_all();
+        throw std::runtime_error("Failed to enqueue correlation2d_argmax kernel: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_argmax, "2D peak search");
+    events.push_back(event_argmax);
+
+    records.resize(pairs * Correlator::kPeak2DRecordFloats);
+    err = clEnqueueReadBuffer(ctx_.queue, ctx_.corr2d_records, CL_TRUE, 0, records.size() * sizeof(float),
+                              records.data(), 1, &event_argmax, nullptr);
+    if (err != CL_SUCCESS) {
+        release_all();
+        throw std::runtime_error("Failed to download 2D correlation peaks: " + std::to_string(err));
+    }
+
+    EventTiming fft_event_timing = profile_event_detailed(event_fft);
+    fft_timing.execute_ms = fft_event_timing.execute_ms;
+    fft_timing.queue_wait_ms = fft_event_timing.queue_wait_ms;
+    fft_timing.cpu_wait_ms = fft_event_timing.wait_ms;
+    fft_timing.total_gpu_ms = fft_event_timing.total_ms;
+    EventTiming multiply_event_timing = profile_event_detailed(event_multiply);
+    multiply_timing.execute_ms = multiply_event_timing.execute_ms;
+    multiply_timing.queue_wait_ms = multiply_event_timing.queue_wait_ms;
+    multiply_timing.cpu_wait_ms = multiply_event_timing.wait_ms;
+    multiply_timing.total_gpu_ms = multiply_event_timing.total_ms;
+    EventTiming transform_span = profile_events_span({event_ifft, event_argmax});
+    ifft_timing.execute_ms = transform_span.execute_ms;
+    ifft_timing.queue_wait_ms = transform_span.queue_wait_ms;
+    ifft_timing.cpu_wait_ms = transform_span.wait_ms;
+    ifft_timing.total_gpu_ms = transform_span.total_ms;
+    printf("  [PROFILE] 2D FFT: %.3f ms; products: %.3f ms; IFFT + peaks: %.3f ms\n",
+           fft_event_timing.execute_ms, multiply_event_timing.execute_ms, transform_span.execute_ms);
+    release_all();
+
+    printf("[OK] 2D correlation completed: %zu peak(s)\n\n", pairs);
+}
+
+// ============================================================================
+// STEP 4: Range-Doppler map (slow-time FFT over device-resident Step 3 output)
+// ============================================================================
+
+// range_profiles: R_shift·conj(X_p) для импульсов p < num_pulses — то же
+// произведение, что pre-callback Step 3; профили дальности — обратный FFT по
+// строкам (план без callback'ов: post-callback Step 3 сохраняет только пики).
+// corner_turn: тайл 16 × 16 [импульс][дальность] из range_profiles → локальная
+// память → [дальность][импульс] в slow_time; отсчёт сопрягается (профиль —
+// IFFT(R·conj(X))) и умножается на окно, импульсы ≥ num_pulses — нули до doppler_size.
+// doppler_power: |·|² со сдвигом нулевого доплера в центр строки.
+// cfar_range: CA-CFAR по дальности, детекции дописываются через atomic_inc.
+static const char* range_doppler_source = R"(
+#define TILE 16
+
+__kernel void range_profiles(
+    __global const float2* reference_fft,
+    __global const float2* input_fft,
+    __global float2* profiles,
+    const uint fft_size,
+    const uint shift
+) {
+    const uint k = get_global_id(0);
+    const uint pulse = get_global_id(1);
+    if (k >= fft_size) return;
+
+    const float2 ref = reference_fft[(size_t)shift * fft_size + k];
+    const float2 inp = input_fft[(size_t)pulse * fft_size + k];
+    profiles[(size_t)pulse * fft_size + k] = (float2)(ref.x * inp.x + ref.y * inp.y, ref.y * inp.x - ref.x * inp.y);
+}
+
+__kernel __attribute__((reqd_work_group_size(TILE, TILE, 1)))
+void corner_turn(
+    __global const float2* profiles,
+    __global const float* window,
+    __global float2* slow_time,
+    const uint fft_size,
+    const uint num_pulses,
+    const uint range_bins,
+    const uint doppler_size
+) {
+    __local float2 tile[TILE][TILE + 1];
+
+    const uint lx = get_local_id(0);
+    const uint ly = get_local_id(1);
+    const uint range_base = get_group_id(0) * TILE;
+    const uint pulse_base = get_group_id(1) * TILE;
+
+    const uint range = range_base + lx;
+    const uint pulse = pulse_base + ly;
+    float2 value = (float2)(0.0f, 0.0f);
+    if (range < range_bins && pulse < num_pulses) {
+        const float2 sample = profiles[(size_t)pulse * fft_size + range];
+        value = (float2)(sample.x, -sample.y) * window[pulse];
+    }
+    tile[ly][lx] = value;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    const uint out_range = range_base + ly;
+    const uint out_pulse = pulse_base + lx;
+    if (out_range < range_bins && out_pulse < doppler_size) {
+        slow_time[(size_t)out_range * doppler_size + out_pulse] = tile[lx][ly];
+    }
+}
+
+__kernel void doppler_power(
+    __global const float2* slow_time,
+    __global float* map,
+    const uint range_bins,
+    const uint doppler_size
+) {
+    const uint column = get_global_id(0);
+    const uint range = get_global_id(1);
+    if (column >= doppler_size || range >= range_bins) return;
+
+    const uint source = (column + doppler_size - doppler_size / 2) % doppler_size;
+    const float2 value = slow_time[(size_t)range * doppler_size + source];
+    map[(size_t)range * doppler_size + column] = value.x * value.x + value.y * value.y;
+}
+
+__kernel void cfar_range(
+    __global const float* map,
+    __global uint* detections,
+    const uint range_bins,
+    const uint doppler_size,
+    const uint guard_cells,
+    const uint training_cells,
+    const float threshold_scale,
+    const uint max_detections
+) {
+    const uint column = get_global_id(0);
+    const uint range = get_global_id(1);
+    if (column >= doppler_size || range >= range_bins) return;
+
+    float sum = 0.0f;
+    uint count = 0;
+    for (uint offset = guard_cells + 1; offset <= guard_cells + training_cells; ++offset) {
+        if (range >= offset) {
+            sum += map[(size_t)(range - offset) * doppler_size + column];
+            ++count;
+        }
+        if (range + offset < range_bins) {
+            sum += map[(size_t)(range + offset) * doppler_size + column];
+            ++count;
+        }
+    }
+    if (count == 0) return;
+
+    const float noise = sum / (float)count;
+    const float power = map[(size_t)range * doppler_size + column];
+    if (power > threshold_scale * noise) {
+        const uint slot = atomic_inc(&detections[0]);
+        if (slot < max_detections) {
+            __global uint* record = detections + 4 + (size_t)slot * 4;
+            record[0] = range;
+            record[1] = column;
+            record[2] = as_uint(power);
+            record[3] = as_uint(noise);
+        }
+    }
+}
+)";
+
+static constexpr size_t kCornerTurnTile = 16;
+
+bool FFTHandler::build_range_doppler_program() {
+    if (ctx_.range_doppler_program) {
+        return true;
+    }
+
+    cl_int err = CL_SUCCESS;
+    const char* source = range_doppler_source;
+    cl_program program = resources_.createProgramWithSource(ctx_.context, 1, &source, nullptr, &err, "range_doppler");
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create range-Doppler program: %d\n", err);
+        return false;
+    }
+
+    err = clBuildProgram(program, 1, &ctx_.device, "", nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+        std::vector<char> log(log_size + 1, '\0');
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
+        fprintf(stderr, "[ERROR] Range-Doppler program build failed:\n%s\n", log.data());
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    const char* names[] = {"range_profiles", "corner_turn", "doppler_power", "cfar_range"};
+    cl_kernel kernels[4] = {nullptr, nullptr, nullptr, nullptr};
+    for (int i = 0; i < 4; ++i) {
+        kernels[i] = resources_.createKernel(program, names[i], &err);
+        if (err != CL_SUCCESS) {
+            fprintf(stderr, "[ERROR] Failed to create %s kernel: %d\n", names[i], err);
+            for (int j = 0; j < i; ++j) resources_.releaseKernel(kernels[j]);
+            resources_.releaseProgram(program);
+            return false;
+        }
+    }
+
+    ctx_.range_doppler_program = program;
+    ctx_.range_profiles_kernel = kernels[0];
+    ctx_.corner_turn_kernel = kernels[1];
+    ctx_.doppler_power_kernel = kernels[2];
+    ctx_.cfar_kernel = kernels[3];
+    return true;
+}
+
+size_t FFTHandler::step4_range_doppler(
+    const Correlator::RangeDopplerParams& params,
+    std::vector<float>* map,
+    std::vector<Correlator::RangeDopplerDetection>& detections,
+    OperationTiming& corner_turn_timing,
+    OperationTiming& fft_timing,
+    OperationTiming& detect_timing
+) {
+    if (step3_signals_ == 0) {
+        throw std::runtime_error("step4_range_doppler: run Step 3 first");
+    }
+    const size_t pulses = static_cast<size_t>(std::max(params.num_pulses, 0));
+    const size_t range_bins = static_cast<size_t>(std::max(params.range_bins, 0));
+    const size_t doppler_size = params.dopplerSize();
+    if (pulses == 0 || params.num_pulses > step3_signals_ || range_bins == 0 || range_bins > fft_size_ ||
+        doppler_size < pulses || params.shift < 0 || params.shift >= num_shifts_) {
+        throw std::runtime_error("step4_range_doppler: expected 1.." + std::to_string(step3_signals_) +
+                                 " pulses, 1.." + std::to_string(fft_size_) + " range bins, shift < " +
+                                 std::to_string(num_shifts_) + " and doppler_size >= pulses");
+    }
+
+    printf("[STEP 4] Range-Doppler: %zu pulses × %zu range bins -> %zu Doppler bins (%s window)%s...\n",
+           pulses, range_bins, doppler_size, Correlator::dopplerWindowName(params.window),
+           params.cfarEnabled() ? " + CA-CFAR" : "");
+    resources_.beginStep("Step3");
+
+    if (!build_range_doppler_program()) {
+        throw std::runtime_error("step4_range_doppler: range-Doppler program is unavailable");
+    }
+    if (ctx_.doppler_fft_plan && (doppler_plan_size_ != doppler_size || doppler_plan_batch_ != range_bins)) {
+        clfftDestroyPlan(&ctx_.doppler_fft_plan);
+        ctx_.doppler_fft_plan = 0;
+    }
+    if (!ctx_.doppler_fft_plan) {
+        ctx_.doppler_fft_plan = create_fft_plan_1d_inplace(doppler_size, static_cast<int>(range_bins),
+                                                           "Doppler FFT Plan");
+        doppler_plan_size_ = doppler_size;
+        doppler_plan_batch_ = range_bins;
+    }
+    if (ctx_.range_profile_plan && range_profile_plan_batch_ != pulses) {
+        clfftDestroyPlan(&ctx_.range_profile_plan);
+        ctx_.range_profile_plan = 0;
+    }
+    if (!ctx_.range_profile_plan) {
+        ctx_.range_profile_plan = create_fft_plan_1d_inplace(fft_size_, static_cast<int>(pulses),
+                                                             "Range Profile IFFT Plan");
+        range_profile_plan_batch_ = pulses;
+    }
+
+    // Спектры импульсов: слитый путь отложил их — досчитать
+    OperationTiming deferred_fft;
+    materialize_input_spectra(deferred_fft);
+
+    const size_t cells = range_bins * doppler_size;
+    const size_t max_detections = params.cfarEnabled() ? params.max_detections : 0;
+    const size_t detections_bytes = (4 + 4 * max_detections) * sizeof(cl_uint);
+    ensure_buffer_size(ctx_.doppler_window, pulses * sizeof(float), CL_MEM_READ_ONLY, "doppler_window");
+    ensure_buffer_size(ctx_.range_profiles, pulses * fft_size_ * sizeof(cl_float2), CL_MEM_READ_WRITE,
+                       "range_profiles");
+    ensure_buffer_size(ctx_.slow_time, cells * sizeof(cl_float2), CL_MEM_READ_WRITE, "slow_time");
+    ensure_buffer_size(ctx_.range_doppler_map, cells * sizeof(float), CL_MEM_READ_WRITE, "range_doppler_map");
+    ensure_buffer_size(ctx_.cfar_detections, detections_bytes, CL_MEM_READ_WRITE, "cfar_detections");
+
+    const std::vector<float> window = Correlator::dopplerWindowCoefficients(params.window, pulses);
+    cl_int err = clEnqueueWriteBuffer(ctx_.queue, ctx_.doppler_window, CL_TRUE, 0, pulses * sizeof(float),
+                                      window.data(), 0, nullptr, nullptr);
+    if (params.cfarEnabled()) {
+        const cl_uint zero = 0;
+        err |= clEnqueueWriteBuffer(ctx_.queue, ctx_.cfar_detections, CL_TRUE, 0, sizeof(zero), &zero,
+                                    0, nullptr, nullptr);
+    }
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to prepare range-Doppler buffers: " + std::to_string(err));
+    }
+
+    const cl_uint fft_size = static_cast<cl_uint>(fft_size_);
+    const cl_uint shift = static_cast<cl_uint>(params.shift);
+    const cl_uint pulses_arg = static_cast<cl_uint>(pulses);
+    const cl_uint range_arg = static_cast<cl_uint>(range_bins);
+    const cl_uint doppler_arg = static_cast<cl_uint>(doppler_size);
+    const cl_uint guard_arg = static_cast<cl_uint>(std::max(params.guard_cells, 0));
+    const cl_uint training_arg = static_cast<cl_uint>(std::max(params.training_cells, 0));
+    const cl_float scale_arg = params.threshold_scale;
+    const cl_uint max_arg = static_cast<cl_uint>(max_detections);
+    err = clSetKernelArg(ctx_.range_profiles_kernel, 0, sizeof(cl_mem), &ctx_.reference_fft);
+    err |= clSetKernelArg(ctx_.range_profiles_kernel, 1, sizeof(cl_mem), &ctx_.input_fft);
+    err |= clSetKernelArg(ctx_.range_profiles_kernel, 2, sizeof(cl_mem), &ctx_.range_profiles);
+    err |= clSetKernelArg(ctx_.range_profiles_kernel, 3, sizeof(cl_uint), &fft_size);
+    err |= clSetKernelArg(ctx_.range_profiles_kernel, 4, sizeof(cl_uint), &shift);
+    err |= clSetKernelArg(ctx_.corner_turn_kernel, 0, sizeof(cl_mem), &ctx_.range_profiles);
+    err |= clSetKernelArg(ctx_.corner_turn_kernel, 1, sizeof(cl_mem), &ctx_.doppler_window);
+    err |= clSetKernelArg(ctx_.corner_turn_kernel, 2, sizeof(cl_mem), &ctx_.slow_time);
+    err |= clSetKernelArg(ctx_.corner_turn_kernel, 3, sizeof(cl_uint), &fft_size);
+    err |= clSetKernelArg(ctx_.corner_turn_kernel, 4, sizeof(cl_uint), &pulses_arg);
+    err |= clSetKernelArg(ctx_.corner_turn_kernel, 5, sizeof(cl_uint), &range_arg);
+    err |= clSetKernelArg(ctx_.corner_turn_kernel, 6, sizeof(cl_uint), &doppler_arg);
+    err |= clSetKernelArg(ctx_.doppler_power_kernel, 0, sizeof(cl_mem), &ctx_.slow_time);
+    err |= clSetKernelArg(ctx_.doppler_power_kernel, 1, sizeof(cl_mem), &ctx_.range_doppler_map);
+    err |= clSetKernelArg(ctx_.doppler_power_kernel, 2, sizeof(cl_uint), &range_arg);
+    err |= clSetKernelArg(ctx_.doppler_power_kernel, 3, sizeof(cl_uint), &doppler_arg);
+    err |= clSetKernelArg(ctx_.cfar_kernel, 0, sizeof(cl_mem), &ctx_.range_doppler_map);
+    err |= clSetKernelArg(ctx_.cfar_kernel, 1, sizeof(cl_mem), &ctx_.cfar_detections);
+    err |= clSetKernelArg(ctx_.cfar_kernel, 2, sizeof(cl_uint), &range_arg);
+    err |= clSetKernelArg(ctx_.cfar_kernel, 3, sizeof(cl_uint), &doppler_arg);
+    err |= clSetKernelArg(ctx_.cfar_kernel, 4, sizeof(cl_uint), &guard_arg);
+    err |= clSetKernelArg(ctx_.cfar_kernel, 5, sizeof(cl_uint), &training_arg);
+    err |= clSetKernelArg(ctx_.cfar_kernel, 6, sizeof(cl_float), &scale_arg);
+    err |= clSetKernelArg(ctx_.cfar_kernel, 7, sizeof(cl_uint), &max_arg);
     if (err != CL_SUCCESS) {
-        fprintf(stderr, "ERROR: clEnqueueReadBuffer failed with error code: %d (CL_INVALID_VALUE)\n", err);
-        fprintf(stderr, "ERROR: Details: offset=%zu, size=%zu, post_params_size=%zu\n", 
-                post_params_size, peaks_size, post_params_size);
-        if (!ctx_.post_callback_userdata) {
-            fprintf(stderr, "ERROR: ctx_.post_callback_userdata is NULL!\n");
-        }
-        if (event_copy_data) clReleaseEvent(event_copy_data);
-        if (event_ifft) clReleaseEvent(event_ifft);
-        throw std::runtime_error("Failed to download results from post_callback_userdata");
+        throw std::runtime_error("Failed to set range-Doppler kernel arguments");
     }
-    
-    EventTiming download_event_timing = profile_event_detailed(event_download);
-    time_download_ms = download_event_timing.execute_ms;
-    download_timing.execute_ms = download_event_timing.execute_ms;
-    download_timing.queue_wait_ms = download_event_timing.queue_wait_ms;
-    download_timing.cpu_wait_ms = download_event_timing.wait_ms;
-    download_timing.total_gpu_ms = download_event_timing.total_ms;
-    printf("  [PROFILE] Download results: execute=%.3f ms, queue_wait=%.3f ms, wait=%.3f ms\n", 
-           download_event_timing.execute_ms, download_event_timing.queue_wait_ms, download_event_timing.wait_ms);
-    
-    // Wait for download to complete
-    if (event_download) {
-        err = clWaitForEvents(1, &event_download);
+
+    // Профили дальности → перестановка → FFT по импульсам → |·|² (→ CFAR), без возврата на хост
+    std::vector<cl_event> turn_events, detect_events;
+    cl_event event_profiles = nullptr, event_range_ifft = nullptr;
+    cl_event event_turn = nullptr, event_fft = nullptr, event_power = nullptr, event_cfar = nullptr;
+    auto release_all = [&]() {
+        for (cl_event event : turn_events) resources_.releaseEvent(event);
+        if (event_fft) resources_.releaseEvent(event_fft);
+        for (cl_event event : detect_events) resources_.releaseEvent(event);
+    };
+
+    size_t profiles_global[2] = {fft_size_, pulses};
+    err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.range_profiles_kernel, 2, nullptr, profiles_global, nullptr,
+                                 0, nullptr, &event_profiles);
+    if (err != CL_SUCCESS) {
+        throw std::runtime_error("Failed to enqueue range_profiles kernel: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_profiles, "Step4 range profiles");
+    turn_events.push_back(event_profiles);
+
+    clfftStatus profile_status = clfftEnqueueTransform(ctx_.range_profile_plan, CLFFT_BACKWARD, 1, &ctx_.queue,
+                                                       1, &event_profiles, &event_range_ifft, &ctx_.range_profiles,
+                                                       nullptr, nullptr);
+    if (profile_status != CLFFT_SUCCESS) {
+        release_all();
+        throw std::runtime_error("clfftEnqueueTransform failed for range profile IFFT");
+    }
+    resources_.trackEvent(event_range_ifft, "Step4 range profile IFFT");
+    turn_events.push_back(event_range_ifft);
+
+    auto round_up = [](size_t value, size_t multiple) { return (value + multiple - 1) / multiple * multiple; };
+    size_t turn_global[2] = {round_up(range_bins, kCornerTurnTile), round_up(doppler_size, kCornerTurnTile)};
+    size_t turn_local[2] = {kCornerTurnTile, kCornerTurnTile};
+    err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.corner_turn_kernel, 2, nullptr, turn_global, turn_local,
+                                 1, &event_range_ifft, &event_turn);
+    if (err != CL_SUCCESS) {
+        release_all();
+        throw std::runtime_error("Failed to enqueue corner_turn kernel: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_turn, "Step4 corner turn");
+    turn_events.push_back(event_turn);
+
+    clfftStatus fft_status = clfftEnqueueTransform(ctx_.doppler_fft_plan, CLFFT_FORWARD, 1, &ctx_.queue,
+                                                   1, &event_turn, &event_fft, &ctx_.slow_time, nullptr, nullptr);
+    if (fft_status != CLFFT_SUCCESS) {
+        release_all();
+        throw std::runtime_error("clfftEnqueueTransform failed for Doppler FFT");
+    }
+    resources_.trackEvent(event_fft, "Step4 Doppler FFT");
+
+    size_t map_global[2] = {doppler_size, range_bins};
+    err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.doppler_power_kernel, 2, nullptr, map_global, nullptr,
+                                 1, &event_fft, &event_power);
+    if (err != CL_SUCCESS) {
+        release_all();
+        throw std::runtime_error("Failed to enqueue doppler_power kernel: " + std::to_string(err));
+    }
+    resources_.trackEvent(event_power, "Step4 power");
+    detect_events.push_back(event_power);
+
+    if (params.cfarEnabled()) {
+        err = clEnqueueNDRangeKernel(ctx_.queue, ctx_.cfar_kernel, 2, nullptr, map_global, nullptr,
+                                     1, &event_power, &event_cfar);
         if (err != CL_SUCCESS) {
-            if (event_copy_data) clReleaseEvent(event_copy_data);
-            if (event_ifft) clReleaseEvent(event_ifft);
-            if (event_download) clReleaseEvent(event_download);
-            throw std::runtime_error("Failed to wait for download completion");
+            release_all();
+            throw std::runtime_error("Failed to enqueue cfar_range kernel: " + std::to_string(err));
         }
+        resources_.trackEvent(event_cfar, "Step4 CA-CFAR");
+        detect_events.push_back(event_cfar);
     }
-    
-    // Post-callback (find peaks) встроен в IFFT план, выполняется автоматически
-    // Извлечение пиков происходит внутри IFFT операции через clFFT callback
-    printf("  4. Post-callback (find peaks) встроен в IFFT план (выполняется автоматически)...\n");
-    
-    // Callback встроен в IFFT, его время включено в IFFT время
-    time_post_callback_ms = 0.0;
-    
-    // Release events
-    if (event_copy_data) clReleaseEvent(event_copy_data);
-    if (event_ifft) clReleaseEvent(event_ifft);
-    if (event_download) clReleaseEvent(event_download);
-    
-    printf("\n[OK] Step 3 completed!\n");
-    printf("  Output: %d × %d × %d correlations\n",
-           num_signals, num_shifts, n_kg);
-    printf("  Ready for results analysis\n\n");
+
+    // Скачиваются только запрошенная карта и детекции
+    cl_event last = detect_events.back();
+    if (map) {
+        map->resize(cells);
+        err = clEnqueueReadBuffer(ctx_.queue, ctx_.range_doppler_map, CL_FALSE, 0, cells * sizeof(float),
+                                  map->data(), 1, &last, nullptr);
+    }
+    size_t found = 0;
+    detections.clear();
+    if (err == CL_SUCCESS && params.cfarEnabled()) {
+        cl_uint count = 0;
+        err = clEnqueueReadBuffer(ctx_.queue, ctx_.cfar_detections, CL_TRUE, 0, sizeof(count), &count,
+                                  1, &last, nullptr);
+        found = count;
+        const size_t stored = std::min<size_t>(count, max_detections);
+        if (err == CL_SUCCESS && stored > 0) {
+            std::vector<cl_uint> records(4 * stored);
+            err = clEnqueueReadBuffer(ctx_.queue, ctx_.cfar_detections, CL_TRUE, 4 * sizeof(cl_uint),
+                                      records.size() * sizeof(cl_uint), records.data(), 0, nullptr, nullptr);
+            detections.resize(stored);
+            for (size_t i = 0; i < stored; ++i) {
+                detections[i].range = records[4 * i];
+                detections[i].doppler = records[4 * i + 1];
+                std::memcpy(&detections[i].power, &records[4 * i + 2], sizeof(float));
+                std::memcpy(&detections[i].noise, &records[4 * i + 3], sizeof(float));
+            }
+            Correlator::sortRangeDopplerDetections(detections);
+        }
+    }
+    if (err == CL_SUCCESS) {
+        err = clFinish(ctx_.queue);
+    }
+    if (err != CL_SUCCESS) {
+        release_all();
+        throw std::runtime_error("Failed to download range-Doppler results: " + std::to_string(err));
+    }
+
+    // Профили + IFFT + перестановка — одна фаза (подготовка медленного времени)
+    EventTiming turn_event_timing = profile_events_span(turn_events);
+    corner_turn_timing.execute_ms = turn_event_timing.execute_ms;
+    corner_turn_timing.queue_wait_ms = turn_event_timing.queue_wait_ms;
+    corner_turn_timing.cpu_wait_ms = turn_event_timing.wait_ms;
+    corner_turn_timing.total_gpu_ms = turn_event_timing.total_ms;
+    EventTiming fft_event_timing = profile_event_detailed(event_fft);
+    fft_timing.execute_ms = fft_event_timing.execute_ms;
+    fft_timing.queue_wait_ms = fft_event_timing.queue_wait_ms;
+    fft_timing.cpu_wait_ms = fft_event_timing.wait_ms;
+    fft_timing.total_gpu_ms = fft_event_timing.total_ms;
+    EventTiming detect_span = profile_events_span(detect_events);
+    detect_timing.execute_ms = detect_span.execute_ms;
+    detect_timing.queue_wait_ms = detect_span.queue_wait_ms;
+    detect_timing.cpu_wait_ms = detect_span.wait_ms;
+    detect_timing.total_gpu_ms = detect_span.total_ms;
+    printf("  [PROFILE] Range profiles + corner turn: %.3f ms; Doppler FFT: %.3f ms; power%s: %.3f ms\n",
+           turn_event_timing.execute_ms, fft_event_timing.execute_ms,
+           params.cfarEnabled() ? " + CFAR" : "", detect_span.execute_ms);
+    release_all();
+
+    printf("[OK] Step 4 completed: %zu × %zu map, %zu detection(s)\n\n", range_bins, doppler_size, found);
+    return found;
 }
 
 // ============================================================================
 // Get Correlation Results
 // ============================================================================
 
-std::vector<std::vector<std::vector<float>>> FFTHandler::get_correlation_results(
+bool FFTHandler::get_correlation_results(
+    std::span<float> output,
     int num_signals,
     int num_shifts,
     int n_kg
-) {
-    std::vector<std::vector<std::vector<float>>> results(
-        num_signals,
-        std::vector<std::vector<float>>(
-            num_shifts,
-            std::vector<float>(n_kg, 0.0f)
-        )
+) const {
+    if (!ctx_.initialized || !ctx_.post_callback_userdata) {
+        return false;
+    }
+
+    size_t count = static_cast<size_t>(num_signals) * num_shifts * n_kg;
+    if (output.size() != count) {
+        fprintf(stderr, "[ERROR] Peaks buffer size mismatch: %zu (expected %zu)\n", output.size(), count);
+        return false;
+    }
+
+    // Пики лежат в post_callback_userdata сразу после PostCallbackParams
+    size_t post_params_size = 6 * sizeof(cl_uint);  // 5 параметров + padding[1]
+
+    cl_int err = clEnqueueReadBuffer(
+        ctx_.queue,
+        ctx_.post_callback_userdata,
+        CL_TRUE,  // Blocking read
+        post_params_size,
+        count * sizeof(float),
+        output.data(),
+        0, nullptr, nullptr
     );
-    
-    // Download from GPU (will implement in step 3)
-    
-    return results;
+
+    return err == CL_SUCCESS;
+}
+
+// ============================================================================
+// Encode Correlation Results (сжатие пиков на устройстве)
+// ============================================================================
+
+// Одна рабочая группа на строку (signal, shift) для log-u16 и sparse-delta.
+// Форматы и эталонный CPU кодер: correlator/PeaksEncoding.hpp
+static const char* peaks_encode_source = R"(
+#define ENCODE_WG 256
+#define MAX_DETECTIONS 64
+#define PEAKS_OFFSET 6   // PostCallbackParams (24 байта) перед пиками в post_callback_userdata
+
+float row_max_reduce(__local float* scratch, float value, uint lid) {
+    scratch[lid] = value;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (uint s = ENCODE_WG / 2; s > 0; s >>= 1) {
+        if (lid < s) scratch[lid] = fmax(scratch[lid], scratch[lid + s]);
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    return scratch[0];
+}
+
+__kernel void encode_peaks_f16(__global const float* userdata, __global half* out, uint count) {
+    uint gid = get_global_id(0);
+    if (gid >= count) return;
+    vstore_half(userdata[PEAKS_OFFSET + gid], gid, out);
+}
+
+__kernel __attribute__((reqd_work_group_size(ENCODE_WG, 1, 1)))
+void encode_peaks_log_u16(__global const float* userdata, __global uchar* out, uint rows, uint n_kg) {
+    __local float scratch[ENCODE_WG];
+    uint row = get_group_id(0);
+    uint lid = get_local_id(0);
+    __global const float* in = userdata + PEAKS_OFFSET + (size_t)row * n_kg;
+
+    float m = 0.0f;
+    for (uint k = lid; k < n_kg; k += ENCODE_WG) m = fmax(m, in[k]);
+    float log_max = log1p(row_max_reduce(scratch, m, lid));
+
+    __global float* scales = (__global float*)out;
+    __global ushort* codes = (__global ushort*)(out + (size_t)rows * sizeof(float)) + (size_t)row * n_kg;
+    if (lid == 0) scales[row] = log_max;
+
+    float inv = log_max > 0.0f ? 65535.0f / log_max : 0.0f;
+    for (uint k = lid; k < n_kg; k += ENCODE_WG) {
+        codes[k] = (ushort)clamp(rint(log1p(fmax(in[k], 0.0f)) * inv), 0.0f, 65535.0f);
+    }
+}
+
+__kernel __attribute__((reqd_work_group_size(ENCODE_WG, 1, 1)))
+void encode_peaks_sparse(__global const float* userdata, __global ushort* out,
+                         uint n_kg, float threshold_ratio, uint slots) {
+    __local float scratch[ENCODE_WG];
+    uint row = get_group_id(0);
+    uint lid = get_local_id(0);
+    __global const float* in = userdata + PEAKS_OFFSET + (size_t)row * n_kg;
+
+    float m = 0.0f;
+    for (uint k = lid; k < n_kg; k += ENCODE_WG) m = fmax(m, in[k]);
+    float threshold = threshold_ratio * row_max_reduce(scratch, m, lid);
+    if (lid != 0) return;
+
+    // Top-K по магнитуде (при равенстве выигрывает меньшая задержка)
+    float mags[MAX_DETECTIONS];
+    uint lags[MAX_DETECTIONS];
+    uint count = 0;
+    for (uint k = 0; k < n_kg; ++k) {
+        float v = in[k];
+        if (!(v > 0.0f) || v < threshold) continue;
+        if (count == slots && v <= mags[slots - 1]) continue;
+        uint pos = count < slots ? count++ : slots - 1;
+        while (pos > 0 && mags[pos - 1] < v) {
+            mags[pos] = mags[pos - 1];
+            lags[pos] = lags[pos - 1];
+            --pos;
+        }
+        mags[pos] = v;
+        lags[pos] = k;
+    }
+
+    // По возрастанию задержки для дельта-кодирования
+    for (uint i = 1; i < count; ++i) {
+        for (uint j = i; j > 0 && lags[j - 1] > lags[j]; --j) {
+            uint l = lags[j - 1]; lags[j - 1] = lags[j]; lags[j] = l;
+            float t = mags[j - 1]; mags[j - 1] = mags[j]; mags[j] = t;
+        }
+    }
+
+    __global ushort* record = out + (size_t)row * (1 + 2 * slots);
+    record[0] = (ushort)count;
+    uint previous = 0;
+    for (uint i = 0; i < slots; ++i) {
+        if (i < count) {
+            record[1 + 2 * i] = (ushort)(lags[i] - previous);
+            vstore_half(mags[i], 2 + 2 * i, (__global half*)record);
+            previous = lags[i];
+        } else {
+            record[1 + 2 * i] = 0;
+            record[2 + 2 * i] = 0;
+        }
+    }
+}
+)";
+
+static constexpr size_t kEncodeWorkGroup = 256;
+
+bool FFTHandler::build_peaks_encode_program() {
+    if (ctx_.peaks_encode_program) {
+        return true;
+    }
+
+    cl_int err = CL_SUCCESS;
+    const char* source = peaks_encode_source;
+    cl_program program = resources_.createProgramWithSource(ctx_.context, 1, &source, nullptr, &err, "peaks_encode");
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create peaks encode program: %d\n", err);
+        return false;
+    }
+
+    err = clBuildProgram(program, 1, &ctx_.device, "", nullptr, nullptr);
+    if (err != CL_SUCCESS) {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &log_size);
+        std::vector<char> log(log_size + 1, '\0');
+        clGetProgramBuildInfo(program, ctx_.device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
+        fprintf(stderr, "[ERROR] Peaks encode program build failed:\n%s\n", log.data());
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    cl_kernel f16 = resources_.createKernel(program, "encode_peaks_f16", &err);
+    cl_kernel log_u16 = err == CL_SUCCESS ? resources_.createKernel(program, "encode_peaks_log_u16", &err) : nullptr;
+    cl_kernel sparse = err == CL_SUCCESS ? resources_.createKernel(program, "encode_peaks_sparse", &err) : nullptr;
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Failed to create peaks encode kernels: %d\n", err);
+        if (f16) resources_.releaseKernel(f16);
+        if (log_u16) resources_.releaseKernel(log_u16);
+        resources_.releaseProgram(program);
+        return false;
+    }
+
+    ctx_.peaks_encode_program = program;
+    ctx_.encode_f16_kernel = f16;
+    ctx_.encode_log_u16_kernel = log_u16;
+    ctx_.encode_sparse_kernel = sparse;
+    return true;
+}
+
+bool FFTHandler::encode_correlation_results(
+    const Correlator::PeaksEncodingParams& params,
+    int num_signals,
+    int num_shifts,
+    int n_kg,
+    Correlator::EncodedPeaks& output,
+    OperationTiming& download_timing
+) {
+    using Correlator::PeaksEncoding;
+
+    if (!ctx_.initialized || !ctx_.post_callback_userdata) {
+        return false;
+    }
+    if (!params.validate(n_kg)) {
+        fprintf(stderr, "[ERROR] Invalid peaks encoding parameters (max_detections=%d, n_kg=%d)\n",
+                params.max_detections, n_kg);
+        return false;
+    }
+
+    cl_uint rows = static_cast<cl_uint>(num_signals * num_shifts);
+    cl_uint row_len = static_cast<cl_uint>(n_kg);
+    cl_uint count = rows * row_len;
+    size_t bytes = Correlator::encodedPeaksBytes(params.encoding, rows, row_len, params.max_detections);
+
+    output.encoding = params.encoding;
+    output.num_signals = static_cast<uint32_t>(num_signals);
+    output.num_shifts = static_cast<uint32_t>(num_shifts);
+    output.n_kg = row_len;
+    output.max_detections = params.encoding == PeaksEncoding::SparseDelta ? params.max_detections : 0;
+    output.payload.resize(bytes);
+
+    // f32: кодировать нечего, читаем пики как есть
+    if (params.encoding == PeaksEncoding::Float32) {
+        download_timing = OperationTiming{};
+        std::span<float> peaks(reinterpret_cast<float*>(output.payload.data()), count);
+        return get_correlation_results(peaks, num_signals, num_shifts, n_kg);
+    }
+
+    if (!build_peaks_encode_program()) {
+        return false;
+    }
+
+    cl_int err = CL_SUCCESS;
+    if (ctx_.encoded_peaks_size < bytes) {
+        if (ctx_.encoded_peaks) {
+            resources_.releaseMemObject(ctx_.encoded_peaks);
+            ctx_.encoded_peaks = nullptr;
+            ctx_.encoded_peaks_size = 0;
+        }
+        ctx_.encoded_peaks = resources_.createBuffer(ctx_.context, CL_MEM_WRITE_ONLY, bytes, nullptr, &err, "encoded_peaks");
+        if (err != CL_SUCCESS) {
+            fprintf(stderr, "[ERROR] Failed to create encoded peaks buffer (%zu bytes): %d\n", bytes, err);
+            return false;
+        }
+        ctx_.encoded_peaks_size = bytes;
+    }
+
+    cl_kernel kernel = nullptr;
+    size_t global_size = 0;
+    size_t local_size = kEncodeWorkGroup;
+    switch (params.encoding) {
+        case PeaksEncoding::Float16:
+            kernel = ctx_.encode_f16_kernel;
+            clSetKernelArg(kernel, 0, sizeof(cl_mem), &ctx_.post_callback_userdata);
+            clSetKernelArg(kernel, 1, sizeof(cl_mem), &ctx_.encoded_peaks);
+            clSetKernelArg(kernel, 2, sizeof(cl_uint), &count);
+            global_size = ((count + local_size - 1) / local_size) * local_size;
+            break;
+
+        case PeaksEncoding::LogU16:
+            kernel = ctx_.encode_log_u16_kernel;
+            clSetKernelArg(kernel, 0, sizeof(cl_mem), &ctx_.post_callback_userdata);
+            clSetKernelArg(kernel, 1, sizeof(cl_mem), &ctx_.encoded_peaks);
+            clSetKernelArg(kernel, 2, sizeof(cl_uint), &rows);
+            clSetKernelArg(kernel, 3, sizeof(cl_uint), &row_len);
+            global_size = static_cast<size_t>(rows) * local_size;
+            break;
+
+        case PeaksEncoding::SparseDelta: {
+            cl_uint slots = static_cast<cl_uint>(params.max_detections);
+            cl_float threshold = params.detection_threshold;
+            kernel = ctx_.encode_sparse_kernel;
+            clSetKernelArg(kernel, 0, sizeof(cl_mem), &ctx_.post_callback_userdata);
+            clSetKernelArg(kernel, 1, sizeof(cl_mem), &ctx_.encoded_peaks);
+            clSetKernelArg(kernel, 2, sizeof(cl_uint), &row_len);
+            clSetKernelArg(kernel, 3, sizeof(cl_float), &threshold);
+            clSetKernelArg(kernel, 4, sizeof(cl_uint), &slots);
+            global_size = static_cast<size_t>(rows) * local_size;
+            break;
+        }
+
+        case PeaksEncoding::Float32:
+            break;
+    }
+
+    cl_event event_encode = nullptr;
+    cl_event event_read = nullptr;
+    err = clEnqueueNDRangeKernel(ctx_.queue, kernel, 1, nullptr, &global_size, &local_size,
+                                 0, nullptr, &event_encode);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Peaks encode kernel failed (code: %d)\n", err);
+        return false;
+    }
+    resources_.trackEvent(event_encode, "Step3 encode peaks");
+
+    err = clEnqueueReadBuffer(ctx_.queue, ctx_.encoded_peaks, CL_FALSE, 0, bytes,
+                              output.payload.data(), 1, &event_encode, &event_read);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "[ERROR] Encoded peaks download failed (code: %d)\n", err);
+        resources_.releaseEvent(event_encode);
+        return false;
+    }
+    resources_.trackEvent(event_read, "Step3 download encoded peaks");
+
+    EventTiming encode_timing = profile_event_detailed(event_encode);
+    EventTiming read_timing = profile_event_detailed(event_read);
+    download_timing.execute_ms = encode_timing.execute_ms + read_timing.execute_ms;
+    download_timing.queue_wait_ms = encode_timing.queue_wait_ms + read_timing.queue_wait_ms;
+    download_timing.cpu_wait_ms = encode_timing.wait_ms + read_timing.wait_ms;
+    download_timing.total_gpu_ms = encode_timing.total_ms + read_timing.total_ms;
+
+    printf("  [PROFILE] Encode peaks (%s): encode=%.3f ms, download=%.3f ms, %.2f KB (%.1fx)\n",
+           Correlator::peaksEncodingName(params.encoding), encode_timing.execute_ms, read_timing.execute_ms,
+           bytes / 1024.0, output.compressionRatio());
+
+    resources_.releaseEvent(event_encode);
+    resources_.releaseEvent(event_read);
+    return true;
 }
 
 // ============================================================================
@@ -1508,20 +4219,18 @@ std::vector<std::vector<std::vector<float>>> FFTHandler::get_correlation_results
 // ============================================================================
 
 void FFTHandler::cleanup() {
-  if(!ctx_.initialized)
+  // initialize() мог упасть посреди аллокаций: initialized ещё false,
+  // но часть буферов уже создана — их тоже нужно освободить
+  if(!ctx_.initialized && resources_.getLiveObjects().empty()) {
+    release_clfft_library();
     return;
+  }
   // ✅ ЗАЩИТА 1: Если уже вычищено - не трогаем!
   if (ctx_.is_cleaned_up) {
     printf("[FFT] Already cleaned up, skipping...\n");
     return;  // ← ВЫХОД ЗДЕСЬ!
   }
     
-  // ✅ ЗАЩИТА 2: Если не инициализировано - не трогаем!
-  if (!ctx_.initialized) {
-    printf("[FFT] Not initialized, skipping cleanup\n");
-    return;  // ← ВЫХОД ЗДЕСЬ!
-  }
-    
 
     printf("[FFT] Cleaning up GPU resources...\n");
     
@@ -1542,6 +4251,14 @@ void FFTHandler::cleanup() {
         ctx_.reference_fft_plan = 0;
     }
     
+    // Sub-buffer'ы частей батча Step 2 (удерживают input_data / input_fft)
+    for (std::vector<cl_mem>* parts : {&ctx_.input_data_parts, &ctx_.input_fft_parts}) {
+        for (cl_mem part : *parts) {
+            clReleaseMemObject(part);
+        }
+        parts->clear();
+    }
+    
     if (ctx_.input_fft_plan) {
         clfftStatus status = clfftDestroyPlan(&ctx_.input_fft_plan);
         if (status == CLFFT_SUCCESS) {
@@ -1562,17 +4279,31 @@ void FFTHandler::cleanup() {
         ctx_.correlation_ifft_plan = 0;
     }
     
+    clfftPlanHandle* corr2d_plans[] = {&ctx_.corr2d_template_plan, &ctx_.corr2d_image_plan, &ctx_.corr2d_inverse_plan,
+                                       &ctx_.doppler_fft_plan, &ctx_.range_profile_plan};
+    for (clfftPlanHandle* plan : corr2d_plans) {
+        if (*plan) {
+            clfftDestroyPlan(plan);
+            *plan = 0;
+        }
+    }
+    
+    if (ctx_.pairwise_ifft_plan) {
+        clfftStatus status = clfftDestroyPlan(&ctx_.pairwise_ifft_plan);
+        if (status == CLFFT_SUCCESS) {
+            printf("     ✓ Pairwise IFFT plan destroyed\n");
+        } else {
+            printf("     ✗ Failed to destroy pairwise IFFT plan (code: %d)\n", status);
+        }
+        ctx_.pairwise_ifft_plan = 0;
+    }
+    
     // ========================================================================
     // 1.5. TEARDOWN clFFT LIBRARY (После уничтожения всех планов!)
     // ========================================================================
     
     printf("  1.5. Tearing down clFFT library...\n");
-    clfftStatus teardown_status = clfftTeardown();
-    if (teardown_status == CLFFT_SUCCESS) {
-        printf("     ✓ clFFT library torn down\n");
-    } else {
-        printf("     ✗ Failed to teardown clFFT library (code: %d)\n", teardown_status);
-    }
+    release_clfft_library();
     
     // ========================================================================
     // 2. RELEASE GPU MEMORY BUFFERS (После разрушения планов!)
@@ -1581,7 +4312,7 @@ void FFTHandler::cleanup() {
     printf("  2. Releasing GPU memory buffers...\n");
     
     if (ctx_.reference_data) {
-        cl_int status = clReleaseMemObject(ctx_.reference_data);
+        cl_int status = resources_.releaseMemObject(ctx_.reference_data);
         if (status == CL_SUCCESS) {
             printf("     ✓ Reference data buffer released\n");
         } else {
@@ -1591,7 +4322,7 @@ void FFTHandler::cleanup() {
     }
     
     if (ctx_.reference_fft) {
-        cl_int status = clReleaseMemObject(ctx_.reference_fft);
+        cl_int status = resources_.releaseMemObject(ctx_.reference_fft);
         if (status == CL_SUCCESS) {
             printf("     ✓ Reference FFT buffer released\n");
         } else {
@@ -1601,7 +4332,7 @@ void FFTHandler::cleanup() {
     }
     
     if (ctx_.input_data) {
-        cl_int status = clReleaseMemObject(ctx_.input_data);
+        cl_int status = resources_.releaseMemObject(ctx_.input_data);
         if (status == CL_SUCCESS) {
             printf("     ✓ Input data buffer released\n");
         } else {
@@ -1611,7 +4342,7 @@ void FFTHandler::cleanup() {
     }
     
     if (ctx_.input_fft) {
-        cl_int status = clReleaseMemObject(ctx_.input_fft);
+        cl_int status = resources_.releaseMemObject(ctx_.input_fft);
         if (status == CL_SUCCESS) {
             printf("     ✓ Input FFT buffer released\n");
         } else {
@@ -1621,7 +4352,7 @@ void FFTHandler::cleanup() {
     }
     
     if (ctx_.correlation_fft) {
-        cl_int status = clReleaseMemObject(ctx_.correlation_fft);
+        cl_int status = resources_.releaseMemObject(ctx_.correlation_fft);
         if (status == CL_SUCCESS) {
             printf("     ✓ Correlation FFT buffer released\n");
         } else {
@@ -1631,7 +4362,7 @@ void FFTHandler::cleanup() {
     }
     
     if (ctx_.correlation_ifft) {
-        cl_int status = clReleaseMemObject(ctx_.correlation_ifft);
+        cl_int status = resources_.releaseMemObject(ctx_.correlation_ifft);
         if (status == CL_SUCCESS) {
             printf("     ✓ Correlation IFFT buffer released\n");
         } else {
@@ -1641,7 +4372,7 @@ void FFTHandler::cleanup() {
     }
     
     if (ctx_.pre_callback_userdata) {
-        cl_int status = clReleaseMemObject(ctx_.pre_callback_userdata);
+        cl_int status = resources_.releaseMemObject(ctx_.pre_callback_userdata);
         if (status == CL_SUCCESS) {
             printf("     ✓ Pre-callback userdata buffer released\n");
         } else {
@@ -1651,7 +4382,7 @@ void FFTHandler::cleanup() {
     }
     
     if (ctx_.post_callback_userdata) {
-        cl_int status = clReleaseMemObject(ctx_.post_callback_userdata);
+        cl_int status = resources_.releaseMemObject(ctx_.post_callback_userdata);
         if (status == CL_SUCCESS) {
             printf("     ✓ Post-callback userdata buffer released\n");
         } else {
@@ -1660,6 +4391,196 @@ void FFTHandler::cleanup() {
         ctx_.post_callback_userdata = nullptr;
     }
     
+    if (ctx_.pre_callback_userdata_correlation) {
+        cl_int status = resources_.releaseMemObject(ctx_.pre_callback_userdata_correlation);
+        if (status == CL_SUCCESS) {
+            printf("     ✓ Correlation pre-callback userdata buffer released\n");
+        } else {
+            printf("     ✗ Failed to release correlation pre-callback userdata (code: %d)\n", status);
+        }
+        ctx_.pre_callback_userdata_correlation = nullptr;
+    }
+    
+    if (ctx_.reference_callback_userdata) {
+        cl_int status = resources_.releaseMemObject(ctx_.reference_callback_userdata);
+        if (status == CL_SUCCESS) {
+            printf("     ✓ Reference plan callback userdata released\n");
+        } else {
+            printf("     ✗ Failed to release reference plan callback userdata (code: %d)\n", status);
+        }
+        ctx_.reference_callback_userdata = nullptr;
+    }
+    
+    if (ctx_.input_callback_userdata) {
+        cl_int status = resources_.releaseMemObject(ctx_.input_callback_userdata);
+        if (status == CL_SUCCESS) {
+            printf("     ✓ Input plan callback userdata released\n");
+        } else {
+            printf("     ✗ Failed to release input plan callback userdata (code: %d)\n", status);
+        }
+        ctx_.input_callback_userdata = nullptr;
+    }
+    
+    if (ctx_.encoded_peaks) {
+        cl_int status = resources_.releaseMemObject(ctx_.encoded_peaks);
+        if (status == CL_SUCCESS) {
+            printf("     ✓ Encoded peaks buffer released\n");
+        } else {
+            printf("     ✗ Failed to release encoded peaks buffer (code: %d)\n", status);
+        }
+        ctx_.encoded_peaks = nullptr;
+        ctx_.encoded_peaks_size = 0;
+    }
+    
+    cl_kernel* encode_kernels[] = {&ctx_.encode_f16_kernel, &ctx_.encode_log_u16_kernel, &ctx_.encode_sparse_kernel};
+    for (cl_kernel* kernel : encode_kernels) {
+        if (*kernel) {
+            resources_.releaseKernel(*kernel);
+            *kernel = nullptr;
+        }
+    }
+    if (ctx_.peaks_encode_program) {
+        resources_.releaseProgram(ctx_.peaks_encode_program);
+        ctx_.peaks_encode_program = nullptr;
+        printf("     ✓ Peaks encode program released\n");
+    }
+    
+    if (ctx_.convert_kernel) {
+        resources_.releaseKernel(ctx_.convert_kernel);
+        ctx_.convert_kernel = nullptr;
+    }
+    if (ctx_.converter_program) {
+        resources_.releaseProgram(ctx_.converter_program);
+        ctx_.converter_program = nullptr;
+        printf("     ✓ Step 2 converter program released\n");
+    }
+    
+    cl_mem* beam_buffers[] = {&ctx_.beam_weights, &ctx_.beam_fft};
+    for (cl_mem* buffer : beam_buffers) {
+        if (*buffer) {
+            resources_.releaseMemObject(*buffer);
+            *buffer = nullptr;
+        }
+    }
+    if (ctx_.beamform_kernel) {
+        resources_.releaseKernel(ctx_.beamform_kernel);
+        ctx_.beamform_kernel = nullptr;
+    }
+    if (ctx_.beamform_program) {
+        resources_.releaseProgram(ctx_.beamform_program);
+        ctx_.beamform_program = nullptr;
+        printf("     ✓ Beamform program released\n");
+    }
+    beam_channels_ = 0;
+    beam_count_ = 0;
+    
+    if (ctx_.fused_kernel) {
+        resources_.releaseKernel(ctx_.fused_kernel);
+        ctx_.fused_kernel = nullptr;
+    }
+    if (ctx_.fused_program) {
+        resources_.releaseProgram(ctx_.fused_program);
+        ctx_.fused_program = nullptr;
+        printf("     ✓ Fused correlation program released\n");
+    }
+    fused_enabled_ = false;
+    fused_input_pending_ = false;
+    
+    cl_mem* pairwise_buffers[] = {&ctx_.pair_table, &ctx_.pairwise_peaks};
+    for (cl_mem* buffer : pairwise_buffers) {
+        if (*buffer) {
+            resources_.releaseMemObject(*buffer);
+            *buffer = nullptr;
+        }
+    }
+    cl_kernel* pairwise_kernels[] = {&ctx_.pairwise_products_kernel, &ctx_.pairwise_lags_kernel};
+    for (cl_kernel* kernel : pairwise_kernels) {
+        if (*kernel) {
+            resources_.releaseKernel(*kernel);
+            *kernel = nullptr;
+        }
+    }
+    if (ctx_.pairwise_program) {
+        resources_.releaseProgram(ctx_.pairwise_program);
+        ctx_.pairwise_program = nullptr;
+        printf("     ✓ Pairwise program released\n");
+    }
+    pairwise_batch_ = 0;
+    pairwise_signals_ = 0;
+    
+    cl_mem* corr2d_buffers[] = {&ctx_.corr2d_input, &ctx_.corr2d_template_spectra, &ctx_.corr2d_image_spectra,
+                                &ctx_.corr2d_products, &ctx_.corr2d_surfaces, &ctx_.corr2d_records};
+    for (cl_mem* buffer : corr2d_buffers) {
+        if (*buffer) {
+            resources_.releaseMemObject(*buffer);
+            *buffer = nullptr;
+        }
+    }
+    cl_kernel* corr2d_kernels[] = {&ctx_.correlation2d_multiply_kernel, &ctx_.correlation2d_argmax_kernel};
+    for (cl_kernel* kernel : corr2d_kernels) {
+        if (*kernel) {
+            resources_.releaseKernel(*kernel);
+            *kernel = nullptr;
+        }
+    }
+    if (ctx_.correlation2d_program) {
+        resources_.releaseProgram(ctx_.correlation2d_program);
+        ctx_.correlation2d_program = nullptr;
+        printf("     ✓ 2D correlation program released\n");
+    }
+    corr2d_height_ = 0;
+    corr2d_width_ = 0;
+    corr2d_templates_ = 0;
+    corr2d_images_ = 0;
+    
+    cl_mem* range_doppler_buffers[] = {&ctx_.doppler_window, &ctx_.range_profiles, &ctx_.slow_time,
+                                       &ctx_.range_doppler_map, &ctx_.cfar_detections};
+    for (cl_mem* buffer : range_doppler_buffers) {
+        if (*buffer) {
+            resources_.releaseMemObject(*buffer);
+            *buffer = nullptr;
+        }
+    }
+    cl_kernel* range_doppler_kernels[] = {&ctx_.range_profiles_kernel, &ctx_.corner_turn_kernel,
+                                          &ctx_.doppler_power_kernel, &ctx_.cfar_kernel};
+    for (cl_kernel* kernel : range_doppler_kernels) {
+        if (*kernel) {
+            resources_.releaseKernel(*kernel);
+            *kernel = nullptr;
+        }
+    }
+    if (ctx_.range_doppler_program) {
+        resources_.releaseProgram(ctx_.range_doppler_program);
+        ctx_.range_doppler_program = nullptr;
+        printf("     ✓ Range-Doppler program released\n");
+    }
+    step3_signals_ = 0;
+    doppler_plan_size_ = 0;
+    doppler_plan_batch_ = 0;
+    range_profile_plan_batch_ = 0;
+    
+    release_reference_cache();
+    if (ctx_.reference_expand_kernel) {
+        resources_.releaseKernel(ctx_.reference_expand_kernel);
+        ctx_.reference_expand_kernel = nullptr;
+    }
+    if (ctx_.reference_decode_kernel) {
+        resources_.releaseKernel(ctx_.reference_decode_kernel);
+        ctx_.reference_decode_kernel = nullptr;
+    }
+    if (ctx_.reference_expand_program) {
+        resources_.releaseProgram(ctx_.reference_expand_program);
+        ctx_.reference_expand_program = nullptr;
+        printf("     ✓ Reference expand program released\n");
+    }
+    
+    // ========================================================================
+    // 2.5. DEVICE MEMORY REPORT + LEAK CHECK
+    // ========================================================================
+    
+    resources_.printMemoryReport();
+    resources_.reportLeaks();
+    
     // ========================================================================
     // 3. MARK AS CLEANED UP (ВАЖНО!)
     // ========================================================================
@@ -1930,31 +4851,7 @@ bool FFTHandler::getCorrelationPeaksData(std::vector<float>& output, int num_sig
     if (!ctx_.initialized || !ctx_.post_callback_userdata) {
         return false;
     }
-    
-    // Вычислить смещение для данных в post_callback_userdata (после параметров)
-    struct PostCallbackParams {
-        cl_uint n_signals;
-        cl_uint n_correlators;
-        cl_uint fft_size;
-        cl_uint n_kg;
-        cl_uint peak_search_range;
-        cl_uint padding[1];
-    };
-    size_t post_params_size = 6 * sizeof(cl_uint);  // 5 параметров + padding[1]
-    size_t peaks_size = num_signals * num_shifts * n_kg * sizeof(float);
-    
-    output.resize(num_signals * num_shifts * n_kg);
-    
-    cl_int err = clEnqueueReadBuffer(
-        ctx_.queue,
-        ctx_.post_callback_userdata,
-        CL_TRUE,  // Blocking read
-        post_params_size,  // Смещение (после параметров)
-        peaks_size,
-        output.data(),
-        0, nullptr, nullptr
-    );
-    
-    return err == CL_SUCCESS;
-}
 
+    output.resize(static_cast<size_t>(num_signals) * num_shifts * n_kg);
+    return get_correlation_results(output, num_signals, num_shifts, n_kg);
+}
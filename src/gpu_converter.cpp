@@ -1,4 +1,5 @@
 #include "gpu_converter.hpp"
+#include "cl_resource_tracker.hpp"
 #include <cstdio>
 #include <cstring>
 #include <fstream>
@@ -81,6 +82,12 @@ const char* get_cl_error_string(cl_int error) {
         return err; \
     }
 
+// Учёт программ, kernel'ов и буферов модуля конвертации (утечки выводятся в cleanup_gpu_context)
+static CLResourceTracker& converter_resources() {
+    static CLResourceTracker tracker("GPUConverter");
+    return tracker;
+}
+
 // ============================================================================
 // Initialization
 // ============================================================================
@@ -160,12 +167,13 @@ cl_int load_kernels(
     const char* source_ptr = source_code.c_str();
     size_t source_len = source_code.length();
     
-    cl_program program = clCreateProgramWithSource(
+    cl_program program = converter_resources().createProgramWithSource(
         ctx.context, 
         1, 
         &source_ptr, 
         &source_len, 
-        &err
+        &err,
+        kernel_file
     );
     CHECK_CL_ERROR(err, "clCreateProgramWithSource");
     
@@ -182,6 +190,7 @@ cl_int load_kernels(
         clGetProgramBuildInfo(program, ctx.device, CL_PROGRAM_BUILD_LOG, log_size, log.data(), nullptr);
         
         fprintf(stderr, "COMPILE ERROR:\n%s\n", log.data());
+        converter_resources().releaseProgram(program);
         return err;
     }
     
@@ -190,20 +199,20 @@ cl_int load_kernels(
     // Создать kernel объекты
     printf("[GPU] Creating kernel objects...\n");
     
-    ctx.kernel_convert_simple = clCreateKernel(program, "convert_int32_to_float2", &err);
+    ctx.kernel_convert_simple = converter_resources().createKernel(program, "convert_int32_to_float2", &err);
     CHECK_CL_ERROR(err, "clCreateKernel(convert_int32_to_float2)");
     
-    ctx.kernel_cyclic_shifts = clCreateKernel(program, "apply_cyclic_shifts", &err);
+    ctx.kernel_cyclic_shifts = converter_resources().createKernel(program, "apply_cyclic_shifts", &err);
     CHECK_CL_ERROR(err, "clCreateKernel(apply_cyclic_shifts)");
     
-    ctx.kernel_cyclic_shifts_batch = clCreateKernel(program, "apply_cyclic_shifts_batch", &err);
+    ctx.kernel_cyclic_shifts_batch = converter_resources().createKernel(program, "apply_cyclic_shifts_batch", &err);
     CHECK_CL_ERROR(err, "clCreateKernel(apply_cyclic_shifts_batch)");
     
-    ctx.kernel_fill_test_data = clCreateKernel(program, "fill_test_data", &err);
+    ctx.kernel_fill_test_data = converter_resources().createKernel(program, "fill_test_data", &err);
     CHECK_CL_ERROR(err, "clCreateKernel(fill_test_data)");
     
     // Освободить программу (kernel объекты их будут удерживать)
-    clReleaseProgram(program);
+    converter_resources().releaseProgram(program);
     
     printf("[OK] All kernels created successfully\n");
     return CL_SUCCESS;
@@ -212,15 +221,17 @@ cl_int load_kernels(
 void cleanup_gpu_context(GPUConverterContext& ctx) {
     printf("[GPU] Cleaning up GPU context...\n");
     
-    if (ctx.kernel_convert_simple) clReleaseKernel(ctx.kernel_convert_simple);
-    if (ctx.kernel_cyclic_shifts) clReleaseKernel(ctx.kernel_cyclic_shifts);
-    if (ctx.kernel_cyclic_shifts_batch) clReleaseKernel(ctx.kernel_cyclic_shifts_batch);
-    if (ctx.kernel_fill_test_data) clReleaseKernel(ctx.kernel_fill_test_data);
+    if (ctx.kernel_convert_simple) converter_resources().releaseKernel(ctx.kernel_convert_simple);
+    if (ctx.kernel_cyclic_shifts) converter_resources().releaseKernel(ctx.kernel_cyclic_shifts);
+    if (ctx.kernel_cyclic_shifts_batch) converter_resources().releaseKernel(ctx.kernel_cyclic_shifts_batch);
+    if (ctx.kernel_fill_test_data) converter_resources().releaseKernel(ctx.kernel_fill_test_data);
     
     if (ctx.queue) clReleaseCommandQueue(ctx.queue);
     if (ctx.profiling_queue) clReleaseCommandQueue(ctx.profiling_queue);
     if (ctx.context) clReleaseContext(ctx.context);
     
+    converter_resources().reportLeaks();
+    
     printf("[OK] GPU context cleaned up\n");
 }
 
@@ -552,8 +563,8 @@ void benchmark_gpu_conversion(
     
     // Выделить GPU память
     cl_int err;
-    cl_mem d_input = clCreateBuffer(ctx.context, CL_MEM_READ_ONLY, N * sizeof(int), nullptr, &err);
-    cl_mem d_output = clCreateBuffer(ctx.context, CL_MEM_WRITE_ONLY, N * sizeof(cl_float2), nullptr, &err);
+    cl_mem d_input = converter_resources().createBuffer(ctx.context, CL_MEM_READ_ONLY, N * sizeof(int), nullptr, &err, "benchmark d_input");
+    cl_mem d_output = converter_resources().createBuffer(ctx.context, CL_MEM_WRITE_ONLY, N * sizeof(cl_float2), nullptr, &err, "benchmark d_output");
     
     if (err != CL_SUCCESS) {
         fprintf(stderr, "ERROR: Cannot allocate GPU memory\n");
@@ -572,6 +583,6 @@ void benchmark_gpu_conversion(
     printf("\n");
     
     // Очистить
-    clReleaseMemObject(d_input);
-    clReleaseMemObject(d_output);
+    converter_resources().releaseMemObject(d_input);
+    converter_resources().releaseMemObject(d_output);
 }
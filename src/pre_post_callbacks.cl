@@ -8,7 +8,8 @@
 //
 // ============================================================================
 
-#define PRE_CALLBACK_KERNEL_SOURCE R"(
+// int32_t не входит в OpenCL C — объявляем, чтобы файл собирался отдельно
+typedef int int32_t;
 
 // Pre-callback: Convert int32 input to float2 (complex)
 __kernel void pre_callback_kernel(
@@ -32,8 +33,6 @@ __kernel void pre_callback_kernel(
     output[gid] = (float2)(real, imag);
 }
 
-)"
-
 // ============================================================================
 // EMBEDDED PRE-CALLBACK FUNCTION (for clFFT)
 // ============================================================================
@@ -192,4 +191,3 @@ __kernel void post_callback_find_peaks(
         peaks_output[output_idx + k] = 0.0f;
     }
 }
-")
\ No newline at end of file
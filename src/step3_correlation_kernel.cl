@@ -1,7 +1,3 @@
-#include "fft_handler.hpp"
-#include <cstdio>
-#include <cstring>
-
 // ============================================================================
 // STEP 3: Correlation (Multiply + IFFT + Post-callback)
 // ============================================================================